@@ -8,9 +8,14 @@
 #include <algorithm>
 #include <map>
 #include <sstream>
+#include <fstream>
 #include <numeric>
 #include <string>
 #include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <cstdlib>
+#include <limits>
 
 //
 // IMS Stuff
@@ -18,14 +23,26 @@
 #include <ims/alphabet.h>
 #include <ims/weights.h>
 #include <ims/isotopedistribution.h>
+#include <ims/isotopedistributioncache.h>
+#include <ims/isotopedistributionfolder.h>
 #include <ims/distributionprobabilityscorer.h>
 #include <ims/composedelement.h>
+#include <ims/composition.h>
+#include <ims/adduct.h>
+#include <ims/finestructurecalculator.h>
+#include <ims/resolvedpatterncalculator.h>
 #include <ims/nitrogenrulefilter.h>
+#include <ims/chemicalrules.h>
 #include <ims/utils/math.h>
 #include <ims/base/exception/ioexception.h>
 #include <ims/decomp/realmassdecomposer.h>
 #include <ims/decomp/integermassdecomposer.h>
 #include <ims/decomp/decomputils.h>
+#include <ims/decomp/decompositionconstraints.h>
+#include <ims/decomp/formulaindex.h>
+#include <ims/utils/logsumexp.h>
+#include <ims/utils/lrucache.h>
+#include <ims/utils/threadpool.h>
 
 //
 // R Stuff
@@ -44,14 +61,20 @@ typedef Alphabet alphabet_t;
 typedef IsotopeDistribution distribution_t;
 typedef IntegerMassDecomposer<>::decompositions_type decompositions_t;
 
-void initializeCHNOPS(alphabet_t&, 
-		      const int maxisotopes);
-void initializeAlphabet(const SEXP l_alphabet, 
-			alphabet_t &alphabet, 
-			const int maxisotopes);
+distribution_t::settings_type initializeCHNOPS(alphabet_t&, 
+					      const int maxisotopes);
+distribution_t::settings_type initializeAlphabet(const SEXP l_alphabet, 
+						alphabet_t &alphabet, 
+						const int maxisotopes);
+SEXP getListElement(SEXP list, char const *str);
 
 template <typename score_type>
-SEXP  rlistScores(multimap<score_type, ComposedElement, greater<score_type> > scores, int z);
+SEXP  rlistScores(multimap<score_type, ComposedElement, greater<score_type> > scores, int z,
+		  const vector<score_type>* log_scores = NULL);
+
+NumericMatrix rmatrixSpecies(const IsotopeSpecies& species);
+
+ThreadPool& getThreadPool();
 
 // }}}
 
@@ -61,8 +84,6 @@ SEXP rlistDecompositions(const decompositions_t& decompositions,
 			  const alphabet_t& alphabet, const Weights& weights,
 			  MassType mass, unsigned int maxNumber);
 
-char* exceptionMesg=NULL;
-
 float getDBE(const ComposedElement& molecule, int z) {
   // {{{ 
 
@@ -116,65 +137,999 @@ bool isValidMyNitrogenRule(const ComposedElement& molecule, int z) {
 }
 // }}}
 
-bool isWithinElementRange(const ComposedElement& molecule, const ComposedElement& minElements, const ComposedElement& maxElements) {
+RealMassDecomposer::bounds_type getDecompositionBounds(const alphabet_t& alphabet, 
+						       const Composition& minElements, 
+						       const Composition& maxElements) {
 // {{{
 
-//iterating over Elements present in minElements
-  for (ComposedElement::container::const_iterator it = minElements.getElements().begin();
-       it != minElements.getElements().end(); ++it) {
+  // bounds are indexed like the alphabet (and the weights of the decomposer)
+  RealMassDecomposer::bounds_type bounds;
+  for (alphabet_t::size_type i = 0; i < alphabet.size(); ++i) {
+    bounds.lower.push_back(minElements[i]);
 
-    int mincount = static_cast<int>(minElements.getElementAbundance((it->first).getName()));
+    // Elements not present in maxElements (or with a count of 0) are not bounded
+    // TODO: Fails e.g. for "C2N0" 
+    unsigned int maxcount = maxElements[i];
+    bounds.upper.push_back(maxcount > 0 ? maxcount : numeric_limits<unsigned int>::max());
+  }
 
-    int count = static_cast<int>(molecule.getElementAbundance((it->first).getName()));
+  return bounds;
+}
+// }}}
 
-      if (count < mincount) {
-	return false;
-      }
+DecompositionConstraints getChemicalRules(const alphabet_t& alphabet, const Weights& weights,
+					  SEXP l_filter, int z) {
+// {{{
+
+  // rules are selected by name, see .chemicalRules() in R/decomposeIsotopes.R;
+  // they are checked while decomposing, in this order
+  DecompositionConstraints constraints(weights);
 
+  SEXP dbe = getListElement(l_filter, "DBE");
+  if (dbe != R_NilValue) {
+    if (Rf_length(dbe) != 2) {
+      throw invalid_argument("the DBE filter has to be a range c(min, max)");
+    }
+    ChemicalRules::addDoubleBondEquivalentRule(constraints, alphabet, REAL(dbe)[0], REAL(dbe)[1]);
   }
-  
-  //must iterate over Elements present in molecule and ignore cases of Elements not defined in maxElements
-  for (ComposedElement::container::const_iterator it = maxElements.getElements().begin(); 
-       it != maxElements.getElements().end(); ++it) {
-    
-    int maxcount = static_cast<int>(maxElements.getElementAbundance((it->first).getName()));
-    
-    int count = static_cast<int>(molecule.getElementAbundance((it->first).getName()));
-    
-    // TODO: Fails e.g. for "C2N0" 
-    if (maxcount>0 && count > maxcount) {
-      return false;
+  if (Rf_asLogical(getListElement(l_filter, "integerDBE")) == TRUE) {
+    ChemicalRules::addIntegerDoubleBondEquivalentRule(constraints, alphabet);
+  }
+  if (Rf_asLogical(getListElement(l_filter, "nitrogen")) == TRUE) {
+    ChemicalRules::addNitrogenRule(constraints, alphabet, z);
+  }
+  if (Rf_asLogical(getListElement(l_filter, "senior")) == TRUE) {
+    ChemicalRules::addSeniorRules(constraints, alphabet);
+  }
+  if (Rf_asLogical(getListElement(l_filter, "ratios")) == TRUE) {
+    ChemicalRules::addElementRatioRules(constraints, alphabet);
+  }
+
+  return constraints;
+}
+// }}}
+
+SEXP rlistFilterStatistics(const DecompositionConstraints& constraints,
+			   const DecompositionConstraints::statistics_type& statistics) {
+// {{{
+
+  vector<string> rule;
+  vector<double> pruned, discarded;
+  for (DecompositionConstraints::size_type i = 0; i < constraints.getNumberOfRules(); ++i) {
+    rule.push_back(constraints.getRuleName(i));
+    pruned.push_back(static_cast<double>(statistics.pruned[i]));
+    discarded.push_back(static_cast<double>(statistics.discarded[i]));
+  }
+
+  return DataFrame::create(_["rule"] = rule,
+			   _["pruned"] = pruned,
+			   _["discarded"] = discarded,
+			   _["stringsAsFactors"] = false);
+}
+// }}}
+
+//
+// Decomposer contexts: alphabet, weights and extended residue table
+// are built once per alphabet and reused for many masses
+//
+
+Weights createWeights(const alphabet_t& alphabet, double precision) {
+// {{{
+
+	// initializes weights
+	Weights weights(alphabet.getMasses(), precision);
+
+	// checks if weights could become smaller, by dividing on gcd.
+	weights.divideByGCD();
+
+	return weights;
+}
+
+// }}}
+
+struct DecomposerContext {
+// {{{
+
+	// maps the extended residue table from residues_file, if given,
+	// otherwise computes it with the threads of pool
+	DecomposerContext(const alphabet_t& alphabet, const vector<string>& elements_order,
+			  const distribution_t::settings_type& settings, double precision,
+			  const string& residues_file, ThreadPool& pool) :
+		alphabet(alphabet), elements_order(elements_order), settings(settings),
+		weights(createWeights(alphabet, precision)),
+		decomposer(residues_file.empty() ? RealMassDecomposer(weights, pool) :
+			   RealMassDecomposer(weights, residues_file)) {}
+
+	alphabet_t alphabet;
+	vector<string> elements_order;
+	// isotope distributions of candidates are folded with these settings
+	distribution_t::settings_type settings;
+	Weights weights;
+	RealMassDecomposer decomposer;
+	// element distributions folded with themselves, shared by the candidates
+	// of all calls (and threads) using this context
+	mutable IsotopeDistributionCache element_powers;
+};
+
+typedef std::shared_ptr<DecomposerContext> decomposer_context_t;
+
+// Contexts of the most recently used alphabets
+LRUCache<string, decomposer_context_t> decomposer_contexts(16);
+
+// Precision of the masses of contexts not created by initializeDecomposer
+const double DEFAULT_PRECISION = 1.0e-05;
+
+// deviation (in log10) of the isotope ratios of a formula index, which are
+// stored as floats, from the ones of the folded distributions
+const double ISOTOPE_RATIO_TOLERANCE = 1.0e-06;
+
+// }}}
+
+string getAlphabetKey(SEXP l_alphabet, SEXP v_element_order, 
+		      int maxisotopes, double precision) {
+// {{{
+
+  ostringstream key;
+  key << setprecision(17) << precision << ';' << maxisotopes << ';';
+
+  if (l_alphabet == NULL || Rf_length(l_alphabet) < 1  ) {
+    key << "CHNOPS";
+    return key.str();
+  }
+
+  for (int i=0; i < Rf_length(l_alphabet); i++) {
+    SEXP l = VECTOR_ELT(l_alphabet,i);
+    SEXP isotope = getListElement(l, "isotope");	
+    int numisotopes = Rf_length(getListElement(isotope, "mass"));
+    double *mass = REAL(getListElement(isotope, "mass"));	
+    double *abundance = REAL(getListElement(isotope, "abundance"));	
+
+    key << CHAR(Rf_asChar(getListElement(l, "name"))) << ':' 
+	<< REAL(getListElement(l, "mass"))[0];
+    for (int j=0; j<numisotopes; j++) {
+      key << ':' << mass[j] << '/' << abundance[j];
+    }
+    key << ';';
+  }
+
+  key << '|';
+  for (int i=0; i < Rf_length(v_element_order); i++) {
+    key << CHAR(STRING_ELT(v_element_order,i)) << ';';
+  }
+  return key.str();
+}
+
+// }}}
+
+decomposer_context_t createDecomposerContext(SEXP l_alphabet, SEXP v_element_order, 
+					     int maxisotopes, double precision,
+					     const string& residues_file) {
+// {{{
+
+  alphabet_t alphabet;
+  vector<string> elements_order;
+  distribution_t::settings_type settings;
+
+  if (l_alphabet == NULL || Rf_length(l_alphabet) < 1  ) {
+    settings = initializeCHNOPS(alphabet, maxisotopes); 
+    // initializes order of atoms in which one would
+    // like them to appear in the molecules sequence
+    elements_order.push_back("C");
+    elements_order.push_back("H");
+    elements_order.push_back("N");
+    elements_order.push_back("O");
+    elements_order.push_back("P");
+    elements_order.push_back("S");
+  } else {
+    settings = initializeAlphabet(l_alphabet, alphabet, maxisotopes);
+	  
+    int element_length = Rf_length(v_element_order);
+    for (int i=0; i<element_length; i++) {
+      elements_order.push_back(string(CHAR(STRING_ELT(v_element_order,i))));
     }
   }
 
-  return true;
+  return decomposer_context_t(new DecomposerContext(alphabet, elements_order, 
+						    settings, precision, residues_file,
+						    getThreadPool()));
+}
+
+// }}}
+
+void finalizeDecomposerContext(SEXP x_decomposer) {
+// {{{
+
+  decomposer_context_t *context = 
+    static_cast<decomposer_context_t*>(R_ExternalPtrAddr(x_decomposer));
+  delete context;
+  R_ClearExternalPtr(x_decomposer);
 }
+
+// }}}
+
+decomposer_context_t getDecomposerContext(SEXP x_decomposer, SEXP l_alphabet, 
+					  SEXP v_element_order, int maxisotopes,
+					  const string& residues_file = string(),
+					  double precision = DEFAULT_PRECISION) {
+// {{{
+
+  decomposer_context_t context;
+
+  if (TYPEOF(x_decomposer) == EXTPTRSXP) {
+    // uses a decomposer handle created by initializeDecomposer
+    decomposer_context_t *handle = 
+      static_cast<decomposer_context_t*>(R_ExternalPtrAddr(x_decomposer));
+    if (handle == NULL) {
+      throw invalid_argument("decomposer is not initialized (was it saved and restored?)");
+    }
+    context = *handle;
+  } else {
+    string key = getAlphabetKey(l_alphabet, v_element_order, maxisotopes, precision);
+    decomposer_context_t *cached = decomposer_contexts.find(key);
+    // an existing file of residues is mapped, otherwise the residue table
+    // is computed (or taken from the cache) and saved to it
+    bool exists = !residues_file.empty() && ifstream(residues_file.c_str()).good();
+    if (cached != NULL) {
+      context = *cached;
+    } else {
+      context = createDecomposerContext(l_alphabet, v_element_order, maxisotopes, precision,
+					exists ? residues_file : string());
+      decomposer_contexts.insert(key, context);
+    }
+    if (!residues_file.empty() && !exists) {
+      context->decomposer.save(residues_file);
+    }
+  }
+
+  return context;
+}
+
+// }}}
+
+RcppExport SEXP initializeDecomposer(SEXP l_alphabet, SEXP v_element_order, 
+				     SEXP i_maxisotopes, SEXP s_file, SEXP n_precision) {
+// {{{
+
+  SEXP x_decomposer = R_NilValue;
+  try {
+    string file = (s_file == R_NilValue) ? string() : string(CHAR(Rf_asChar(s_file)));
+    decomposer_context_t context = getDecomposerContext(R_NilValue, l_alphabet, 
+							v_element_order, 
+							Rf_asInteger(i_maxisotopes),
+							file, Rf_asReal(n_precision));
+
+    x_decomposer = PROTECT(R_MakeExternalPtr(new decomposer_context_t(context), 
+					     R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(x_decomposer, finalizeDecomposerContext, TRUE);
+    Rf_setAttrib(x_decomposer, R_ClassSymbol, Rf_mkString("RdisopDecomposer"));
+    UNPROTECT(1);
+  } catch(std::exception& ex) {
+    forward_exception_to_r(ex);
+  } catch(...) {
+    ::Rf_error("%s", "c++ exception (unknown reason)");
+  }
+
+  return x_decomposer;
+}
+
+// }}}
+
+//
+// Threads used for decomposing and scoring
+//
+
+// Pool of the last call, recreated when the number of threads changes
+unique_ptr<ThreadPool> thread_pool;
+
+int getNumberOfThreads() {
+// {{{
+
+  // options(Rdisop.threads=) takes precedence over OMP_NUM_THREADS
+  SEXP option = Rf_GetOption1(Rf_install("Rdisop.threads"));
+  if (option != R_NilValue && Rf_length(option) > 0) {
+    int threads = Rf_asInteger(option);
+    return (threads == NA_INTEGER || threads < 1) ? 1 : threads;
+  }
+
+  const char* omp_threads = getenv("OMP_NUM_THREADS");
+  if (omp_threads != NULL) {
+    int threads = atoi(omp_threads);
+    return (threads < 1) ? 1 : threads;
+  }
+
+  return 1;
+}
+
+// }}}
+
+ThreadPool& getThreadPool() {
+// {{{
+
+  // must be called from the R thread, since it reads the options
+  ThreadPool::size_type threads = getNumberOfThreads();
+  if (!thread_pool || thread_pool->size() != threads) {
+    thread_pool.reset();
+    thread_pool.reset(new ThreadPool(threads));
+  }
+  return *thread_pool;
+}
+
+// }}}
+
+//
+// Formula indices: all formulas of a mass range over the alphabet of a 
+// decomposer context, looked up instead of decomposing
+//
+
+struct FormulaIndexContext {
+// {{{
+
+	FormulaIndexContext(const decomposer_context_t& context, FormulaIndex&& index) :
+		context(context), index(std::move(index)) {}
+
+	decomposer_context_t context;
+	FormulaIndex index;
+};
+
+typedef std::shared_ptr<FormulaIndexContext> formula_index_context_t;
+
+// }}}
+
+string getIndexParameters(double min_mass, double max_mass, SEXP l_filter, 
+			  SEXP s_minElements, SEXP s_maxElements, int z) {
+// {{{
+
+  // an index file is only used with the mass range, bounds and rules it was built with
+  ostringstream parameters;
+  parameters << setprecision(17) << "mass=" << min_mass << ',' << max_mass
+	     << ";min=" << CHAR(Rf_asChar(s_minElements)) 
+	     << ";max=" << CHAR(Rf_asChar(s_maxElements)) << ";z=" << z;
+  SEXP names = Rf_getAttrib(l_filter, R_NamesSymbol);
+  for (int i = 0; i < Rf_length(l_filter); ++i) {
+    SEXP rule = PROTECT(Rf_coerceVector(VECTOR_ELT(l_filter, i), REALSXP));
+    parameters << ';' << CHAR(STRING_ELT(names, i)) << '=';
+    for (int j = 0; j < Rf_length(rule); ++j) {
+      parameters << (j > 0 ? "," : "") << REAL(rule)[j];
+    }
+    UNPROTECT(1);
+  }
+  return parameters.str();
+}
+
+// }}}
+
+void finalizeFormulaIndexContext(SEXP x_index) {
+// {{{
+
+  formula_index_context_t *context = 
+    static_cast<formula_index_context_t*>(R_ExternalPtrAddr(x_index));
+  delete context;
+  R_ClearExternalPtr(x_index);
+}
+
+// }}}
+
+formula_index_context_t getFormulaIndexContext(SEXP x_index) {
+// {{{
+
+  formula_index_context_t context;
+  if (TYPEOF(x_index) == EXTPTRSXP) {
+    formula_index_context_t *handle = 
+      static_cast<formula_index_context_t*>(R_ExternalPtrAddr(x_index));
+    if (handle == NULL) {
+      throw invalid_argument("formula index is not initialized (was it saved and restored?)");
+    }
+    context = *handle;
+  }
+  return context;
+}
+
+// }}}
+
+RcppExport SEXP initializeFormulaIndex(SEXP s_minMass, SEXP s_maxMass, 
+				       SEXP l_alphabet, SEXP v_element_order, 
+				       SEXP z, SEXP i_maxisotopes,
+				       SEXP s_minElements, SEXP s_maxElements,
+				       SEXP l_filter, SEXP s_file) {
+// {{{
+
+  SEXP x_index = R_NilValue;
+  try {
+    // the index shares alphabet and decomposer with decomposeMass()
+    decomposer_context_t context = getDecomposerContext(R_NilValue, l_alphabet, 
+							v_element_order, 
+							Rf_asInteger(i_maxisotopes));
+    Composition minElements(CHAR(Rf_asChar(s_minElements)), context->alphabet);
+    Composition maxElements(CHAR(Rf_asChar(s_maxElements)), context->alphabet);
+    double min_mass = Rf_asReal(s_minMass);
+    double max_mass = Rf_asReal(s_maxMass);
+    int charge = Rf_asInteger(z);
+    string parameters = getIndexParameters(min_mass, max_mass, l_filter, 
+					   s_minElements, s_maxElements, charge);
+
+    // an existing file is mapped, otherwise the index is built (and saved)
+    string file = (s_file == R_NilValue) ? string() : string(CHAR(Rf_asChar(s_file)));
+    formula_index_context_t index_context;
+    if (!file.empty() && ifstream(file.c_str()).good()) {
+      index_context.reset(new FormulaIndexContext(context, 
+			    FormulaIndex(file, context->alphabet, parameters)));
+    } else {
+      DecompositionConstraints constraints = getChemicalRules(context->alphabet, context->weights,
+								  l_filter, charge);
+      index_context.reset(new FormulaIndexContext(context, 
+			    FormulaIndex(context->alphabet, context->decomposer,
+					 min_mass, max_mass,
+					 getDecompositionBounds(context->alphabet, minElements, maxElements),
+					 constraints, parameters, getThreadPool())));
+      if (!file.empty()) {
+	index_context->index.save(file);
+      }
+    }
+
+    const FormulaIndex& index = index_context->index;
+    x_index = PROTECT(R_MakeExternalPtr(new formula_index_context_t(index_context), 
+					R_NilValue, R_NilValue));
+    R_RegisterCFinalizerEx(x_index, finalizeFormulaIndexContext, TRUE);
+    Rf_setAttrib(x_index, R_ClassSymbol, Rf_mkString("RdisopFormulaIndex"));
+    Rf_setAttrib(x_index, Rf_install("formulas"), Rf_ScalarReal(static_cast<double>(index.size())));
+    SEXP range = PROTECT(Rf_allocVector(REALSXP, 2));
+    REAL(range)[0] = index.getMinMass();
+    REAL(range)[1] = index.getMaxMass();
+    Rf_setAttrib(x_index, Rf_install("massRange"), range);
+    UNPROTECT(2);
+  } catch(std::exception& ex) {
+    forward_exception_to_r(ex);
+  } catch(...) {
+    ::Rf_error("%s", "c++ exception (unknown reason)");
+  }
+
+  return x_index;
+}
+
 // }}}
 
 //
 // Decomposition of Mass / Isotope Pattern
 //
 
-RcppExport SEXP decomposeIsotopes(SEXP v_masses, SEXP v_abundances, SEXP s_error, 
-				  SEXP l_alphabet, SEXP v_element_order, 
-				  SEXP z, SEXP i_maxisotopes,
-				  SEXP s_minElements, SEXP s_maxElements) {
+typedef DistributionProbabilityScorer::score_type score_t;
+typedef multimap<score_t, ComposedElement, greater<score_t> > scores_t;
+
+int getMaxCandidates(SEXP i_maxCandidates) {
+// {{{
+
+  int max_candidates = Rf_asInteger(i_maxCandidates);
+  if (max_candidates == NA_INTEGER || max_candidates < 0) {
+    throw invalid_argument("maxCandidates has to be a non-negative number");
+  }
+  return max_candidates;
+}
+
+// }}}
+
+// How the measured pattern was ionized: its masses as masses of the uncharged
+// ion, and the number of molecules in the ion and the atoms added to them, by
+// which the ion of a candidate molecule is folded. Without an adduct the pattern
+// is the one of a single molecule.
+struct IonHypothesis {
+	typedef DistributionProbabilityScorer::masses_container masses_container;
+
+	// name of the adduct, empty without one
+	string adduct;
+	int charge;
+	unsigned int mass_factor;
+	// isotope distribution and monoisotopic mass of the added atoms, if any
+	bool has_added;
+	distribution_t added;
+	double added_mass;
+	masses_container masses;
+	// mass of the molecule to be decomposed and its absolute error
+	double mass;
+	double error;
+};
+
+// Candidate composition and its full isotope distribution with the non-normalized
+// score (its logarithm when scoring in log space), position counts the candidates
+// scored before it by the same visitor
+struct Candidate {
+	score_t score;
+	vector<IonHypothesis>::size_type hypothesis;
+	decompositions_t::size_type position;
+	Composition composition;
+	distribution_t distribution;
+};
+
+// Orders candidates by decreasing score, ties in the order they were scored
+// (as the multimap of scores does)
+struct BetterCandidate {
+	bool operator()(const Candidate& left, const Candidate& right) const {
+		return left.score > right.score || 
+			(left.score == right.score && left.position < right.position);
+	}
+};
+
+// Scores the decompositions of one branch of the traversal as they are found,
+// keeping only the max_candidates best ones in a heap (all if max_candidates is 0)
+// and summing up the scores of all of them for normalization.
+// Scoring is staged, cheapest first: once the heap is full, candidates whose
+// monoisotopic mass alone scores 0 are dropped before folding their isotope
+// distribution, and only the peaks compared with the measured ones are folded.
+// Compositions and full isotope distributions are built for kept candidates only,
+// molecules with element names for the reported ones.
+// In log space, scores do not underflow and are summed up by log-sum-exp. As
+// every term of a log score is at most 0, partial sums bound it from above:
+// candidates are dropped as soon as their bound neither reaches the heap nor
+// changes the accumulated sum.
+// Candidates are scored by the pattern of their ion under the given hypothesis,
+// their molecules are reported.
+// Candidates looked up in a formula index come with the ratios of their M+1
+// and M+2 peaks, which bound the score before folding as well.
+struct CandidateScorer {
+	typedef DistributionProbabilityScorer scorer_type;
+	typedef scorer_type::masses_container masses_container;
+	typedef scorer_type::abundances_container abundances_container;
+	typedef distribution_t::abundance_type abundance_type;
+	typedef distribution_t::mass_type mass_type;
+
+	const DecomposerContext* context;
+	const scorer_type* scorer;
+	const IonHypothesis* ion;
+	vector<IonHypothesis>::size_type hypothesis;
+	abundances_container::size_type peaks;
+	vector<Candidate>::size_type max_candidates;
+
+	// folds the peaks to be scored, without normalizing them
+	// (candidates are normalized over the scored peaks)
+	distribution_t::settings_type scoring_settings;
+
+	// keeps the distributions of the heavier elements, which are shared by
+	// the decompositions visited one after another
+	IsotopeDistributionFolder folder;
+
+	// folds the full distributions of kept candidates, if not all are kept
+	IsotopeDistributionFolder candidates_folder;
+
+	// scored distribution of the ion of a candidate, unless it is the molecule itself
+	distribution_t ion_distribution;
+	distribution_t workspace;
+
+	// monoisotopic masses of the alphabet elements, empty if some element
+	// lacks its monoisotopic peak
+	vector<mass_type> monoisotopic_masses;
+
+	// ratios of the M+1 and M+2 peaks of the next candidate molecule to its
+	// monoisotopic peak, 0 if unknown
+	FormulaIndex::value_type isotope_ratios[2];
+
+	// best candidates, the worst of them on top of the heap
+	vector<Candidate> candidates;
+	decompositions_t::size_type scored;
+	bool log_space;
+	score_t accumulated_score;
+	LogSumExp accumulated_log_score;
+
+	CandidateScorer(const DecomposerContext& context, const scorer_type& scorer, 
+			const IonHypothesis& ion, vector<IonHypothesis>::size_type hypothesis,
+			abundances_container::size_type peaks,
+			vector<Candidate>::size_type max_candidates, bool log_space) :
+		context(&context), scorer(&scorer), ion(&ion), hypothesis(hypothesis), 
+		peaks(peaks), max_candidates(max_candidates),
+		scoring_settings(getScoringSettings(context.settings, peaks, max_candidates)),
+		folder(context.alphabet, scoring_settings, &context.element_powers),
+		candidates_folder(context.alphabet, context.settings, &context.element_powers),
+		ion_distribution(distribution_t::nominal_mass_type(0), scoring_settings),
+		workspace(distribution_t::nominal_mass_type(0), scoring_settings),
+		scored(0), log_space(log_space), accumulated_score(0.0) {
+		setIsotopeRatios(0.0, 0.0);
+		for (alphabet_t::size_type i = 0; i < context.alphabet.size(); ++i) {
+			const distribution_t& distribution = context.alphabet.getElement(i).getIsotopeDistribution();
+			if (distribution.size() == 0 || !(distribution.getAbundance(0) > 0)) {
+				monoisotopic_masses.clear();
+				break;
+			}
+			monoisotopic_masses.push_back(distribution.getMass(0));
+		}
+	}
+
+	// with all candidates kept, their full distributions are folded right away
+	static distribution_t::settings_type getScoringSettings(const distribution_t::settings_type& settings,
+							     abundances_container::size_type peaks,
+							     vector<Candidate>::size_type max_candidates) {
+		if (max_candidates == 0 || peaks >= settings.size) {
+			return settings;
+		}
+		return distribution_t::settings_type(peaks, numeric_limits<abundance_type>::infinity());
+	}
+
+	// whether a candidate with score can still enter the full heap, 
+	// candidates scored later lose ties
+	bool isKept(score_t score) const {
+		return max_candidates == 0 || candidates.size() < max_candidates ||
+			score > candidates.front().score;
+	}
+
+	bool isFull() const {
+		return max_candidates > 0 && candidates.size() == max_candidates;
+	}
+
+	// log scores below this bound neither enter the full heap nor change
+	// the accumulated sum
+	score_t getLogRejectionBound() const {
+		if (!isFull()) {
+			return -numeric_limits<score_t>::infinity();
+		}
+		return min(candidates.front().score, accumulated_log_score.getNegligibleBound());
+	}
+
+	void setIsotopeRatios(FormulaIndex::value_type ratio1, FormulaIndex::value_type ratio2) {
+		isotope_ratios[0] = ratio1;
+		isotope_ratios[1] = ratio2;
+	}
+
+	// bounds the log score by the isotope ratios of the candidate molecule, 
+	// if they are those of its ion and peaks M+1 or M+2 are scored
+	score_t getLogIsotopeRatioBound() const {
+		score_t bound = 0.0;
+		if (ion->mass_factor != 1 || ion->has_added) {
+			return bound;
+		}
+		for (abundances_container::size_type i = 1; 
+		     i <= 2 && i < peaks && i < scoring_settings.size; ++i) {
+			bound = min(bound, scorer->logScoreIsotopeRatio(i, isotope_ratios[i - 1],
+									ISOTOPE_RATIO_TOLERANCE));
+		}
+		return bound;
+	}
+
+	// folds the distribution of the ion out of the one of the candidate molecule
+	const distribution_t& getIonDistribution(const distribution_t& distribution) {
+		if (ion->mass_factor == 1 && !ion->has_added) {
+			return distribution;
+		}
+		if (ion->mass_factor > 1) {
+			distribution_t::power(distribution, ion->mass_factor, ion_distribution, workspace);
+			if (ion->has_added) {
+				distribution_t::fold(ion_distribution, ion->added, ion_distribution);
+			}
+		} else {
+			distribution_t::fold(distribution, ion->added, ion_distribution);
+		}
+		return ion_distribution;
+	}
+
+	void operator()(const RealMassDecomposer::decomposition_type& decomposition) {
+		const distribution_t::settings_type& settings = context->settings;
+		decompositions_t::size_type position = scored++;
+
+		// the monoisotopic mass bounds the score, candidates with a bound of 0
+		// (or a log bound below the rejection bound) neither enter the full 
+		// heap nor add to the accumulated score
+		if (isFull() && !monoisotopic_masses.empty()) {
+			mass_type mass = 0.0;
+			for (RealMassDecomposer::decomposition_type::size_type i = 0; i < decomposition.size(); ++i) {
+				mass += decomposition[i] * monoisotopic_masses[i];
+			}
+			mass = mass * ion->mass_factor + ion->added_mass;
+			if (log_space ? scorer->logScoreMonoisotopicMass(mass) < getLogRejectionBound() :
+					scorer->scoreMonoisotopicMass(mass) == 0.0) {
+				return;
+			}
+		}
+		if (isFull()) {
+			score_t bound = getLogIsotopeRatioBound();
+			if (log_space ? bound < getLogRejectionBound() : exp(bound) == 0.0) {
+				return;
+			}
+		}
+
+		// gets a theoretical isotope distribution of the candidate molecule,
+		// only the elements whose counts changed since the last decomposition are folded,
+		// and the one of its ion to be scored
+		const IsotopeDistribution& distribution = folder.fold(decomposition);
+		const IsotopeDistribution& scored_distribution = getIonDistribution(distribution);
+
+		// normalizes candidate abundances if the size of the measured peaklist is less than 
+		// the size of theoretical isotope distribution. This is always the case since our
+		// theoretical distributions are limited to by default 10 peaks and measured peaklists contain
+		// less than 10 peaks
+		distribution_t::size_type size = min(peaks, scored_distribution.size());
+		abundance_type scale = 1.0;
+		if (size < settings.size) {
+			// normalizes the isotope distribution abundances with respect to the number of elements in peaklist
+			abundance_type sum = 0.0;
+			for (distribution_t::size_type i = 0; i < size; ++i) {
+				sum += scored_distribution.getAbundance(i);
+			}
+			if (fabs(sum - 1) > settings.abundances_sum_error) {
+				scale = 1/sum;
+			}
+		}
+
+		// calculates a score, every candidate counts for normalization
+		score_t score;
+		if (log_space) {
+			score_t bound = getLogRejectionBound();
+			score = scorer->logScore(scored_distribution, size, scale, bound);
+			if (score < bound) {
+				return;
+			}
+			accumulated_log_score.add(score);
+		} else {
+			score = scorer->score(scored_distribution, size, scale);
+			accumulated_score += score;
+		}
+
+		if (!isKept(score)) {
+			return;
+		}
+		if (max_candidates > 0 && candidates.size() == max_candidates) {
+			pop_heap(candidates.begin(), candidates.end(), BetterCandidate());
+			candidates.pop_back();
+		}
+
+		// keeps the elemental composition, indexed like the alphabet, with its full distribution
+		Candidate candidate = { score, hypothesis, position, Composition(decomposition, context->alphabet),
+					(scoring_settings == settings) ? distribution : candidates_folder.fold(decomposition) };
+		candidates.push_back(std::move(candidate));
+		if (max_candidates > 0) {
+			push_heap(candidates.begin(), candidates.end(), BetterCandidate());
+		}
+	}
+};
+
+typedef ConstrainedVisitor<CandidateScorer> constrained_scorer_t;
+
+// Passes the decompositions of the index within error of mass and within
+// bounds to the visitor, in increasing order of their masses, with their
+// isotope ratios
+void visitIndexedDecompositions(const FormulaIndex& index, double mass, double error,
+				const RealMassDecomposer::bounds_type& bounds,
+				constrained_scorer_t& visitor) {
+// {{{
+
+	if (!index.covers(mass, error)) {
+		ostringstream message;
+		message << "mass " << mass << " is outside the mass range [" << index.getMinMass()
+			<< ", " << index.getMaxMass() << ") of the formula index";
+		throw invalid_argument(message.str());
+	}
+
+	FormulaIndex::range_type range = index.find(mass, error);
+	RealMassDecomposer::decomposition_type decomposition;
+	for (FormulaIndex::size_type i = range.first; i < range.second; ++i) {
+		if (fabs(index.getMass(i) - mass) > error) {
+			continue;
+		}
+		index.getDecomposition(i, decomposition);
+		bool within = true;
+		for (RealMassDecomposer::decomposition_type::size_type j = 0; within && j < decomposition.size(); ++j) {
+			within = decomposition[j] >= bounds.lower[j] && decomposition[j] <= bounds.upper[j];
+		}
+		if (within) {
+			visitor.visitor.setIsotopeRatios(index.getIsotopeRatio(i, 1), index.getIsotopeRatio(i, 2));
+			visitor(decomposition);
+		}
+	}
+}
+
+// }}}
+
+// Whether the molecule masses of all hypotheses are within the mass range of the index
+bool isCoveredByIndex(const FormulaIndex& index, const vector<IonHypothesis>& hypotheses) {
+	for (vector<IonHypothesis>::const_iterator it = hypotheses.begin(); it != hypotheses.end(); ++it) {
+		if (!index.covers(it->mass, it->error)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void decomposePattern(DecomposerContext& context,
+		      const vector<IonHypothesis>& hypotheses,
+		      const DistributionProbabilityScorer::abundances_container& abundances,
+		      const Composition& minElements, const Composition& maxElements,
+		      const DecompositionConstraints& constraints,
+		      vector<Candidate>::size_type max_candidates, bool log_space,
+		      const FormulaIndex* index,
+		      ThreadPool& pool, scores_t& scores, vector<score_t>& log_scores,
+		      vector<vector<IonHypothesis>::size_type>& scores_hypotheses,
+		      DecompositionConstraints::statistics_type& statistics) {
 // {{{ 
 
     typedef DistributionProbabilityScorer scorer_type;
     typedef scorer_type::score_type score_type;
     typedef scorer_type::masses_container masses_container;
     typedef scorer_type::abundances_container abundances_container;
-    typedef distribution_t::peaks_container peaks_container;
-    typedef distribution_t::mass_type mass_type;
     typedef distribution_t::abundance_type abundance_type;
-    typedef distribution_t::nominal_mass_type nominal_mass_type;
-    typedef multimap<score_type, ComposedElement, greater<score_type> > scores_container;
-    typedef vector<pair<ComposedElement, score_type> > nonnormalized_scores_container;
-    typedef decompositions_t::value_type decomposition_type;
 
-    // Reset error state
-    exceptionMesg = NULL;
+	const alphabet_t& alphabet = context.alphabet;
+	RealMassDecomposer& decomposer = context.decomposer;
+
+	// normalizes abundances
+	abundance_type abundances_sum = accumulate(abundances.begin(), abundances.end(), 0.0);
+	abundances_container normalized_abundances;
+	for (abundances_container::size_type mi = 0; mi < abundances.size(); ++mi) {
+		normalized_abundances.push_back(abundances[mi] / abundances_sum);
+	}
+	RealMassDecomposer::bounds_type bounds = getDecompositionBounds(alphabet, minElements, maxElements);
+
+	///////////////////////////////////////////////////////////////////////////////////////
+	//////////////////////////  Start identification pipeline /////////////////////////////
+	///////////////////////////////////////////////////////////////////////////////////////
+
+	// decomposes the monoisotopic mass with error allowed, minimum/maximum element 
+	// counts and chemical rules are applied while decomposing. Every decomposition
+	// found is turned into a candidate molecule whose isotopic pattern is matched
+	// against the input spectrum right away, only the best candidates are kept.
+	// Branches of the traversal are scored in parallel, each by its own copy of
+	// the scorer. Every ion hypothesis decomposes its own molecule mass with the
+	// same decomposer, their candidates are ranked and normalized together.
+	// With a formula index, the decompositions are looked up instead and
+	// bounds and rules are applied to them.
+	vector<constrained_scorer_t> parts;
+	for (vector<IonHypothesis>::size_type hi = 0; hi < hypotheses.size(); ++hi) {
+		const IonHypothesis& hypothesis = hypotheses[hi];
+
+		// fills peaklist masses and abundances
+		masses_container peaklist_masses;
+		abundances_container peaklist_abundances;
+		for (masses_container::size_type mi = 0; 
+		     mi < hypothesis.masses.size() && mi < normalized_abundances.size(); ++mi) {
+			peaklist_masses.push_back(hypothesis.masses[mi]);
+			peaklist_abundances.push_back(normalized_abundances[mi]);
+		}
+
+		// initializes distribution probability scorer
+		scorer_type scorer(peaklist_masses, peaklist_abundances);
+
+		if (index != NULL) {
+			parts.push_back(constrained_scorer_t(constraints, 
+							     CandidateScorer(context, scorer, hypothesis, hi,
+									     peaklist_abundances.size(),
+									     max_candidates, log_space)));
+			visitIndexedDecompositions(*index, hypothesis.mass, hypothesis.error, 
+						   bounds, parts.back());
+			continue;
+		}
+
+		vector<constrained_scorer_t> hypothesis_parts = 
+			decomposer.visitPrunedDecompositions(hypothesis.mass, hypothesis.error, bounds,
+							     constrained_scorer_t(constraints, 
+										  CandidateScorer(context, scorer, 
+												  hypothesis, hi,
+												  peaklist_abundances.size(),
+												  max_candidates, log_space)),
+							     pool);
+		std::move(hypothesis_parts.begin(), hypothesis_parts.end(), back_inserter(parts));
+	}
+
+	// joins the branches in traversal order (of one hypothesis after the other), so 
+	// that neither the ranking of ties nor the sum of scores depend on the number of threads
+	typedef pair<Candidate*, vector<constrained_scorer_t>::size_type> ranked_candidate;
+	vector<ranked_candidate> ranking;
+	score_type accumulated_score = 0.0;	
+	LogSumExp accumulated_log_score;
+	score_type log_sum = 0.0;
+	for (vector<constrained_scorer_t>::size_type bi = 0; bi < parts.size(); ++bi) {
+		CandidateScorer& part = parts[bi].visitor;
+		accumulated_score += part.accumulated_score;
+		accumulated_log_score.add(part.accumulated_log_score);
+		statistics += parts[bi].statistics;
+		for (vector<Candidate>::iterator it = part.candidates.begin(); it != part.candidates.end(); ++it) {
+			ranking.push_back(make_pair(&*it, bi));
+		}
+	}
+
+	sort(ranking.begin(), ranking.end(), 
+	     [](const ranked_candidate& left, const ranked_candidate& right) {
+		if (left.first->score != right.first->score) {
+			return left.first->score > right.first->score;
+		}
+		return left.second < right.second || 
+			(left.second == right.second && left.first->position < right.first->position);
+	     });
+	if (max_candidates > 0 && ranking.size() > max_candidates) {
+		ranking.resize(max_candidates);
+	}
+	if (log_space) {
+		log_sum = accumulated_log_score.get();
+	}
+
+	for (vector<ranked_candidate>::const_iterator it = ranking.begin(); it != ranking.end(); ++it) {
+		score_type normalized_score = it->first->score;
+		if (log_space) {
+			// the posterior, normalized in log space
+			log_scores.push_back(normalized_score);
+			if (log_sum > -numeric_limits<score_type>::infinity()) {
+				normalized_score -= log_sum;
+			}
+			normalized_score = exp(normalized_score);
+		} else if (accumulated_score > 0.0) {
+			normalized_score /= accumulated_score;
+		}
+		// creates the molecule out of the elemental composition, its sequence in the
+		// order of elements(atoms) one would like it to appear, and stores it with
+		// the score, in the order of the ranking
+		ComposedElement molecule = it->first->composition.getComposedElement(&context.elements_order);
+		molecule.setIsotopeDistribution(it->first->distribution);
+		scores.insert(scores.end(), make_pair(normalized_score, std::move(molecule)));
+		scores_hypotheses.push_back(it->first->hypothesis);
+	}
+}
+
+// }}}
+
+vector<Adduct> getAdducts(SEXP v_adducts) {
+// {{{
+
+  vector<Adduct> adducts;
+  for (int i = 0; i < Rf_length(v_adducts); ++i) {
+    adducts.push_back(Adduct(CHAR(STRING_ELT(v_adducts, i))));
+  }
+  return adducts;
+}
+
+// }}}
+
+vector<IonHypothesis> getIonHypotheses(const IonHypothesis::masses_container& masses, double error,
+				       const vector<Adduct>& adducts, const alphabet_t& adduct_elements,
+				       const distribution_t::settings_type& settings) {
+// {{{
+
+  vector<IonHypothesis> hypotheses;
+
+  // without adducts, the masses are the ones of a molecule
+  if (adducts.empty()) {
+    IonHypothesis hypothesis;
+    hypothesis.charge = 0;
+    hypothesis.mass_factor = 1;
+    hypothesis.has_added = false;
+    hypothesis.added_mass = 0.0;
+    hypothesis.masses = masses;
+    hypothesis.mass = masses[0];
+    hypothesis.error = error;
+    hypotheses.push_back(hypothesis);
+  }
+
+  for (vector<Adduct>::const_iterator it = adducts.begin(); it != adducts.end(); ++it) {
+    IonHypothesis hypothesis;
+    hypothesis.adduct = it->getName();
+    hypothesis.charge = it->getCharge();
+    hypothesis.mass_factor = it->getMassFactor();
+    hypothesis.has_added = !it->getAddedElements().empty();
+    if (hypothesis.has_added) {
+      hypothesis.added = it->getAddedIsotopeDistribution(adduct_elements, settings);
+    }
+    hypothesis.added_mass = Adduct::getMonoisotopicMass(it->getAddedElements(), adduct_elements);
+
+    // corrects m/z values for the charge (and its electrons) and the removed atoms,
+    // the masses are the ones of the molecules with the added atoms
+    int charge = abs(hypothesis.charge);
+    double shift = it->getMassShift(adduct_elements);
+    for (IonHypothesis::masses_container::size_type i = 0; i < masses.size(); ++i) {
+      hypothesis.masses.push_back(masses[i] * charge - shift + hypothesis.added_mass);
+    }
+    hypothesis.mass = it->getMoleculeMass(masses[0], adduct_elements);
+    hypothesis.error = error * charge / hypothesis.mass_factor;
+    hypotheses.push_back(hypothesis);
+  }
+  return hypotheses;
+}
+
+// }}}
+
+RcppExport SEXP decomposeIsotopes(SEXP v_masses, SEXP v_abundances, SEXP s_error, 
+				  SEXP l_alphabet, SEXP v_element_order, 
+				  SEXP z, SEXP i_maxisotopes,
+				  SEXP s_minElements, SEXP s_maxElements,
+				  SEXP l_filter, SEXP i_maxCandidates, SEXP b_logScore, 
+				  SEXP v_adducts, SEXP l_adductElements, SEXP x_decomposer,
+				  SEXP x_index) {
+// {{{ 
+
+    typedef DistributionProbabilityScorer scorer_type;
+    typedef scorer_type::masses_container masses_container;
+    typedef scorer_type::abundances_container abundances_container;
 
     SEXP  rl=R_NilValue; // Use this when there is nothing to be returned.
     try {
@@ -186,181 +1141,311 @@ RcppExport SEXP decomposeIsotopes(SEXP v_masses, SEXP v_abundances, SEXP s_error
 	// converts relative (ppm) in absolute error 
 	error *= masses(0) * 1.0e-06;
 
-	// initializes precision
-	double precision = 1.0e-05;
-	int number_molecules_shown = 100;
-	
-	// initializes alphabet
-	int maxisotopes = Rf_asInteger(i_maxisotopes);
-	alphabet_t alphabet;
-	vector<string> elements_order;
+	// only the best candidates are kept, all of them for 0
+	int max_candidates = getMaxCandidates(i_maxCandidates);
 
-	if (l_alphabet == NULL || Rf_length(l_alphabet) < 1  ) {
-	  initializeCHNOPS(alphabet, maxisotopes); 
-	  // initializes order of atoms in which one would
-	  // like them to appear in the molecules sequence
-	  elements_order.push_back("C");
-	  elements_order.push_back("H");
-	  elements_order.push_back("N");
-	  elements_order.push_back("O");
-	  elements_order.push_back("P");
-	  elements_order.push_back("S");
-	} else {
-	  initializeAlphabet(l_alphabet, alphabet, maxisotopes);
-	  
-	  int element_length = Rf_length(v_element_order);
-	  for (int i=0; i<element_length; i++) {
-	    elements_order.push_back(string(CHAR(STRING_ELT(v_element_order,i))));
-	  }
-	}
-	
-	// initializes weights
-	Weights weights(alphabet.getMasses(), precision);
-	
-	// checks if weights could become smaller, by dividing on gcd.
-	weights.divideByGCD();
-	
-	// initializes decomposer
-	RealMassDecomposer decomposer(weights);
-	
-	// normalizes abundances
-	abundance_type abundances_sum = 0.0;
-	for (peaks_container::size_type i = 0; i < abundances.size(); ++i) {
-		abundances_sum += abundances(i);
-	}
-	for (peaks_container::size_type i = 0; i < abundances.size(); ++i) {
-		abundances(i) /= abundances_sum;
-	}
+	// gets alphabet, weights and decomposer, either from the given handle
+	// or from the cache of recently used alphabets, or the ones of the index
+	formula_index_context_t index_context = getFormulaIndexContext(x_index);
+	decomposer_context_t context = index_context ? index_context->context :
+	  getDecomposerContext(x_decomposer, l_alphabet, v_element_order,
+			       Rf_asInteger(i_maxisotopes));
 
-	// fills peaklist masses and abundances, 
-	// since we cannot use masses and abundances - instances of RcppVector object - directly
-	masses_container peaklist_masses;
-	abundances_container peaklist_abundances;
-	for (masses_container::size_type mi = 0; mi < masses.size() && mi < abundances.size(); ++mi) {
-		peaklist_masses.push_back(masses(mi));
-		peaklist_abundances.push_back(abundances(mi));
+	// Initialize minimum/maximum element count "molecules"
+	Composition minElements(CHAR(Rf_asChar(s_minElements)), context->alphabet);
+	Composition maxElements(CHAR(Rf_asChar(s_maxElements)), context->alphabet);
+
+	// masses are decomposed for every adduct, its atoms are taken from the adduct elements.
+	// Candidates are then uncharged molecules, whose charge is the one of the adduct
+	vector<Adduct> adducts = getAdducts(v_adducts);
+	alphabet_t adduct_elements;
+	if (!adducts.empty()) {
+	  initializeAlphabet(l_adductElements, adduct_elements, Rf_asInteger(i_maxisotopes));
 	}
+	int charge = adducts.empty() ? Rf_asInteger(z) : 0;
+	vector<IonHypothesis> hypotheses = 
+	  getIonHypotheses(masses_container(masses.begin(), masses.end()), error,
+			   adducts, adduct_elements, context->settings);
 
-	// initializes distribution probability scorer
-	scorer_type scorer(peaklist_masses, peaklist_abundances);
-	
-	// initializes storage to store sum formulas and their non-normalized scores
-	nonnormalized_scores_container nonnormalized_scores;
+	// chemical rules applied while decomposing
+	DecompositionConstraints constraints = getChemicalRules(context->alphabet, context->weights,
+								l_filter, charge);
+	DecompositionConstraints::statistics_type statistics(constraints.getNumberOfRules());
+
+	// scores are calculated and summed up in log space
+	bool log_space = Rf_asLogical(b_logScore) == TRUE;
 
 	// initializes storage for results: sum formulas and their scores
-	scores_container scores;
+	scores_t scores;
+	vector<score_t> log_scores;
+	vector<vector<IonHypothesis>::size_type> scores_hypotheses;
 
-	///////////////////////////////////////////////////////////////////////////////////////
-	//////////////////////////  Start identification pipeline /////////////////////////////
-	///////////////////////////////////////////////////////////////////////////////////////
+	decomposePattern(*context, hypotheses,
+			 abundances_container(abundances.begin(), abundances.end()),
+			 minElements, maxElements, constraints, max_candidates, log_space,
+			 index_context ? &index_context->index : NULL,
+			 getThreadPool(), scores, log_scores, scores_hypotheses, statistics);
 
-	// gets all possible decompositions for the monoisotopic mass with error allowed
-	decompositions_t decompositions = 
-		decomposer.getDecompositions(masses(0), error);
+	// Now output to R ...
+	if (scores.size() >0 ) {
+	  List result(rlistScores(scores, charge, log_space ? &log_scores : NULL));
+	  if (!adducts.empty()) {
+	    vector<string> adduct(scores_hypotheses.size());
+	    vector<int> adduct_charge(scores_hypotheses.size());
+	    for (vector<vector<IonHypothesis>::size_type>::size_type i = 0; i < scores_hypotheses.size(); ++i) {
+	      adduct[i] = hypotheses[scores_hypotheses[i]].adduct;
+	      adduct_charge[i] = hypotheses[scores_hypotheses[i]].charge;
+	    }
+	    result["charge"] = wrap(adduct_charge);
+	    result["adduct"] = wrap(adduct);
+	  }
+	  if (!constraints.empty()) {
+	    result.attr("filter") = rlistFilterStatistics(constraints, statistics);
+	  }
+	  rl = result;
+	}
+    } catch(std::exception& ex) {
+      forward_exception_to_r(ex);
+    } catch(...) {
+      ::Rf_error("%s", "c++ exception (unknown reason)");
+    }
+        
+    return rl;
 
-	score_type accumulated_score = 0.0;	
-	// for every decomposition:
-	// - chemical filter is applied
-	// - isotopic pattern is calculated
-	// - isotopic pattern is matched against input spectrum
+}
 
-	// Initialize minimum/maximum element count "molecules"
-	ComposedElement minElements(CHAR(Rf_asChar(s_minElements)), alphabet);
-	ComposedElement maxElements(CHAR(Rf_asChar(s_maxElements)), alphabet);
+// }}}
 
-	for (decompositions_t::iterator decomps_it = decompositions.begin(); 
-		decomps_it != decompositions.end(); ++decomps_it) {
+RcppExport SEXP decomposeIsotopesBatch(SEXP l_masses, SEXP l_abundances, SEXP v_error, 
+				       SEXP l_alphabet, SEXP v_element_order, 
+				       SEXP z, SEXP i_maxisotopes,
+				       SEXP s_minElements, SEXP s_maxElements,
+				       SEXP l_filter, SEXP i_maxCandidates, SEXP b_logScore,
+				       SEXP v_adducts, SEXP l_adductElements, SEXP x_decomposer,
+				       SEXP x_index) {
+// {{{ 
 
-		// creates a candidate molecule out of elemental composition and a set of elements
-		ComposedElement candidate_molecule(*decomps_it, alphabet);
+    typedef DistributionProbabilityScorer scorer_type;
+    typedef scorer_type::masses_container masses_container;
+    typedef scorer_type::abundances_container abundances_container;
 
-		// Check minimum/maximum element counts
-		if (!isWithinElementRange(candidate_molecule, minElements, maxElements)) {
-			continue;
-		} 
+    SEXP  rl=R_NilValue; // Use this when there is nothing to be returned.
+    try {
 
+	int number_patterns = Rf_length(l_masses);
+	if (Rf_length(l_abundances) != number_patterns || Rf_length(v_error) != number_patterns) {
+	  throw invalid_argument("masses, intensities and ppm have to be given for every pattern");
+	}
+	// only the best candidates of every pattern are kept, all of them for 0
+	int max_candidates = getMaxCandidates(i_maxCandidates);
 
-		// checks on chemical filter
-// 		if (!isValidMyNitrogenRule(candidate_molecule, z)) {
-// 			continue;
-// 		} 
+	// alphabet, weights and decomposer (or index) are shared by all patterns
+	formula_index_context_t index_context = getFormulaIndexContext(x_index);
+	decomposer_context_t context = index_context ? index_context->context :
+	  getDecomposerContext(x_decomposer, l_alphabet, v_element_order,
+			       Rf_asInteger(i_maxisotopes));
 
+	// Initialize minimum/maximum element count "molecules"
+	Composition minElements(CHAR(Rf_asChar(s_minElements)), context->alphabet);
+	Composition maxElements(CHAR(Rf_asChar(s_maxElements)), context->alphabet);
+
+	// masses are decomposed for every adduct, as in decomposeIsotopes
+	vector<Adduct> adducts = getAdducts(v_adducts);
+	alphabet_t adduct_elements;
+	if (!adducts.empty()) {
+	  initializeAlphabet(l_adductElements, adduct_elements, Rf_asInteger(i_maxisotopes));
+	}
+	int charge = adducts.empty() ? Rf_asInteger(z) : 0;
+
+	// chemical rules applied while decomposing, pruning is counted over all patterns
+	DecompositionConstraints constraints = getChemicalRules(context->alphabet, context->weights,
+								l_filter, charge);
+	DecompositionConstraints::statistics_type statistics(constraints.getNumberOfRules());
+
+	// scores are calculated and summed up in log space
+	bool log_space = Rf_asLogical(b_logScore) == TRUE;
+
+	// patterns are decomposed in parallel, each of them by a single thread
+	ThreadPool& pool = getThreadPool();
+
+	// result table, one row per pattern and candidate
+	vector<int> pattern;
+	vector<string> formula;
+	vector<double> score;
+	vector<score_t> log_score;
+	vector<double> exactmass;
+	vector<int> ion_charge;
+	vector<string> adduct;
+	vector<string> parity;
+	vector<string> valid;
+	vector<double> DBE;
+	// patterns outside the mass range of the index
+	vector<int> outside_index;
+
+	// the hypotheses and abundances of the patterns are read before the threads
+	// are started, patterns without hypotheses are skipped
+	vector<vector<IonHypothesis> > pattern_hypotheses(number_patterns);
+	vector<abundances_container> pattern_abundances(number_patterns);
+	for (int p = 0; p < number_patterns; ++p) {
+	  NumericVector masses = NumericVector(VECTOR_ELT(l_masses, p));
+	  NumericVector abundances = NumericVector(VECTOR_ELT(l_abundances, p));
+	  if (masses.size() < 1) {
+	    continue;
+	  }
 
-		// updates molecules isotope distribution (since its not calculated upon creation: 
-		// it would be time consuming before applying chemical filter)
-		candidate_molecule.updateIsotopeDistribution();
-		// updates molecules sequence in a order of elements(atoms) one would like it
-		// to appear
-		candidate_molecule.updateSequence(&elements_order);
+	  // converts relative (ppm) in absolute error 
+	  double error = REAL(v_error)[p] * masses(0) * 1.0e-06;
 
-		// gets a theoretical isotope distribution of the candidate molecule
-		IsotopeDistribution candidate_molecule_distribution = 
-				candidate_molecule.getIsotopeDistribution();
-		
-		// gets a sequence of the candidate molecule
-		string candidate_molecule_sequence = 
-				candidate_molecule.getSequence();
+	  vector<IonHypothesis> hypotheses = 
+	    getIonHypotheses(masses_container(masses.begin(), masses.end()), error,
+			     adducts, adduct_elements, context->settings);
+	  // skips them instead of failing the whole batch
+	  if (index_context && !isCoveredByIndex(index_context->index, hypotheses)) {
+	    outside_index.push_back(p + 1);
+	    continue;
+	  }
+	  pattern_hypotheses[p] = hypotheses;
+	  pattern_abundances[p].assign(abundances.begin(), abundances.end());
+	}
 
-		// extracts masses and abundances from isotope distribution of the candidate molecule
-		masses_container candidate_masses = candidate_molecule_distribution.getMasses();
-		abundances_container candidate_abundances = candidate_molecule_distribution.getAbundances();
+	// every pattern is decomposed without splitting its traversal, so that 
+	// no scorer is copied per branch
+	vector<scores_t> pattern_scores(number_patterns);
+	vector<vector<score_t> > pattern_log_scores(number_patterns);
+	vector<vector<vector<IonHypothesis>::size_type> > pattern_scores_hypotheses(number_patterns);
+	vector<DecompositionConstraints::statistics_type> pattern_statistics(number_patterns, statistics);
+	pool.parallelFor(number_patterns, [&](ThreadPool::size_type p) {
+	    if (pattern_hypotheses[p].empty()) {
+	      return;
+	    }
+	    ThreadPool single_thread;
+	    decomposePattern(*context, pattern_hypotheses[p], pattern_abundances[p],
+			     minElements, maxElements, constraints, max_candidates, log_space,
+			     index_context ? &index_context->index : NULL,
+			     single_thread, pattern_scores[p], pattern_log_scores[p],
+			     pattern_scores_hypotheses[p], pattern_statistics[p]);
+	  });
+
+	// joins the patterns in their order
+	for (int p = 0; p < number_patterns; ++p) {
+	  const vector<IonHypothesis>& hypotheses = pattern_hypotheses[p];
+	  statistics += pattern_statistics[p];
+	  log_score.insert(log_score.end(), pattern_log_scores[p].begin(), pattern_log_scores[p].end());
+
+	  vector<vector<IonHypothesis>::size_type>::const_iterator hi = pattern_scores_hypotheses[p].begin();
+	  for (scores_t::const_iterator it = pattern_scores[p].begin(); it != pattern_scores[p].end(); ++it, ++hi) {
+	    pattern.push_back(p + 1);
+	    formula.push_back(it->second.getSequence());
+	    score.push_back(it->first);
+	    exactmass.push_back(it->second.getMass());
+	    ion_charge.push_back(adducts.empty() ? charge : hypotheses[*hi].charge);
+	    adduct.push_back(hypotheses[*hi].adduct);
+	    parity.push_back(string(1, getParity(it->second, charge)));
+	    valid.push_back(isValidMyNitrogenRule(it->second, charge) ? "Valid" : "Invalid");
+	    DBE.push_back(getDBE(it->second, charge));
+	  }
+	}
 
-		// normalizes candidate abundances if the size of the measured peaklist is less than 
-		// the size of theoretical isotope distribution. This is always the case since our
-		// theoretical distributions are limited to by default 10 peaks and measured peaklists contain
-		// less than 10 peaks
+	List result = List::create(  _["pattern"]  = pattern,
+				     _["formula"]  = formula,
+				     _["score"]  = score,
+				     _["exactmass"]  = exactmass,
+				     _["charge"]  = ion_charge,
+				     _["parity"]  = parity,
+				     _["valid"]  = valid,
+				     _["DBE"]  = DBE);
+	if (log_space) {
+	  result["logScore"] = wrap(log_score);
+	}
+	if (!adducts.empty()) {
+	  result["adduct"] = wrap(adduct);
+	}
+	if (!constraints.empty()) {
+	  result.attr("filter") = rlistFilterStatistics(constraints, statistics);
+	}
+	if (!outside_index.empty()) {
+	  result.attr("outsideIndex") = wrap(outside_index);
+	}
+	rl = result;
+    } catch(std::exception& ex) {
+      forward_exception_to_r(ex);
+    } catch(...) {
+      ::Rf_error("%s", "c++ exception (unknown reason)");
+    }
+        
+    return rl;
 
-		distribution_t::size_type size = min(peaklist_abundances.size(), candidate_abundances.size());
-		
-		if (size < candidate_abundances.size()) {
-			// normalizes the isotope distribution abundances with respect to the number of elements in peaklist
-			abundance_type sum = accumulate(candidate_abundances.begin(), 
-							candidate_abundances.begin() + size, 
-							0.0);
-			if (fabs(sum - 1) > IsotopeDistribution::ABUNDANCES_SUM_ERROR) {
-				abundance_type scale = 1/sum;
-				transform(candidate_abundances.begin(),			// begin of source range
-					candidate_abundances.begin() + size,		// end of source range
-					candidate_abundances.begin(), 			// destination
-					[scale](abundance_type a) { return a * scale; }); // operation (*scale)
-			}
-				
-		}
+}
 
-		// calculates a score
-		score_type score = scorer.score(candidate_masses, candidate_abundances);
+// }}}
 
-		// stores the sequence with non-normalized score
-		nonnormalized_scores.push_back(make_pair(candidate_molecule, score));
+RcppExport SEXP countDecompositions(SEXP v_masses, SEXP v_error,
+				    SEXP l_alphabet, SEXP v_element_order, SEXP i_maxisotopes,
+				    SEXP s_minElements, SEXP s_maxElements,
+				    SEXP b_exact, SEXP x_decomposer) {
+// {{{
 
-		// accumulates scores
-		accumulated_score += score;
+    typedef RealMassDecomposer::number_of_decompositions_type number_type;
 
-	}
+    SEXP  rl=R_NilValue; // Use this when there is nothing to be returned.
+    try {
 
-	for (nonnormalized_scores_container::const_iterator it = nonnormalized_scores.begin(); it != nonnormalized_scores.end(); ++it) {
-		score_type normalized_score = it->second;
-		if (accumulated_score > 0.0) {
-			normalized_score /= accumulated_score;
-		}
-		// stores the sequence with the score
-		scores.insert(make_pair(normalized_score, it->first));
+	NumericVector masses = NumericVector(v_masses);
+	NumericVector errors = NumericVector(v_error);
+	if (errors.size() != masses.size()) {
+	  throw invalid_argument("ppm has to be given for every mass");
 	}
+	bool exact = Rf_asLogical(b_exact) == TRUE;
 
-	// Now output to R ...
-	if (scores.size() >0 ) {
-	  rl = rlistScores(scores, Rf_asInteger(z));
+	// alphabet, weights and decomposer are shared by all masses
+	decomposer_context_t context = getDecomposerContext(x_decomposer, l_alphabet,
+							    v_element_order,
+							    Rf_asInteger(i_maxisotopes));
+
+	// Initialize minimum/maximum element count "molecules"
+	Composition minElements(CHAR(Rf_asChar(s_minElements)), context->alphabet);
+	Composition maxElements(CHAR(Rf_asChar(s_maxElements)), context->alphabet);
+	RealMassDecomposer::bounds_type bounds =
+		getDecompositionBounds(context->alphabet, minElements, maxElements);
+
+	// masses are counted one after the other, each of them in parallel
+	// unless there is only one thread
+	ThreadPool& pool = getThreadPool();
+	RealMassDecomposer& decomposer = context->decomposer;
+
+	// exact numbers, or lower and upper bounds of them
+	NumericVector lower(masses.size(), NA_REAL);
+	NumericVector upper(masses.size(), NA_REAL);
+
+	for (R_xlen_t i = 0; i < masses.size(); ++i) {
+	  if (ISNAN(masses[i]) || ISNAN(errors[i])) {
+	    continue;
+	  }
+	  // converts relative (ppm) in absolute error
+	  double error = errors[i] * masses[i] * 1.0e-06;
+
+	  if (exact) {
+	    number_type number = (pool.size() > 1) ?
+	      decomposer.getNumberOfDecompositions(masses[i], error, bounds, pool) :
+	      decomposer.getNumberOfDecompositions(masses[i], error, bounds);
+	    lower[i] = upper[i] = static_cast<double>(number);
+	  } else {
+	    pair<number_type, number_type> range = (pool.size() > 1) ?
+	      decomposer.getNumberOfDecompositionsBounds(masses[i], error, bounds, pool) :
+	      decomposer.getNumberOfDecompositionsBounds(masses[i], error, bounds);
+	    lower[i] = static_cast<double>(range.first);
+	    upper[i] = static_cast<double>(range.second);
+	  }
 	}
+
+	rl = List::create(  _["lower"]  = lower,
+			    _["upper"]  = upper);
     } catch(std::exception& ex) {
-      //exceptionMesg = copyMessageToR(ex.what());
-      //error_return(exceptionMesg); 
       forward_exception_to_r(ex);
     } catch(...) {
-      //exceptionMesg = copyMessageToR("unknown reason");
-      //error_return(exceptionMesg); 
       ::Rf_error("%s", "c++ exception (unknown reason)");
     }
-        
+
     return rl;
 
 }
@@ -423,9 +1508,72 @@ RcppExport SEXP calculateScore(SEXP v_predictMasses, SEXP v_predictAbundances, S
 }
 // }}}
 
+RcppExport SEXP calculateScores(SEXP v_predictMasses, SEXP v_predictAbundances,
+				SEXP m_measuredMasses, SEXP m_measuredAbundances, SEXP b_exact) {
+//  {{{
+    typedef DistributionProbabilityScorer scorer_type;
+    typedef scorer_type::masses_container masses_container;
+    typedef scorer_type::abundances_container abundances_container;
+
+    SEXP  rl=R_NilValue; // Use this when there is nothing to be returned.
+    try {
+	NumericVector masses = NumericVector(v_predictMasses);
+	NumericVector abundances = NumericVector(v_predictAbundances);
+	masses_container peaklist_masses;
+	abundances_container peaklist_abundances;
+	for (masses_container::size_type mi = 0; mi < masses.size() && mi < abundances.size(); ++mi) {
+		peaklist_masses.push_back(masses(mi));
+		peaklist_abundances.push_back(abundances(mi));
+	}
+	if (peaklist_masses.empty()) {
+	  throw invalid_argument("the molecule has no isotopes");
+	}
+	scorer_type scorer(peaklist_masses, peaklist_abundances);
+
+	// patterns are the rows of the matrices, stored column by column
+	int patterns = Rf_nrows(m_measuredMasses);
+	int peaks = Rf_ncols(m_measuredMasses);
+	if (Rf_nrows(m_measuredAbundances) != patterns || Rf_ncols(m_measuredAbundances) != peaks) {
+	  throw invalid_argument("masses and intensities have different dimensions");
+	}
+	const double* measured_masses = REAL(m_measuredMasses);
+	const double* measured_abundances = REAL(m_measuredAbundances);
+
+	// normalizes abundances pattern by pattern
+	vector<double> sums(patterns, 0.0);
+	for (int i = 0; i < peaks; ++i) {
+	  for (int p = 0; p < patterns; ++p) {
+	    sums[p] += measured_abundances[i * patterns + p];
+	  }
+	}
+	vector<double> normalized_abundances(patterns * peaks);
+	for (int i = 0; i < peaks; ++i) {
+	  for (int p = 0; p < patterns; ++p) {
+	    normalized_abundances[i * patterns + p] = measured_abundances[i * patterns + p] / sums[p];
+	  }
+	}
+
+	NumericVector scores(patterns);
+	if (patterns > 0 && peaks > 0) {
+	  scorer.scoreBatch(measured_masses, &normalized_abundances[0], patterns, peaks,
+			    scores.begin(), Rf_asLogical(b_exact) == TRUE);
+	}
+	rl = scores;
+    } catch(std::exception& ex) {
+      forward_exception_to_r(ex);
+    } catch(...) {
+      ::Rf_error("%s", "c++ exception (unknown reason)");
+    }
+
+    return rl;
+}
+// }}}
+
 
 RcppExport SEXP getMolecule(SEXP s_formula, SEXP l_alphabet, 
-			    SEXP v_element_order, SEXP z, SEXP i_maxisotopes) {
+			    SEXP v_element_order, SEXP z, SEXP i_maxisotopes,
+			    SEXP b_fineStructure, SEXP d_coverage,
+			    SEXP d_resolution, SEXP i_resolutionScaling) {
 // {{{ 
 
   SEXP  rl=R_NilValue; // Use this when there is nothing to be returned.
@@ -437,16 +1585,14 @@ RcppExport SEXP getMolecule(SEXP s_formula, SEXP l_alphabet,
   typedef scorer_type::score_type score_type;
   typedef multimap<score_type, ComposedElement, greater<score_type> > scores_container;
 
-  // Reset error state
-  exceptionMesg = NULL;
-
   // initializes alphabet
   int maxisotopes = Rf_asInteger(i_maxisotopes);
   alphabet_t alphabet;
   vector<string> elements_order;
+  distribution_t::settings_type settings;
 
   if (l_alphabet == NULL || Rf_length(l_alphabet) < 1  ) {
-    initializeCHNOPS(alphabet, maxisotopes); 
+    settings = initializeCHNOPS(alphabet, maxisotopes); 
     // initializes order of atoms in which one would
     // like them to appear in the molecules sequence
     elements_order.push_back("C");
@@ -456,7 +1602,7 @@ RcppExport SEXP getMolecule(SEXP s_formula, SEXP l_alphabet,
     elements_order.push_back("P");
     elements_order.push_back("S");
   } else {
-    initializeAlphabet(l_alphabet, alphabet, maxisotopes);
+    settings = initializeAlphabet(l_alphabet, alphabet, maxisotopes);
 
     int element_length = Rf_length(v_element_order);
     for (int i=0; i<element_length; i++) {
@@ -477,10 +1623,26 @@ RcppExport SEXP getMolecule(SEXP s_formula, SEXP l_alphabet,
     ComposedElement molecule( CHAR(Rf_asChar(s_formula)), alphabet);
     
     molecule.updateSequence(&elements_order);
-    molecule.updateIsotopeDistribution();
+    molecule.updateIsotopeDistribution(settings);
     
     scores.insert(make_pair(1.0, molecule));
-    rl = rlistScores(scores, Rf_asInteger(z));
+    List result(rlistScores(scores, Rf_asInteger(z)));
+
+    if (Rf_asLogical(b_fineStructure) == TRUE) {
+      // replaces the nominal isotope pattern by the isotopologues
+      // covering the requested share of the total abundance
+      FineStructureCalculator calculator(molecule);
+      result["isotopes"] = List::create(
+	rmatrixSpecies(calculator.getSpeciesWithCoverage(Rf_asReal(d_coverage))));
+    } else if (Rf_asReal(d_resolution) > 0) {
+      // replaces the nominal isotope pattern by the one seen at the
+      // given resolving power (at m/z 200)
+      ResolvingPower resolving_power(Rf_asReal(d_resolution), 200.0,
+	static_cast<ResolvingPower::scaling_type>(Rf_asInteger(i_resolutionScaling)));
+      ResolvedPatternCalculator calculator(resolving_power, maxisotopes);
+      result["isotopes"] = List::create(rmatrixSpecies(calculator.getPattern(molecule)));
+    }
+    rl = result;
   } catch(std::exception& ex) {
     forward_exception_to_r(ex);
   } catch(...) {
@@ -512,9 +1674,10 @@ RcppExport SEXP addMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
   int maxisotopes = Rf_asInteger(i_maxisotopes);
   alphabet_t alphabet;
   vector<string> elements_order;
+  distribution_t::settings_type settings;
 
   if (l_alphabet == NULL || Rf_length(l_alphabet) < 1  ) {
-    initializeCHNOPS(alphabet, maxisotopes);
+    settings = initializeCHNOPS(alphabet, maxisotopes);
     // initializes order of atoms in which one would
     // like them to appear in the molecules sequence
     elements_order.push_back("C");
@@ -524,7 +1687,7 @@ RcppExport SEXP addMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
     elements_order.push_back("P");
     elements_order.push_back("S");
   } else {
-    initializeAlphabet(l_alphabet, alphabet, maxisotopes);    
+    settings = initializeAlphabet(l_alphabet, alphabet, maxisotopes);
 
     int element_length = Rf_length(v_element_order);
     for (int i=0; i<element_length; i++) {
@@ -547,7 +1710,7 @@ RcppExport SEXP addMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
   molecule += molecule2;
 
   molecule.updateSequence(&elements_order);
-  molecule.updateIsotopeDistribution();
+  molecule.updateIsotopeDistribution(settings);
 
   scores.insert(make_pair(1.0, molecule));
   rl = rlistScores(scores, 0);
@@ -575,9 +1738,10 @@ RcppExport SEXP subMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
   int maxisotopes = Rf_asInteger(i_maxisotopes);
   alphabet_t alphabet;
   vector<string> elements_order;
+  distribution_t::settings_type settings;
 
   if (l_alphabet == NULL || Rf_length(l_alphabet) < 1  ) { 
-   initializeCHNOPS(alphabet, maxisotopes);
+    settings = initializeCHNOPS(alphabet, maxisotopes);
     // initializes order of atoms in which one would
     // like them to appear in the molecules sequence
     elements_order.push_back("C");
@@ -587,7 +1751,7 @@ RcppExport SEXP subMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
     elements_order.push_back("P");
     elements_order.push_back("S");
   } else {
-    initializeAlphabet(l_alphabet, alphabet, maxisotopes);
+    settings = initializeAlphabet(l_alphabet, alphabet, maxisotopes);
 
     int element_length = Rf_length(v_element_order);
     for (int i=0; i<element_length; i++) {
@@ -610,7 +1774,7 @@ RcppExport SEXP subMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
   molecule -= molecule2;
 
   molecule.updateSequence(&elements_order);
-  molecule.updateIsotopeDistribution();
+  molecule.updateIsotopeDistribution(settings);
 
   scores.insert(make_pair(1.0, molecule));
   rl = rlistScores(scores, 0);
@@ -620,7 +1784,8 @@ RcppExport SEXP subMolecules(SEXP s_formula1, SEXP s_formula2, SEXP l_alphabet,
 // }}}
 
 template <typename score_type>
-SEXP  rlistScores(multimap<score_type, ComposedElement, greater<score_type> > scores, int z) {
+SEXP  rlistScores(multimap<score_type, ComposedElement, greater<score_type> > scores, int z,
+		  const vector<score_type>* log_scores) {
   // {{{ 
 
     typedef DistributionProbabilityScorer scorer_type;
@@ -680,19 +1845,34 @@ SEXP  rlistScores(multimap<score_type, ComposedElement, greater<score_type> > sc
 
 
 	UNPROTECT(1); // SEXP isotopes
-
-	if(exceptionMesg != NULL) {
-	  Rf_error("%s", exceptionMesg);
-	}
 	
-	return(List::create(  _["formula"]  = formula,
+	List result = List::create(  _["formula"]  = formula,
                        _["score"]  = score,
                        _["exactmass"]  = exactmass,
                        _["charge"]  = charge,
                        _["parity"]  = parity,
                        _["valid"]  = valid,
                        _["DBE"]  = DBE,
-                       _["isotopes"]  = isotopes));
+                       _["isotopes"]  = isotopes);
+	if (log_scores != NULL) {
+	  result["logScore"] = wrap(*log_scores);
+	}
+	return(result);
+
+	// }}}
+}
+
+NumericMatrix rmatrixSpecies(const IsotopeSpecies& species) {
+  // {{{ 
+
+	// masses and intensities as rows, like the isotopes of rlistScores
+	int ny = species.size();
+	NumericMatrix isotopes(2, ny);
+	for (int j = 0; j < ny; j++) {
+		isotopes(0, j) = species.getMass(j);
+		isotopes(1, j) = species.getAbundance(j);
+	}
+	return isotopes;
 
 	// }}}
 }
@@ -700,7 +1880,7 @@ SEXP  rlistScores(multimap<score_type, ComposedElement, greater<score_type> > sc
 //
 // Initialisation of Standard Element Alphabet 
 //
-void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
+distribution_t::settings_type initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
   // {{{ 
 
 	typedef distribution_t::peaks_container peaks_container;
@@ -708,8 +1888,7 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	typedef alphabet_t::element_type element_type;
 	typedef alphabet_t::container elements_type;
 
-	distribution_t::SIZE = maxisotopes;
-	distribution_t::ABUNDANCES_SUM_ERROR = 0.00001;
+	distribution_t::settings_type settings(maxisotopes, 0.00001);
 
 // Hydrogen
 	nominal_mass_type massH = 1;
@@ -717,7 +1896,7 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	peaksH.push_back(peaks_container::value_type(0.007825, 0.99985));
 	peaksH.push_back(peaks_container::value_type(0.014102, 0.00015));
 
-	distribution_t distributionH(peaksH, massH);
+	distribution_t distributionH(peaksH, massH, settings);
 
 // Oxygen
 	nominal_mass_type massO = 16;
@@ -726,7 +1905,7 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	peaksO.push_back(peaks_container::value_type(-0.000868, 0.00038));
 	peaksO.push_back(peaks_container::value_type(-0.000839, 0.002));
 
-	distribution_t distributionO(peaksO, massO);
+	distribution_t distributionO(peaksO, massO, settings);
 
 // Carbonate
 	nominal_mass_type massC = 12;
@@ -734,7 +1913,7 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	peaksC.push_back(peaks_container::value_type(0.0, 0.9889));
 	peaksC.push_back(peaks_container::value_type(0.003355, 0.0111));
 
-	distribution_t distributionC(peaksC, massC);
+	distribution_t distributionC(peaksC, massC, settings);
 
 // Nitrogen
 	nominal_mass_type massN = 14;
@@ -742,7 +1921,7 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	peaksN.push_back(peaks_container::value_type(0.003074, 0.99634));
 	peaksN.push_back(peaks_container::value_type(0.000109, 0.00366));
 
-	distribution_t distributionN(peaksN, massN);
+	distribution_t distributionN(peaksN, massN, settings);
 
 // Sulfur
 	nominal_mass_type massS = 32;
@@ -753,14 +1932,14 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	peaksS.push_back(peaks_container::value_type());
 	peaksS.push_back(peaks_container::value_type(-0.032919, 0.0002));
 
-	distribution_t distributionS(peaksS, massS);
+	distribution_t distributionS(peaksS, massS, settings);
 
 // Phosphor
 	nominal_mass_type massP = 31;
 	peaks_container peaksP;
 	peaksP.push_back(peaks_container::value_type(-0.026238, 1.0));
 
-	distribution_t distributionP(peaksP, massP);
+	distribution_t distributionP(peaksP, massP, settings);
 
 	element_type H("H", distributionH);
 	element_type C("C", distributionC);
@@ -776,6 +1955,8 @@ void initializeCHNOPS(alphabet_t& chnops, const int maxisotopes) {
 	chnops.push_back(P);
 	chnops.push_back(S);
 
+	return settings;
+
 	// }}}
 }
 
@@ -803,9 +1984,9 @@ SEXP getListElement(SEXP list, char const *str)
 
 // }}}
 
-void initializeAlphabet(const SEXP l_alphabet, 
-			alphabet_t &alphabet,
-			const int maxisotopes) {
+distribution_t::settings_type initializeAlphabet(const SEXP l_alphabet, 
+						alphabet_t &alphabet,
+						const int maxisotopes) {
   // {{{ 
 
   typedef distribution_t::peaks_container peaks_container;
@@ -813,8 +1994,7 @@ void initializeAlphabet(const SEXP l_alphabet,
   typedef alphabet_t::element_type element_type;
   typedef alphabet_t::container elements_type;
 
-  distribution_t::SIZE = maxisotopes;
-  distribution_t::ABUNDANCES_SUM_ERROR = 0.0001;
+  distribution_t::settings_type settings(maxisotopes, 0.0001);
        
   for (int i=0; i < Rf_length(l_alphabet); i++) {
     SEXP l = VECTOR_ELT(l_alphabet,i);
@@ -833,12 +2013,14 @@ void initializeAlphabet(const SEXP l_alphabet,
     for (int j=0; j<numisotopes; j++) {
       peaks->push_back(peaks_container::value_type(mass[j], abundance[j]));
     }
-    distribution_t *distribution = new distribution_t(*peaks, nominalmass);
+    distribution_t *distribution = new distribution_t(*peaks, nominalmass, settings);
 
     element_type element(symbol, *distribution);	
     alphabet.push_back(element);
   }
 
+  return settings;
+
   // }}}
 
 }
@@ -851,11 +2033,16 @@ extern "C" {
      * We call most functions with .Call 
      */
     R_CallMethodDef callMethods[]  = {
-      {"getMolecule", (void* (*)())&getMolecule, 4},
-      {"addMolecules", (void* (*)())&addMolecules, 4},
-      {"subMolecules", (void* (*)())&subMolecules, 4},
-      {"decomposeIsotopes", (void* (*)())&decomposeIsotopes, 9},
-      {"calculateScore", (void* (*)())&calculateScore, 7},
+      {"getMolecule", (void* (*)())&getMolecule, 9},
+      {"addMolecules", (void* (*)())&addMolecules, 5},
+      {"subMolecules", (void* (*)())&subMolecules, 5},
+      {"decomposeIsotopes", (void* (*)())&decomposeIsotopes, 16},
+      {"decomposeIsotopesBatch", (void* (*)())&decomposeIsotopesBatch, 16},
+      {"countDecompositions", (void* (*)())&countDecompositions, 9},
+      {"initializeDecomposer", (void* (*)())&initializeDecomposer, 5},
+      {"initializeFormulaIndex", (void* (*)())&initializeFormulaIndex, 10},
+      {"calculateScore", (void* (*)())&calculateScore, 4},
+      {"calculateScores", (void* (*)())&calculateScores, 5},
       {NULL, NULL, 0}
     };
     
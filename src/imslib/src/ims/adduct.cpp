@@ -0,0 +1,148 @@
+#include <cstdlib>
+#include <cctype>
+#include <ims/adduct.h>
+#include <ims/element.h>
+#include <ims/base/parser/moleculesequenceparser.h>
+
+namespace ims {
+
+namespace {
+
+// reads the digits at position pos as a number, 0 if there are none
+unsigned int parseNumber(const std::string& sequence, std::string::size_type& pos) {
+	unsigned int number = 0;
+	for (; pos < sequence.size() && std::isdigit(sequence[pos]); ++pos) {
+		number = number * 10 + (sequence[pos] - '0');
+	}
+	return number;
+}
+
+} // namespace
+
+
+Adduct::Adduct(const name_type& name) /*throw (UnknownCharacterException)*/ :
+		name(name), mass_factor(1), charge(0) {
+	this->parse();
+}
+
+
+void Adduct::parse() /*throw (UnknownCharacterException)*/ {
+	typedef name_type::size_type size_type;
+
+	size_type close = name.find(']');
+	if (name.empty() || name[0] != '[' || close == name_type::npos) {
+		throw UnknownCharacterException("Adduct \"" + name +
+			"\" has to be given in brackets like [M+H]+!");
+	}
+	const name_type body = name.substr(1, close - 1);
+
+	// number of molecules in front of M
+	size_type pos = 0;
+	size_type number_pos = pos;
+	mass_factor = parseNumber(body, pos);
+	if (pos == number_pos) {
+		mass_factor = 1;
+	}
+	if (mass_factor == 0 || pos >= body.size() || body[pos] != MOLECULE_SYMBOL) {
+		throw UnknownCharacterException("Adduct \"" + name + "\" has to start with " +
+			"a number of molecules '" + MOLECULE_SYMBOL + "'!");
+	}
+	++pos;
+
+	// groups of added or removed atoms, each with an optional count like +2H
+	while (pos < body.size()) {
+		char sign = body[pos++];
+		if (sign != '+' && sign != '-') {
+			throw UnknownCharacterException("Adduct \"" + name +
+				"\" has a wrong character '" + sign + "'!");
+		}
+		number_pos = pos;
+		count_type count = parseNumber(body, pos);
+		if (pos == number_pos) {
+			count = 1;
+		}
+		size_type end = body.find_first_of("+-", pos);
+		if (end == name_type::npos) {
+			end = body.size();
+		}
+		if (end == pos || count == 0) {
+			throw UnknownCharacterException("Adduct \"" + name +
+				"\" has an empty group of atoms!");
+		}
+		MoleculeSequenceParser parser;
+		parser.parse(body.substr(pos, end - pos));
+		elements_type& elements = (sign == '+') ? added_elements : removed_elements;
+		for (elements_type::const_iterator it = parser.getElements().begin();
+				it != parser.getElements().end(); ++it) {
+			elements[it->first] += it->second * count;
+		}
+		pos = end;
+	}
+
+	// charge after the closing bracket, like +, 2+ or --
+	const name_type tail = name.substr(close + 1);
+	pos = 0;
+	unsigned int magnitude = parseNumber(tail, pos);
+	if (pos < tail.size() && (tail[pos] == '+' || tail[pos] == '-')) {
+		char sign = tail[pos];
+		if (pos > 0) {
+			++pos;
+		} else {
+			for (; pos < tail.size() && tail[pos] == sign; ++pos) {
+				++magnitude;
+			}
+		}
+		charge = (sign == '+') ? static_cast<int>(magnitude) : -static_cast<int>(magnitude);
+	}
+	if (charge == 0 || pos != tail.size()) {
+		throw UnknownCharacterException("Adduct \"" + name +
+			"\" has to end with a charge like + or 2-!");
+	}
+}
+
+
+Adduct::mass_type Adduct::getMonoisotopicMass(const elements_type& elements,
+		const alphabet_type& alphabet) /*throw (UnknownCharacterException)*/ {
+	mass_type mass = 0.0;
+	for (elements_type::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+		mass += alphabet.getElement(it->first).getIsotopeDistribution().getMass(0) * it->second;
+	}
+	return mass;
+}
+
+
+Adduct::mass_type Adduct::getMassShift(const alphabet_type& alphabet) const
+		/*throw (UnknownCharacterException)*/ {
+	return getMonoisotopicMass(added_elements, alphabet) -
+		getMonoisotopicMass(removed_elements, alphabet) -
+		charge * Element::ELECTRON_MASS_IN_U;
+}
+
+
+Adduct::mass_type Adduct::getMoleculeMass(mass_type mz, const alphabet_type& alphabet) const
+		/*throw (UnknownCharacterException)*/ {
+	return (mz * std::abs(charge) - getMassShift(alphabet)) / mass_factor;
+}
+
+
+Adduct::mass_type Adduct::getIonMass(mass_type mass, const alphabet_type& alphabet) const
+		/*throw (UnknownCharacterException)*/ {
+	return (mass * mass_factor + getMassShift(alphabet)) / std::abs(charge);
+}
+
+
+Adduct::isotopes_type Adduct::getAddedIsotopeDistribution(const alphabet_type& alphabet,
+		const isotopes_type::settings_type& settings) const
+		/*throw (UnknownCharacterException)*/ {
+	isotopes_type distribution(isotopes_type::nominal_mass_type(0), settings);
+	isotopes_type element_distribution(isotopes_type::nominal_mass_type(0), settings);
+	isotopes_type workspace(isotopes_type::nominal_mass_type(0), settings);
+	for (elements_type::const_iterator it = added_elements.begin(); it != added_elements.end(); ++it) {
+		isotopes_type::power(alphabet.getElement(it->first).getIsotopeDistribution(), it->second,
+				element_distribution, workspace);
+		distribution *= element_distribution;
+	}
+	return distribution;
+}
+
+} // namespace ims
@@ -0,0 +1,158 @@
+#ifndef IMS_ADDUCT_H
+#define IMS_ADDUCT_H
+
+#include <string>
+#include <ims/alphabet.h>
+#include <ims/isotopedistribution.h>
+#include <ims/base/parser/abstractmoleculesequenceparser.h>
+#include <ims/base/exception/unknowncharacterexception.h>
+
+namespace ims {
+
+/**
+ * @brief Describes how a molecule is turned into an ion, like [M+H]+ or [2M+Na]+.
+ *
+ * An adduct is given in the common bracket notation: the number of molecules
+ * @c M in the ion, groups of atoms added to or removed from them, and the charge
+ * of the ion after the closing bracket. Examples are
+ * 		[M+H]+, [M+Na]+, [M+NH4]+, [M-H]-, [M+Cl]-, [2M+H]+, [M+2H]2+, [M+H-H2O]+.
+ *
+ * The mass of the ion is the mass of its atoms less the mass of the electrons
+ * it lacks (or plus the mass of the extra electrons of an anion), the m/z value
+ * is that mass divided by the absolute charge. Masses of added and removed atoms
+ * are the monoisotopic ones of the elements in a given alphabet.
+ *
+ * @c MoleculeIonChargeModificationParser parses a related notation, but
+ * counts one electron per ion group instead of one per charge.
+ *
+ * @see Element::ELECTRON_MASS_IN_U
+ *
+ * @ingroup alphabet
+ */
+class Adduct {
+	public:
+		typedef Alphabet alphabet_type;
+		typedef alphabet_type::mass_type mass_type;
+		typedef std::string name_type;
+		typedef AbstractMoleculeSequenceParser::container elements_type;
+		typedef elements_type::mapped_type count_type;
+		typedef IsotopeDistribution isotopes_type;
+
+		/**
+		 * Symbol of the molecule in the notation.
+		 */
+		static const char MOLECULE_SYMBOL = 'M';
+
+		/**
+		 * Constructor with the adduct @c name in bracket notation, i.e. [M+H]+.
+		 *
+		 * @throws UnknownCharacterException if the name cannot be parsed
+		 */
+		explicit Adduct(const name_type& name) /*throw (UnknownCharacterException)*/;
+
+		/**
+		 * Gets the name of the adduct as given.
+		 */
+		const name_type& getName() const { return name; }
+
+		/**
+		 * Gets the number of molecules in the ion, 2 for [2M+H]+.
+		 */
+		unsigned int getMassFactor() const { return mass_factor; }
+
+		/**
+		 * Gets the charge of the ion, negative for anions.
+		 */
+		int getCharge() const { return charge; }
+
+		/**
+		 * Gets the atoms added to the molecules with their counts.
+		 */
+		const elements_type& getAddedElements() const { return added_elements; }
+
+		/**
+		 * Gets the atoms removed from the molecules with their counts.
+		 */
+		const elements_type& getRemovedElements() const { return removed_elements; }
+
+		/**
+		 * Gets the mass the ion differs from the molecules it consists of:
+		 * the monoisotopic masses of added atoms less the ones of removed
+		 * atoms and less the mass of the electrons of the charge.
+		 *
+		 * @throws UnknownCharacterException if an element is not in the @c alphabet
+		 */
+		mass_type getMassShift(const alphabet_type& alphabet) const
+			/*throw (UnknownCharacterException)*/;
+
+		/**
+		 * Gets the mass of the molecule of an ion with the given @c mz value.
+		 *
+		 * @throws UnknownCharacterException if an element is not in the @c alphabet
+		 */
+		mass_type getMoleculeMass(mass_type mz, const alphabet_type& alphabet) const
+			/*throw (UnknownCharacterException)*/;
+
+		/**
+		 * Gets the m/z value of the ion of a molecule with the given @c mass.
+		 *
+		 * @throws UnknownCharacterException if an element is not in the @c alphabet
+		 */
+		mass_type getIonMass(mass_type mass, const alphabet_type& alphabet) const
+			/*throw (UnknownCharacterException)*/;
+
+		/**
+		 * Gets the isotope distribution of the added atoms, folded with
+		 * the given @c settings. It is empty if no atoms are added.
+		 *
+		 * @throws UnknownCharacterException if an element is not in the @c alphabet
+		 */
+		isotopes_type getAddedIsotopeDistribution(const alphabet_type& alphabet,
+				const isotopes_type::settings_type& settings) const
+			/*throw (UnknownCharacterException)*/;
+
+		/**
+		 * Gets the monoisotopic mass of the @c elements, that is the sum
+		 * of the masses of the lightest isotopes of the elements in the
+		 * @c alphabet times their counts.
+		 *
+		 * @throws UnknownCharacterException if an element is not in the @c alphabet
+		 */
+		static mass_type getMonoisotopicMass(const elements_type& elements,
+				const alphabet_type& alphabet) /*throw (UnknownCharacterException)*/;
+
+	private:
+		/**
+		 * Name of the adduct as given.
+		 */
+		name_type name;
+
+		/**
+		 * Number of molecules in the ion.
+		 */
+		unsigned int mass_factor;
+
+		/**
+		 * Charge of the ion, negative for anions.
+		 */
+		int charge;
+
+		/**
+		 * Added atoms with their counts.
+		 */
+		elements_type added_elements;
+
+		/**
+		 * Removed atoms with their counts.
+		 */
+		elements_type removed_elements;
+
+		/**
+		 * Parses the name, see the class description for the notation.
+		 */
+		void parse() /*throw (UnknownCharacterException)*/;
+};
+
+} // namespace ims
+
+#endif // IMS_ADDUCT_H
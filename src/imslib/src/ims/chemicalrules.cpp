@@ -0,0 +1,161 @@
+/**
+ * chemicalrules.cpp
+ */
+
+#include <vector>
+#include <limits>
+#include <cstdlib>
+
+#include <ims/chemicalrules.h>
+
+namespace ims {
+
+namespace {
+
+/**
+ * Returns the valences of the alphabet's elements.
+ */
+std::vector<ChemicalRules::valence_type> getValences(const ChemicalRules::alphabet_type& alphabet) {
+	std::vector<ChemicalRules::valence_type> valences;
+	for (ChemicalRules::alphabet_type::size_type i = 0; i < alphabet.size(); ++i) {
+		valences.push_back(ChemicalRules::getValence(alphabet.getName(i)));
+	}
+	return valences;
+}
+
+/**
+ * Returns the index of element @c name in @c alphabet, alphabet.size() if missing.
+ */
+ChemicalRules::alphabet_type::size_type findElement(const ChemicalRules::alphabet_type& alphabet,
+													const std::string& name) {
+	ChemicalRules::alphabet_type::size_type i = 0;
+	while (i < alphabet.size() && alphabet.getName(i) != name) {
+		++i;
+	}
+	return i;
+}
+
+} // namespace
+
+
+ChemicalRules::valence_type ChemicalRules::getValence(const std::string& name) {
+	if (name == "H" || name == "F" || name == "Cl" || name == "Br" || name == "I" ||
+		name == "Li" || name == "Na" || name == "K") {
+		return 1;
+	}
+	if (name == "B" || name == "N" || name == "P") {
+		return 3;
+	}
+	if (name == "C" || name == "Si") {
+		return 4;
+	}
+	return 2;
+}
+
+
+void ChemicalRules::addDoubleBondEquivalentRule(DecompositionConstraints& constraints,
+		const alphabet_type& alphabet, double min, double max) {
+	std::vector<valence_type> valences = getValences(alphabet);
+	DecompositionConstraints::coefficients_type coefficients;
+	for (std::vector<valence_type>::size_type i = 0; i < valences.size(); ++i) {
+		coefficients.push_back((static_cast<double>(valences[i]) - 2.0) / 2.0);
+	}
+	constraints.addLinearConstraint("DBE", coefficients, 1.0, min, max);
+}
+
+
+void ChemicalRules::addIntegerDoubleBondEquivalentRule(DecompositionConstraints& constraints,
+		const alphabet_type& alphabet) {
+	std::vector<valence_type> valences = getValences(alphabet);
+	DecompositionConstraints::parity_coefficients_type coefficients(valences.begin(), valences.end());
+	constraints.addParityConstraint("integerDBE", coefficients, 0);
+}
+
+
+void ChemicalRules::addNitrogenRule(DecompositionConstraints& constraints,
+		const alphabet_type& alphabet, int charge) {
+	DecompositionConstraints::parity_coefficients_type coefficients;
+	for (alphabet_type::size_type i = 0; i < alphabet.size(); ++i) {
+		long coefficient = static_cast<long>(alphabet.getElement(i).getNominalMass());
+		if (alphabet.getName(i) == "N") {
+			++coefficient;
+		}
+		coefficients.push_back(coefficient);
+	}
+	constraints.addParityConstraint("nitrogen", coefficients, std::abs(charge));
+}
+
+
+void ChemicalRules::addSeniorRules(DecompositionConstraints& constraints,
+		const alphabet_type& alphabet) {
+	std::vector<valence_type> valences = getValences(alphabet);
+
+	// (i) the sum of valences is even
+	DecompositionConstraints::parity_coefficients_type parity_coefficients(valences.begin(),
+																			valences.end());
+	constraints.addParityConstraint("senior", parity_coefficients, 0);
+
+	// (iii) sum(valence * count) >= 2 * (sum(count) - 1)
+	DecompositionConstraints::coefficients_type coefficients;
+	for (std::vector<valence_type>::size_type i = 0; i < valences.size(); ++i) {
+		coefficients.push_back(static_cast<double>(valences[i]) - 2.0);
+	}
+	constraints.addLinearConstraint("senior", coefficients, 2.0, 0.0,
+									std::numeric_limits<double>::infinity());
+
+	// (ii) the sum of valences is at least twice the largest valence
+	constraints.addPredicate("senior",
+		[valences](const DecompositionConstraints::decomposition_type& decomposition) {
+			unsigned long sum = 0;
+			valence_type max_valence = 0;
+			for (std::vector<valence_type>::size_type i = 0; i < valences.size() &&
+												i < decomposition.size(); ++i) {
+				if (decomposition[i] > 0) {
+					sum += static_cast<unsigned long>(valences[i]) * decomposition[i];
+					if (valences[i] > max_valence) {
+						max_valence = valences[i];
+					}
+				}
+			}
+			return sum >= 2 * static_cast<unsigned long>(max_valence);
+		});
+}
+
+
+void ChemicalRules::addElementRatioRules(DecompositionConstraints& constraints,
+		const alphabet_type& alphabet) {
+	addElementRatioRule(constraints, alphabet, "ratios", "H", "C", 0.2, 3.1);
+	addElementRatioRule(constraints, alphabet, "ratios", "F", "C", 0.0, 1.5);
+	addElementRatioRule(constraints, alphabet, "ratios", "Cl", "C", 0.0, 0.8);
+	addElementRatioRule(constraints, alphabet, "ratios", "Br", "C", 0.0, 0.8);
+	addElementRatioRule(constraints, alphabet, "ratios", "N", "C", 0.0, 1.3);
+	addElementRatioRule(constraints, alphabet, "ratios", "O", "C", 0.0, 1.2);
+	addElementRatioRule(constraints, alphabet, "ratios", "P", "C", 0.0, 0.3);
+	addElementRatioRule(constraints, alphabet, "ratios", "S", "C", 0.0, 0.8);
+	addElementRatioRule(constraints, alphabet, "ratios", "Si", "C", 0.0, 0.5);
+}
+
+
+void ChemicalRules::addElementRatioRule(DecompositionConstraints& constraints,
+		const alphabet_type& alphabet, const std::string& rule,
+		const std::string& element, const std::string& reference, double min, double max) {
+	alphabet_type::size_type element_index = findElement(alphabet, element);
+	alphabet_type::size_type reference_index = findElement(alphabet, reference);
+	if (element_index == alphabet.size() || reference_index == alphabet.size() ||
+		element_index == reference_index) {
+		return;
+	}
+
+	// element - ratio * reference, compared against zero
+	const double infinity = std::numeric_limits<double>::infinity();
+	DecompositionConstraints::coefficients_type coefficients(alphabet.size(), 0.0);
+	coefficients[element_index] = 1.0;
+	coefficients[reference_index] = -max;
+	constraints.addLinearConstraint(rule, coefficients, 0.0, -infinity, 0.0);
+	if (min > 0.0) {
+		coefficients[reference_index] = -min;
+		constraints.addLinearConstraint(rule, coefficients, 0.0, 0.0, infinity);
+	}
+}
+
+} // namespace ims
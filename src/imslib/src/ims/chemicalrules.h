@@ -0,0 +1,125 @@
+#ifndef IMS_CHEMICALRULES_H
+#define IMS_CHEMICALRULES_H
+
+#include <string>
+
+#include <ims/alphabet.h>
+#include <ims/decomp/decompositionconstraints.h>
+
+namespace ims {
+
+/**
+ * @brief Chemical rules on sum formulas as constraints for decomposing.
+ *
+ * Adds the rules for the elements of an alphabet to
+ * @c DecompositionConstraints, whose coefficients are indexed like the
+ * alphabet. Elements are assigned their lowest common valence
+ * (see getValence()), elements not known to getValence() are treated as
+ * bivalent and thus do not change the double bond equivalent.
+ *
+ * Rules refer to neutral molecules, only the nitrogen rule takes a charge
+ * into account.
+ *
+ * @see NitrogenRuleFilter
+ */
+class ChemicalRules {
+	public:
+		/**
+		 * Type of alphabets.
+		 */
+		typedef Alphabet alphabet_type;
+
+		/**
+		 * Type of valences.
+		 */
+		typedef unsigned int valence_type;
+
+		/**
+		 * Returns the valence used for the element @c name: 1 for H, F, Cl,
+		 * Br, I, Li, Na and K, 3 for B, N and P, 4 for C and Si and 2 otherwise.
+		 *
+		 * @param name Name of the element.
+		 * @return Valence of the element.
+		 */
+		static valence_type getValence(const std::string& name);
+
+		/**
+		 * Adds the rule "DBE": the double bond equivalent
+		 * 1 + sum((valence - 2) * count) / 2 has to lie in [@c min, @c max].
+		 *
+		 * @param constraints Constraints to add the rule to.
+		 * @param alphabet Elements of the decompositions.
+		 * @param min Smallest allowed double bond equivalent.
+		 * @param max Largest allowed double bond equivalent.
+		 */
+		static void addDoubleBondEquivalentRule(DecompositionConstraints& constraints,
+												const alphabet_type& alphabet,
+												double min, double max);
+
+		/**
+		 * Adds the rule "integerDBE": the double bond equivalent has to be an
+		 * integer, i.e. the number of atoms of odd valence has to be even.
+		 *
+		 * @param constraints Constraints to add the rule to.
+		 * @param alphabet Elements of the decompositions.
+		 */
+		static void addIntegerDoubleBondEquivalentRule(DecompositionConstraints& constraints,
+													   const alphabet_type& alphabet);
+
+		/**
+		 * Adds the rule "nitrogen": the nominal mass plus the number of
+		 * nitrogen atoms plus the charge has to be even.
+		 *
+		 * @param constraints Constraints to add the rule to.
+		 * @param alphabet Elements of the decompositions.
+		 * @param charge Charge of the molecule.
+		 */
+		static void addNitrogenRule(DecompositionConstraints& constraints,
+									const alphabet_type& alphabet, int charge);
+
+		/**
+		 * Adds the rule "senior" with Senior's three rules: the sum of
+		 * valences has to be even, it has to be at least twice the largest
+		 * valence and at least twice the number of atoms minus one.
+		 *
+		 * @param constraints Constraints to add the rule to.
+		 * @param alphabet Elements of the decompositions.
+		 */
+		static void addSeniorRules(DecompositionConstraints& constraints,
+								   const alphabet_type& alphabet);
+
+		/**
+		 * Adds the rule "ratios": the common ranges of element ratios of
+		 * the "Seven Golden Rules" (T. Kind, O. Fiehn, BMC Bioinformatics
+		 * 2007, 8:105): H/C in [0.2, 3.1], F/C <= 1.5, Cl/C <= 0.8,
+		 * Br/C <= 0.8, N/C <= 1.3, O/C <= 1.2, P/C <= 0.3, S/C <= 0.8 and
+		 * Si/C <= 0.5. Ratios of elements missing in the alphabet are not
+		 * checked, nothing is checked without carbon.
+		 *
+		 * @param constraints Constraints to add the rule to.
+		 * @param alphabet Elements of the decompositions.
+		 */
+		static void addElementRatioRules(DecompositionConstraints& constraints,
+										 const alphabet_type& alphabet);
+
+		/**
+		 * Adds the constraint @c min <= @c element / @c reference <= @c max
+		 * to the rule @c rule, if both elements are in the alphabet.
+		 *
+		 * @param constraints Constraints to add the rule to.
+		 * @param alphabet Elements of the decompositions.
+		 * @param rule Name of the rule.
+		 * @param element Name of the element in the numerator.
+		 * @param reference Name of the element in the denominator.
+		 * @param min Smallest allowed ratio.
+		 * @param max Largest allowed ratio.
+		 */
+		static void addElementRatioRule(DecompositionConstraints& constraints,
+										const alphabet_type& alphabet, const std::string& rule,
+										const std::string& element, const std::string& reference,
+										double min, double max);
+};
+
+} // namespace ims
+
+#endif // IMS_CHEMICALRULES_H
@@ -6,6 +6,7 @@
 #include <sstream>
 #include <ostream>
 #include <ims/composedelement.h>
+#include <ims/isotopedistributioncache.h>
 #include <ims/base/parser/moleculesequenceparser.h>
 #include <ims/base/parser/standardmoleculesequenceparser.h>
 #include <iostream>
@@ -196,20 +197,45 @@ void ComposedElement::updateSequence(const std::vector<name_type>* elements_orde
 
 
 void ComposedElement::updateIsotopeDistribution(){
+	this->updateIsotopeDistribution(this->getIsotopeDistribution().getSettings());
+}
+
+
+void ComposedElement::updateIsotopeDistribution(const isotopes_type::settings_type& settings){
 	// initializes store where folded distributions will be collected
-	isotopes_type isodistr;
+	isotopes_type isodistr(isotopes_type::nominal_mass_type(0), settings);
 	// loops through elements and folds them first with themselves so often
 	// as their abundance in molecule is and then folds the result into store.
+	// The distributions of the elements are left untouched.
+	isotopes_type element_isodistr(isotopes_type::nominal_mass_type(0), settings);
+	isotopes_type workspace(isotopes_type::nominal_mass_type(0), settings);
 	for (container::const_iterator it = elements.begin(); 
 								   it != elements.end(); ++it) {
-		isotopes_type element_isodistr = it->first.getIsotopeDistribution();
-		element_isodistr *= it->second;
+		isotopes_type::power(it->first.getIsotopeDistribution(), it->second,
+					element_isodistr, workspace);
 		isodistr *= element_isodistr;
 	}
 	this->setIsotopeDistribution(isodistr);
 }
 
 
+void ComposedElement::updateIsotopeDistribution(const isotopes_type::settings_type& settings,
+		IsotopeDistributionCache& cache) {
+	isotopes_type isodistr(isotopes_type::nominal_mass_type(0), settings);
+	// the same as above, but the foldings of elements with themselves
+	// are shared with other molecules through the cache
+	for (container::const_iterator it = elements.begin(); 
+								   it != elements.end(); ++it) {
+		if (it->second > 1) {
+			isodistr *= *cache.getPower(it->first, it->second, settings);
+		} else {
+			isodistr *= it->first.getIsotopeDistribution();
+		}
+	}
+	this->setIsotopeDistribution(isodistr);
+}
+
+
 std::ostream& operator << (std::ostream& os, 
 							const ComposedElement& composed_element) {
 	for (ComposedElement::container::const_iterator 
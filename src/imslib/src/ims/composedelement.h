@@ -11,6 +11,8 @@
 
 namespace ims {
 
+class IsotopeDistributionCache;
+
 /**
  * @brief Represents a bio-chemical molecule with a name, a sequence of simple elements (atoms) or other molecules it consists of) and an isotope distribution.
  * 
@@ -174,10 +176,30 @@ class ComposedElement : public Element {
 		
 		/**
 		 * Updates isotope distribution by folding isotope distributions of elements
-		 * this composed element consists of.
+		 * this composed element consists of. The settings of the current
+		 * isotope distribution are kept.
+		 * 
+		 */
+		void updateIsotopeDistribution();
+
+		/**
+		 * Updates isotope distribution by folding isotope distributions of elements
+		 * this composed element consists of, using the given @c settings.
+		 * 
+		 * @param settings Settings for folding the isotope distributions.
+		 */
+		void updateIsotopeDistribution(const isotopes_type::settings_type& settings);		
+
+		/**
+		 * Updates isotope distribution like updateIsotopeDistribution(const isotopes_type::settings_type&),
+		 * but takes the distributions of elements folded with themselves
+		 * from the @c cache.
 		 * 
+		 * @param settings Settings for folding the isotope distributions.
+		 * @param cache Cache of folded element distributions.
 		 */
-		void updateIsotopeDistribution();		
+		void updateIsotopeDistribution(const isotopes_type::settings_type& settings,
+				IsotopeDistributionCache& cache);
 
 		/**
 		 * Destructor.
@@ -0,0 +1,50 @@
+#include <ims/composition.h>
+#include <ims/base/parser/moleculesequenceparser.h>
+
+namespace ims {
+
+Composition::Composition(const container& counts, const alphabet_type& alphabet) :
+		alphabet(&alphabet), counts(counts) {
+	this->counts.resize(alphabet.size(), 0);
+}
+
+
+Composition::Composition(const name_type& sequence, const alphabet_type& alphabet)
+		/*throw (UnknownCharacterException)*/ :
+		alphabet(&alphabet), counts(alphabet.size(), 0) {
+	typedef MoleculeSequenceParser::container parser_container;
+
+	MoleculeSequenceParser parser;
+	parser.parse(sequence);
+	const parser_container& parsed_elements = parser.getElements();
+	for (parser_container::const_iterator it = parsed_elements.begin();
+			it != parsed_elements.end(); ++it) {
+		size_type i = 0;
+		while (i < alphabet.size() && alphabet.getName(i) != it->first) {
+			++i;
+		}
+		if (i == alphabet.size()) {
+			throw UnknownCharacterException(it->first + " was not found in alphabet!");
+		}
+		counts[i] = it->second;
+	}
+}
+
+
+Composition::count_type Composition::getElementAbundance(const name_type& name) const {
+	for (size_type i = 0; i < counts.size(); ++i) {
+		if (alphabet->getName(i) == name) {
+			return counts[i];
+		}
+	}
+	return 0;
+}
+
+
+ComposedElement Composition::getComposedElement(const std::vector<name_type>* elements_order) const {
+	ComposedElement molecule(counts, *alphabet);
+	molecule.updateSequence(elements_order);
+	return molecule;
+}
+
+} // namespace ims
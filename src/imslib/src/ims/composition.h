@@ -0,0 +1,126 @@
+#ifndef IMS_COMPOSITION_H
+#define IMS_COMPOSITION_H
+
+#include <vector>
+#include <ims/alphabet.h>
+#include <ims/composedelement.h>
+
+namespace ims {
+
+/**
+ * @brief Represents the elemental composition of a molecule as counts indexed
+ * like an alphabet.
+ *
+ * Unlike @c ComposedElement, which keeps copies of its elements with their names
+ * and isotope distributions in a map, a composition consists of the element
+ * counts only and refers to the alphabet for everything else. It is therefore
+ * cheap to copy and to compare, and the count of an element is accessed by its
+ * index in the alphabet in constant time. Compositions are used where many
+ * molecules are handled, like the candidates of a decomposition; a
+ * @c ComposedElement is built from a composition where names are needed.
+ *
+ * The alphabet is not copied and has to outlive the composition.
+ *
+ * @see ComposedElement
+ * @see Alphabet
+ *
+ * @ingroup alphabet
+ */
+class Composition {
+	public:
+		typedef Alphabet alphabet_type;
+		typedef alphabet_type::name_type name_type;
+		typedef unsigned int count_type;
+		typedef std::vector<count_type> container;
+		typedef container::size_type size_type;
+
+		/**
+		 * Empty constructor, a composition without alphabet.
+		 */
+		Composition() : alphabet(0) {}
+
+		/**
+		 * Constructor with @c counts of the elements, where the index of a count
+		 * is the index of the element in the @c alphabet. Missing counts are 0,
+		 * counts beyond the size of the @c alphabet are ignored.
+		 */
+		Composition(const container& counts, const alphabet_type& alphabet);
+
+		/**
+		 * Constructor with a @c sequence, i.e. C2H4O6N, and an @c alphabet that
+		 * contains the elements parsed in the @c sequence.
+		 *
+		 * @throws UnknownCharacterException if an element parsed in the sequence
+		 * 			is not found in the alphabet
+		 */
+		Composition(const name_type& sequence, const alphabet_type& alphabet)
+			/*throw (UnknownCharacterException)*/;
+
+		/**
+		 * Gets the alphabet the counts refer to.
+		 */
+		const alphabet_type& getAlphabet() const { return *alphabet; }
+
+		/**
+		 * Gets the counts of the elements, indexed like the alphabet.
+		 */
+		const container& getCounts() const { return counts; }
+
+		/**
+		 * Returns the number of counts, which is the size of the alphabet.
+		 */
+		size_type size() const { return counts.size(); }
+
+		/**
+		 * Gets the count of the element with index @c index in the alphabet.
+		 * @note Operation takes constant time.
+		 */
+		count_type operator[](size_type index) const { return counts[index]; }
+
+		/**
+		 * Gets the count of the element with the given @c name, 0 if there is
+		 * no such element in the alphabet.
+		 * @note Operation takes linear time in the size of the alphabet.
+		 */
+		count_type getElementAbundance(const name_type& name) const;
+
+		/**
+		 * Returns true if a given @c composition has the same counts over
+		 * the same alphabet.
+		 */
+		bool operator ==(const Composition& composition) const {
+			return alphabet == composition.alphabet && counts == composition.counts;
+		}
+
+		/**
+		 * Returns true if a given @c composition differs from this one.
+		 */
+		bool operator !=(const Composition& composition) const {
+			return !this->operator==(composition);
+		}
+
+		/**
+		 * Builds the molecule of this composition, its sequence in the order of
+		 * element names @c elements_order (see ComposedElement::updateSequence).
+		 * The isotope distribution of the molecule is not folded.
+		 *
+		 * @param elements_order Order of element names in the sequence.
+		 * @return Molecule with the elements of this composition.
+		 */
+		ComposedElement getComposedElement(const std::vector<name_type>* elements_order = 0) const;
+
+	private:
+		/**
+		 * Alphabet the counts refer to.
+		 */
+		const alphabet_type* alphabet;
+
+		/**
+		 * Counts of the elements, indexed like the alphabet.
+		 */
+		container counts;
+};
+
+} // namespace ims
+
+#endif // IMS_COMPOSITION_H
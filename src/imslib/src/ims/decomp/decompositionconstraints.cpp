@@ -0,0 +1,160 @@
+/**
+ * decompositionconstraints.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <ims/decomp/decompositionconstraints.h>
+
+namespace ims {
+
+namespace {
+
+/**
+ * Tolerance for rounding errors of the sums, relative to the bound.
+ */
+bool isBelow(double value, double bound) {
+	return value < bound - 1.0e-9 * std::max(1.0, std::fabs(bound));
+}
+
+bool isAbove(double value, double bound) {
+	return value > bound + 1.0e-9 * std::max(1.0, std::fabs(bound));
+}
+
+} // namespace
+
+
+DecompositionConstraints::Statistics&
+DecompositionConstraints::Statistics::operator+=(const Statistics& statistics) {
+	if (pruned.size() < statistics.pruned.size()) {
+		pruned.resize(statistics.pruned.size(), 0);
+		discarded.resize(statistics.discarded.size(), 0);
+	}
+	for (size_type i = 0; i < statistics.pruned.size(); ++i) {
+		pruned[i] += statistics.pruned[i];
+		discarded[i] += statistics.discarded[i];
+	}
+	return *this;
+}
+
+
+DecompositionConstraints::DecompositionConstraints(const Weights& weights) :
+		weights(weights) {
+}
+
+
+void DecompositionConstraints::addLinearConstraint(const std::string& rule,
+		const coefficients_type& coefficients, double constant, double lower, double upper) {
+	LinearConstraint constraint;
+	constraint.rule = getRuleIndex(rule);
+	constraint.coefficients = coefficients;
+	constraint.coefficients.resize(weights.size(), 0.0);
+	constraint.constant = constant;
+	constraint.lower = lower;
+	constraint.upper = upper;
+
+	// every unit of mass left for the weights 0..i changes the sum by
+	// at least min_ratios[i] and at most max_ratios[i]
+	constraint.min_ratios.resize(weights.size());
+	constraint.max_ratios.resize(weights.size());
+	for (size_type i = 0; i < weights.size(); ++i) {
+		double ratio = constraint.coefficients[i] / weights.getWeight(i);
+		constraint.min_ratios[i] = (i > 0) ? std::min(constraint.min_ratios[i-1], ratio) : ratio;
+		constraint.max_ratios[i] = (i > 0) ? std::max(constraint.max_ratios[i-1], ratio) : ratio;
+	}
+	linear_constraints.push_back(constraint);
+}
+
+
+void DecompositionConstraints::addParityConstraint(const std::string& rule,
+		const parity_coefficients_type& coefficients, long constant) {
+	ParityConstraint constraint;
+	constraint.rule = getRuleIndex(rule);
+	constraint.coefficients = coefficients;
+	constraint.coefficients.resize(weights.size(), 0);
+	constraint.constant = constant;
+	parity_constraints.push_back(constraint);
+}
+
+
+void DecompositionConstraints::addPredicate(const std::string& rule,
+											const predicate_type& predicate) {
+	Predicate constraint;
+	constraint.rule = getRuleIndex(rule);
+	constraint.predicate = predicate;
+	predicates.push_back(constraint);
+}
+
+
+DecompositionConstraints::size_type
+DecompositionConstraints::findViolatedRule(const decomposition_type& decomposition) const {
+	for (std::vector<LinearConstraint>::const_iterator it = linear_constraints.begin();
+												it != linear_constraints.end(); ++it) {
+		double sum = getSum(*it, decomposition);
+		if (isBelow(sum, it->lower) || isAbove(sum, it->upper)) {
+			return it->rule;
+		}
+	}
+	for (std::vector<ParityConstraint>::const_iterator it = parity_constraints.begin();
+												it != parity_constraints.end(); ++it) {
+		// only the lowest bit matters, so that overflows do no harm
+		unsigned long sum = static_cast<unsigned long>(it->constant);
+		for (size_type i = 0; i < decomposition.size() && i < it->coefficients.size(); ++i) {
+			sum += static_cast<unsigned long>(it->coefficients[i]) * decomposition[i];
+		}
+		if (sum % 2 != 0) {
+			return it->rule;
+		}
+	}
+	for (std::vector<Predicate>::const_iterator it = predicates.begin();
+												it != predicates.end(); ++it) {
+		if (!it->predicate(decomposition)) {
+			return it->rule;
+		}
+	}
+	return rules.size();
+}
+
+
+DecompositionConstraints::size_type
+DecompositionConstraints::findViolatedRule(const decomposition_type& decomposition,
+		size_type alphabetMassIndex, value_type lowMass, value_type highMass) const {
+	for (std::vector<LinearConstraint>::const_iterator it = linear_constraints.begin();
+												it != linear_constraints.end(); ++it) {
+		double sum = getSum(*it, decomposition);
+		// bounds of the sum over the remaining counts x[i] with
+		// lowMass <= sum(x[i] * weight[i]) <= highMass
+		double min_ratio = it->min_ratios[alphabetMassIndex];
+		double max_ratio = it->max_ratios[alphabetMassIndex];
+		double min_sum = sum + min_ratio * static_cast<double>((min_ratio < 0) ? highMass : lowMass);
+		double max_sum = sum + max_ratio * static_cast<double>((max_ratio > 0) ? highMass : lowMass);
+		if (isBelow(max_sum, it->lower) || isAbove(min_sum, it->upper)) {
+			return it->rule;
+		}
+	}
+	return rules.size();
+}
+
+
+DecompositionConstraints::size_type
+DecompositionConstraints::getRuleIndex(const std::string& rule) {
+	std::vector<std::string>::const_iterator it = std::find(rules.begin(), rules.end(), rule);
+	if (it != rules.end()) {
+		return it - rules.begin();
+	}
+	rules.push_back(rule);
+	return rules.size() - 1;
+}
+
+
+double DecompositionConstraints::getSum(const LinearConstraint& constraint,
+										const decomposition_type& decomposition) {
+	double sum = constraint.constant;
+	for (size_type i = 0; i < decomposition.size() && i < constraint.coefficients.size(); ++i) {
+		sum += constraint.coefficients[i] * decomposition[i];
+	}
+	return sum;
+}
+
+} // namespace ims
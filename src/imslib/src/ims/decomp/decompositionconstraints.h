@@ -0,0 +1,290 @@
+#ifndef IMS_DECOMPOSITIONCONSTRAINTS_H
+#define IMS_DECOMPOSITIONCONSTRAINTS_H
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <ims/weights.h>
+#include <ims/decomp/integermassdecomposer.h>
+
+namespace ims {
+
+/**
+ * @brief Named rules on the counts of decompositions, applied while
+ * decomposing.
+ *
+ * Every rule consists of one or more constraints:
+ * - Linear constraints <tt>lower <= constant + sum(coefficients[i] * count[i]) <= upper</tt>,
+ *   e.g. the range of double bond equivalents or element ratios. They are
+ *   also checked for partial decompositions: from the mass left to be
+ *   decomposed, the range of the sum over the remaining alphabet masses
+ *   is estimated, and subtrees which cannot get the sum into
+ *   [lower, upper] are pruned.
+ * - Parity constraints <tt>constant + sum(coefficients[i] * count[i])</tt> even,
+ *   e.g. the nitrogen rule, checked for complete decompositions.
+ * - Predicates on complete decompositions for everything else.
+ *
+ * Constraints are checked in this order (and in the order they were added
+ * within each kind), a decomposition is reported as discarded by the rule
+ * of the first constraint it violates.
+ *
+ * Coefficients are indexed like the weights the decompositions are
+ * computed over. The object is not changed while decomposing, so that one
+ * set of constraints can be shared by several threads.
+ *
+ * @see ConstrainedVisitor, ChemicalRules
+ *
+ * @ingroup decomp
+ */
+class DecompositionConstraints {
+	public:
+		/**
+		 * Type of decompositions the constraints are applied to.
+		 */
+		typedef IntegerMassDecomposer<>::decomposition_type decomposition_type;
+
+		/**
+		 * Type of integer masses (over the scaled weights).
+		 */
+		typedef IntegerMassDecomposer<>::value_type value_type;
+
+		/**
+		 * Type of sizes and indices.
+		 */
+		typedef decomposition_type::size_type size_type;
+
+		/**
+		 * Type of coefficients of linear constraints.
+		 */
+		typedef std::vector<double> coefficients_type;
+
+		/**
+		 * Type of coefficients of parity constraints.
+		 */
+		typedef std::vector<long> parity_coefficients_type;
+
+		/**
+		 * Type of predicates on complete decompositions.
+		 */
+		typedef std::function<bool(const decomposition_type&)> predicate_type;
+
+		/**
+		 * Type of counters.
+		 */
+		typedef unsigned long long counter_type;
+
+		/**
+		 * Numbers of subtrees pruned and of decompositions discarded,
+		 * indexed by rule.
+		 */
+		struct Statistics {
+			std::vector<counter_type> pruned;
+			std::vector<counter_type> discarded;
+
+			explicit Statistics(size_type rules = 0) :
+				pruned(rules, 0), discarded(rules, 0) { }
+
+			Statistics& operator+=(const Statistics& statistics);
+		};
+
+		/**
+		 * Type of statistics.
+		 */
+		typedef Statistics statistics_type;
+
+		/**
+		 * Constructor with the weights the decompositions are computed over.
+		 *
+		 * @param weights Weights of the decomposer.
+		 */
+		explicit DecompositionConstraints(const Weights& weights);
+
+		/**
+		 * Adds the linear constraint
+		 * <tt>lower <= constant + sum(coefficients[i] * count[i]) <= upper</tt>
+		 * to the rule @c rule. Missing coefficients are zero.
+		 *
+		 * @param rule Name of the rule.
+		 * @param coefficients Coefficients of the counts.
+		 * @param constant Constant term.
+		 * @param lower Smallest allowed value, may be -infinity.
+		 * @param upper Largest allowed value, may be infinity.
+		 */
+		void addLinearConstraint(const std::string& rule,
+								 const coefficients_type& coefficients,
+								 double constant, double lower, double upper);
+
+		/**
+		 * Adds the constraint that <tt>constant + sum(coefficients[i] * count[i])</tt>
+		 * is even to the rule @c rule. Missing coefficients are zero.
+		 *
+		 * @param rule Name of the rule.
+		 * @param coefficients Coefficients of the counts.
+		 * @param constant Constant term.
+		 */
+		void addParityConstraint(const std::string& rule,
+								 const parity_coefficients_type& coefficients,
+								 long constant);
+
+		/**
+		 * Adds a predicate, which has to be true for complete decompositions,
+		 * to the rule @c rule.
+		 *
+		 * @param rule Name of the rule.
+		 * @param predicate Function object called with the counts.
+		 */
+		void addPredicate(const std::string& rule, const predicate_type& predicate);
+
+		/**
+		 * Returns true if there are no constraints.
+		 */
+		bool empty() const { return rules.empty(); }
+
+		/**
+		 * Returns the number of rules.
+		 */
+		size_type getNumberOfRules() const { return rules.size(); }
+
+		/**
+		 * Returns the name of the rule with index @c rule.
+		 */
+		const std::string& getRuleName(size_type rule) const { return rules[rule]; }
+
+		/**
+		 * Returns the index of the rule violated by the complete
+		 * @c decomposition, getNumberOfRules() if it satisfies all rules.
+		 *
+		 * @param decomposition Counts of all weights.
+		 * @return Index of the first violated rule or getNumberOfRules().
+		 */
+		size_type findViolatedRule(const decomposition_type& decomposition) const;
+
+		/**
+		 * Returns the index of a rule which no decomposition of a subtree
+		 * can satisfy, getNumberOfRules() if there is none. In
+		 * @c decomposition the counts of weights with index greater than
+		 * @c alphabetMassIndex are fixed, the other ones are increased by
+		 * weights adding up to some integer mass in [@c lowMass, @c highMass],
+		 * see IntegerMassDecomposer::visitPrunedDecompositions().
+		 *
+		 * @param decomposition Partial decomposition.
+		 * @param alphabetMassIndex Largest index of weights that can still be increased.
+		 * @param lowMass Smallest remaining mass.
+		 * @param highMass Largest remaining mass.
+		 * @return Index of the first violated rule or getNumberOfRules().
+		 */
+		size_type findViolatedRule(const decomposition_type& decomposition,
+								   size_type alphabetMassIndex,
+								   value_type lowMass, value_type highMass) const;
+
+	private:
+		/**
+		 * Linear constraint, with the smallest and largest ratio of
+		 * coefficient to weight over the weights 0..i.
+		 */
+		struct LinearConstraint {
+			size_type rule;
+			coefficients_type coefficients;
+			double constant;
+			double lower;
+			double upper;
+			coefficients_type min_ratios;
+			coefficients_type max_ratios;
+		};
+
+		/**
+		 * Parity constraint.
+		 */
+		struct ParityConstraint {
+			size_type rule;
+			parity_coefficients_type coefficients;
+			long constant;
+		};
+
+		/**
+		 * Predicate of a rule.
+		 */
+		struct Predicate {
+			size_type rule;
+			predicate_type predicate;
+		};
+
+		/**
+		 * Returns the index of rule @c rule, adds it if needed.
+		 */
+		size_type getRuleIndex(const std::string& rule);
+
+		/**
+		 * Returns the value of the linear constraint's sum for @c decomposition.
+		 */
+		static double getSum(const LinearConstraint& constraint,
+							 const decomposition_type& decomposition);
+
+		/**
+		 * Weights the decompositions are computed over.
+		 */
+		Weights weights;
+
+		/**
+		 * Names of the rules.
+		 */
+		std::vector<std::string> rules;
+
+		std::vector<LinearConstraint> linear_constraints;
+		std::vector<ParityConstraint> parity_constraints;
+		std::vector<Predicate> predicates;
+};
+
+
+/**
+ * @brief Pruning visitor applying @c DecompositionConstraints.
+ *
+ * Passes the decompositions satisfying all constraints on to @c visitor
+ * and counts per rule how many subtrees were pruned and how many
+ * decompositions were discarded. Can be used with
+ * IntegerMassDecomposer::visitPrunedDecompositions() and
+ * RealMassDecomposer::visitPrunedDecompositions(); for parallel traversals
+ * the statistics of the copies are to be summed up.
+ *
+ * @param Visitor Type of function object to be called for every decomposition.
+ *
+ * @ingroup decomp
+ */
+template <typename Visitor>
+struct ConstrainedVisitor {
+	typedef DecompositionConstraints::decomposition_type decomposition_type;
+	typedef DecompositionConstraints::size_type size_type;
+	typedef DecompositionConstraints::value_type value_type;
+
+	ConstrainedVisitor(const DecompositionConstraints& constraints, const Visitor& visitor) :
+		constraints(&constraints), statistics(constraints.getNumberOfRules()), visitor(visitor) { }
+
+	bool acceptsBranch(const decomposition_type& decomposition, size_type alphabetMassIndex,
+					   value_type lowMass, value_type highMass) {
+		size_type rule = constraints->findViolatedRule(decomposition, alphabetMassIndex,
+													   lowMass, highMass);
+		if (rule < constraints->getNumberOfRules()) {
+			++statistics.pruned[rule];
+			return false;
+		}
+		return true;
+	}
+
+	void operator()(const decomposition_type& decomposition) {
+		size_type rule = constraints->findViolatedRule(decomposition);
+		if (rule < constraints->getNumberOfRules()) {
+			++statistics.discarded[rule];
+		} else {
+			visitor(decomposition);
+		}
+	}
+
+	const DecompositionConstraints* constraints;
+	DecompositionConstraints::statistics_type statistics;
+	Visitor visitor;
+};
+
+} // namespace ims
+
+#endif // IMS_DECOMPOSITIONCONSTRAINTS_H
@@ -139,6 +139,36 @@ typename DecompositionWeights::alphabet_mass_type getParentMass(const Decomposit
 }
 
 
+/**
+ * Returns the sum of floor((a*i + b) / m) for i = 0, ..., n-1 (m > 0).
+ * Instead of summing up n terms, the slope a/m is reduced like in the
+ * Euclidean algorithm, which takes O(log m) steps.
+ */
+template <typename T>
+T getFloorSum(T n, T m, T a, T b) {
+	T sum = 0;
+	while (n > 0) {
+		if (a >= m) {
+			sum += (n * (n - 1) / 2) * (a / m);
+			a %= m;
+		}
+		if (b >= m) {
+			sum += n * (b / m);
+			b %= m;
+		}
+		// the lattice points below the line, counted with the axes swapped
+		const T y_max = a * n + b;
+		if (y_max < m) {
+			break;
+		}
+		n = y_max / m;
+		b = y_max % m;
+		std::swap(m, a);
+	}
+	return sum;
+}
+
+
 template <typename DecompositionWeights, typename DecompositionType>
 typename DecompositionWeights::weight_type getIntegerParentMass(const DecompositionWeights& weights, DecompositionType* decomposition) {
 	typename DecompositionWeights::weight_type parentMass = 0;
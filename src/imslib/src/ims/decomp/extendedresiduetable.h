@@ -0,0 +1,519 @@
+#ifndef IMS_EXTENDEDRESIDUETABLE_H
+#define IMS_EXTENDEDRESIDUETABLE_H
+
+#include <vector>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include <stdint.h>
+#include <ims/weights.h>
+#include <ims/utils/gcd.h>
+#include <ims/utils/threadpool.h>
+
+namespace ims {
+
+/**
+ * @brief Extended residue table of a set of weights, stored in one
+ * contiguous block with the columns of all weights one after another.
+ *
+ * Entry [i][r] is the smallest mass with residue @c r modulo the smallest
+ * weight, which is decomposable over the weights 0..i, or infinity if there
+ * is none. As every such mass is congruent to @c r, only its quotient by the
+ * smallest weight is stored, and this quotient is smaller than the largest
+ * weight. With @c ResidueType @c uint32_t the table takes half the space of
+ * 64 bit masses for all weights below 2^32 - 1, which keeps more of it in
+ * the caches while decomposing.
+ *
+ * The entries are owned by the table or refer to memory owned by someone
+ * else, e.g. a mapped file.
+ *
+ * @param ValueType Type of masses.
+ * @param ResidueType Type of the stored entries.
+ *
+ * @see IntegerMassDecomposer
+ *
+ * @ingroup decomp
+ */
+template <typename ValueType, typename ResidueType = uint32_t>
+class ExtendedResidueTable {
+	public:
+		/**
+		 * Type of masses.
+		 */
+		typedef ValueType value_type;
+
+		/**
+		 * Type of the stored entries.
+		 */
+		typedef ResidueType residue_type;
+
+		/**
+		 * Type of sizes and indices.
+		 */
+		typedef std::size_t size_type;
+
+		/**
+		 * Type of the masses of one column.
+		 */
+		typedef std::vector<value_type> column_type;
+
+		/**
+		 * Entry stored for residues without decomposable masses.
+		 */
+		static const residue_type unreachable = std::numeric_limits<residue_type>::max();
+
+		/**
+		 * Default constructor, creates an empty table.
+		 */
+		ExtendedResidueTable() : columns(0), residues(0), infty(0), external(0) { }
+
+		/**
+		 * Constructor, creates a table of @c columns columns of @c residues
+		 * entries each, all of them infinite.
+		 *
+		 * @param columns Number of columns (weights).
+		 * @param residues Number of residues (the smallest weight).
+		 * @param infty Mass representing infinity.
+		 * @throws std::overflow_error if quotients of masses below @c infty
+		 * do not fit into @c residue_type
+		 */
+		ExtendedResidueTable(size_type columns, value_type residues, value_type infty);
+
+		/**
+		 * Constructor, creates a table of @c columns columns of @c residues
+		 * entries each, which uses the @c entries of someone else (column
+		 * after column). These have to outlive the table and its copies.
+		 *
+		 * @param columns Number of columns (weights).
+		 * @param residues Number of residues (the smallest weight).
+		 * @param infty Mass representing infinity.
+		 * @param entries Entries of the table.
+		 * @throws std::overflow_error if quotients of masses below @c infty
+		 * do not fit into @c residue_type
+		 */
+		ExtendedResidueTable(size_type columns, value_type residues, value_type infty,
+							 const residue_type* entries);
+
+		/**
+		 * Constructor, computes the extended residue table of @c weights as
+		 * described in "Efficient Mass Decomposition" by S. Böcker and
+		 * Zs. Lipták. Infinity is the product of the smallest and the
+		 * largest weight. Tables of less than two weights are empty.
+		 *
+		 * @param weights Weights, the smallest one first.
+		 * @param lcms Least common multiples of the smallest and every
+		 * other weight, filled for indices from 1 on.
+		 * @param mass_in_lcms Number of times the smallest weight fits into
+		 * the least common multiples, filled for indices from 1 on.
+		 * @param witness_vector One witness per residue, the index of the
+		 * last weight and its count on the way to the mass of the last column.
+		 * @throws std::overflow_error if the largest weight does not fit
+		 * into @c residue_type
+		 */
+		template <typename WitnessVector>
+		ExtendedResidueTable(const Weights& weights, column_type& lcms,
+							 column_type& mass_in_lcms, WitnessVector& witness_vector);
+
+		/**
+		 * Constructor, computes the extended residue table of @c weights
+		 * like the one above, with the threads of @c pool. The table and
+		 * the witnesses do not depend on the number of threads.
+		 *
+		 * @param weights Weights, the smallest one first.
+		 * @param lcms Least common multiples, see above.
+		 * @param mass_in_lcms Number of times the smallest weight fits into
+		 * the least common multiples, see above.
+		 * @param witness_vector One witness per residue, see above.
+		 * @param pool Threads filling the columns.
+		 * @throws std::overflow_error if the largest weight does not fit
+		 * into @c residue_type
+		 */
+		template <typename WitnessVector>
+		ExtendedResidueTable(const Weights& weights, column_type& lcms,
+							 column_type& mass_in_lcms, WitnessVector& witness_vector,
+							 ThreadPool& pool);
+
+		/**
+		 * Gets the number of columns.
+		 */
+		size_type getNumberOfColumns() const { return columns; }
+
+		/**
+		 * Gets the number of residues, the length of every column.
+		 */
+		value_type getNumberOfResidues() const { return residues; }
+
+		/**
+		 * Gets the mass representing infinity.
+		 */
+		value_type infinity() const { return infty; }
+
+		/**
+		 * Whether the table has no entries.
+		 */
+		bool empty() const { return columns == 0 || residues == 0; }
+
+		/**
+		 * Gets the number of entries.
+		 */
+		size_type size() const { return columns * residues; }
+
+		/**
+		 * Gets the entries, column after column.
+		 */
+		const residue_type* data() const { return external ? external : entries.data(); }
+
+		/**
+		 * Gets the entries of column @c i, to be turned into masses by getMass().
+		 */
+		const residue_type* getColumn(size_type i) const { return data() + i * residues; }
+
+		/**
+		 * Gets the mass of an @c entry stored for the residue @c residue.
+		 */
+		value_type getMass(residue_type entry, value_type residue) const {
+			return (entry == unreachable) ? infty : entry * residues + residue;
+		}
+
+		/**
+		 * Gets the mass of entry [@c i][@c residue].
+		 */
+		value_type get(size_type i, value_type residue) const {
+			return getMass(getColumn(i)[residue], residue);
+		}
+
+		/**
+		 * Gets the masses of column @c i.
+		 */
+		void getMasses(size_type i, column_type& masses) const;
+
+		/**
+		 * Sets column @c i to @c masses, which have to be infinite or
+		 * congruent to their residues. The table must own its entries.
+		 */
+		void setMasses(size_type i, const column_type& masses);
+
+	private:
+		/**
+		 * Smallest number of residues of a cycle filled by one task.
+		 */
+		static const size_type MIN_SEGMENT_SIZE = 4096;
+
+		/**
+		 * Computes the table, see the constructors.
+		 */
+		template <typename WitnessVector>
+		void fill(const Weights& weights, column_type& lcms, column_type& mass_in_lcms,
+				  WitnessVector& witness_vector, ThreadPool& pool);
+
+		/**
+		 * Computes column @c i of the weight @c currentMass from the
+		 * previous column, with the threads of @c pool.
+		 */
+		template <typename WitnessVector>
+		void fillColumn(size_type i, value_type currentMass, const column_type& prev_column,
+						column_type& cur_column, WitnessVector& witness_vector,
+						ThreadPool& pool) const;
+
+		/**
+		 * Throws std::overflow_error unless quotients of masses below
+		 * @c infty fit into @c residue_type.
+		 */
+		void checkRange() const;
+
+		/**
+		 * Number of columns.
+		 */
+		size_type columns;
+
+		/**
+		 * Number of residues, the smallest weight.
+		 */
+		value_type residues;
+
+		/**
+		 * Mass representing infinity.
+		 */
+		value_type infty;
+
+		/**
+		 * Entries owned by the table.
+		 */
+		std::vector<residue_type> entries;
+
+		/**
+		 * Entries of someone else, if set.
+		 */
+		const residue_type* external;
+};
+
+
+template <typename ValueType, typename ResidueType>
+const typename ExtendedResidueTable<ValueType, ResidueType>::residue_type
+ExtendedResidueTable<ValueType, ResidueType>::unreachable;
+
+
+template <typename ValueType, typename ResidueType>
+ExtendedResidueTable<ValueType, ResidueType>::ExtendedResidueTable(size_type columns,
+		value_type residues, value_type infty) :
+		columns(columns), residues(residues), infty(infty), external(0) {
+	checkRange();
+	entries.assign(columns * residues, unreachable);
+}
+
+
+template <typename ValueType, typename ResidueType>
+ExtendedResidueTable<ValueType, ResidueType>::ExtendedResidueTable(size_type columns,
+		value_type residues, value_type infty, const residue_type* entries) :
+		columns(columns), residues(residues), infty(infty), external(entries) {
+	checkRange();
+}
+
+
+template <typename ValueType, typename ResidueType>
+template <typename WitnessVector>
+ExtendedResidueTable<ValueType, ResidueType>::ExtendedResidueTable(const Weights& weights,
+		column_type& lcms, column_type& mass_in_lcms, WitnessVector& witness_vector) :
+		columns(0), residues(0), infty(0), external(0) {
+	ThreadPool pool;
+	fill(weights, lcms, mass_in_lcms, witness_vector, pool);
+}
+
+
+template <typename ValueType, typename ResidueType>
+template <typename WitnessVector>
+ExtendedResidueTable<ValueType, ResidueType>::ExtendedResidueTable(const Weights& weights,
+		column_type& lcms, column_type& mass_in_lcms, WitnessVector& witness_vector,
+		ThreadPool& pool) :
+		columns(0), residues(0), infty(0), external(0) {
+	fill(weights, lcms, mass_in_lcms, witness_vector, pool);
+}
+
+
+template <typename ValueType, typename ResidueType>
+template <typename WitnessVector>
+void ExtendedResidueTable<ValueType, ResidueType>::fill(const Weights& weights,
+		column_type& lcms, column_type& mass_in_lcms, WitnessVector& witness_vector,
+		ThreadPool& pool) {
+	typedef typename WitnessVector::value_type::second_type decomposition_value_type;
+
+	if (weights.size() == 0) {
+		return;
+	}
+	infty = weights.getWeight(0) * weights.getWeight(weights.size()-1);
+	if (weights.size() < 2) {
+		return;
+	}
+	// caches the most often used mass - smallest mass
+	value_type smallestMass = weights.getWeight(0), secondMass = weights.getWeight(1);
+
+	columns = weights.size();
+	residues = smallestMass;
+	checkRange();
+	entries.resize(columns * residues);
+
+	// columns are computed as masses and stored one after another.
+	// The first column has infinity everywhere except in the first field.
+	column_type prev_column(smallestMass, infty);
+	prev_column[0] = 0;
+	setMasses(0, prev_column);
+
+	// initializes witness vector
+	witness_vector.resize(smallestMass);
+
+	// fills second column
+	column_type cur_column(prev_column);
+	size_type it_inc = secondMass % smallestMass, witness = 1;
+	size_type it = it_inc;
+	value_type mass = secondMass;
+	// initializes counter to create a witness vector
+	decomposition_value_type counter = 0;
+	while (it != 0) {
+		cur_column[it] = mass;
+		mass += secondMass;
+		++counter;
+		witness_vector[it] = std::make_pair(witness, counter);
+		it += it_inc;
+		if (it >= smallestMass) {
+			it -= smallestMass;
+		}
+	}
+	setMasses(1, cur_column);
+	// fills cache variables for i==1
+	value_type d = gcd(smallestMass, secondMass);
+	lcms[1] = secondMass*smallestMass / d;
+	mass_in_lcms[1] = smallestMass / d;
+
+	// fills remaining table. i is the column index.
+	for (size_type i = 2; i < weights.size(); ++i) {
+		prev_column.swap(cur_column);
+
+		// caches often used i-th alphabet mass
+		value_type currentMass = weights.getWeight(i);
+
+		value_type d = gcd(smallestMass, currentMass);
+
+		// fills cache for various variables.
+		// note that values for i==0 are never assigned since they're unused anyway.
+		lcms[i] = currentMass*smallestMass / d;
+		mass_in_lcms[i] = smallestMass / d;
+
+		// Nijenhuis' improvement: Is currentMass composable with smaller alphabet?
+		if (currentMass >= prev_column[currentMass % smallestMass]) {
+			cur_column = prev_column;
+			setMasses(i, cur_column);
+			continue;
+		}
+
+		fillColumn(i, currentMass, prev_column, cur_column, witness_vector, pool);
+		setMasses(i, cur_column);
+	}
+}
+
+
+template <typename ValueType, typename ResidueType>
+template <typename WitnessVector>
+void ExtendedResidueTable<ValueType, ResidueType>::fillColumn(size_type i,
+		value_type currentMass, const column_type& prev_column, column_type& cur_column,
+		WitnessVector& witness_vector, ThreadPool& pool) const {
+	typedef typename WitnessVector::value_type::second_type decomposition_value_type;
+
+	// Adding currentMass runs through the residues of one class modulo
+	// d = gcd(smallestMass, currentMass) in a cycle of smallestMass / d steps.
+	// Every entry is the smaller one of its entry in prev_column and the
+	// entry before it in the cycle plus currentMass. The d cycles are
+	// independent, and they are cut into segments filled in parallel: first
+	// as if no mass entered a segment from the one before, then the masses
+	// leaving the segments are passed around the cycle and replace the
+	// leading entries of the next segment as long as they are not larger.
+	const value_type smallestMass = residues;
+	const value_type d = gcd(smallestMass, currentMass);
+	const size_type cycle_size = smallestMass / d;
+	const size_type p_inc = currentMass % smallestMass;
+
+	size_type segments = 1;
+	if (pool.size() > 1) {
+		segments = std::min<size_type>(std::max<size_type>(cycle_size / MIN_SEGMENT_SIZE, 1),
+									   (4 * pool.size() + d - 1) / d);
+	}
+	const size_type segment_size = (cycle_size + segments - 1) / segments;
+	segments = (cycle_size + segment_size - 1) / segment_size;
+
+	// mass and counter of the witness at the end of a segment
+	typedef std::pair<value_type, decomposition_value_type> state_type;
+	std::vector<state_type> ends(d * segments), carries(d * segments);
+
+	// residue reached in step 'step' of the cycle starting at residue 'c'
+	auto getResidue = [=](value_type c, size_type step) {
+		return static_cast<size_type>((c + static_cast<uint64_t>(step) * p_inc) % smallestMass);
+	};
+
+	pool.parallelFor(d * segments, [&](size_type task) {
+		size_type first = (task % segments) * segment_size;
+		size_type last = std::min(first + segment_size, cycle_size);
+		size_type p = getResidue(task / segments, first);
+		// n is the value that will be written into the table, starting with
+		// infinity nothing is carried into the first residue
+		value_type n = infty;
+		// counter for creation of witness vector
+		decomposition_value_type counter = 0;
+		for (size_type step = first; step < last; ++step) {
+			n += currentMass;
+			++counter;
+			if (n > prev_column[p]) {
+				n = prev_column[p];
+				counter = 0;
+			} else {
+				witness_vector[p] = std::make_pair(i, counter);
+			}
+			cur_column[p] = n;
+			p += p_inc;
+			if (p >= smallestMass) {
+				p -= smallestMass;
+			}
+		}
+		ends[task] = state_type(n, counter);
+	});
+
+	// The segment with the smallest entry of prev_column in a cycle ends
+	// the same whatever enters it, so two rounds carry the right masses
+	// into all segments.
+	for (size_type c = 0; c < d; ++c) {
+		state_type carry(infty, 0);
+		for (size_type round = 0; round < 2; ++round) {
+			for (size_type task = c * segments; task < (c + 1) * segments; ++task) {
+				carries[task] = carry;
+				value_type length = std::min(segment_size,
+											 cycle_size - (task % segments) * segment_size);
+				// the carried mass is not larger than any entry of the segment
+				if (carry.first <= ends[task].first &&
+						ends[task].first - carry.first >= length * currentMass) {
+					carry.first += length * currentMass;
+					carry.second += static_cast<decomposition_value_type>(length);
+				} else {
+					carry = ends[task];
+				}
+			}
+		}
+	}
+
+	pool.parallelFor(d * segments, [&](size_type task) {
+		size_type first = (task % segments) * segment_size;
+		size_type last = std::min(first + segment_size, cycle_size);
+		size_type p = getResidue(task / segments, first);
+		value_type n = carries[task].first;
+		decomposition_value_type counter = carries[task].second;
+		for (size_type step = first; step < last; ++step) {
+			n += currentMass;
+			++counter;
+			// once an entry is smaller than the carried mass, so are the following ones
+			if (n > cur_column[p]) {
+				break;
+			}
+			cur_column[p] = n;
+			witness_vector[p] = std::make_pair(i, counter);
+			p += p_inc;
+			if (p >= smallestMass) {
+				p -= smallestMass;
+			}
+		}
+	});
+}
+
+
+template <typename ValueType, typename ResidueType>
+void ExtendedResidueTable<ValueType, ResidueType>::checkRange() const {
+	// finite masses are smaller than infty, hence their quotients smaller
+	// than the largest weight, which must differ from unreachable
+	if (residues > 0 && infty / residues >= unreachable) {
+		throw std::overflow_error("weights are too large for the entries of the residue table");
+	}
+}
+
+
+template <typename ValueType, typename ResidueType>
+void ExtendedResidueTable<ValueType, ResidueType>::getMasses(size_type i,
+															column_type& masses) const {
+	const residue_type* column = getColumn(i);
+	masses.resize(residues);
+	for (value_type r = 0; r < residues; ++r) {
+		masses[r] = getMass(column[r], r);
+	}
+}
+
+
+template <typename ValueType, typename ResidueType>
+void ExtendedResidueTable<ValueType, ResidueType>::setMasses(size_type i,
+															const column_type& masses) {
+	residue_type* column = &entries[i * residues];
+	for (value_type r = 0; r < residues; ++r) {
+		column[r] = (masses[r] >= infty) ? unreachable :
+			static_cast<residue_type>(masses[r] / residues);
+	}
+}
+
+} // namespace ims
+
+#endif // IMS_EXTENDEDRESIDUETABLE_H
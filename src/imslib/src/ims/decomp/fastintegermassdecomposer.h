@@ -7,6 +7,7 @@
 #include <ims/weights.h>
 #include <ims/utils/gcd.h>
 #include <ims/decomp/massdecomposer.h>
+#include <ims/decomp/extendedresiduetable.h>
 
 namespace ims {
 
@@ -118,7 +119,7 @@ class FastIntegerMassDecomposer :
 		/**
 		 * Type of the residues table.
 		 */
-		typedef std::vector<residues_table_row_type> residues_table_type;
+		typedef ExtendedResidueTable<value_type> residues_table_type;
 
 		/**
 		 * Weights over which the mass is to be decomposed.
@@ -156,13 +157,6 @@ class FastIntegerMassDecomposer :
 		 */
 		witness_vector_type witness_vector;
 
-		/**
-		 * Fills the extended residues table.
-		 */
-		void fillExtendedResidueTable(const Weights& _alphabet, residues_table_row_type& _lcms,
-									  residues_table_row_type& _mass_in_lcms, const value_type _infty,
-									  witness_vector_type& _witness_vector, residues_table_type& _ertable);
-
 		/**
 		 * Collects decompositions for @c mass by recursion. 
 		 *
@@ -188,179 +182,8 @@ FastIntegerMassDecomposer<ValueType, DecompositionValueType>::FastIntegerMassDec
 
 	infty = alphabet.getWeight(0) * alphabet.getWeight(alphabet.size()-1);
 
-	fillExtendedResidueTable(alphabet, lcms, mass_in_lcms, infty, witness_vector, ertable);
-
-}
-
-
-template <typename ValueType, typename DecompositionValueType>
-void FastIntegerMassDecomposer<ValueType, DecompositionValueType>::fillExtendedResidueTable(
-	const Weights& _alphabet, residues_table_row_type& _lcms, residues_table_row_type& _mass_in_lcms,
-	const value_type _infty, witness_vector_type& _witnessVector, residues_table_type& _ertable) {
-
-	if (_alphabet.size() < 2) {
-		return;
-	}
-	// caches the most often used mass - smallest mass
-	value_type smallestMass = _alphabet.getWeight(0), secondMass = _alphabet.getWeight(1);
-
-	// initializes table: infinity everywhere except in the first field of every column
-	_ertable.reserve(_alphabet.size());
-	_ertable.assign(_alphabet.size(), std::vector<value_type>(smallestMass, _infty));
-
-	for (size_type i = 0; i < _alphabet.size(); ++i) {
-		_ertable[i][0] = 0;
-	}
-
-	// initializes witness vector
-	_witnessVector.reserve(smallestMass);
-	_witnessVector.resize(smallestMass);
-
-	// fills second column (the first one is already correct)
-	size_type it_inc = secondMass % smallestMass, witness = 1;
-	typename residues_table_row_type::iterator it = _ertable[1].begin() + it_inc;
-	value_type mass = secondMass;
-	// initializes counter to create a witness vector
-	decomposition_value_type counter = 0;
-	while (it != _ertable[1].begin()) {
-		*it = mass;
-		mass += secondMass;
-		++counter;
-		_witnessVector[it - _ertable[1].begin()] = std::make_pair(witness, counter);
-		it += it_inc;
-		if (it >= _ertable[1].end()) {
-			it -= _ertable[1].size();
-		}
-	}
-	// fills cache variables for i==1
-	value_type d = gcd(smallestMass, secondMass);
-	_lcms[1] = secondMass*smallestMass / d;
-	_mass_in_lcms[1] = smallestMass / d;
-
-	// fills remaining table. i is the column index.
-	for (size_type i = 2; i < _alphabet.size(); ++i) {
-		// caches often used i-th alphabet mass
-		value_type currentMass = _alphabet.getWeight(i);
-
-		value_type d = gcd(smallestMass, currentMass);
-
-		// fills cache for various variables.
-		// note that values for i==0 are never assigned since they're unused anyway.
-		_lcms[i] = currentMass*smallestMass / d;
-		_mass_in_lcms[i] = smallestMass / d;
-
-		// Nijenhuis' improvement: Is currentMass composable with smaller alphabet?
-		if (currentMass >= _ertable[i-1][currentMass % smallestMass]) {
-			_ertable[i] = _ertable[i-1];
-			continue;
-		}
-
-		const residues_table_row_type& prev_column = _ertable[i-1];
-		residues_table_row_type& cur_column = _ertable[i];
-
-		if (d == 1) {
-			// This loop is for the case that the gcd is 1. The optimization used below
-			// is not applicable here.
-
-			// p_inc is used to change residue (p) efficiently
-			size_type p_inc = currentMass % smallestMass;
-
-			// n is the value that will be written into the table
-			value_type n = 0;
-			// current residue (in paper variable 'r' is used)
-			size_type p = 0;
-			// counter for creation of witness vector
-			decomposition_value_type counter = 0;
-
-			for (size_type m = smallestMass; m > 0; --m) {
-				n += currentMass;
-				p += p_inc;
-				++counter;
-				if (p >= smallestMass) {
-					p -= smallestMass;
-				}
-				if (n > prev_column[p]) {
-					n = prev_column[p];
-					counter = 0;
-				} else {
-					_witnessVector[p] = std::make_pair(i, counter);
-				}
-				cur_column[p] = n;
-			}
-		}
-		else {
-			// If we're here, the gcd is not 1. We can use the following cache-optimized
-			// version of the algorithm. The trick is to put the iteration over all
-			// residue classes into the _inner_ loop.
-			//
-			// One could see it as going through one column in blocks which are gcd entries long.
-			size_type cur = currentMass % smallestMass;
-			size_type prev = 0;
-			size_type p_inc = cur-d;
-			// counters for creation of one witness vector
-			std::vector<decomposition_value_type> counters(smallestMass);
-
-			// copies first block from prev_column to cur_column
-			for (size_type j = 1; j < d; ++j) {
-				cur_column[j] = prev_column[j];
-			}
+	ertable = residues_table_type(alphabet, lcms, mass_in_lcms, witness_vector);
 
-			// first loop: goes through all blocks, updating cur_column for the first time.
-			for (size_type m = smallestMass / d; m > 1; m--) {
-				// r: current residue class
-				for (size_type r = 0; r < d; r++) {
-
-					++counters[cur];
-					if (cur_column[prev] + currentMass > prev_column[cur]) {
-						cur_column[cur] = prev_column[cur];
-						counters[cur] = 0;
-					} else {
-						cur_column[cur] = cur_column[prev] + currentMass;
-						_witnessVector[cur] = std::make_pair(i, counters[cur]);
-					}
-
-					prev++;
-					cur++;
-				}
-
-				prev = cur - d;
-
-				// this does: cur = (cur + currentMass) % smallestMass - d;
-				cur += p_inc;
-				if (cur >= smallestMass) {
-					cur -= smallestMass;
-				}
-			}
-
-			// second loop:
-			bool cont = true;
-			while (cont) {
-				cont = false;
-				prev++;
-				cur++;
-				++counters[cur];
-				for (size_type r = 1; r < d; ++r) {
-					if (cur_column[prev] + currentMass < cur_column[cur]) {
-						cur_column[cur] = cur_column[prev] + currentMass;
-						cont = true;
-						_witnessVector[cur] = std::make_pair(i, counters[cur]);
-					} else {
-						counters[cur] = 0;
-					}
-					prev++;
-					cur++;
-				}
-
-				prev = cur - d;
-
-				cur += p_inc;
-				if (cur >= smallestMass) {
-					cur -= smallestMass;
-				}
-			}
-		}
-
-	}
 }
 
 
@@ -368,7 +191,7 @@ template <typename ValueType, typename DecompositionValueType>
 bool FastIntegerMassDecomposer<ValueType, DecompositionValueType>::
 exist(value_type mass) {
 
-	value_type residue = ertable.back().at(mass % alphabet.getWeight(0));
+	value_type residue = ertable.get(alphabet.size()-1, mass % alphabet.getWeight(0));
 	return (residue != infty && mass >= residue);
 }
 
@@ -388,7 +211,7 @@ getDecomposition(value_type mass) {
 
 	// initial mass residue: in FIND-ONE algorithm in paper corresponds variable "r"
 	value_type r = mass % alphabet.getWeight(0);
-	value_type m = ertable.back().at(r);
+	value_type m = ertable.get(alphabet.size()-1, r);
 
 	decomposition.at(0) = static_cast<decomposition_value_type>
 		((mass - m) / alphabet.getWeight(0));
@@ -476,7 +299,7 @@ getAllDecompositions(value_type mass) {
                         decomposition[index] = static_cast<decomposition_value_type>(amounts[index]);
                         mass_rests[index-1] = mass_rests[index] - amounts[index] * alphabet.getWeight(index);
                         residues[index] = mass_rests[index-1] % alphabet.getWeight(0);
-                        lbounds[index] = ertable[index-1][residues[index]];
+                        lbounds[index] = ertable.get(index-1, residues[index]);
 
                         // enters in while loop
                         isInWhileLoop = true;
@@ -543,7 +366,7 @@ collectDecompositionsRecursively(value_type mass, size_type alphabetMassIndex,
 		}
 
 		/* r: current residue class. will stay the same in the following loop */
-		value_type r = ertable[alphabetMassIndex-1][mass_mod_alphabet0];
+		value_type r = ertable.get(alphabetMassIndex-1, mass_mod_alphabet0);
 
 		// TODO: if infty was std::numeric_limits<...>... the following 'if' would not be necessary
 		if (r != infty) {
@@ -0,0 +1,294 @@
+/**
+ * formulaindex.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include <ims/decomp/formulaindex.h>
+#include <ims/isotopedistributionfolder.h>
+#include <ims/chemicalrules.h>
+
+namespace ims {
+
+const FormulaIndex::mass_type FormulaIndex::WINDOW = 1.0;
+
+namespace {
+
+const char MAGIC[8] = { 'I', 'M', 'S', 'F', 'I', 'D', 'X', '\0' };
+
+// written as is, reads differently with another byte order
+const uint32_t ORDER_MARK = 0x01020304;
+
+FormulaIndex::size_type align(FormulaIndex::size_type size) {
+	return (size + 7) / 8 * 8;
+}
+
+/**
+ * Collects the decompositions with masses in [min_mass; max_mass) with
+ * their masses, double bond equivalents and isotope ratios.
+ */
+struct FormulaCollector {
+	typedef FormulaIndex::decomposition_type decomposition_type;
+	typedef FormulaIndex::mass_type mass_type;
+	typedef FormulaIndex::count_type count_type;
+	typedef FormulaIndex::value_type value_type;
+	typedef IsotopeDistribution::abundance_type abundance_type;
+
+	FormulaCollector(const Alphabet& alphabet, const Alphabet::masses_type& alphabet_masses,
+					 const std::vector<long>& dbe_coefficients) :
+		alphabet_masses(&alphabet_masses), dbe_coefficients(&dbe_coefficients),
+		min_mass(0.0), max_mass(0.0),
+		folder(alphabet, IsotopeDistribution::settings_type(3,
+				std::numeric_limits<abundance_type>::infinity())) { }
+
+	void operator()(const decomposition_type& decomposition) {
+		// the mass as summed up by the decomposer
+		mass_type mass = 0.0;
+		for (decomposition_type::size_type i = 0; i < decomposition.size(); ++i) {
+			mass += decomposition[i] * (*alphabet_masses)[i];
+		}
+		if (mass < min_mass || mass >= max_mass) {
+			return;
+		}
+		masses.push_back(mass);
+
+		// twice the double bond equivalent, which is a multiple of 1/2
+		long dbe = 2;
+		for (decomposition_type::size_type i = 0; i < decomposition.size(); ++i) {
+			dbe += (*dbe_coefficients)[i] * static_cast<long>(decomposition[i]);
+			counts.push_back(static_cast<count_type>(decomposition[i]));
+		}
+		dbes.push_back(static_cast<FormulaIndex::dbe_type>(std::max<long>(
+			std::numeric_limits<FormulaIndex::dbe_type>::min(),
+			std::min<long>(dbe, std::numeric_limits<FormulaIndex::dbe_type>::max()))));
+
+		// the first peaks, not normalized
+		const IsotopeDistribution& distribution = folder.fold(decomposition);
+		abundance_type monoisotopic = (distribution.size() > 0) ? distribution.getAbundance(0) : 0.0;
+		for (IsotopeDistribution::size_type peak = 1; peak <= 2; ++peak) {
+			abundance_type ratio = 0.0;
+			if (peak < distribution.size() && monoisotopic > 0.0) {
+				ratio = distribution.getAbundance(peak) / monoisotopic;
+			}
+			ratios.push_back(static_cast<value_type>(ratio));
+		}
+	}
+
+	const Alphabet::masses_type* alphabet_masses;
+	const std::vector<long>* dbe_coefficients;
+	mass_type min_mass;
+	mass_type max_mass;
+	IsotopeDistributionFolder folder;
+
+	std::vector<mass_type> masses;
+	std::vector<count_type> counts;
+	std::vector<value_type> ratios;
+	std::vector<FormulaIndex::dbe_type> dbes;
+};
+
+} // namespace
+
+
+FormulaIndex::FormulaIndex(const alphabet_type& alphabet, RealMassDecomposer& decomposer,
+						   mass_type min_mass, mass_type max_mass, const bounds_type& bounds,
+						   const DecompositionConstraints& constraints,
+						   const std::string& parameters, ThreadPool& pool) :
+		data(0), data_size(0), header(0), formulas(0), elements(alphabet.size()),
+		masses(0), ratios(0), dbes(0), counts(0) {
+	if (!(min_mass >= 0.0 && min_mass < max_mass)) {
+		throw std::invalid_argument("the mass range of a formula index must not be empty");
+	}
+
+	// counts are bounded by the mass range (and the bounds, if any)
+	Alphabet::masses_type alphabet_masses = alphabet.getMasses();
+	std::vector<long> dbe_coefficients;
+	for (alphabet_type::size_type i = 0; i < alphabet.size(); ++i) {
+		double max_count = std::floor(max_mass / alphabet_masses[i]);
+		if (i < bounds.upper.size()) {
+			max_count = std::min(max_count, static_cast<double>(bounds.upper[i]));
+		}
+		if (!(max_count <= std::numeric_limits<count_type>::max())) {
+			throw std::invalid_argument("counts of element " + alphabet.getName(i) +
+				" exceed the ones a formula index can hold");
+		}
+		dbe_coefficients.push_back(static_cast<long>(ChemicalRules::getValence(alphabet.getName(i))) - 2);
+	}
+
+	// decomposes window by window, the decompositions of every window are
+	// collected by the copies of the collector in traversal order
+	FormulaCollector collector(alphabet, alphabet_masses, dbe_coefficients);
+	FormulaCollector collected(collector);
+	for (mass_type low = min_mass; low < max_mass; low += WINDOW) {
+		collector.min_mass = low;
+		collector.max_mass = std::min(low + WINDOW, max_mass);
+		mass_type mass = (collector.min_mass + collector.max_mass) / 2;
+		mass_type error = (collector.max_mass - collector.min_mass) / 2;
+		std::vector< ConstrainedVisitor<FormulaCollector> > parts =
+			decomposer.visitPrunedDecompositions(mass, error, bounds,
+				ConstrainedVisitor<FormulaCollector>(constraints, collector), pool);
+		for (std::vector< ConstrainedVisitor<FormulaCollector> >::const_iterator it = parts.begin();
+				it != parts.end(); ++it) {
+			const FormulaCollector& part = it->visitor;
+			collected.masses.insert(collected.masses.end(), part.masses.begin(), part.masses.end());
+			collected.counts.insert(collected.counts.end(), part.counts.begin(), part.counts.end());
+			collected.ratios.insert(collected.ratios.end(), part.ratios.begin(), part.ratios.end());
+			collected.dbes.insert(collected.dbes.end(), part.dbes.begin(), part.dbes.end());
+		}
+	}
+
+	// sorts by mass, ties in the order they were decomposed
+	formulas = collected.masses.size();
+	std::vector<size_type> order(formulas);
+	for (size_type i = 0; i < formulas; ++i) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&collected](size_type left, size_type right) {
+		return collected.masses[left] < collected.masses[right];
+	});
+
+	// writes the image of the file
+	std::string alphabet_key = getAlphabetKey(alphabet);
+	size_type tables = align(sizeof(Header) + alphabet_key.size() + parameters.size());
+	size_type counts_offset = align(tables +
+		formulas * (sizeof(double) + 2 * sizeof(value_type) + sizeof(dbe_type)));
+	data_size = counts_offset + formulas * elements * sizeof(count_type);
+	image.assign((data_size + sizeof(double) - 1) / sizeof(double), 0.0);
+	char* image_data = reinterpret_cast<char*>(image.data());
+
+	Header image_header;
+	std::memset(&image_header, 0, sizeof(Header));
+	std::memcpy(image_header.magic, MAGIC, sizeof(MAGIC));
+	image_header.version = VERSION;
+	image_header.byte_order = ORDER_MARK;
+	image_header.formulas = formulas;
+	image_header.elements = static_cast<uint32_t>(elements);
+	image_header.min_mass = min_mass;
+	image_header.max_mass = max_mass;
+	image_header.alphabet_key_size = alphabet_key.size();
+	image_header.parameters_size = parameters.size();
+	std::memcpy(image_data, &image_header, sizeof(Header));
+	std::memcpy(image_data + sizeof(Header), alphabet_key.data(), alphabet_key.size());
+	std::memcpy(image_data + sizeof(Header) + alphabet_key.size(), parameters.data(), parameters.size());
+
+	double* image_masses = reinterpret_cast<double*>(image_data + tables);
+	value_type* image_ratios = reinterpret_cast<value_type*>(image_masses + formulas);
+	dbe_type* image_dbes = reinterpret_cast<dbe_type*>(image_ratios + 2 * formulas);
+	count_type* image_counts = reinterpret_cast<count_type*>(image_data + counts_offset);
+	for (size_type i = 0; i < formulas; ++i) {
+		size_type formula = order[i];
+		image_masses[i] = collected.masses[formula];
+		image_ratios[2 * i] = collected.ratios[2 * formula];
+		image_ratios[2 * i + 1] = collected.ratios[2 * formula + 1];
+		image_dbes[i] = collected.dbes[formula];
+		std::copy(collected.counts.begin() + formula * elements,
+				  collected.counts.begin() + (formula + 1) * elements,
+				  image_counts + i * elements);
+	}
+
+	setTables(image_data, data_size);
+}
+
+
+FormulaIndex::FormulaIndex(const std::string& filename, const alphabet_type& alphabet,
+						   const std::string& parameters) /*throw (IOException)*/ :
+		file(new MappedFile(filename)), data(0), data_size(0), header(0), formulas(0),
+		elements(0), masses(0), ratios(0), dbes(0), counts(0) {
+	const Header* file_header = reinterpret_cast<const Header*>(file->data());
+	if (file->size() < sizeof(Header) || std::memcmp(file_header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+		throw IOException("File \"" + filename + "\" is no formula index!");
+	}
+	if (file_header->byte_order != ORDER_MARK) {
+		throw IOException("Formula index \"" + filename + "\" was written with another byte order!");
+	}
+	if (file_header->version != VERSION) {
+		throw IOException("Formula index \"" + filename + "\" was written by another version!");
+	}
+	setTables(file->data(), file->size());
+
+	const char* strings = data + sizeof(Header);
+	if (std::string(strings, header->alphabet_key_size) != getAlphabetKey(alphabet)) {
+		throw IOException("Formula index \"" + filename + "\" was built over other elements!");
+	}
+	if (getParameters() != parameters) {
+		throw IOException("Formula index \"" + filename + "\" was built with other parameters!");
+	}
+}
+
+
+void FormulaIndex::setTables(const char* data, size_type size) /*throw (IOException)*/ {
+	this->data = data;
+	data_size = size;
+	header = reinterpret_cast<const Header*>(data);
+	formulas = static_cast<size_type>(header->formulas);
+	elements = header->elements;
+
+	size_type tables = align(sizeof(Header) + header->alphabet_key_size + header->parameters_size);
+	size_type counts_offset = align(tables +
+		formulas * (sizeof(double) + 2 * sizeof(value_type) + sizeof(dbe_type)));
+	if (size < counts_offset + formulas * elements * sizeof(count_type)) {
+		throw IOException("Formula index is truncated!");
+	}
+	masses = reinterpret_cast<const double*>(data + tables);
+	ratios = reinterpret_cast<const value_type*>(masses + formulas);
+	dbes = reinterpret_cast<const dbe_type*>(ratios + 2 * formulas);
+	counts = reinterpret_cast<const count_type*>(data + counts_offset);
+}
+
+
+void FormulaIndex::save(const std::string& filename) const /*throw (IOException)*/ {
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out || !out.write(data, data_size) || !out.flush()) {
+		throw IOException("Cannot write formula index to file \"" + filename + "\"!");
+	}
+}
+
+
+std::string FormulaIndex::getAlphabetKey(const alphabet_type& alphabet) {
+	std::ostringstream key;
+	key << std::setprecision(17);
+	for (alphabet_type::size_type i = 0; i < alphabet.size(); ++i) {
+		const IsotopeDistribution& distribution = alphabet.getElement(i).getIsotopeDistribution();
+		key << alphabet.getName(i);
+		for (IsotopeDistribution::size_type j = 0; j < distribution.size(); ++j) {
+			key << ':' << distribution.getMass(j) << '/' << distribution.getAbundance(j);
+		}
+		key << ';';
+	}
+	return key.str();
+}
+
+
+FormulaIndex::mass_type FormulaIndex::getMinMass() const {
+	return header->min_mass;
+}
+
+
+FormulaIndex::mass_type FormulaIndex::getMaxMass() const {
+	return header->max_mass;
+}
+
+
+std::string FormulaIndex::getParameters() const {
+	return std::string(data + sizeof(Header) + header->alphabet_key_size, header->parameters_size);
+}
+
+
+FormulaIndex::range_type FormulaIndex::find(mass_type mass, mass_type error) const {
+	const double* first = std::lower_bound(masses, masses + formulas, mass - error);
+	const double* last = std::upper_bound(first, masses + formulas, mass + error);
+	return range_type(first - masses, last - masses);
+}
+
+
+void FormulaIndex::getDecomposition(size_type i, decomposition_type& decomposition) const {
+	decomposition.assign(counts + i * elements, counts + (i + 1) * elements);
+}
+
+} // namespace ims
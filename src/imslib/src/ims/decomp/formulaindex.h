@@ -0,0 +1,282 @@
+#ifndef IMS_FORMULAINDEX_H
+#define IMS_FORMULAINDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstddef>
+#include <stdint.h>
+
+#include <ims/alphabet.h>
+#include <ims/decomp/realmassdecomposer.h>
+#include <ims/decomp/decompositionconstraints.h>
+#include <ims/utils/mappedfile.h>
+#include <ims/utils/threadpool.h>
+#include <ims/base/exception/ioexception.h>
+
+namespace ims {
+
+/**
+ * @brief Precomputed table of all decompositions of a mass range, sorted by
+ * their exact mass, to look up the decompositions of a mass without decomposing it.
+ *
+ * The index is built once by decomposing the mass range [min_mass; max_mass)
+ * window by window with a @c RealMassDecomposer, applying bounds and
+ * constraints while decomposing. For every decomposition it keeps the
+ * counts of the alphabet elements, the exact mass (the sum of the alphabet
+ * masses, as used by the decomposer), the double bond equivalent in one
+ * byte and the abundances of the M+1 and M+2 isotope peaks relative to the
+ * monoisotopic one, which scorers can compare with the measured ones before
+ * folding. Decompositions of a mass within an error are then found by
+ * binary search followed by a scan of the range.
+ *
+ * The index can be saved to a file and mapped into memory later, so that
+ * it is neither built nor read again. The file is tied to the alphabet
+ * (names, masses and isotopes of the elements, see getAlphabetKey()) and
+ * to a description of the bounds and constraints given by the caller; a
+ * file built for other ones or by another version of the format is rejected.
+ * Files are read with the byte order they were written with and are not
+ * portable between platforms of different byte order.
+ *
+ * @see RealMassDecomposer, DecompositionConstraints
+ *
+ * @ingroup decomp
+ */
+class FormulaIndex {
+	public:
+		/**
+		 * Type of alphabet.
+		 */
+		typedef Alphabet alphabet_type;
+
+		/**
+		 * Type of masses.
+		 */
+		typedef alphabet_type::mass_type mass_type;
+
+		/**
+		 * Type of decompositions, the counts of the alphabet elements.
+		 */
+		typedef RealMassDecomposer::decomposition_type decomposition_type;
+
+		/**
+		 * Type of bounds for the counts of the elements.
+		 */
+		typedef RealMassDecomposer::bounds_type bounds_type;
+
+		/**
+		 * Type of element counts as stored in the index.
+		 */
+		typedef uint16_t count_type;
+
+		/**
+		 * Type of isotope ratios.
+		 */
+		typedef float value_type;
+
+		/**
+		 * Type of double bond equivalents as stored in the index, twice
+		 * their values.
+		 */
+		typedef int8_t dbe_type;
+
+		/**
+		 * Type of sizes and positions in the index.
+		 */
+		typedef std::size_t size_type;
+
+		/**
+		 * Type of ranges [first; second) of positions in the index.
+		 */
+		typedef std::pair<size_type, size_type> range_type;
+
+		/**
+		 * Version of the file format, files of other versions are rejected.
+		 */
+		static const uint32_t VERSION = 1;
+
+		/**
+		 * Width of the mass windows decomposed one after another while building.
+		 */
+		static const mass_type WINDOW;
+
+		/**
+		 * Constructor, builds the index of all decompositions of the masses
+		 * in [@c min_mass; @c max_mass) over the @c alphabet by @c decomposer,
+		 * whose weights have to be the ones of the @c alphabet.
+		 *
+		 * @param alphabet Alphabet the decompositions are counting the elements of.
+		 * @param decomposer Decomposer over the masses of the @c alphabet.
+		 * @param min_mass Smallest mass of the index.
+		 * @param max_mass Mass above the ones of the index.
+		 * @param bounds Bounds for the counts of the elements.
+		 * @param constraints Constraints the decompositions have to satisfy.
+		 * @param parameters Description of @c bounds and @c constraints, loading
+		 * the index from a file requires the same description.
+		 * @param pool Threads to decompose with.
+		 * @throws std::invalid_argument if the mass range is empty or element
+		 * counts in it may exceed the range of @c count_type
+		 */
+		FormulaIndex(const alphabet_type& alphabet, RealMassDecomposer& decomposer,
+					 mass_type min_mass, mass_type max_mass, const bounds_type& bounds,
+					 const DecompositionConstraints& constraints,
+					 const std::string& parameters, ThreadPool& pool);
+
+		/**
+		 * Constructor, maps the index saved to the file @c filename.
+		 *
+		 * @param filename Name of the file written by save().
+		 * @param alphabet Alphabet the index has to be built over.
+		 * @param parameters Description of bounds and constraints the index
+		 * has to be built with.
+		 * @throws IOException if the file cannot be mapped, is no index of this
+		 * version or was built over another alphabet or with other parameters
+		 */
+		FormulaIndex(const std::string& filename, const alphabet_type& alphabet,
+					 const std::string& parameters) /*throw (IOException)*/;
+
+		/**
+		 * Saves the index to the file @c filename.
+		 *
+		 * @throws IOException if the file cannot be written
+		 */
+		void save(const std::string& filename) const /*throw (IOException)*/;
+
+		/**
+		 * Gets the key an index is tied to for the @c alphabet: names,
+		 * masses and isotope abundances of the elements in their order.
+		 */
+		static std::string getAlphabetKey(const alphabet_type& alphabet);
+
+		/**
+		 * Gets the number of decompositions in the index.
+		 */
+		size_type size() const { return formulas; }
+
+		/**
+		 * Gets the number of elements every decomposition counts.
+		 */
+		size_type getNumberOfElements() const { return elements; }
+
+		/**
+		 * Gets the smallest mass of the index.
+		 */
+		mass_type getMinMass() const;
+
+		/**
+		 * Gets the mass above the ones of the index.
+		 */
+		mass_type getMaxMass() const;
+
+		/**
+		 * Gets the description of bounds and constraints the index was built with.
+		 */
+		std::string getParameters() const;
+
+		/**
+		 * Whether the index was mapped from a file.
+		 */
+		bool isMapped() const { return file.get() != 0; }
+
+		/**
+		 * Whether all decompositions of @c mass within @c error are in the index.
+		 */
+		bool covers(mass_type mass, mass_type error) const {
+			return mass - error >= getMinMass() && mass + error < getMaxMass();
+		}
+
+		/**
+		 * Gets the positions of the decompositions whose masses lie in
+		 * [@c mass - @c error; @c mass + @c error], in increasing order of mass.
+		 */
+		range_type find(mass_type mass, mass_type error) const;
+
+		/**
+		 * Gets the exact mass of the decomposition at position @c i.
+		 */
+		mass_type getMass(size_type i) const { return masses[i]; }
+
+		/**
+		 * Gets the double bond equivalent of the decomposition at position @c i,
+		 * with the valences of ChemicalRules::getValence(). Values beyond
+		 * [-64; 63.5] are stored as the nearest bound.
+		 */
+		double getDoubleBondEquivalent(size_type i) const { return dbes[i] / 2.0; }
+
+		/**
+		 * Gets the abundance of the isotope peak M+@c peak (1 or 2) of the
+		 * decomposition at position @c i relative to the monoisotopic one.
+		 */
+		value_type getIsotopeRatio(size_type i, size_type peak) const {
+			return ratios[2 * i + peak - 1];
+		}
+
+		/**
+		 * Gets the count of the element @c element of the decomposition at position @c i.
+		 */
+		count_type getCount(size_type i, size_type element) const {
+			return counts[i * elements + element];
+		}
+
+		/**
+		 * Gets the decomposition at position @c i.
+		 */
+		void getDecomposition(size_type i, decomposition_type& decomposition) const;
+
+	private:
+		/**
+		 * Header of the file, followed by the alphabet key, the parameters
+		 * and the tables, each aligned to 8 bytes.
+		 */
+		struct Header {
+			char magic[8];
+			uint32_t version;
+			uint32_t byte_order;
+			uint64_t formulas;
+			uint32_t elements;
+			uint32_t reserved;
+			double min_mass;
+			double max_mass;
+			uint64_t alphabet_key_size;
+			uint64_t parameters_size;
+		};
+
+		/**
+		 * Sets the tables to the image of the index at @c data of @c size bytes.
+		 *
+		 * @throws IOException if the image is too small for its header
+		 */
+		void setTables(const char* data, size_type size) /*throw (IOException)*/;
+
+		/**
+		 * Index in memory, if it was built.
+		 */
+		std::vector<double> image;
+
+		/**
+		 * File the index was mapped from, if it was loaded.
+		 */
+		std::unique_ptr<MappedFile> file;
+
+		/**
+		 * Start and size of the image, in memory or mapped.
+		 */
+		const char* data;
+		size_type data_size;
+
+		/**
+		 * Header and tables of the image.
+		 */
+		const Header* header;
+		size_type formulas;
+		size_type elements;
+		const double* masses;
+		const value_type* ratios;
+		const dbe_type* dbes;
+		const count_type* counts;
+};
+
+} // namespace ims
+
+#endif // IMS_FORMULAINDEX_H
@@ -2,10 +2,24 @@
 #define IMS_INTEGERMASSDECOMPOSER_H
 
 #include <vector>
+#include <algorithm>
+#include <map>
 #include <utility>
+#include <limits>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <fstream>
+#include <stdint.h>
 #include <ims/weights.h>
 #include <ims/utils/gcd.h>
+#include <ims/utils/mappedfile.h>
+#include <ims/utils/threadpool.h>
+#include <ims/base/exception/ioexception.h>
 #include <ims/decomp/massdecomposer.h>
+#include <ims/decomp/extendedresiduetable.h>
+#include <ims/decomp/decomputils.h>
 
 namespace ims {
 
@@ -20,6 +34,8 @@ namespace ims {
  *
  * @param ValueType Type of values to be decomposed.
  * @param DecompositionValueType Type of decomposition elements.
+ * @param ResidueType Type of the entries of the residue tables, see
+ * ExtendedResidueTable.
  * 
  * @see ClassicalDPMassDecomposer
  * 
@@ -30,7 +46,8 @@ namespace ims {
  * @author Henner Sudek <Henner.Sudek@CeBiTec.Uni-Bielefeld.DE>  
  */
 template <typename ValueType = long unsigned int,
-		  typename DecompositionValueType = unsigned int>
+		  typename DecompositionValueType = unsigned int,
+		  typename ResidueType = uint32_t>
 class IntegerMassDecomposer : 
 				public MassDecomposer<ValueType,DecompositionValueType> {
 	public:
@@ -63,13 +80,93 @@ class IntegerMassDecomposer :
 		 */
 		typedef typename decomposition_type::size_type size_type;
 
+		/**
+		 * Type of flat container for many decompositions: a row-major
+		 * matrix of counts with one row per decomposition and one column
+		 * per alphabet mass.
+		 */
+		typedef std::vector<decomposition_value_type> flat_decompositions_type;
+
+		/**
+		 * Lower and upper bounds for the counts of the alphabet masses.
+		 * Entries missing at the end of @c lower mean 0, entries missing
+		 * at the end of @c upper mean no upper bound.
+		 */
+		struct Bounds {
+			decomposition_type lower;
+			decomposition_type upper;
+		};
+
+		/**
+		 * Type of bounds for the counts of the alphabet masses.
+		 */
+		typedef Bounds bounds_type;
+
+		/**
+		 * Type of the number of decompositions.
+		 */
+		typedef unsigned long long number_of_decompositions_type;
+
+		/**
+		 * Version of the file format of saved residue tables, files of
+		 * other versions are rejected.
+		 */
+		static const uint32_t FILE_VERSION = 3;
+
 		/**
 		 * Constructor with weights.
 		 *
 		 * @param alphabet Weights over which masses to be decomposed.
+		 * @throws std::overflow_error if the weights are too large for
+		 * the entries of the residue tables
 		 */
 		IntegerMassDecomposer(const Weights& alphabet);
 
+		/**
+		 * Constructor with weights, computes the extended residue table with
+		 * the threads of @c pool. The decomposer is the same as the one of
+		 * IntegerMassDecomposer(const Weights&).
+		 *
+		 * @param alphabet Weights over which masses to be decomposed.
+		 * @param pool Threads computing the residue table.
+		 * @throws std::overflow_error if the weights are too large for
+		 * the entries of the residue tables
+		 */
+		IntegerMassDecomposer(const Weights& alphabet, ThreadPool& pool);
+
+		/**
+		 * Constructor with weights, maps the extended residue table saved to
+		 * the file @c filename instead of computing it. The table is used
+		 * where it is mapped, so processes mapping the same file share one
+		 * copy of it. Mass intervals are decomposed with the minima of blocks
+		 * of residues saved along with the table, no residue tables for
+		 * intervals are computed.
+		 *
+		 * @param alphabet Weights over which masses to be decomposed.
+		 * @param filename Name of the file written by save().
+		 * @throws IOException if the file cannot be mapped, is no residue
+		 * table of this version or was computed for other weights
+		 */
+		IntegerMassDecomposer(const Weights& alphabet, const std::string& filename)
+												/*throw (IOException)*/;
+
+		/**
+		 * Saves the extended residue table to the file @c filename: a header
+		 * with the weights, their precision, the least common multiples and
+		 * the witness vector, followed by the table, one column per alphabet
+		 * mass, and the smallest entry of every block of residues per column.
+		 * Files are read with the byte order they were written with
+		 * and are not portable between platforms of different byte order.
+		 *
+		 * @throws IOException if the file cannot be written
+		 */
+		void save(const std::string& filename) const /*throw (IOException)*/;
+
+		/**
+		 * Whether the extended residue table was mapped from a file.
+		 */
+		bool isMapped() const { return ertable_file.get() != 0; }
+
 		/**
 		 * Returns true if decomposition over the @c mass exists, otherwise - false.
 		 *
@@ -94,16 +191,196 @@ class IntegerMassDecomposer :
 		 */
 		virtual decompositions_type getAllDecompositions(value_type mass);
 
+		/**
+		 * Gets all possible decompositions for masses in [@c lo, @c hi].
+		 * Unlike decomposing every mass of the interval separately, the
+		 * extended residue table is traversed only once: branches are
+		 * followed as long as some mass of the interval is still decomposable.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @return All possible decompositions for masses in a given interval.
+		 */
+		virtual decompositions_type getAllDecompositions(value_type lo, value_type hi);
+
+		/**
+		 * Appends all possible decompositions for masses in [@c lo, @c hi]
+		 * to @c decompositions, one row per decomposition. Unlike the other
+		 * overloads, no memory is allocated per decomposition.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param decompositions Row-major matrix the decompositions are appended to.
+		 */
+		void getAllDecompositions(value_type lo, value_type hi,
+								  flat_decompositions_type& decompositions);
+
+		/**
+		 * Calls @c visitor for every decomposition of masses in [@c lo, @c hi].
+		 * The decomposition is passed as <tt>const decomposition_type&</tt>
+		 * and is modified in place by the enumeration once the visitor returns,
+		 * so the visitor has to copy what it wants to keep.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param visitor Function object to be called for every decomposition.
+		 * @return The visitor after all decompositions were visited.
+		 */
+		template <typename Visitor>
+		Visitor visitDecompositions(value_type lo, value_type hi, Visitor visitor);
+
+		/**
+		 * Calls @c visitor for every decomposition of masses in [@c lo, @c hi]
+		 * whose counts lie within @c bounds. The bounds are applied during the
+		 * traversal: lower bounds shift the masses to be decomposed, branches
+		 * exceeding an upper bound or whose remaining mass cannot be reached
+		 * within the upper bounds of the smaller alphabet masses are not
+		 * descended into.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param bounds Bounds for the counts of the alphabet masses.
+		 * @param visitor Function object to be called for every decomposition.
+		 * @return The visitor after all decompositions were visited.
+		 */
+		template <typename Visitor>
+		Visitor visitDecompositions(value_type lo, value_type hi,
+									const bounds_type& bounds, Visitor visitor);
+
+		/**
+		 * Visits decompositions of masses in [@c lo, @c hi] like
+		 * visitDecompositions(), but splits the traversal into independent
+		 * branches which are visited by the threads of @c pool. Every branch is
+		 * visited by its own copy of @c visitor, hence visitors need no locking.
+		 *
+		 * The residue tables are prepared before the threads are started.
+		 * Concurrent calls on the same decomposer are allowed, the residue
+		 * tables for intervals are shared between them.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param visitor Function object to be copied for every branch.
+		 * @param pool Threads to be used.
+		 * @return The copies of the visitor in traversal order: the decompositions
+		 * seen by them one after another are the same (and in the same order)
+		 * as the ones seen by visitDecompositions(). The traversal is split in
+		 * the same way for any number of threads greater than one, so every copy
+		 * sees the same decompositions independent of the pool. A pool of a
+		 * single thread does not split the traversal, its only copy sees all
+		 * decompositions.
+		 */
+		template <typename Visitor>
+		std::vector<Visitor> visitDecompositions(value_type lo, value_type hi,
+												 const Visitor& visitor, ThreadPool& pool);
+
+		/**
+		 * Visits decompositions of masses in [@c lo, @c hi] within @c bounds
+		 * by the threads of @c pool, see the overloads above.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param bounds Bounds for the counts of the alphabet masses.
+		 * @param visitor Function object to be copied for every branch.
+		 * @param pool Threads to be used.
+		 * @return The copies of the visitor in traversal order.
+		 */
+		template <typename Visitor>
+		std::vector<Visitor> visitDecompositions(value_type lo, value_type hi,
+												 const bounds_type& bounds,
+												 const Visitor& visitor, ThreadPool& pool);
+
+		/**
+		 * Visits decompositions of masses in [@c lo, @c hi] within @c bounds
+		 * and lets @c visitor prune the traversal. Besides being called for
+		 * every decomposition, the visitor has to provide
+		 * <tt>bool acceptsBranch(const decomposition_type& decomposition,
+		 * size_type alphabetMassIndex, value_type lowMass, value_type highMass)</tt>,
+		 * which is asked before a subtree is descended into. The counts of
+		 * alphabet masses with index greater than @c alphabetMassIndex are
+		 * fixed in @c decomposition, the other ones are at their lower bounds
+		 * and are increased within the subtree by alphabet masses adding up to
+		 * some mass in [@c lowMass, @c highMass]. If it returns false, the
+		 * subtree is skipped.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param bounds Bounds for the counts of the alphabet masses.
+		 * @param visitor Function object to be called for every branch and decomposition.
+		 * @return The visitor after all decompositions were visited.
+		 */
+		template <typename PruningVisitor>
+		PruningVisitor visitPrunedDecompositions(value_type lo, value_type hi,
+												 const bounds_type& bounds,
+												 PruningVisitor visitor);
+
+		/**
+		 * Visits decompositions of masses in [@c lo, @c hi] within @c bounds
+		 * by the threads of @c pool and lets the copies of @c visitor prune
+		 * the traversal, see the overloads above.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param bounds Bounds for the counts of the alphabet masses.
+		 * @param visitor Function object to be copied for every branch.
+		 * @param pool Threads to be used.
+		 * @return The copies of the visitor in traversal order. The first one
+		 * pruned the upper levels of the recursion while these were split into
+		 * branches and has not seen any decomposition. With a pool of a single
+		 * thread, the traversal is not split and the second copy is the one
+		 * returned by the serial overload.
+		 */
+		template <typename PruningVisitor>
+		std::vector<PruningVisitor> visitPrunedDecompositions(value_type lo, value_type hi,
+															  const bounds_type& bounds,
+															  const PruningVisitor& visitor,
+															  ThreadPool& pool);
+
 		/**
 		 * Gets number of all possible decompositions for a given @c mass.
-		 * Since using getAllDecomposition() the usage of this function could 
-		 * be @b consuming.
+		 * Decompositions are counted without enumerating them, see
+		 * getNumberOfDecompositions(value_type, value_type, const bounds_type&).
 		 * 
 		 * @param mass Mass to be decomposed
 		 * @return number of decompositions for a given mass.
 		 */
 		virtual decomposition_value_type getNumberOfDecompositions(value_type mass);
-		
+
+		/**
+		 * Gets number of all decompositions of masses in [@c lo, @c hi]
+		 * whose counts lie within @c bounds, without enumerating them.
+		 * The traversal of visitDecompositions() is followed for the larger
+		 * alphabet masses only. Once the counts of all but the three smallest
+		 * alphabet masses are fixed, the decompositions of the remaining
+		 * masses are counted by a table of the masses over the three smallest
+		 * alphabet masses, which is cached by the decomposer. Where the bounds
+		 * of the three smallest alphabet masses apply or the table would be
+		 * too large, the traversal goes one level further down and counts
+		 * over the two smallest alphabet masses per residue class in closed
+		 * form instead.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param bounds Bounds for the counts of the alphabet masses.
+		 * @return Number of decompositions for masses in a given interval.
+		 */
+		number_of_decompositions_type getNumberOfDecompositions(value_type lo, value_type hi,
+																const bounds_type& bounds);
+
+		/**
+		 * Gets number of all decompositions of masses in [@c lo, @c hi]
+		 * whose counts lie within @c bounds like the overload above, the
+		 * branches of the traversal are counted by the threads of @c pool.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @param bounds Bounds for the counts of the alphabet masses.
+		 * @param pool Threads to be used.
+		 * @return Number of decompositions for masses in a given interval.
+		 */
+		number_of_decompositions_type getNumberOfDecompositions(value_type lo, value_type hi,
+																const bounds_type& bounds,
+																ThreadPool& pool);
+
 	private:
 	
 		/**
@@ -119,7 +396,235 @@ class IntegerMassDecomposer :
 		/**
 		 * Type of the residues table.
 		 */
-		typedef std::vector<residues_table_row_type> residues_table_type;
+		typedef ExtendedResidueTable<value_type, ResidueType> residues_table_type;
+
+		/**
+		 * Type of the entries of the residues table.
+		 */
+		typedef typename residues_table_type::residue_type residue_type;
+
+		/**
+		 * Header of a saved residue table, followed by the weights, the
+		 * least common multiples and their counters (as 64 bit values), the
+		 * witness vector (pairs of 64 bit values), the entries of the
+		 * residue table and the minima of its blocks of RESIDUE_BLOCK_SIZE
+		 * residues (column after column, the last block of a column may be
+		 * shorter).
+		 */
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t byte_order;
+			uint32_t residue_size;
+			uint32_t decomposition_value_size;
+			uint64_t weights;
+			uint64_t residues;
+			uint64_t infty;
+			double precision;
+		};
+
+		/**
+		 * Magic of saved residue tables, 8 bytes including the terminating zeros.
+		 */
+		static const char* getFileMagic() { return "IMSERT\0"; }
+
+		/**
+		 * Mark written as is, reads differently with another byte order.
+		 */
+		static const uint32_t FILE_ORDER_MARK = 0x01020304;
+
+		/**
+		 * Number of residues per block minimum of a saved residue table,
+		 * changing it changes the file format.
+		 */
+		static const size_type RESIDUE_BLOCK_SIZE = 64;
+
+		/**
+		 * Residue tables for intervals of the extended residue table, keyed
+		 * by the (rounded up) interval width, shared by the copies of the
+		 * decomposer. Entry [i][r] holds the smallest mass @c m with residue
+		 * @c r such that some mass in [m - width, m] is decomposable over
+		 * the first i+1 alphabet masses.
+		 */
+		struct WindowResidueTables {
+			std::mutex mutex;
+			std::map<value_type, std::shared_ptr<const residues_table_type> > tables;
+		};
+
+		/**
+		 * Lookup of the smallest upper interval bounds with decomposable
+		 * masses for intervals of one width, see getWindowMass().
+		 */
+		struct WindowResidues {
+			/**
+			 * Table whose entries are the bounds, or the mapped extended
+			 * residue table to be searched for them.
+			 */
+			const residues_table_type* table;
+
+			/**
+			 * Whether the bounds are searched in @c table.
+			 */
+			bool searched;
+
+			/**
+			 * Width of the intervals searched for.
+			 */
+			value_type width;
+
+			/**
+			 * Owner of @c table if it is a cached one.
+			 */
+			std::shared_ptr<const residues_table_type> cached;
+		};
+
+		/**
+		 * Bounds of one traversal, prepared for the recursion. Counts are
+		 * enumerated relative to the lower bounds.
+		 */
+		struct TraversalBounds {
+			/**
+			 * Lower bounds, added to the enumerated counts.
+			 */
+			decomposition_type lower;
+
+			/**
+			 * Largest enumerated count (upper minus lower bound) per alphabet mass.
+			 */
+			residues_table_row_type ranges;
+
+			/**
+			 * Largest mass reachable by the alphabet masses 0..i within the ranges,
+			 * infty_mass if unbounded.
+			 */
+			residues_table_row_type max_masses;
+
+			/**
+			 * Sum of lower bounds times alphabet masses.
+			 */
+			value_type min_mass;
+
+			/**
+			 * True if the lower bounds cannot be met by any finite mass.
+			 */
+			bool overflow;
+		};
+
+		/**
+		 * Number of branches the parallel traversals are split into (at least,
+		 * unless the recursion is exhausted earlier or the interval is narrow).
+		 */
+		static const size_type parallel_branches = 256;
+
+		/**
+		 * Number of decompositions expected per branch of the parallel
+		 * traversals, narrow intervals are split into fewer branches. Copying
+		 * a scoring visitor for a branch costs about as much as scoring a
+		 * few decompositions.
+		 */
+		static const size_type branch_decompositions = 64;
+
+		/**
+		 * Pruning visitor that accepts every branch and passes the
+		 * decompositions on to @c visitor.
+		 */
+		template <typename Visitor>
+		struct AllBranches {
+			Visitor visitor;
+
+			explicit AllBranches(const Visitor& visitor) : visitor(visitor) { }
+
+			bool acceptsBranch(const decomposition_type&, size_type, value_type, value_type) {
+				return true;
+			}
+
+			void operator()(const decomposition_type& decomposition) {
+				visitor(decomposition);
+			}
+		};
+
+		/**
+		 * Masses of all decompositions over the three smallest alphabet masses
+		 * with a quotient by the smallest alphabet mass of at most
+		 * @c max_quotient, by buckets of masses with the same quotient.
+		 * A decomposition over the second and third alphabet mass with the
+		 * quotient q' has one mass in every bucket q >= q' (adding q - q'
+		 * smallest alphabet masses), all of them with its residue. Hence only
+		 * the residues are stored and every bucket holds those of the one
+		 * before and the ones of decompositions with its quotient.
+		 */
+		struct SmallestMassesCounts {
+			/**
+			 * Largest quotient of a bucket.
+			 */
+			value_type max_quotient;
+
+			/**
+			 * Position of the first residue of every bucket, followed by the
+			 * number of residues.
+			 */
+			std::vector<size_type> offsets;
+
+			/**
+			 * Residues of the masses, sorted within every bucket.
+			 */
+			std::vector<residue_type> residues;
+		};
+
+		/**
+		 * Table of the masses over the three smallest alphabet masses, shared
+		 * by the copies of the decomposer and extended when larger masses
+		 * are counted.
+		 */
+		struct SmallestMassesCountsCache {
+			std::mutex mutex;
+			std::shared_ptr<const SmallestMassesCounts> counts;
+
+			/**
+			 * Smallest quotient for which the table would be too large, 0 if none.
+			 */
+			value_type too_large_quotient;
+		};
+
+		/**
+		 * Largest number of residues of a table of the masses over the three
+		 * smallest alphabet masses (32 MB for 32 bit residues). CHNOPS
+		 * reaches it at about 2000 Da.
+		 */
+		static const size_type max_smallest_masses_counts = 1 << 23;
+
+		/**
+		 * Pruning visitor that counts the decompositions of every branch
+		 * reaching the three smallest alphabet masses by the table @c counts,
+		 * if any, or the two smallest ones by countSmallestMasses() instead
+		 * of descending into it.
+		 */
+		struct DecompositionsCounter {
+			const IntegerMassDecomposer* decomposer;
+			const TraversalBounds* bounds;
+			const SmallestMassesCounts* counts;
+			number_of_decompositions_type number_of_decompositions;
+
+			bool acceptsBranch(const decomposition_type&, size_type alphabetMassIndex,
+							   value_type lowMass, value_type highMass) {
+				if (alphabetMassIndex == 2 && counts != 0) {
+					number_of_decompositions += decomposer->countSmallestMasses(
+															*counts, lowMass, highMass);
+					return false;
+				}
+				if (alphabetMassIndex > 1) {
+					return true;
+				}
+				number_of_decompositions += decomposer->countSmallestMasses(
+									alphabetMassIndex, lowMass, highMass, *bounds);
+				return false;
+			}
+
+			// never called, since no branch of the smallest masses is descended into
+			void operator()(const decomposition_type&) {
+				++number_of_decompositions;
+			}
+		};
 
 		/**
 		 * Weights over which the mass is to be decomposed.
@@ -130,9 +635,16 @@ class IntegerMassDecomposer :
 		 * Table with the residues of the smallest decomposable numbers over
 		 * every modulo of the smallest alphabet mass are stored.
 		 * Corresponds to the Extended Residue Table in the paper.
+		 * Refers to the entries in @c ertable_file if it is mapped.
 		 */
 		residues_table_type ertable;
 
+		/**
+		 * File the extended residue table is mapped from, if any, shared
+		 * by the copies of the decomposer.
+		 */
+		std::shared_ptr<const MappedFile> ertable_file;
+
 		/**
 		 * List of the least common multiples. Corresponds to the lcm data structure
 		 * in the paper.
@@ -158,28 +670,152 @@ class IntegerMassDecomposer :
 		witness_vector_type witness_vector;
 
 		/**
-		 * Fills the extended residues table.
+		 * Smallest entry of every block of RESIDUE_BLOCK_SIZE residues of the
+		 * extended residue table, column after column, where it is mapped.
+		 * Null unless the table is mapped.
+		 */
+		const residue_type* block_minima;
+
+		/**
+		 * Residue tables used to decompose mass intervals, unless the
+		 * extended residue table is mapped.
+		 */
+		std::shared_ptr<WindowResidueTables> window_ertables;
+
+		/**
+		 * Table used to count decompositions.
+		 */
+		std::shared_ptr<SmallestMassesCountsCache> smallest_masses_counts;
+
+		/**
+		 * Prepares @c bounds for the recursion.
+		 */
+		TraversalBounds getTraversalBounds(const bounds_type& bounds) const;
+
+		/**
+		 * Estimates the number of decompositions of masses in [@c lo, @c hi]
+		 * by the leading term of the number of decompositions of a mass
+		 * @c m, m^(k-1) / ((k-1)! * product of the k alphabet masses).
+		 */
+		double getEstimatedNumberOfDecompositions(value_type lo, value_type hi) const;
+
+		/**
+		 * Counts the decompositions of masses in [@c lowMass, @c highMass]
+		 * over the alphabet masses with index up to @c alphabetMassIndex
+		 * (0 or 1) within the ranges of @c bounds. For two alphabet masses,
+		 * the counts of the smallest one for every count of the second one
+		 * are summed up by DecompUtils::getFloorSum().
 		 */
-		void fillExtendedResidueTable(const Weights& _alphabet, residues_table_row_type& _lcms,
-									  residues_table_row_type& _mass_in_lcms, const value_type _infty,
-									  witness_vector_type& _witness_vector, residues_table_type& _ertable);
+		number_of_decompositions_type countSmallestMasses(size_type alphabetMassIndex,
+				value_type lowMass, value_type highMass, const TraversalBounds& bounds) const;
 
 		/**
-		 * Collects decompositions for @c mass by recursion. 
+		 * Counts the decompositions of masses in [@c lowMass, @c highMass]
+		 * over the three smallest alphabet masses by the table @c counts,
+		 * which has to cover @c highMass.
+		 */
+		number_of_decompositions_type countSmallestMasses(const SmallestMassesCounts& counts,
+				value_type lowMass, value_type highMass) const;
+
+		/**
+		 * Returns the table of the masses over the three smallest alphabet
+		 * masses for counting masses up to @c highMass within @c bounds,
+		 * computes (or extends) it if it is not cached yet. Safe to be called
+		 * concurrently.
 		 *
-		 * @param mass Mass to be decomposed.
+		 * @return The table, or null if there are less than three alphabet
+		 * masses, the bounds of the three smallest ones restrict masses up to
+		 * @c highMass or the table would be too large.
+		 */
+		std::shared_ptr<const SmallestMassesCounts> getSmallestMassesCounts(value_type highMass,
+				const TraversalBounds& bounds) const;
+
+		/**
+		 * Gets the number of blocks of RESIDUE_BLOCK_SIZE residues per column
+		 * of the extended residue table.
+		 */
+		size_type getNumberOfResidueBlocks() const;
+
+		/**
+		 * Returns the lookup for decomposing intervals of a given @c width.
+		 * For a mapped extended residue table the bounds are searched in it,
+		 * otherwise a residue table for intervals is computed (and cached)
+		 * unless it is cached already. Safe to be called concurrently.
+		 *
+		 * @param width Width of the mass interval.
+		 * @return Lookup for intervals at least as wide as @c width.
+		 */
+		WindowResidues getWindowResidues(value_type width) const;
+
+		/**
+		 * Gets the smallest mass with residue @c residue such that some mass
+		 * of the interval below it is decomposable over the alphabet masses
+		 * 0..@c alphabetMassIndex, or infty if there is none.
+		 *
+		 * @param window Lookup returned by getWindowResidues().
+		 * @param alphabetMassIndex Index of the largest alphabet mass.
+		 * @param residue Residue modulo the smallest alphabet mass.
+		 */
+		value_type getWindowMass(const WindowResidues& window, size_type alphabetMassIndex,
+								 value_type residue) const;
+
+		/**
+		 * Gets the smallest entry of column @c alphabetMassIndex of the mapped
+		 * extended residue table for residues in [@c lo, @c hi].
+		 */
+		residue_type getSmallestEntry(size_type alphabetMassIndex, value_type lo,
+									  value_type hi) const;
+
+		/**
+		 * Visits decompositions for masses in [@c mass - @c width, @c mass]
+		 * by recursion. The counts for alphabet masses with index greater than
+		 * @c alphabetMassIndex are already fixed in @c decomposition, the
+		 * remaining ones are at their lower bounds and are overwritten in place.
+		 * They are reset to the lower bounds before returning.
+		 *
+		 * @param mass Largest mass to be decomposed.
+		 * @param width Width of the mass interval.
 		 * @param alphabetMassIndex An index of the mass in alphabet that is used on this step of recursion.
 		 * @param decomposition Decomposition which is calculated on this step of recursion.
-		 * @param decompositionStore Container where decompositions are collected.
+		 * @param window Lookup returned by getWindowResidues() for @c width.
+		 * @param bounds Bounds of the traversal.
+		 * @param visitor Pruning visitor to be called for every branch and decomposition.
 		 */
-		 void collectDecompositionsRecursively(value_type mass, size_type alphabetMassIndex,
-				decomposition_type decomposition, decompositions_type& decompositionsStore);
+		template <typename Visitor>
+		void visitDecompositionsRecursively(value_type mass, value_type width,
+				size_type alphabetMassIndex, decomposition_type& decomposition,
+				const WindowResidues& window, const TraversalBounds& bounds,
+				Visitor& visitor);
+
+		/**
+		 * Visits the branches of one recursion step: for every count of the
+		 * alphabet mass with index @c alphabetMassIndex (@c alphabetMassIndex > 0)
+		 * that leaves a remaining mass worth decomposing and is accepted by
+		 * @c visitor, the count is written to @c decomposition and
+		 * @c branchVisitor is called with the remaining mass. Afterwards the
+		 * count is reset to its lower bound.
+		 *
+		 * @param mass Largest mass to be decomposed.
+		 * @param alphabetMassIndex An index of the mass in alphabet that is used on this step of recursion.
+		 * @param decomposition Decomposition which is calculated on this step of recursion.
+		 * @param width Width of the mass interval.
+		 * @param window Lookup returned by getWindowResidues().
+		 * @param bounds Bounds of the traversal.
+		 * @param visitor Pruning visitor asked for every branch.
+		 * @param branchVisitor Function object to be called with every remaining mass.
+		 */
+		template <typename Visitor, typename BranchVisitor>
+		void visitBranches(value_type mass, value_type width, size_type alphabetMassIndex,
+				decomposition_type& decomposition, const WindowResidues& window,
+				const TraversalBounds& bounds, Visitor& visitor, BranchVisitor branchVisitor);
 };
 
 
-template <typename ValueType, typename DecompositionValueType>
-IntegerMassDecomposer<ValueType, DecompositionValueType>::IntegerMassDecomposer(
-            const Weights& alphabet) : alphabet(alphabet){
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::IntegerMassDecomposer(
+            const Weights& alphabet) : alphabet(alphabet), block_minima(0),
+			window_ertables(new WindowResidueTables),
+			smallest_masses_counts(new SmallestMassesCountsCache()) {
 
 	lcms.reserve(alphabet.size());
 	lcms.resize(alphabet.size());
@@ -189,194 +825,149 @@ IntegerMassDecomposer<ValueType, DecompositionValueType>::IntegerMassDecomposer(
 
 	infty = alphabet.getWeight(0) * alphabet.getWeight(alphabet.size()-1);
 
-	fillExtendedResidueTable(alphabet, lcms, mass_in_lcms, infty, witness_vector, ertable);
+	ertable = residues_table_type(alphabet, lcms, mass_in_lcms, witness_vector);
 
 }
 
 
-template <typename ValueType, typename DecompositionValueType>
-void IntegerMassDecomposer<ValueType, DecompositionValueType>::fillExtendedResidueTable(
-	const Weights& _alphabet, residues_table_row_type& _lcms, residues_table_row_type& _mass_in_lcms,
-	const value_type _infty, witness_vector_type& _witnessVector, residues_table_type& _ertable) {
-
-	if (_alphabet.size() < 2) {
-		return;
-	}
-	// caches the most often used mass - smallest mass
-	value_type smallestMass = _alphabet.getWeight(0), secondMass = _alphabet.getWeight(1);
-
-	// initializes table: infinity everywhere except in the first field of every column
-	_ertable.reserve(_alphabet.size());
-	_ertable.assign(_alphabet.size(), std::vector<value_type>(smallestMass, _infty));
-
-	for (size_type i = 0; i < _alphabet.size(); ++i) {
-		_ertable[i][0] = 0;
-	}
-
-	// initializes witness vector
-	_witnessVector.reserve(smallestMass);
-	_witnessVector.resize(smallestMass);
-
-	// fills second column (the first one is already correct)
-	size_type it_inc = secondMass % smallestMass, witness = 1;
-	typename residues_table_row_type::iterator it = _ertable[1].begin() + it_inc;
-	value_type mass = secondMass;
-	// initializes counter to create a witness vector
-	decomposition_value_type counter = 0;
-	while (it != _ertable[1].begin()) {
-		*it = mass;
-		mass += secondMass;
-		++counter;
-		_witnessVector[it - _ertable[1].begin()] = std::make_pair(witness, counter);
-		it += it_inc;
-		if (it >= _ertable[1].end()) {
-			it -= _ertable[1].size();
-		}
-	}
-	// fills cache variables for i==1
-	value_type d = gcd(smallestMass, secondMass);
-	_lcms[1] = secondMass*smallestMass / d;
-	_mass_in_lcms[1] = smallestMass / d;
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::IntegerMassDecomposer(
+			const Weights& alphabet, ThreadPool& pool) : alphabet(alphabet), block_minima(0),
+			window_ertables(new WindowResidueTables),
+			smallest_masses_counts(new SmallestMassesCountsCache()) {
 
-	// fills remaining table. i is the column index.
-	for (size_type i = 2; i < _alphabet.size(); ++i) {
-		// caches often used i-th alphabet mass
-		value_type currentMass = _alphabet.getWeight(i);
-
-		value_type d = gcd(smallestMass, currentMass);
+	lcms.resize(alphabet.size());
+	mass_in_lcms.resize(alphabet.size());
 
-		// fills cache for various variables.
-		// note that values for i==0 are never assigned since they're unused anyway.
-		_lcms[i] = currentMass*smallestMass / d;
-		_mass_in_lcms[i] = smallestMass / d;
+	infty = alphabet.getWeight(0) * alphabet.getWeight(alphabet.size()-1);
 
-		// Nijenhuis' improvement: Is currentMass composable with smaller alphabet?
-		if (currentMass >= _ertable[i-1][currentMass % smallestMass]) {
-			_ertable[i] = _ertable[i-1];
-			continue;
-		}
+	ertable = residues_table_type(alphabet, lcms, mass_in_lcms, witness_vector, pool);
+}
 
-		const residues_table_row_type& prev_column = _ertable[i-1];
-		residues_table_row_type& cur_column = _ertable[i];
-
-		if (d == 1) {
-			// This loop is for the case that the gcd is 1. The optimization used below
-			// is not applicable here.
-
-			// p_inc is used to change residue (p) efficiently
-			size_type p_inc = currentMass % smallestMass;
-
-			// n is the value that will be written into the table
-			value_type n = 0;
-			// current residue (in paper variable 'r' is used)
-			size_type p = 0;
-			// counter for creation of witness vector
-			decomposition_value_type counter = 0;
-
-			for (size_type m = smallestMass; m > 0; --m) {
-				n += currentMass;
-				p += p_inc;
-				++counter;
-				if (p >= smallestMass) {
-					p -= smallestMass;
-				}
-				if (n > prev_column[p]) {
-					n = prev_column[p];
-					counter = 0;
-				} else {
-					_witnessVector[p] = std::make_pair(i, counter);
-				}
-				cur_column[p] = n;
-			}
-		}
-		else {
-			// If we're here, the gcd is not 1. We can use the following cache-optimized
-			// version of the algorithm. The trick is to put the iteration over all
-			// residue classes into the _inner_ loop.
-			//
-			// One could see it as going through one column in blocks which are gcd entries long.
-			size_type cur = currentMass % smallestMass;
-			size_type prev = 0;
-			size_type p_inc = cur-d;
-			// counters for creation of one witness vector
-			std::vector<decomposition_value_type> counters(smallestMass);
-
-			// copies first block from prev_column to cur_column
-			for (size_type j = 1; j < d; ++j) {
-				cur_column[j] = prev_column[j];
-			}
 
-			// first loop: goes through all blocks, updating cur_column for the first time.
-			for (size_type m = smallestMass / d; m > 1; m--) {
-				// r: current residue class
-				for (size_type r = 0; r < d; r++) {
-
-					++counters[cur];
-					if (cur_column[prev] + currentMass > prev_column[cur]) {
-						cur_column[cur] = prev_column[cur];
-						counters[cur] = 0;
-					} else {
-						cur_column[cur] = cur_column[prev] + currentMass;
-						_witnessVector[cur] = std::make_pair(i, counters[cur]);
-					}
-
-					prev++;
-					cur++;
-				}
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::IntegerMassDecomposer(
+			const Weights& alphabet, const std::string& filename) /*throw (IOException)*/ :
+		alphabet(alphabet), ertable_file(new MappedFile(filename)), block_minima(0),
+		smallest_masses_counts(new SmallestMassesCountsCache()) {
+	const size_type size = alphabet.size();
+	const uint64_t residues = (size < 2) ? 0 : alphabet.getWeight(0);
+	const char* data = ertable_file->data();
 
-				prev = cur - d;
+	FileHeader header;
+	if (ertable_file->size() < sizeof(FileHeader)) {
+		throw IOException("File \"" + filename + "\" is no residue table!");
+	}
+	std::memcpy(&header, data, sizeof(FileHeader));
+	if (std::memcmp(header.magic, getFileMagic(), sizeof(header.magic)) != 0) {
+		throw IOException("File \"" + filename + "\" is no residue table!");
+	}
+	if (header.byte_order != FILE_ORDER_MARK) {
+		throw IOException("Residue table \"" + filename + "\" was written with another byte order!");
+	}
+	if (header.version != FILE_VERSION || header.residue_size != sizeof(residue_type) ||
+		header.decomposition_value_size != sizeof(decomposition_value_type)) {
+		throw IOException("Residue table \"" + filename + "\" was written by another version!");
+	}
+	infty = (size == 0) ? 0 : alphabet.getWeight(0) * alphabet.getWeight(size-1);
+	if (header.weights != size || header.residues != residues || header.infty != infty ||
+		header.precision != alphabet.getPrecision()) {
+		throw IOException("Residue table \"" + filename + "\" was computed for other weights!");
+	}
+	const size_type table_offset = sizeof(FileHeader) +
+		(3 * size + 2 * residues) * sizeof(uint64_t);
+	const size_type minima_offset = table_offset + size * residues * sizeof(residue_type);
+	if (ertable_file->size() < minima_offset + size * getNumberOfResidueBlocks() * sizeof(residue_type)) {
+		throw IOException("Residue table \"" + filename + "\" is truncated!");
+	}
 
-				// this does: cur = (cur + currentMass) % smallestMass - d;
-				cur += p_inc;
-				if (cur >= smallestMass) {
-					cur -= smallestMass;
-				}
-			}
+	const uint64_t* values = reinterpret_cast<const uint64_t*>(data + sizeof(FileHeader));
+	for (size_type i = 0; i < size; ++i) {
+		if (values[i] != alphabet.getWeight(i)) {
+			throw IOException("Residue table \"" + filename + "\" was computed for other weights!");
+		}
+	}
+	values += size;
+	lcms.assign(values, values + size);
+	mass_in_lcms.assign(values + size, values + 2 * size);
+	values += 2 * size;
+	witness_vector.resize(residues);
+	for (size_type r = 0; r < residues; ++r) {
+		witness_vector[r] = std::make_pair(static_cast<size_type>(values[2 * r]),
+				static_cast<decomposition_value_type>(values[2 * r + 1]));
+	}
+	// the table itself stays where it is mapped
+	if (residues > 0) {
+		ertable = residues_table_type(size, residues, infty,
+			reinterpret_cast<const residue_type*>(data + table_offset));
+		block_minima = reinterpret_cast<const residue_type*>(data + minima_offset);
+	}
+}
 
-			// second loop:
-			bool cont = true;
-			while (cont) {
-				cont = false;
-				prev++;
-				cur++;
-				++counters[cur];
-				for (size_type r = 1; r < d; ++r) {
-					if (cur_column[prev] + currentMass < cur_column[cur]) {
-						cur_column[cur] = cur_column[prev] + currentMass;
-						cont = true;
-						_witnessVector[cur] = std::make_pair(i, counters[cur]);
-					} else {
-						counters[cur] = 0;
-					}
-					prev++;
-					cur++;
-				}
 
-				prev = cur - d;
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+void IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+save(const std::string& filename) const /*throw (IOException)*/ {
+	const size_type size = alphabet.size();
+	const uint64_t residues = (size < 2) ? 0 : alphabet.getWeight(0);
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::memcpy(header.magic, getFileMagic(), sizeof(header.magic));
+	header.version = FILE_VERSION;
+	header.byte_order = FILE_ORDER_MARK;
+	header.residue_size = sizeof(residue_type);
+	header.decomposition_value_size = sizeof(decomposition_value_type);
+	header.weights = size;
+	header.residues = residues;
+	header.infty = infty;
+	header.precision = alphabet.getPrecision();
+
+	std::vector<uint64_t> values;
+	values.reserve(3 * size + 2 * residues);
+	for (size_type i = 0; i < size; ++i) {
+		values.push_back(alphabet.getWeight(i));
+	}
+	values.insert(values.end(), lcms.begin(), lcms.end());
+	values.insert(values.end(), mass_in_lcms.begin(), mass_in_lcms.end());
+	for (size_type r = 0; r < residues; ++r) {
+		values.push_back(witness_vector[r].first);
+		values.push_back(witness_vector[r].second);
+	}
 
-				cur += p_inc;
-				if (cur >= smallestMass) {
-					cur -= smallestMass;
-				}
-			}
+	const size_type blocks = getNumberOfResidueBlocks();
+	std::vector<residue_type> minima(size * blocks, residues_table_type::unreachable);
+	for (size_type i = 0; i < size && residues > 0; ++i) {
+		const residue_type* column = ertable.getColumn(i);
+		for (value_type r = 0; r < residues; ++r) {
+			residue_type& minimum = minima[i * blocks + r / RESIDUE_BLOCK_SIZE];
+			minimum = std::min(minimum, column[r]);
 		}
+	}
 
+	std::ofstream out(filename.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(uint64_t));
+	out.write(reinterpret_cast<const char*>(ertable.data()), ertable.size() * sizeof(residue_type));
+	out.write(reinterpret_cast<const char*>(minima.data()), minima.size() * sizeof(residue_type));
+	if (!out || !out.flush()) {
+		throw IOException("Cannot write residue table to file \"" + filename + "\"!");
 	}
 }
 
 
-template <typename ValueType, typename DecompositionValueType>
-bool IntegerMassDecomposer<ValueType, DecompositionValueType>::
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+bool IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
 exist(value_type mass) {
 
-	value_type residue = ertable.back().at(mass % alphabet.getWeight(0));
+	value_type residue = ertable.get(alphabet.size()-1, mass % alphabet.getWeight(0));
 	return (residue != infty && mass >= residue);
 }
 
 
-template <typename ValueType, typename DecompositionValueType>
-typename IntegerMassDecomposer<ValueType, DecompositionValueType>::decomposition_type
-IntegerMassDecomposer<ValueType, DecompositionValueType>::
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::decomposition_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
 getDecomposition(value_type mass) {
 
 	decomposition_type decomposition;
@@ -389,7 +980,7 @@ getDecomposition(value_type mass) {
 
 	// initial mass residue: in FIND-ONE algorithm in paper corresponds variable "r"
 	value_type r = mass % alphabet.getWeight(0);
-	value_type m = ertable.back().at(r);
+	value_type m = ertable.get(alphabet.size()-1, r);
 
 	decomposition.at(0) = static_cast<decomposition_value_type>
 		((mass - m) / alphabet.getWeight(0));
@@ -408,60 +999,448 @@ getDecomposition(value_type mass) {
 }
 
 
-template <typename ValueType, typename DecompositionValueType>
-typename IntegerMassDecomposer<ValueType, DecompositionValueType>::decompositions_type
-IntegerMassDecomposer<ValueType, DecompositionValueType>::
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::decompositions_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
 getAllDecompositions(value_type mass) {
+	return getAllDecompositions(mass, mass);
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::decompositions_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getAllDecompositions(value_type lo, value_type hi) {
 	decompositions_type decompositionsStore;
-	decomposition_type decomposition(alphabet.size());
-	collectDecompositionsRecursively(mass, alphabet.size()-1, decomposition, decompositionsStore);
+	visitDecompositions(lo, hi, [&decompositionsStore](const decomposition_type& decomposition) {
+		decompositionsStore.push_back(decomposition);
+	});
 	return decompositionsStore;
 }
 
 
-template <typename ValueType, typename DecompositionValueType>
-void IntegerMassDecomposer<ValueType, DecompositionValueType>::
-collectDecompositionsRecursively(value_type mass, size_type alphabetMassIndex,
- decomposition_type decomposition, decompositions_type& decompositionsStore) {
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+void IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getAllDecompositions(value_type lo, value_type hi, flat_decompositions_type& decompositions) {
+	visitDecompositions(lo, hi, [&decompositions](const decomposition_type& decomposition) {
+		decompositions.insert(decompositions.end(), decomposition.begin(), decomposition.end());
+	});
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename Visitor>
+Visitor IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitDecompositions(value_type lo, value_type hi, Visitor visitor) {
+	return visitDecompositions(lo, hi, bounds_type(), visitor);
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename Visitor>
+Visitor IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitDecompositions(value_type lo, value_type hi, const bounds_type& bounds, Visitor visitor) {
+	return visitPrunedDecompositions(lo, hi, bounds, AllBranches<Visitor>(visitor)).visitor;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename Visitor>
+std::vector<Visitor> IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitDecompositions(value_type lo, value_type hi, const Visitor& visitor, ThreadPool& pool) {
+	return visitDecompositions(lo, hi, bounds_type(), visitor, pool);
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename Visitor>
+std::vector<Visitor> IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitDecompositions(value_type lo, value_type hi, const bounds_type& bounds,
+					const Visitor& visitor, ThreadPool& pool) {
+	const std::vector< AllBranches<Visitor> > pruningVisitors =
+		visitPrunedDecompositions(lo, hi, bounds, AllBranches<Visitor>(visitor), pool);
+	std::vector<Visitor> visitors;
+	// the first copy only split the traversal into branches
+	for (size_type i = 1; i < pruningVisitors.size(); ++i) {
+		visitors.push_back(pruningVisitors[i].visitor);
+	}
+	return visitors;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename PruningVisitor>
+PruningVisitor IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitPrunedDecompositions(value_type lo, value_type hi, const bounds_type& bounds,
+						  PruningVisitor visitor) {
+	if (lo > hi || alphabet.size() == 0) {
+		return visitor;
+	}
+	const TraversalBounds traversalBounds = getTraversalBounds(bounds);
+	if (traversalBounds.overflow || hi < traversalBounds.min_mass) {
+		return visitor;
+	}
+	// decomposes the masses left after the lower bounds
+	hi -= traversalBounds.min_mass;
+	lo = (lo > traversalBounds.min_mass) ? lo - traversalBounds.min_mass : 0;
+
+	decomposition_type decomposition(traversalBounds.lower);
+	if (visitor.acceptsBranch(static_cast<const decomposition_type&>(decomposition),
+							  alphabet.size()-1, lo, hi)) {
+		visitDecompositionsRecursively(hi, hi - lo, alphabet.size()-1, decomposition,
+									   getWindowResidues(hi - lo), traversalBounds, visitor);
+	}
+	return visitor;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename PruningVisitor>
+std::vector<PruningVisitor> IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitPrunedDecompositions(value_type lo, value_type hi, const bounds_type& bounds,
+						  const PruningVisitor& visitor, ThreadPool& pool) {
+	std::vector<PruningVisitor> visitors;
+	if (lo > hi || alphabet.size() == 0) {
+		return visitors;
+	}
+	const TraversalBounds traversalBounds = getTraversalBounds(bounds);
+	if (traversalBounds.overflow || hi < traversalBounds.min_mass) {
+		return visitors;
+	}
+	// a single thread has nothing to balance, the visitor is not copied per branch
+	if (pool.size() == 1) {
+		visitors.push_back(visitor);
+		visitors.push_back(visitPrunedDecompositions(lo, hi, bounds, visitor));
+		return visitors;
+	}
+	hi -= traversalBounds.min_mass;
+	lo = (lo > traversalBounds.min_mass) ? lo - traversalBounds.min_mass : 0;
+
+	const value_type width = hi - lo;
+	const WindowResidues window = getWindowResidues(width);
+
+	// narrow intervals are split into fewer branches
+	const double decompositions = getEstimatedNumberOfDecompositions(lo, hi);
+	const size_type splitBranches = (decompositions < parallel_branches * branch_decompositions) ?
+		static_cast<size_type>(decompositions / branch_decompositions) : parallel_branches;
+
+	// the first copy prunes the levels expanded below
+	visitors.push_back(visitor);
+	PruningVisitor& expansionVisitor = visitors.front();
+
+	// branch of the recursion: remaining mass and the counts fixed so far
+	typedef std::pair<value_type, decomposition_type> branch_type;
+	std::vector<branch_type> branches;
+	size_type alphabetMassIndex = alphabet.size()-1;
+	if (expansionVisitor.acceptsBranch(traversalBounds.lower, alphabetMassIndex, lo, hi)) {
+		branches.push_back(branch_type(hi, traversalBounds.lower));
+	}
+
+	// expands the upper levels of the recursion (keeping the traversal order)
+	// until there are enough branches to balance the work between threads.
+	// The split does not depend on the pool, so that reductions over the
+	// copies of the visitor give the same results for any number of threads.
+	while (alphabetMassIndex > 0 && !branches.empty() &&
+		   branches.size() < splitBranches) {
+		std::vector<branch_type> children;
+		for (typename std::vector<branch_type>::iterator it = branches.begin();
+											it != branches.end(); ++it) {
+			visitBranches(it->first, width, alphabetMassIndex, it->second, window,
+				traversalBounds, expansionVisitor, [&children, it](value_type m) {
+					children.push_back(branch_type(m, it->second));
+				});
+		}
+		branches.swap(children);
+		--alphabetMassIndex;
+	}
+
+	visitors.resize(branches.size() + 1, visitor);
+	pool.parallelFor(branches.size(), [&](ThreadPool::size_type i) {
+		decomposition_type decomposition(branches[i].second);
+		visitDecompositionsRecursively(branches[i].first, width, alphabetMassIndex,
+									   decomposition, window, traversalBounds, visitors[i+1]);
+	});
+	return visitors;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::TraversalBounds
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getTraversalBounds(const bounds_type& bounds) const {
+	const value_type infty_mass = std::numeric_limits<value_type>::max();
+	const value_type unbounded = std::numeric_limits<decomposition_value_type>::max();
+
+	TraversalBounds traversalBounds;
+	traversalBounds.lower.assign(alphabet.size(), 0);
+	traversalBounds.ranges.assign(alphabet.size(), unbounded);
+	traversalBounds.max_masses.assign(alphabet.size(), infty_mass);
+	traversalBounds.min_mass = 0;
+	traversalBounds.overflow = false;
+
+	value_type max_mass = 0;
+	for (size_type i = 0; i < alphabet.size(); ++i) {
+		const value_type weight = alphabet.getWeight(i);
+		value_type lower = (i < bounds.lower.size()) ? bounds.lower[i] : 0;
+		value_type upper = (i < bounds.upper.size()) ? bounds.upper[i] : unbounded;
+		if (upper < lower) {
+			// nothing can be decomposed
+			traversalBounds.overflow = true;
+			return traversalBounds;
+		}
+		traversalBounds.lower[i] = static_cast<decomposition_value_type>(lower);
+		traversalBounds.ranges[i] = upper - lower;
+
+		if (lower > (infty_mass - traversalBounds.min_mass) / weight) {
+			traversalBounds.overflow = true;
+			return traversalBounds;
+		}
+		traversalBounds.min_mass += lower * weight;
+
+		// saturates at infty_mass, which is also used for unbounded counts
+		if (max_mass != infty_mass) {
+			if (upper == unbounded || traversalBounds.ranges[i] > (infty_mass - max_mass) / weight) {
+				max_mass = infty_mass;
+			} else {
+				max_mass += traversalBounds.ranges[i] * weight;
+			}
+		}
+		traversalBounds.max_masses[i] = max_mass;
+	}
+	return traversalBounds;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+double IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getEstimatedNumberOfDecompositions(value_type lo, value_type hi) const {
+	double decompositions = static_cast<double>(hi - lo + 1);
+	for (size_type i = 0; i < alphabet.size(); ++i) {
+		decompositions /= alphabet.getWeight(i);
+		if (i > 0) {
+			decompositions *= static_cast<double>(hi) / i;
+		}
+	}
+	return decompositions;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::size_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getNumberOfResidueBlocks() const {
+	const value_type residues = (alphabet.size() < 2) ? 0 : alphabet.getWeight(0);
+	return (residues + RESIDUE_BLOCK_SIZE - 1) / RESIDUE_BLOCK_SIZE;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::WindowResidues
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getWindowResidues(value_type width) const {
+	WindowResidues window = { &ertable, false, 0, std::shared_ptr<const residues_table_type>() };
+	if (width == 0 || ertable.empty()) {
+		return window;
+	}
+	const value_type smallestMass = alphabet.getWeight(0);
+
+	// rounds the width up to 2^k - 1 to share tables between similar widths.
+	// Windows wider than smallestMass - 1 cover all residues and give nothing new.
+	value_type windowSize = 1;
+	while (windowSize <= width && windowSize < smallestMass) {
+		windowSize <<= 1;
+	}
+
+	// the mapped table is searched with the same width the table below would
+	// have, so that both prune the same branches
+	if (isMapped()) {
+		window.searched = true;
+		window.width = std::min(windowSize, smallestMass) - 1;
+		return window;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(window_ertables->mutex);
+		typename std::map<value_type, std::shared_ptr<const residues_table_type> >::const_iterator
+			cached = window_ertables->tables.find(windowSize);
+		if (cached != window_ertables->tables.end()) {
+			window.cached = cached->second;
+			window.table = window.cached.get();
+			return window;
+		}
+	}
+
+	// computed without holding the lock, a table computed by another thread
+	// in the meantime is taken instead
+	std::shared_ptr<residues_table_type> table(
+		new residues_table_type(alphabet.size(), smallestMass, infty));
+	residues_table_row_type row, previous;
+	for (size_type i = 0; i < alphabet.size(); ++i) {
+		ertable.getMasses(i, row);
+		// the last column is only used by exist() and never in the recursion
+		// doubling: after the step with 'step' the row holds for every residue r
+		// min{ ertable[i][r-t] + t : 0 <= t < 2*step }, where r-t is taken modulo smallestMass
+		for (value_type step = 1; step < windowSize && i + 1 < alphabet.size(); step <<= 1) {
+			previous = row;
+			for (value_type r = 0; r < smallestMass; ++r) {
+				value_type shifted = (r >= step) ? r - step : r + smallestMass - step;
+				if (previous[shifted] != infty && previous[shifted] + step < row[r]) {
+					row[r] = previous[shifted] + step;
+				}
+			}
+		}
+		table->setMasses(i, row);
+	}
+
+	std::lock_guard<std::mutex> lock(window_ertables->mutex);
+	window.cached = window_ertables->tables.insert(std::make_pair(windowSize,
+		std::shared_ptr<const residues_table_type>(table))).first->second;
+	window.table = window.cached.get();
+	return window;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::value_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getWindowMass(const WindowResidues& window, size_type alphabetMassIndex, value_type residue) const {
+	if (!window.searched) {
+		return window.table->get(alphabetMassIndex, residue);
+	}
+	// the smallest decomposable mass with residue r - t, raised by t, is the
+	// smallest mass with residue r that has it in its interval. Residues r - t
+	// wrapped around to smallestMass + r - t are raised to the next multiple.
+	const value_type smallestMass = alphabet.getWeight(0);
+	residue_type entry = getSmallestEntry(alphabetMassIndex,
+		(residue > window.width) ? residue - window.width : 0, residue);
+	if (window.width > residue) {
+		residue_type wrapped = getSmallestEntry(alphabetMassIndex,
+			smallestMass - (window.width - residue), smallestMass - 1);
+		if (wrapped != residues_table_type::unreachable && wrapped + 1 < entry) {
+			entry = wrapped + 1;
+		}
+	}
+	return ertable.getMass(entry, residue);
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::residue_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getSmallestEntry(size_type alphabetMassIndex, value_type lo, value_type hi) const {
+	const residue_type* column = ertable.getColumn(alphabetMassIndex);
+	const residue_type* minima = block_minima + alphabetMassIndex * getNumberOfResidueBlocks();
+	residue_type smallest = residues_table_type::unreachable;
+	value_type r = lo;
+	// entries up to the first whole block, the whole blocks and the entries after them
+	for (; r <= hi && r % RESIDUE_BLOCK_SIZE != 0; ++r) {
+		smallest = std::min(smallest, column[r]);
+	}
+	for (; r + RESIDUE_BLOCK_SIZE - 1 <= hi; r += RESIDUE_BLOCK_SIZE) {
+		smallest = std::min(smallest, minima[r / RESIDUE_BLOCK_SIZE]);
+	}
+	for (; r <= hi; ++r) {
+		smallest = std::min(smallest, column[r]);
+	}
+	return smallest;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename Visitor>
+void IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitDecompositionsRecursively(value_type mass, value_type width,
+	size_type alphabetMassIndex, decomposition_type& decomposition,
+	const WindowResidues& window, const TraversalBounds& bounds, Visitor& visitor) {
 	if (alphabetMassIndex == 0) {
-		value_type numberOfMasses0 = mass / alphabet.getWeight(0);
-		if (numberOfMasses0 * alphabet.getWeight(0) == mass) {
+		const value_type smallestMass = alphabet.getWeight(0);
+		value_type lowestMass = (mass > width) ? mass - width : 0;
+		value_type highestNumberOfMasses0 = mass / smallestMass;
+		if (highestNumberOfMasses0 > bounds.ranges[0]) {
+			highestNumberOfMasses0 = bounds.ranges[0];
+		}
+		for (value_type numberOfMasses0 = (lowestMass + smallestMass - 1) / smallestMass;
+						numberOfMasses0 <= highestNumberOfMasses0; ++numberOfMasses0) {
 			decomposition[0] = static_cast<decomposition_value_type>(
-															numberOfMasses0);
-			decompositionsStore.push_back(decomposition);
+												bounds.lower[0] + numberOfMasses0);
+			visitor(static_cast<const decomposition_type&>(decomposition));
 		}
+		decomposition[0] = bounds.lower[0];
 		return;
 	}
 
+	visitBranches(mass, width, alphabetMassIndex, decomposition, window, bounds, visitor,
+		[&](value_type m) {
+			visitDecompositionsRecursively(m, width, alphabetMassIndex-1,
+										   decomposition, window, bounds, visitor);
+		});
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+template <typename Visitor, typename BranchVisitor>
+void IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+visitBranches(value_type mass, value_type width, size_type alphabetMassIndex,
+	decomposition_type& decomposition, const WindowResidues& window,
+	const TraversalBounds& bounds, Visitor& visitor, BranchVisitor branchVisitor) {
+
 	// tested: caching these values gives us 15% better performance, at least
 	// with aminoacid-mono.masses
 	const value_type lcm = lcms[alphabetMassIndex];
 	const value_type mass_in_lcm = mass_in_lcms[alphabetMassIndex]; // this is alphabet mass divided by gcd
+	const value_type alphabetMass = alphabet.getWeight(alphabetMassIndex);
 
-	value_type mass_mod_alphabet0 = mass % alphabet.getWeight(0); // trying to avoid modulo
-	const value_type mass_mod_decrement = alphabet.getWeight(alphabetMassIndex) % alphabet.getWeight(0);
+	// largest count of this alphabet mass (relative to its lower bound)
+	const value_type range = bounds.ranges[alphabetMassIndex];
 
-	for (value_type i = 0; i < mass_in_lcm; ++i) {
-		// here is the conversion from value_type to decomposition_value_type
-		decomposition[alphabetMassIndex] = static_cast<decomposition_value_type>(i);
+	// remaining masses above this one cannot be reached by the smaller
+	// alphabet masses within their upper bounds, for no mass of the interval
+	const value_type max_mass = bounds.max_masses[alphabetMassIndex-1];
+	const value_type highest_mass = (max_mass > std::numeric_limits<value_type>::max() - width) ?
+		std::numeric_limits<value_type>::max() : max_mass + width;
 
+	value_type mass_mod_alphabet0 = mass % alphabet.getWeight(0); // trying to avoid modulo
+	const value_type mass_mod_decrement = alphabetMass % alphabet.getWeight(0);
+
+	for (value_type i = 0; i < mass_in_lcm && i <= range; ++i) {
 		// this check is needed because mass could have unsigned type and after reduction on i*alphabetMass will be still be positive but huge
 		// and that will end up in unfinite loop
-		if (mass < i*alphabet.getWeight(alphabetMassIndex)) {
+		if (mass < i*alphabetMass) {
 			break;
 		}
 
-		/* r: current residue class. will stay the same in the following loop */
-		value_type r = ertable[alphabetMassIndex-1][mass_mod_alphabet0];
+		/* r: smallest upper interval bound with the current residue, for which
+		 * the interval still contains a decomposable mass. Will stay the same
+		 * in the following loop */
+		value_type r = getWindowMass(window, alphabetMassIndex-1, mass_mod_alphabet0);
 
 		// TODO: if infty was std::numeric_limits<...>... the following 'if' would not be necessary
-		if (r != infty) {
-			for (value_type m = mass - i * alphabet.getWeight(alphabetMassIndex); m >= r; m -= lcm) {
+		bool reachable = (r != infty);
+
+		value_type count = i;
+		value_type m = mass - i * alphabetMass;
+		if (reachable && m > highest_mass) {
+			// skips the counts leaving too much mass for the smaller alphabet masses
+			value_type steps = (m - highest_mass + lcm - 1) / lcm;
+			reachable = (m >= steps * lcm);
+			count += steps * mass_in_lcm;
+			m -= reachable ? steps * lcm : 0;
+		}
+
+		if (reachable) {
+			for (; m >= r && count <= range; m -= lcm, count += mass_in_lcm) {
 				/* the condition of the 'for' loop (m >= r) and decrementing the mass
-				 * in steps of the lcm ensures that m is decomposable. Therefore
-				 * the recursion will result in at least one witness. */
-				collectDecompositionsRecursively(m, alphabetMassIndex-1, decomposition, decompositionsStore);
-				decomposition[alphabetMassIndex] += mass_in_lcm;
+				 * in steps of the lcm ensures that some mass in [m - width, m] is
+				 * decomposable, unless the cached table is wider than width. */
+				// here is the conversion from value_type to decomposition_value_type.
+				// Counts of the smaller alphabet masses are overwritten by the recursion,
+				// hence one decomposition can be shared by the whole traversal.
+				decomposition[alphabetMassIndex] = static_cast<decomposition_value_type>(
+													bounds.lower[alphabetMassIndex] + count);
+				if (visitor.acceptsBranch(static_cast<const decomposition_type&>(decomposition),
+										  alphabetMassIndex-1, (m > width) ? m - width : 0, m)) {
+					branchVisitor(m);
+				}
 				// this check is needed because mass could have unsigned type and after reduction on i*alphabetMass will be still be positive but huge
 				// and that will end up in unfinite loop
 				if (m < lcm) {
@@ -476,22 +1455,222 @@ collectDecompositionsRecursively(value_type mass, size_type alphabetMassIndex,
 			mass_mod_alphabet0 -= mass_mod_decrement;
 		}
 	}
-
+	decomposition[alphabetMassIndex] = bounds.lower[alphabetMassIndex];
 }
 
 /**
  * Gets number of all possible decompositions for a given @c mass.
- * Since using getAllDecomposition() the usage of this function could 
- * be @b consuming.
+ * Decompositions are counted without enumerating them.
  * 
  * @param mass Mass to be decomposed
  * @return number of decompositions for given mass.
  */
-template <typename ValueType, typename DecompositionValueType>
-typename IntegerMassDecomposer<ValueType, DecompositionValueType>::
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
 decomposition_value_type IntegerMassDecomposer<ValueType, 
-DecompositionValueType>::getNumberOfDecompositions(value_type mass) {
-	return getAllDecompositions(mass).size();
+DecompositionValueType, ResidueType>::getNumberOfDecompositions(value_type mass) {
+	return static_cast<decomposition_value_type>(
+					getNumberOfDecompositions(mass, mass, bounds_type()));
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::number_of_decompositions_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getNumberOfDecompositions(value_type lo, value_type hi, const bounds_type& bounds) {
+	const TraversalBounds traversalBounds = getTraversalBounds(bounds);
+	const std::shared_ptr<const SmallestMassesCounts> counts =
+		getSmallestMassesCounts(hi, traversalBounds);
+	DecompositionsCounter counter = { this, &traversalBounds, counts.get(), 0 };
+	return visitPrunedDecompositions(lo, hi, bounds, counter).number_of_decompositions;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::number_of_decompositions_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getNumberOfDecompositions(value_type lo, value_type hi, const bounds_type& bounds, ThreadPool& pool) {
+	const TraversalBounds traversalBounds = getTraversalBounds(bounds);
+	const std::shared_ptr<const SmallestMassesCounts> counts =
+		getSmallestMassesCounts(hi, traversalBounds);
+	DecompositionsCounter counter = { this, &traversalBounds, counts.get(), 0 };
+	const std::vector<DecompositionsCounter> counters =
+		visitPrunedDecompositions(lo, hi, bounds, counter, pool);
+
+	// the first copy counts the branches cut while splitting the traversal
+	number_of_decompositions_type numberOfDecompositions = 0;
+	for (typename std::vector<DecompositionsCounter>::const_iterator it = counters.begin();
+														it != counters.end(); ++it) {
+		numberOfDecompositions += it->number_of_decompositions;
+	}
+	return numberOfDecompositions;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::number_of_decompositions_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+countSmallestMasses(size_type alphabetMassIndex, value_type lowMass, value_type highMass,
+					const TraversalBounds& bounds) const {
+	typedef number_of_decompositions_type count_type;
+
+	const count_type low = lowMass, high = highMass;
+	const count_type mass0 = alphabet.getWeight(0);
+	// largest count of the smallest alphabet mass
+	const count_type max0 = std::min<count_type>(bounds.ranges[0], high / mass0);
+	if (alphabetMassIndex == 0) {
+		const count_type min0 = (low + mass0 - 1) / mass0;
+		return (min0 <= max0) ? max0 - min0 + 1 : 0;
+	}
+
+	// counts of the second alphabet mass, for which some count of the
+	// smallest one gives a mass in [low, high]
+	const count_type mass1 = alphabet.getWeight(1);
+	const count_type min1 = (low > max0 * mass0) ? (low - max0 * mass0 + mass1 - 1) / mass1 : 0;
+	const count_type max1 = std::min<count_type>(bounds.ranges[1], high / mass1);
+	if (min1 > max1) {
+		return 0;
+	}
+
+	// for every count c1 in [min1, max1] the counts of the smallest alphabet mass are
+	// max(0, ceil((low - c1*mass1) / mass0)) ... min(max0, floor((high - c1*mass1) / mass0)),
+	// which is never empty. The sums of both ends are taken separately.
+	count_type numberOfDecompositions = max1 - min1 + 1;
+
+	// upper end: max0 for c1 < upper1, floor((high - c1*mass1) / mass0) from there on,
+	// summed up from max1 downwards to keep the terms of the floor sum non-negative
+	count_type upper1 = (high >= (max0 + 1) * mass0) ? (high - (max0 + 1) * mass0) / mass1 + 1 : 0;
+	upper1 = std::min(std::max(upper1, min1), max1 + 1);
+	numberOfDecompositions += max0 * (upper1 - min1);
+	if (upper1 <= max1) {
+		numberOfDecompositions += DecompUtils::getFloorSum<count_type>(max1 - upper1 + 1,
+									mass0, mass1, high - max1 * mass1);
+	}
+
+	// lower end: ceil((low - c1*mass1) / mass0) for c1 < lower1, 0 from there on
+	const count_type lower1 = std::min((low + mass1 - 1) / mass1, max1 + 1);
+	if (lower1 > min1) {
+		numberOfDecompositions -= DecompUtils::getFloorSum<count_type>(lower1 - min1,
+									mass0, mass1, low + mass0 - 1 - (lower1 - 1) * mass1);
+	}
+	return numberOfDecompositions;
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+typename IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::number_of_decompositions_type
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+countSmallestMasses(const SmallestMassesCounts& counts, value_type lowMass,
+					value_type highMass) const {
+	const value_type smallestMass = alphabet.getWeight(0);
+	const residue_type* residues = counts.residues.data();
+
+	// number of masses below 'mass': all masses of the buckets before its
+	// quotient and those of its bucket with a smaller residue
+	auto countBelow = [&](value_type mass) -> size_type {
+		const value_type quotient = mass / smallestMass, residue = mass % smallestMass;
+		size_type below = counts.offsets[quotient];
+		if (residue > 0) {
+			const residue_type* begin = residues + counts.offsets[quotient];
+			const residue_type* end = residues + counts.offsets[quotient + 1];
+			below += std::lower_bound(begin, end, static_cast<residue_type>(residue)) - begin;
+		}
+		return below;
+	};
+	return countBelow(highMass + 1) - countBelow(lowMass);
+}
+
+
+template <typename ValueType, typename DecompositionValueType, typename ResidueType>
+std::shared_ptr<const typename IntegerMassDecomposer<ValueType, DecompositionValueType,
+													 ResidueType>::SmallestMassesCounts>
+IntegerMassDecomposer<ValueType, DecompositionValueType, ResidueType>::
+getSmallestMassesCounts(value_type highMass, const TraversalBounds& bounds) const {
+	std::shared_ptr<const SmallestMassesCounts> counts;
+	if (alphabet.size() < 3 || bounds.overflow) {
+		return counts;
+	}
+	// the table holds the masses of unbounded counts
+	for (size_type i = 0; i < 3; ++i) {
+		if (bounds.ranges[i] < highMass / alphabet.getWeight(i)) {
+			return counts;
+		}
+	}
+	const value_type smallestMass = alphabet.getWeight(0);
+	const value_type quotient = highMass / smallestMass;
+	{
+		std::lock_guard<std::mutex> lock(smallest_masses_counts->mutex);
+		if (smallest_masses_counts->counts &&
+			smallest_masses_counts->counts->max_quotient >= quotient) {
+			return smallest_masses_counts->counts;
+		}
+		if (smallest_masses_counts->too_large_quotient > 0 &&
+			quotient >= smallest_masses_counts->too_large_quotient) {
+			return counts;
+		}
+	}
+
+	// buckets are added in steps of 64, so that similar masses share the table.
+	// The number of masses below (q+1) * smallestMass is about
+	// ((q+1) * smallestMass)^3 / (6 * the product of the three masses)
+	const value_type maxQuotient = quotient | 63;
+	const value_type mass1 = alphabet.getWeight(1), mass2 = alphabet.getWeight(2);
+	const value_type end = (maxQuotient + 1) * smallestMass;
+	const double expected = static_cast<double>(end) / smallestMass *
+		static_cast<double>(end) / mass1 * static_cast<double>(end) / mass2 / 6;
+
+	// masses over the second and third alphabet mass below the end, sorted
+	std::vector<value_type> sums;
+	if (expected < 2.0 * max_smallest_masses_counts) {
+		for (value_type sum2 = 0; sum2 < end; sum2 += mass2) {
+			for (value_type sum = sum2; sum < end; sum += mass1) {
+				sums.push_back(sum);
+			}
+		}
+	}
+	size_type size = 0;
+	for (typename std::vector<value_type>::const_iterator it = sums.begin(); it != sums.end(); ++it) {
+		size += maxQuotient - *it / smallestMass + 1;
+	}
+	if (sums.empty() || size > max_smallest_masses_counts) {
+		std::lock_guard<std::mutex> lock(smallest_masses_counts->mutex);
+		if (smallest_masses_counts->too_large_quotient == 0 ||
+			smallest_masses_counts->too_large_quotient > quotient) {
+			smallest_masses_counts->too_large_quotient = quotient;
+		}
+		return counts;
+	}
+	std::sort(sums.begin(), sums.end());
+
+	// every bucket merges the residues of the one before with the new ones
+	std::shared_ptr<SmallestMassesCounts> table(new SmallestMassesCounts);
+	table->max_quotient = maxQuotient;
+	table->offsets.reserve(maxQuotient + 2);
+	table->residues.resize(size);
+	residue_type* residues = table->residues.data();
+	std::vector<residue_type> added;
+	typename std::vector<value_type>::const_iterator next = sums.begin();
+	size_type offset = 0, previous = 0;
+	for (value_type q = 0; q <= maxQuotient; ++q) {
+		added.clear();
+		for (; next != sums.end() && *next / smallestMass == q; ++next) {
+			added.push_back(static_cast<residue_type>(*next % smallestMass));
+		}
+		table->offsets.push_back(offset);
+		residue_type* bucketEnd = std::merge(residues + previous, residues + offset,
+									added.begin(), added.end(), residues + offset);
+		previous = offset;
+		offset = bucketEnd - residues;
+	}
+	table->offsets.push_back(offset);
+
+	std::lock_guard<std::mutex> lock(smallest_masses_counts->mutex);
+	// keeps a larger table computed by another thread in the meantime
+	if (!smallest_masses_counts->counts ||
+		smallest_masses_counts->counts->max_quotient < maxQuotient) {
+		smallest_masses_counts->counts = table;
+	}
+	return smallest_masses_counts->counts;
 }
 
 
@@ -82,6 +82,31 @@ class MassDecomposer {
 		 */
 		virtual decompositions_type getAllDecompositions(value_type mass) = 0;
 
+		/**
+		 * Returns all possible decompositions for masses in the interval
+		 * [@c lo, @c hi]. The default implementation decomposes every mass
+		 * in the interval separately; decomposers that can do better should
+		 * override it.
+		 *
+		 * @param lo Smallest mass to be decomposed.
+		 * @param hi Largest mass to be decomposed.
+		 * @return All possible decompositions of masses in [@c lo, @c hi],
+		 * if there are any exist, otherwise - an empty container.
+		 */
+		virtual decompositions_type getAllDecompositions(value_type lo, value_type hi) {
+			decompositions_type decompositions;
+			for (value_type mass = lo; mass <= hi; ++mass) {
+				decompositions_type mass_decompositions = getAllDecompositions(mass);
+				decompositions.insert(decompositions.end(),
+					mass_decompositions.begin(), mass_decompositions.end());
+				// avoids wrap around if hi is the largest value_type
+				if (mass == hi) {
+					break;
+				}
+			}
+			return decompositions;
+		}
+
 		/**
 		 * Returns the number of possible decompositions for the given @c mass.
 		 *
@@ -6,11 +6,50 @@
 
 #include <ims/utils/math.h>
 #include <ims/decomp/realmassdecomposer.h>
-#include <ims/decomp/decomputils.h>
 #include <iostream>
 
 namespace ims {
 
+namespace {
+
+/**
+ * Collects decompositions visited on one branch of a parallel traversal.
+ */
+struct DecompositionsCollector {
+	RealMassDecomposer::decompositions_type decompositions;
+
+	void operator()(const RealMassDecomposer::decomposition_type& decomposition) {
+		decompositions.push_back(decomposition);
+	}
+};
+
+/**
+ * Counts decompositions visited on one branch of a parallel traversal.
+ */
+struct DecompositionsCounter {
+	DecompositionsCounter() : number_of_decompositions(0) {}
+
+	RealMassDecomposer::number_of_decompositions_type number_of_decompositions;
+
+	void operator()(const RealMassDecomposer::decomposition_type&) {
+		++number_of_decompositions;
+	}
+};
+
+/**
+ * Sums up the decompositions counted by the copies of a filtered counter.
+ */
+template <typename Filters>
+RealMassDecomposer::number_of_decompositions_type sumNumberOfDecompositions(const Filters& filters) {
+	RealMassDecomposer::number_of_decompositions_type number_of_decompositions = 0;
+	for (typename Filters::const_iterator it = filters.begin(); it != filters.end(); ++it) {
+		number_of_decompositions += it->visitor.number_of_decompositions;
+	}
+	return number_of_decompositions;
+}
+
+} // namespace
+
 
 RealMassDecomposer::RealMassDecomposer(const Weights& weights) :
 		weights(weights) {
@@ -23,70 +62,223 @@ RealMassDecomposer::RealMassDecomposer(const Weights& weights) :
 }
 
 
-RealMassDecomposer::decompositions_type
-RealMassDecomposer::getDecompositions(double mass, double error) {
-	// defines the range of integers to be decomposed
-	integer_value_type start_integer_mass = static_cast<integer_value_type>(
-		ceil((1 + rounding_errors.first) * (mass - error) / precision));
-	integer_value_type end_integer_mass = static_cast<integer_value_type>(
-		floor((1 + rounding_errors.second) * (mass + error) / precision));
+RealMassDecomposer::RealMassDecomposer(const Weights& weights, ThreadPool& pool) :
+		weights(weights) {
 
-	decompositions_type all_decompositions_from_range;
+	rounding_errors =
+		DecompUtils::getMinMaxWeightsRoundingErrors(weights);
+	precision = weights.getPrecision();
+	decomposer = std::unique_ptr<integer_decomposer_type>(
+							new integer_decomposer_type(weights, pool));
+}
 
-	// loops and finds decompositions for every integer mass,
-	// then checks if real mass of decomposition lays in the allowed
-	// error interval [mass-error; mass+error]
-	for (integer_value_type integer_mass = start_integer_mass;
-							integer_mass < end_integer_mass; ++integer_mass) {
-		decompositions_type decompositions =
-			decomposer->getAllDecompositions(integer_mass);
-		for (decompositions_type::iterator pos = decompositions.begin();
-			 						pos != decompositions.end();) {
-			double parent_mass =
-						DecompUtils::getParentMass(weights, *pos);
-			if (fabs(parent_mass - mass) > error) {
-				pos = decompositions.erase(pos);
-			} else {
-				++pos;
-			}
-		}
-		all_decompositions_from_range.insert(all_decompositions_from_range.end(), 
-								decompositions.begin(), decompositions.end());
-	}
 
-	return all_decompositions_from_range;
+RealMassDecomposer::RealMassDecomposer(const Weights& weights, const std::string& filename) :
+		weights(weights) {
+
+	rounding_errors =
+		DecompUtils::getMinMaxWeightsRoundingErrors(weights);
+	precision = weights.getPrecision();
+	decomposer = std::unique_ptr<integer_decomposer_type>(
+							new integer_decomposer_type(weights, filename));
 }
 
-RealMassDecomposer::number_of_decompositions_type
-RealMassDecomposer::getNumberOfDecompositions(double mass, double error) {
+
+std::pair<RealMassDecomposer::integer_value_type, RealMassDecomposer::integer_value_type>
+RealMassDecomposer::getIntegerMassRange(double mass, double error) const {
 	// defines the range of integers to be decomposed
 	integer_value_type start_integer_mass = static_cast<integer_value_type>(1);
 	if (mass - error > 0) {
 		start_integer_mass = static_cast<integer_value_type>(
 		ceil((1 + rounding_errors.first) * (mass - error) / precision));
 	}
-	integer_value_type end_integer_mass = static_cast<integer_value_type>(
+	integer_value_type end_integer_mass = static_cast<integer_value_type>(0);
+	if (mass + error > 0) {
+		end_integer_mass = static_cast<integer_value_type>(
 		floor((1 + rounding_errors.second) * (mass + error) / precision));
+	}
+	return std::make_pair(start_integer_mass, end_integer_mass);
+}
 
-	number_of_decompositions_type number_of_decompositions = static_cast<number_of_decompositions_type>(0);
 
-	// loops and finds decompositions for every integer mass,
-	// then checks if real mass of decomposition lays in the allowed
-	// error interval [mass-error; mass+error]
-	for (integer_value_type integer_mass = start_integer_mass;
-							integer_mass < end_integer_mass; ++integer_mass) {
-		decompositions_type decompositions =
-			decomposer->getAllDecompositions(integer_mass);
-		for (decompositions_type::iterator pos = decompositions.begin();
-			 						pos != decompositions.end(); ++pos) {
-			double parent_mass = DecompUtils::getParentMass(weights, *pos);
-			if (fabs(parent_mass - mass) <= error) {
-				++number_of_decompositions;
-			}
-		}
+std::pair<RealMassDecomposer::integer_value_type, RealMassDecomposer::integer_value_type>
+RealMassDecomposer::getCertainIntegerMassRange(double mass, double error,
+		const std::pair<integer_value_type, integer_value_type>& range) const {
+	// a decomposition of the integer mass m has a real mass within
+	// [m * precision / (1 + max error); m * precision / (1 + min error)].
+	// The integer masses next to the ends are left out against errors of the 
+	// floating point arithmetics.
+	integer_value_type start_integer_mass = range.first;
+	if (mass - error > 0) {
+		start_integer_mass = std::max(range.first, static_cast<integer_value_type>(
+		ceil((1 + rounding_errors.second) * (mass - error) / precision)) + 1);
+	}
+	integer_value_type end_integer_mass = std::min(range.second, static_cast<integer_value_type>(
+		floor((1 + rounding_errors.first) * (mass + error) / precision)));
+	if (end_integer_mass < start_integer_mass) {
+		end_integer_mass = start_integer_mass = std::min(start_integer_mass, range.second);
 	}
+	return std::make_pair(start_integer_mass, end_integer_mass);
+}
+
+
+RealMassDecomposer::decompositions_type
+RealMassDecomposer::getDecompositions(double mass, double error) {
+	decompositions_type decompositions;
+	visitDecompositions(mass, error, [&decompositions](const decomposition_type& decomposition) {
+		decompositions.push_back(decomposition);
+	});
+	return decompositions;
+}
+
 
+void RealMassDecomposer::getDecompositions(double mass, double error,
+										   flat_decompositions_type& decompositions) {
+	visitDecompositions(mass, error, [&decompositions](const decomposition_type& decomposition) {
+		decompositions.insert(decompositions.end(), decomposition.begin(), decomposition.end());
+	});
+}
+
+
+RealMassDecomposer::decompositions_type
+RealMassDecomposer::getDecompositions(double mass, double error, ThreadPool& pool) {
+	return getDecompositions(mass, error, bounds_type(), pool);
+}
+
+
+RealMassDecomposer::decompositions_type
+RealMassDecomposer::getDecompositions(double mass, double error, 
+									  const bounds_type& bounds, ThreadPool& pool) {
+	// every branch of the traversal is collected separately
+	// and the parts are joined in traversal order
+	std::vector<DecompositionsCollector> parts = 
+		visitDecompositions(mass, error, bounds, DecompositionsCollector(), pool);
+
+	decompositions_type decompositions;
+	for (std::vector<DecompositionsCollector>::iterator it = parts.begin(); 
+												it != parts.end(); ++it) {
+		decompositions.insert(decompositions.end(), 
+							  it->decompositions.begin(), it->decompositions.end());
+	}
+	return decompositions;
+}
+
+
+RealMassDecomposer::number_of_decompositions_type
+RealMassDecomposer::getNumberOfDecompositions(double mass, double error) {
+	return getNumberOfDecompositions(mass, error, bounds_type());
+}
+
+
+RealMassDecomposer::number_of_decompositions_type
+RealMassDecomposer::getNumberOfDecompositions(double mass, double error, 
+											  const bounds_type& bounds) {
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return static_cast<number_of_decompositions_type>(0);
+	}
+	std::pair<integer_value_type, integer_value_type> certain =
+		getCertainIntegerMassRange(mass, error, range);
+
+	// decompositions of the certain integer masses are counted, the ones
+	// of the integer masses left and right of them are checked one by one.
+	// Without certain integer masses, all decompositions are checked at once.
+	ParentMassFilter<DecompositionsCounter> filter = { &weights, mass, error, DecompositionsCounter() };
+	if (certain.first == certain.second) {
+		return decomposer->visitDecompositions(range.first, range.second - 1, 
+											   bounds, filter).visitor.number_of_decompositions;
+	}
+	number_of_decompositions_type number_of_decompositions = 
+		decomposer->getNumberOfDecompositions(certain.first, certain.second - 1, bounds);
+	if (range.first < certain.first) {
+		number_of_decompositions += decomposer->visitDecompositions(
+			range.first, certain.first - 1, bounds, filter).visitor.number_of_decompositions;
+	}
+	if (certain.second < range.second) {
+		number_of_decompositions += decomposer->visitDecompositions(
+			certain.second, range.second - 1, bounds, filter).visitor.number_of_decompositions;
+	}
+	return number_of_decompositions;
+}
+
+
+RealMassDecomposer::number_of_decompositions_type
+RealMassDecomposer::getNumberOfDecompositions(double mass, double error, ThreadPool& pool) {
+	return getNumberOfDecompositions(mass, error, bounds_type(), pool);
+}
+
+
+RealMassDecomposer::number_of_decompositions_type
+RealMassDecomposer::getNumberOfDecompositions(double mass, double error, 
+											  const bounds_type& bounds, ThreadPool& pool) {
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return static_cast<number_of_decompositions_type>(0);
+	}
+	std::pair<integer_value_type, integer_value_type> certain =
+		getCertainIntegerMassRange(mass, error, range);
+
+	ParentMassFilter<DecompositionsCounter> filter = { &weights, mass, error, DecompositionsCounter() };
+	if (certain.first == certain.second) {
+		return sumNumberOfDecompositions(decomposer->visitDecompositions(
+			range.first, range.second - 1, bounds, filter, pool));
+	}
+	number_of_decompositions_type number_of_decompositions = 
+		decomposer->getNumberOfDecompositions(certain.first, certain.second - 1, bounds, pool);
+	if (range.first < certain.first) {
+		number_of_decompositions += sumNumberOfDecompositions(decomposer->visitDecompositions(
+			range.first, certain.first - 1, bounds, filter, pool));
+	}
+	if (certain.second < range.second) {
+		number_of_decompositions += sumNumberOfDecompositions(decomposer->visitDecompositions(
+			certain.second, range.second - 1, bounds, filter, pool));
+	}
 	return number_of_decompositions;
 }
 
+
+std::pair<RealMassDecomposer::number_of_decompositions_type, 
+		  RealMassDecomposer::number_of_decompositions_type>
+RealMassDecomposer::getNumberOfDecompositionsBounds(double mass, double error, 
+													const bounds_type& bounds) {
+	number_of_decompositions_type lower = 0, upper = 0;
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return std::make_pair(lower, upper);
+	}
+	std::pair<integer_value_type, integer_value_type> certain =
+		getCertainIntegerMassRange(mass, error, range);
+
+	if (certain.first < certain.second) {
+		lower = decomposer->getNumberOfDecompositions(certain.first, certain.second - 1, bounds);
+	}
+	upper = decomposer->getNumberOfDecompositions(range.first, range.second - 1, bounds);
+	return std::make_pair(lower, upper);
+}
+
+
+std::pair<RealMassDecomposer::number_of_decompositions_type, 
+		  RealMassDecomposer::number_of_decompositions_type>
+RealMassDecomposer::getNumberOfDecompositionsBounds(double mass, double error, 
+													const bounds_type& bounds, ThreadPool& pool) {
+	number_of_decompositions_type lower = 0, upper = 0;
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return std::make_pair(lower, upper);
+	}
+	std::pair<integer_value_type, integer_value_type> certain =
+		getCertainIntegerMassRange(mass, error, range);
+
+	if (certain.first < certain.second) {
+		lower = decomposer->getNumberOfDecompositions(certain.first, certain.second - 1, 
+													  bounds, pool);
+	}
+	upper = decomposer->getNumberOfDecompositions(range.first, range.second - 1, bounds, pool);
+	return std::make_pair(lower, upper);
+}
+
 } // namespace ims
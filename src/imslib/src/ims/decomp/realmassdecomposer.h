@@ -3,8 +3,11 @@
 
 #include <utility>
 #include <memory>
+#include <cmath>
+#include <string>
 
 #include <ims/decomp/integermassdecomposer.h>
+#include <ims/decomp/decomputils.h>
 
 namespace ims {
 
@@ -43,16 +46,34 @@ class RealMassDecomposer {
 		 */
 		typedef integer_decomposer_type::value_type integer_value_type;
 		
+		/**
+		 * Type of result decomposition from integer decomposer.
+		 */
+		typedef integer_decomposer_type::decomposition_type
+											decomposition_type;
+
 		/**
 		 * Type of result decompositions from integer decomposer.
 		 */
 		typedef integer_decomposer_type::decompositions_type 
 											decompositions_type;
 
+		/**
+		 * Type of flat container for many decompositions (row-major counts).
+		 */
+		typedef integer_decomposer_type::flat_decompositions_type
+											flat_decompositions_type;
+
+		/**
+		 * Type of bounds for the counts of the weights.
+		 */
+		typedef integer_decomposer_type::bounds_type bounds_type;
+
 		/**
 		 * Type of the number of decompositions.
 		 */
-		typedef unsigned long long number_of_decompositions_type;
+		typedef integer_decomposer_type::number_of_decompositions_type 
+											number_of_decompositions_type;
 
 		/**
 		 * Constructor with weights.
@@ -60,6 +81,41 @@ class RealMassDecomposer {
 		 * @param weights Weights over which values/masses to be decomposed.
 		 */
 		RealMassDecomposer(const Weights& weights);
+
+		/**
+		 * Constructor with weights, computes the extended residue table of
+		 * the integer decomposer with the threads of @c pool.
+		 * 
+		 * @param weights Weights over which values/masses to be decomposed.
+		 * @param pool Threads computing the residue table.
+		 */
+		RealMassDecomposer(const Weights& weights, ThreadPool& pool);
+
+		/**
+		 * Constructor with weights, maps the extended residue table of the
+		 * integer decomposer from the file @c filename instead of computing it,
+		 * see IntegerMassDecomposer::IntegerMassDecomposer(const Weights&, const std::string&).
+		 * 
+		 * @param weights Weights over which values/masses to be decomposed.
+		 * @param filename Name of the file written by save().
+		 * @throws IOException if the file cannot be mapped or was computed for other weights
+		 */
+		RealMassDecomposer(const Weights& weights, const std::string& filename) /*throw (IOException)*/;
+
+		/**
+		 * Saves the extended residue table of the integer decomposer to the
+		 * file @c filename, see IntegerMassDecomposer::save().
+		 * 
+		 * @throws IOException if the file cannot be written
+		 */
+		void save(const std::string& filename) const /*throw (IOException)*/ {
+			decomposer->save(filename);
+		}
+
+		/**
+		 * Whether the extended residue table was mapped from a file.
+		 */
+		bool isMapped() const { return decomposer->isMapped(); }
 		
 		/**
 		 * Gets all decompositions for a @c mass with an @c error allowed.
@@ -70,17 +126,267 @@ class RealMassDecomposer {
 		 */
 		decompositions_type getDecompositions(double mass, double error);
 
+		/**
+		 * Appends all decompositions for a @c mass with an @c error allowed
+		 * to @c decompositions, one row of counts per decomposition.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param decompositions Row-major matrix the decompositions are appended to.
+		 */
+		void getDecompositions(double mass, double error,
+							   flat_decompositions_type& decompositions);
+
+		/**
+		 * Calls @c visitor for every decomposition for a @c mass with an
+		 * @c error allowed. The decomposition passed to the visitor is
+		 * reused afterwards, see IntegerMassDecomposer::visitDecompositions().
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param visitor Function object to be called for every decomposition.
+		 * @return The visitor after all decompositions were visited.
+		 */
+		template <typename Visitor>
+		Visitor visitDecompositions(double mass, double error, Visitor visitor);
+
+		/**
+		 * Calls @c visitor for every decomposition for a @c mass with an
+		 * @c error allowed whose counts lie within @c bounds. Branches violating
+		 * the bounds are cut during the traversal, see 
+		 * IntegerMassDecomposer::visitDecompositions(value_type, value_type, const bounds_type&, Visitor).
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param visitor Function object to be called for every decomposition.
+		 * @return The visitor after all decompositions were visited.
+		 */
+		template <typename Visitor>
+		Visitor visitDecompositions(double mass, double error, 
+									const bounds_type& bounds, Visitor visitor);
+
+		/**
+		 * Visits all decompositions for a @c mass with an @c error allowed
+		 * by the threads of @c pool, see 
+		 * IntegerMassDecomposer::visitDecompositions(value_type, value_type, const Visitor&, ThreadPool&).
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param visitor Function object to be copied for every branch of the traversal.
+		 * @param pool Threads to be used.
+		 * @return The copies of the visitor in traversal order.
+		 */
+		template <typename Visitor>
+		std::vector<Visitor> visitDecompositions(double mass, double error, 
+												 const Visitor& visitor, ThreadPool& pool);
+
+		/**
+		 * Visits all decompositions for a @c mass with an @c error allowed
+		 * whose counts lie within @c bounds by the threads of @c pool.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param visitor Function object to be copied for every branch of the traversal.
+		 * @param pool Threads to be used.
+		 * @return The copies of the visitor in traversal order.
+		 */
+		template <typename Visitor>
+		std::vector<Visitor> visitDecompositions(double mass, double error, 
+												 const bounds_type& bounds,
+												 const Visitor& visitor, ThreadPool& pool);
+
+		/**
+		 * Calls @c visitor for every decomposition for a @c mass with an
+		 * @c error allowed whose counts lie within @c bounds and lets the
+		 * visitor prune the traversal, see
+		 * IntegerMassDecomposer::visitPrunedDecompositions(). The masses passed
+		 * to <tt>acceptsBranch()</tt> are integer masses over the scaled weights
+		 * (Weights::getWeight()), the visitor is called only for decompositions
+		 * within the error.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param visitor Function object to be called for every branch and decomposition.
+		 * @return The visitor after all decompositions were visited.
+		 */
+		template <typename PruningVisitor>
+		PruningVisitor visitPrunedDecompositions(double mass, double error, 
+												 const bounds_type& bounds,
+												 PruningVisitor visitor);
+
+		/**
+		 * Visits all decompositions for a @c mass with an @c error allowed
+		 * whose counts lie within @c bounds by the threads of @c pool and lets
+		 * the copies of @c visitor prune the traversal.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param visitor Function object to be copied for every branch of the traversal.
+		 * @param pool Threads to be used.
+		 * @return The copies of the visitor in traversal order, see
+		 * IntegerMassDecomposer::visitPrunedDecompositions().
+		 */
+		template <typename PruningVisitor>
+		std::vector<PruningVisitor> visitPrunedDecompositions(double mass, double error, 
+															  const bounds_type& bounds,
+															  const PruningVisitor& visitor,
+															  ThreadPool& pool);
+
+		/**
+		 * Gets all decompositions for a @c mass with an @c error allowed
+		 * using the threads of @c pool. The result is the same as the one of
+		 * getDecompositions(double, double).
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param pool Threads to be used.
+		 * @return All possible decompositions for a given mass and error.
+		 */
+		decompositions_type getDecompositions(double mass, double error, ThreadPool& pool);
+
+		/**
+		 * Gets all decompositions for a @c mass with an @c error allowed
+		 * whose counts lie within @c bounds, using the threads of @c pool.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param pool Threads to be used.
+		 * @return All decompositions for a given mass and error within the bounds.
+		 */
+		decompositions_type getDecompositions(double mass, double error, 
+											  const bounds_type& bounds, ThreadPool& pool);
+
 		/**
 		 * Gets a number of all decompositions for a @c mass with an @c error
 		 * allowed. It's similar to the @c getDecompositions(double,double) function
 		 * but less space consuming, since doesn't use container to store decompositions.
 		 * 
+		 * Decompositions of integer masses, whose real masses are within the
+		 * @c error whatever the rounding errors of the weights are, are counted
+		 * by IntegerMassDecomposer::getNumberOfDecompositions(value_type, value_type, const bounds_type&)
+		 * without enumerating them. Only the decompositions of the few integer
+		 * masses at both ends of the range are enumerated and checked.
+		 * 
 		 * @param mass Mass to be decomposed.
 		 * @param error Error allowed between given and result decomposition.
 		 * @return Number of all decompositions for a given mass and error.
 		 */
 		number_of_decompositions_type getNumberOfDecompositions(double mass, double error);
+
+		/**
+		 * Gets a number of all decompositions for a @c mass with an @c error
+		 * allowed using the threads of @c pool.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param pool Threads to be used.
+		 * @return Number of all decompositions for a given mass and error.
+		 */
+		number_of_decompositions_type getNumberOfDecompositions(double mass, double error, 
+																ThreadPool& pool);
+
+		/**
+		 * Gets a number of all decompositions for a @c mass with an @c error
+		 * allowed whose counts lie within @c bounds.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @return Number of all decompositions for a given mass and error within the bounds.
+		 */
+		number_of_decompositions_type getNumberOfDecompositions(double mass, double error, 
+																const bounds_type& bounds);
+
+		/**
+		 * Gets a number of all decompositions for a @c mass with an @c error
+		 * allowed whose counts lie within @c bounds, using the threads of @c pool.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param pool Threads to be used.
+		 * @return Number of all decompositions for a given mass and error within the bounds.
+		 */
+		number_of_decompositions_type getNumberOfDecompositions(double mass, double error, 
+																const bounds_type& bounds,
+																ThreadPool& pool);
+
+		/**
+		 * Gets a lower and an upper bound for the number of decompositions 
+		 * for a @c mass with an @c error allowed whose counts lie within
+		 * @c bounds. No decomposition is enumerated: the lower bound counts 
+		 * the integer masses whose decompositions are certainly within the
+		 * @c error, the upper bound all integer masses which could have one.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @return Lower and upper bound of the number of decompositions.
+		 */
+		std::pair<number_of_decompositions_type, number_of_decompositions_type>
+			getNumberOfDecompositionsBounds(double mass, double error, const bounds_type& bounds);
+
+		/**
+		 * Gets a lower and an upper bound for the number of decompositions 
+		 * like the overload above, using the threads of @c pool.
+		 * 
+		 * @param mass Mass to be decomposed.
+		 * @param error Error allowed between given and result decomposition.
+		 * @param bounds Bounds for the counts of the weights.
+		 * @param pool Threads to be used.
+		 * @return Lower and upper bound of the number of decompositions.
+		 */
+		std::pair<number_of_decompositions_type, number_of_decompositions_type>
+			getNumberOfDecompositionsBounds(double mass, double error, const bounds_type& bounds,
+											ThreadPool& pool);
 	private:
+		/**
+		 * Passes decompositions, whose real mass is within the allowed error,
+		 * to another visitor.
+		 */
+		template <typename Visitor>
+		struct ParentMassFilter {
+			const Weights* weights;
+			double mass;
+			double error;
+			Visitor visitor;
+
+			void operator()(const decomposition_type& decomposition) {
+				double parent_mass = DecompUtils::getParentMass(*weights, decomposition);
+				if (fabs(parent_mass - mass) <= error) {
+					visitor(decomposition);
+				}
+			}
+
+			// only instantiated for pruning visitors
+			bool acceptsBranch(const decomposition_type& decomposition,
+							   decomposition_type::size_type alphabetMassIndex,
+							   integer_value_type lowMass, integer_value_type highMass) {
+				return visitor.acceptsBranch(decomposition, alphabetMassIndex, lowMass, highMass);
+			}
+		};
+
+		/**
+		 * Gets the range [first; second) of integer masses which
+		 * decompositions can be within @c error of @c mass.
+		 */
+		std::pair<integer_value_type, integer_value_type>
+			getIntegerMassRange(double mass, double error) const;
+
+		/**
+		 * Gets the range [first; second) of integer masses within @c range,
+		 * whose decompositions are all within @c error of @c mass.
+		 * The range is empty (first == second) if there are no such masses.
+		 */
+		std::pair<integer_value_type, integer_value_type>
+			getCertainIntegerMassRange(double mass, double error,
+				const std::pair<integer_value_type, integer_value_type>& range) const;
+
 		/**
 		 * Weights over which values/masses to be decomposed.
 		 */
@@ -103,6 +409,96 @@ class RealMassDecomposer {
 		std::unique_ptr<integer_decomposer_type> decomposer;
 };
 
+
+template <typename Visitor>
+Visitor RealMassDecomposer::visitDecompositions(double mass, double error, Visitor visitor) {
+	return visitDecompositions(mass, error, bounds_type(), visitor);
+}
+
+
+template <typename Visitor>
+Visitor RealMassDecomposer::visitDecompositions(double mass, double error, 
+												const bounds_type& bounds, Visitor visitor) {
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return visitor;
+	}
+
+	// decomposes all integer masses of the range at once,
+	// then checks if real mass of decomposition lays in the allowed
+	// error interval [mass-error; mass+error]
+	ParentMassFilter<Visitor> filter = { &weights, mass, error, visitor };
+	return decomposer->visitDecompositions(range.first, range.second - 1, bounds, filter).visitor;
+}
+
+
+template <typename Visitor>
+std::vector<Visitor> RealMassDecomposer::visitDecompositions(double mass, double error,
+										const Visitor& visitor, ThreadPool& pool) {
+	return visitDecompositions(mass, error, bounds_type(), visitor, pool);
+}
+
+
+template <typename Visitor>
+std::vector<Visitor> RealMassDecomposer::visitDecompositions(double mass, double error,
+										const bounds_type& bounds, 
+										const Visitor& visitor, ThreadPool& pool) {
+	std::vector<Visitor> visitors;
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return visitors;
+	}
+
+	ParentMassFilter<Visitor> filter = { &weights, mass, error, visitor };
+	std::vector< ParentMassFilter<Visitor> > filters =
+		decomposer->visitDecompositions(range.first, range.second - 1, bounds, filter, pool);
+	visitors.reserve(filters.size());
+	for (typename std::vector< ParentMassFilter<Visitor> >::const_iterator it = filters.begin();
+																it != filters.end(); ++it) {
+		visitors.push_back(it->visitor);
+	}
+	return visitors;
+}
+
+
+template <typename PruningVisitor>
+PruningVisitor RealMassDecomposer::visitPrunedDecompositions(double mass, double error,
+										const bounds_type& bounds, PruningVisitor visitor) {
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return visitor;
+	}
+
+	ParentMassFilter<PruningVisitor> filter = { &weights, mass, error, visitor };
+	return decomposer->visitPrunedDecompositions(range.first, range.second - 1, bounds, filter).visitor;
+}
+
+
+template <typename PruningVisitor>
+std::vector<PruningVisitor> RealMassDecomposer::visitPrunedDecompositions(double mass, double error,
+										const bounds_type& bounds, 
+										const PruningVisitor& visitor, ThreadPool& pool) {
+	std::vector<PruningVisitor> visitors;
+	std::pair<integer_value_type, integer_value_type> range =
+		getIntegerMassRange(mass, error);
+	if (range.second <= range.first) {
+		return visitors;
+	}
+
+	ParentMassFilter<PruningVisitor> filter = { &weights, mass, error, visitor };
+	std::vector< ParentMassFilter<PruningVisitor> > filters =
+		decomposer->visitPrunedDecompositions(range.first, range.second - 1, bounds, filter, pool);
+	visitors.reserve(filters.size());
+	for (typename std::vector< ParentMassFilter<PruningVisitor> >::const_iterator it = filters.begin();
+																it != filters.end(); ++it) {
+		visitors.push_back(it->visitor);
+	}
+	return visitors;
+}
+
 } // namespace ims
 
 #endif // IMS_REALMASSDECOMPOSER_H
@@ -81,7 +81,7 @@ class TwoMassDecomposer {
 		/**
 		 * Type of the residues table.
 		 */
-		typedef std::vector<row_type> table_type;
+		typedef typename ResidueTable<ValueType,DecompositionValueType>::table_type table_type;
 
 		/**
 		 * First set of weights.
@@ -289,7 +289,7 @@ void TwoMassDecomposer<ValueType, DecompositionValueType>::collectDecompositions
 		}
 
 		// current residue class
-		const value_type r = ertable[alphabetMassIndex-1][mass_mod_alphabet0];
+		const value_type r = ertable.get(alphabetMassIndex-1, mass_mod_alphabet0);
 
 		// TODO: if infty was std::numeric_limits<...>... the following 'if' would not be necessary
 		if (r != infty) {
@@ -377,7 +377,7 @@ collectDecompositionsRecursively(
 			break;
 		}
 		// current residue class
-		const value_type r = ertable[alphabetMassIndex-1][mass_mod_alphabet0]; // "lbound" in paper
+		const value_type r = ertable.get(alphabetMassIndex-1, mass_mod_alphabet0); // "lbound" in paper
 
 		// TODO: if infty was std::numeric_limits<...>... the following 'if' would not be necessary
 		if (r != infty) {
@@ -389,7 +389,7 @@ collectDecompositionsRecursively(
 				 * in steps of the lcm ensures that m is decomposable. Therefore
 				 * the recursion will result in at least one witness. */
 
-				value_type r2 = ertable2[alphabetMassIndex-1][residue2];
+				value_type r2 = ertable2.get(alphabetMassIndex-1, residue2);
 
 				if (r2 != infty2 && m2 >= r2) {
 					collectDecompositionsRecursively(m1, m2, alphabetMassIndex-1,
@@ -78,7 +78,7 @@ class TwoMassDecomposer2 {
 		typedef std::vector<value_type> row_type;
 
 		/** Type of the residues table. */
-		typedef std::vector<row_type> table_type;
+		typedef typename ResidueTable<ValueType,DecompositionValueType>::table_type table_type;
 
 		/**
 		 * Weights over which the mass is to be decomposed. Note that except
@@ -340,7 +340,7 @@ void TwoMassDecomposer2<ValueType, DecompositionValueType>::decompose(
 			break;
 		}
 		// r: current residue class
-		const value_type r = ertable_c[max_i-1][mass_mod_alphabet0];
+		const value_type r = ertable_c.get(max_i-1, mass_mod_alphabet0);
 
 		// TODO if infty was numeric_limits<...>... the following 'if' would not be necessary
 		if (r != rt_c.infinity()) {
@@ -358,7 +358,7 @@ void TwoMassDecomposer2<ValueType, DecompositionValueType>::decompose(
 				always result in at least one witness.
 				*/
 #ifdef CHECK_A
-				value_type r2 = ertable_a[max_i][residue2];
+				value_type r2 = ertable_a.get(max_i, residue2);
 				if (r2 != rt_a.infinity() && m_a >= r2) {
 					decompose(m_a, m, max_i-1, decomposition, decompositions);
 				}
@@ -4,20 +4,27 @@
 #include <cmath>
 #include <cassert>
 #include <iostream>
+#include <ims/utils/erfc.h>
 
 namespace ims {
 
-/*
-TODO
-- don't save variance, but deviation/sqrt(2)
-*/
+namespace {
+
+struct ExactErfc {
+	double operator()(double z) const { return erfc(z); }
+};
+
+struct FastErfc {
+	double operator()(double z) const { return fastErfc(z); }
+};
 
-DistributionProbabilityScorer::DistributionProbabilityScorer(
-			const IsotopeDistribution& distribution) {
-	DistributionProbabilityScorer(distribution.getMasses(), 
-								distribution.getAbundances());
 }
 
+DistributionProbabilityScorer::DistributionProbabilityScorer(
+			const IsotopeDistribution& distribution) :
+		DistributionProbabilityScorer(distribution.getMasses(),
+								distribution.getAbundances()) {}
+
 DistributionProbabilityScorer::DistributionProbabilityScorer(
 			const masses_container& masses,
 			const abundances_container& abundances) :
@@ -175,6 +182,7 @@ void DistributionProbabilityScorer::setMassPrecision(double new_mass_precision_p
 									it != mass_dists.end(); ++it) {
 		it->mean *= new_mass_precision_ppm / mass_precision_ppm;		
 		it->variance *= new_mass_precision_ppm * new_mass_precision_ppm / mass_precision_ppm / mass_precision_ppm;
+		it->scale = sqrt(it->variance) * sqrt(2.0);
 	}
 	mass_precision_ppm = new_mass_precision_ppm;
 }
@@ -184,11 +192,8 @@ std::vector<DistributionProbabilityScorer::score_type> DistributionProbabilitySc
 scores(const masses_container& measured_masses,
 		const abundances_container& measured_abundances) const {
 
-	// TODO a lot in this function can be simplified and/or precalculated
 	using std::abs;
 
-	double sqrt2 = sqrt(2.0);
-
 	/*
 	Formulas
 
@@ -230,12 +235,7 @@ scores(const masses_container& measured_masses,
 	// new mass scoring: absolute diff	
 //	double x = predicted_masses[0] - measured_masses[0];
 
-	double prob = erfc(abs(x - mass_dists[0].mean) / (sqrt(mass_dists[0].variance) * sqrt2));
-
-	scores.push_back(prob);
-	// if (isDebugMode) {
- 	// 	std::cout << "erfc[mass_0] = " << prob << '\n';
-	// }
+	scores.push_back(erfc(abs(x - mass_dists[0].mean) / mass_dists[0].scale));
 	
 	// remaining peaks (only mass)
 	for (size_type i = 1; i < i_max; ++i) {
@@ -254,19 +254,10 @@ scores(const masses_container& measured_masses,
 //		// absolute direct diff
 //		x = predicted_masses[i] - measured_masses[i];
 		
-		double mean = (i < mass_dists.size()) ? mass_dists[i].mean : mass_dists.back().mean;
-		double variance = (i < mass_dists.size()) ? mass_dists[i].variance : mass_dists.back().variance;
-		prob *= erfc(abs(x - mean) / (sqrt(variance) * sqrt2));
-		// if (isDebugMode) {
- 		// 	std::cout << "erfc[mass_" << i << "] = " << erfc(abs(x - mean) / (sqrt(variance) * sqrt2)) << '\n';
-		// }
-		scores.push_back(erfc(abs(x - mean) / (sqrt(variance) * sqrt2)));
+		const NormalDistribution& dist = getMassDistribution(i);
+		scores.push_back(erfc(abs(x - dist.mean) / dist.scale));
 	}
 
-	// if (isDebugMode) {
- 	// 	std::cout << "prob (after masses) = " << prob << '\n';
-	// }
-
 	// intensities
 	i_max = std::min(predicted_masses.size(), std::min(measured_masses.size(), intensity_dists.size()));
 
@@ -277,22 +268,11 @@ scores(const masses_container& measured_masses,
 		// score relative
 //		x = predicted_abundances[i] / measured_abundances[i];
 		
-		double mean = (i < intensity_dists.size()) ? intensity_dists[i].mean : intensity_dists.back().mean;
-		double variance = (i < intensity_dists.size()) ? intensity_dists[i].variance : intensity_dists.back().variance;
-
-		prob *= erfc(abs(x - mean) / (sqrt(variance) * sqrt2));
 		// or perhaps:
 //		 prob *= erfc((x - mean) / (sqrt(variance) * sqrt2));
-		// if (isDebugMode) {
- 		// 	std::cout << "erfc[abund_" << i << "] = " << erfc(abs(x - mean) / (sqrt(variance) * sqrt2)) << '\n';
-		// }
-		scores.push_back(erfc(abs(x - mean) / (sqrt(variance) * sqrt2)));
+		scores.push_back(erfc(abs(x - intensity_dists[i].mean) / intensity_dists[i].scale));
 	}
 	
-	// if (isDebugMode) {
- 	// 	std::cout << "prob (after abundances) = " << prob << '\n';
-	// }
-
 //////	i_max = std::min(predicted_masses.size(), measured_masses.size());
 //////
 //////	// "missing" peaks (those not present in the measured spectrum)
@@ -334,6 +314,155 @@ DistributionProbabilityScorer::score(const IsotopeDistribution& distribution) co
 	return this->score(distribution.getMasses(), distribution.getAbundances());
 }
 
+DistributionProbabilityScorer::score_type 
+DistributionProbabilityScorer::score(const IsotopeDistribution& distribution, size_type size,
+		IsotopeDistribution::abundance_type scale) const {
+	using std::abs;
+
+	// the same factors as in scores(), with distribution as the measured peaks
+	size_t i_max = std::min(predicted_masses.size(), size);
+	assert(predicted_masses.size() > 0);
+	assert(size > 0);
+
+	// masses
+	const double measured_mass0 = distribution.getMass(0);
+	score_type prob = scoreMonoisotopicMass(measured_mass0);
+	for (size_type i = 1; i < i_max && prob != 0; ++i) {
+		double measured_mass = distribution.getMass(i);
+		double x = (predicted_masses[i] - predicted_masses[0] - measured_mass + measured_mass0) / measured_mass;
+		const NormalDistribution& dist = getMassDistribution(i);
+		prob *= erfc(abs(x - dist.mean) / dist.scale);
+	}
+
+	// intensities
+	i_max = std::min(predicted_masses.size(), std::min(size, intensity_dists.size()));
+	for (size_type i = 0; i < i_max && prob != 0; ++i) {
+		double x = log10(predicted_abundances[i] / (distribution.getAbundance(i) * scale));
+		prob *= erfc(abs(x - intensity_dists[i].mean) / intensity_dists[i].scale);
+	}
+	return prob;
+}
+
+DistributionProbabilityScorer::score_type 
+DistributionProbabilityScorer::scoreMonoisotopicMass(double mass) const {
+	using std::abs;
+
+	assert(predicted_masses.size() > 0);
+	double x = (predicted_masses[0] - mass) / mass;
+	return erfc(abs(x - mass_dists[0].mean) / mass_dists[0].scale);
+}
+
+DistributionProbabilityScorer::score_type 
+DistributionProbabilityScorer::logScore(const IsotopeDistribution& distribution, size_type size,
+		IsotopeDistribution::abundance_type scale, score_type bound) const {
+	using std::abs;
+
+	// the same factors as in score(distribution, size, scale), in logarithms
+	size_t i_max = std::min(predicted_masses.size(), size);
+	assert(predicted_masses.size() > 0);
+	assert(size > 0);
+
+	// masses
+	const double measured_mass0 = distribution.getMass(0);
+	score_type log_prob = logScoreMonoisotopicMass(measured_mass0);
+	for (size_type i = 1; i < i_max && !(log_prob < bound); ++i) {
+		double measured_mass = distribution.getMass(i);
+		double x = (predicted_masses[i] - predicted_masses[0] - measured_mass + measured_mass0) / measured_mass;
+		const NormalDistribution& dist = getMassDistribution(i);
+		log_prob += logErfc(abs(x - dist.mean) / dist.scale);
+	}
+
+	// intensities
+	i_max = std::min(predicted_masses.size(), std::min(size, intensity_dists.size()));
+	for (size_type i = 0; i < i_max && !(log_prob < bound); ++i) {
+		double x = log10(predicted_abundances[i] / (distribution.getAbundance(i) * scale));
+		log_prob += logErfc(abs(x - intensity_dists[i].mean) / intensity_dists[i].scale);
+	}
+	return log_prob;
+}
+
+DistributionProbabilityScorer::score_type 
+DistributionProbabilityScorer::logScoreMonoisotopicMass(double mass) const {
+	using std::abs;
+
+	assert(predicted_masses.size() > 0);
+	double x = (predicted_masses[0] - mass) / mass;
+	return logErfc(abs(x - mass_dists[0].mean) / mass_dists[0].scale);
+}
+
+DistributionProbabilityScorer::score_type 
+DistributionProbabilityScorer::logScoreIsotopeRatio(size_type i, double ratio, double tolerance) const {
+	using std::abs;
+
+	if (i == 0 || i >= predicted_abundances.size() || i >= intensity_dists.size() ||
+			!(ratio > 0) || !(predicted_abundances[0] > 0) || !(predicted_abundances[i] > 0)) {
+		return 0.0;
+	}
+	// the difference of the intensity terms x_i - x_0 does not depend on the
+	// scale, one of them deviates from its mean by at least half of the
+	// deviation of the difference, the other term is at most 0
+	double x = log10(predicted_abundances[i] / (predicted_abundances[0] * ratio));
+	double deviation = abs(x - (intensity_dists[i].mean - intensity_dists[0].mean)) - tolerance;
+	if (!(deviation > 0)) {
+		return 0.0;
+	}
+	return logErfc(deviation / (2.0 * std::max(intensity_dists[0].scale, intensity_dists[i].scale)));
+}
+
+void DistributionProbabilityScorer::scoreBatch(const double* masses, const double* abundances,
+		size_type candidates, size_type peaks, score_type* result, bool exact) const {
+	if (exact) {
+		scoreBatch(masses, abundances, candidates, peaks, result, ExactErfc());
+	} else {
+		scoreBatch(masses, abundances, candidates, peaks, result, FastErfc());
+	}
+}
+
+template <typename Erfc>
+void DistributionProbabilityScorer::scoreBatch(const double* masses, const double* abundances,
+		size_type candidates, size_type peaks, score_type* result, Erfc erfc) const {
+	using std::abs;
+
+	// the same factors as in scores(), computed column by column, so that
+	// the inner loops run over contiguous candidates without branches
+	size_t i_max = std::min(predicted_masses.size(), peaks);
+	assert(predicted_masses.size() > 0);
+	assert(peaks > 0);
+
+	// masses
+	const double predicted_mass0 = predicted_masses[0];
+	const double mean0 = mass_dists[0].mean;
+	const double scale0 = mass_dists[0].scale;
+	const double* masses0 = masses;
+	for (size_type c = 0; c < candidates; ++c) {
+		double x = (predicted_mass0 - masses0[c]) / masses0[c];
+		result[c] = erfc(abs(x - mean0) / scale0);
+	}
+	for (size_type i = 1; i < i_max; ++i) {
+		const double predicted_shift = predicted_masses[i] - predicted_mass0;
+		const double mean = getMassDistribution(i).mean;
+		const double scale = getMassDistribution(i).scale;
+		const double* masses_i = masses + i * candidates;
+		for (size_type c = 0; c < candidates; ++c) {
+			double x = (predicted_shift - masses_i[c] + masses0[c]) / masses_i[c];
+			result[c] *= erfc(abs(x - mean) / scale);
+		}
+	}
+
+	// intensities
+	i_max = std::min(predicted_masses.size(), std::min(peaks, intensity_dists.size()));
+	for (size_type i = 0; i < i_max; ++i) {
+		const double predicted_abundance = predicted_abundances[i];
+		const double mean = intensity_dists[i].mean;
+		const double scale = intensity_dists[i].scale;
+		const double* abundances_i = abundances + i * candidates;
+		for (size_type c = 0; c < candidates; ++c) {
+			double x = log10(predicted_abundance / abundances_i[c]);
+			result[c] *= erfc(abs(x - mean) / scale);
+		}
+	}
+}
+
 std::ostream& operator <<(std::ostream& os, 
 							const DistributionProbabilityScorer& scorer) {
 	os << "predicted masses and abundances:\n";
@@ -1,6 +1,8 @@
 #ifndef IMS_DISTRIBUTIONPROBABILITYSCORER_H
 #define IMS_DISTRIBUTIONPROBABILITYSCORER_H
 
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <ims/isotopedistribution.h>
 
@@ -32,6 +34,69 @@ class DistributionProbabilityScorer {
 
 		score_type score(const IsotopeDistribution& distribution) const;
 
+		/**
+		 * Scores the first @c size peaks of @c distribution with abundances
+		 * multiplied by @c scale, as score() does for their masses and scaled
+		 * abundances, but without copying them. Factors are multiplied in the
+		 * same order, so the scores are the same. As all factors are at most 1,
+		 * the remaining ones are skipped once the score is 0.
+		 */
+		score_type score(const IsotopeDistribution& distribution, size_type size,
+				IsotopeDistribution::abundance_type scale = 1.0) const;
+
+		/**
+		 * Scores the monoisotopic @c mass of a candidate only, the first
+		 * factor of score(). It bounds the score from above and is cheap
+		 * enough to be computed before the isotope distribution.
+		 */
+		score_type scoreMonoisotopicMass(double mass) const;
+
+		/**
+		 * Gets the logarithm of the score of the first @c size peaks of
+		 * @c distribution with abundances multiplied by @c scale, as
+		 * score() does. The logarithms of the factors are added up, so that
+		 * poor candidates, whose scores underflow to 0, are still ranked.
+		 *
+		 * All terms are at most 0, hence any partial sum bounds the
+		 * logarithm from above. Once it falls below @c bound, the
+		 * remaining terms are skipped and the partial sum is returned.
+		 */
+		score_type logScore(const IsotopeDistribution& distribution, size_type size,
+				IsotopeDistribution::abundance_type scale = 1.0,
+				score_type bound = -std::numeric_limits<score_type>::infinity()) const;
+
+		/**
+		 * Gets the logarithm of scoreMonoisotopicMass(), the first term of
+		 * logScore() and an upper bound of it.
+		 */
+		score_type logScoreMonoisotopicMass(double mass) const;
+
+		/**
+		 * Gets an upper bound of logScore() for a candidate whose peak @c i
+		 * has @c ratio times the abundance of its monoisotopic peak, from
+		 * the intensity terms of both peaks. Scaling the abundances keeps
+		 * their ratio, so the bound holds for any scale. Deviations of the
+		 * ratio of up to @c tolerance (in log10) are not counted, the bound
+		 * is 0 if peak @c i has no intensity term or either abundance is 0.
+		 */
+		score_type logScoreIsotopeRatio(size_type i, double ratio, double tolerance = 0.0) const;
+
+		/**
+		 * Scores @c candidates isotope patterns of @c peaks peaks each in one
+		 * call and writes their scores to @c result. Masses and abundances
+		 * are matrices with a row per candidate, stored column by column as
+		 * R does: peak @c i of candidate @c c is at <tt>i * candidates + c</tt>.
+		 * Abundances are used as they are, normalize them as for score().
+		 *
+		 * Each factor is computed for all candidates before the next one,
+		 * so that the loops can be vectorized. With @c exact, erfc() is used
+		 * and the scores equal those of score(); otherwise it is approximated
+		 * by fastErfc() with a relative error below 1.2e-7 per factor.
+		 */
+		void scoreBatch(const double* masses, const double* abundances,
+				size_type candidates, size_type peaks, score_type* result,
+				bool exact = false) const;
+
 		void setMassPrecision(double new_mass_precision_ppm);
 		
 		double getMassPrecision() const { return mass_precision_ppm; }
@@ -44,10 +109,29 @@ class DistributionProbabilityScorer {
 
 	private:
 		struct NormalDistribution {
-			NormalDistribution(double mean, double variance) : mean(mean), variance(variance) { }
+			NormalDistribution(double mean, double variance) :
+				mean(mean), variance(variance), scale(std::sqrt(variance) * std::sqrt(2.0)) { }
 			double mean;
 			double variance;
+			/**
+			 * Standard deviation times sqrt(2), which the differences
+			 * are divided by before erfc() is taken.
+			 */
+			double scale;
 		};
+
+		/**
+		 * Gets the distribution of the mass differences of peak @c i;
+		 * peaks beyond the known distributions share the last one.
+		 */
+		const NormalDistribution& getMassDistribution(size_type i) const {
+			return (i < mass_dists.size()) ? mass_dists[i] : mass_dists.back();
+		}
+
+		template <typename Erfc>
+		void scoreBatch(const double* masses, const double* abundances,
+				size_type candidates, size_type peaks, score_type* result,
+				Erfc erfc) const;
 		
 		masses_container predicted_masses;
 		abundances_container predicted_abundances;
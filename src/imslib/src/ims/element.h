@@ -161,9 +161,9 @@ class Element {
 /* 		    std::cerr << std::endl; */
 		    
 		    IsotopeDistribution::abundance_type maxval=-FLT_MAX;
-		    int maxindex=0;
+		    size_type maxindex=0;
 		    
-		    for (int i=0; i < IsotopeDistribution::SIZE; i++) {
+		    for (size_type i=0; i < isotopes.size(); i++) {
 /* 		      std::cerr << "Abundance is " << isotopes.getAbundance(i) << std::endl; */
 		      
 		      if (isotopes.getAbundance(i) > 0.5) { 
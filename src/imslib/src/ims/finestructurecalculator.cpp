@@ -0,0 +1,324 @@
+/**
+ * finestructurecalculator.cpp
+ */
+#include <cmath>
+#include <limits>
+#include <set>
+#include <algorithm>
+#include <ims/finestructurecalculator.h>
+#include <ims/base/exception/invalidargumentexception.h>
+
+namespace ims {
+
+namespace {
+
+/**
+ * Factor by which the abundance threshold is lowered from one layer to
+ * the next one when a coverage is to be reached.
+ */
+const double LAYER_THRESHOLD_FACTOR = 0.01;
+
+template <typename Configuration>
+struct MoreAbundant {
+	bool operator()(const Configuration& left, const Configuration& right) const {
+		return left.log_abundance > right.log_abundance;
+	}
+};
+
+template <typename Configuration>
+struct Lighter {
+	bool operator()(const Configuration& left, const Configuration& right) const {
+		return left.mass < right.mass;
+	}
+};
+
+}
+
+
+FineStructureCalculator::FineStructureCalculator(const ComposedElement& molecule) :
+			mode_log_abundance(0.0) {
+	const ComposedElement::container& molecule_elements = molecule.getElements();
+	for (ComposedElement::container::const_iterator it = molecule_elements.begin();
+			it != molecule_elements.end(); ++it) {
+		if (it->second == 0) {
+			continue;
+		}
+		ElementIsotopes element;
+		element.count = it->second;
+		element.log_factorial = std::lgamma(element.count + 1.0);
+		const IsotopeDistribution& distribution = it->first.getIsotopeDistribution();
+		for (IsotopeDistribution::size_type i = 0; i < distribution.size(); ++i) {
+			// skips the nominal masses without an isotope
+			if (distribution.getAbundance(i) > 0) {
+				Isotope isotope = { distribution.getMass(i), std::log(distribution.getAbundance(i)) };
+				element.isotopes.push_back(isotope);
+			}
+		}
+		if (element.isotopes.empty()) {
+			// the molecule cannot occur, there are no isotopologues
+			mode_log_abundance = -std::numeric_limits<abundance_type>::infinity();
+			elements.clear();
+			return;
+		}
+		findMode(element);
+		mode_log_abundance += element.mode_log_abundance;
+		elements.push_back(element);
+	}
+}
+
+
+FineStructureCalculator::species_type
+FineStructureCalculator::getSpecies(abundance_type threshold) const {
+	if (!(threshold > 0)) {
+		throw InvalidArgumentException("abundance threshold has to be positive");
+	}
+	configurations_type isotopologues;
+	getIsotopologues(std::log(threshold), isotopologues);
+	std::sort(isotopologues.begin(), isotopologues.end(), Lighter<Configuration>());
+
+	species_type::peaks_container peaks;
+	for (configurations_type::const_iterator it = isotopologues.begin();
+			it != isotopologues.end(); ++it) {
+		peaks.push_back(species_type::peak_type(it->mass, std::exp(it->log_abundance)));
+	}
+	return species_type(peaks);
+}
+
+
+FineStructureCalculator::species_type
+FineStructureCalculator::getSpeciesWithCoverage(abundance_type coverage) const {
+	if (!(coverage > 0 && coverage < 1)) {
+		throw InvalidArgumentException("coverage has to be in (0, 1)");
+	}
+
+	// the isotopologues cannot cover more than the product of the abundance
+	// sums of the elements, which are below one for user-defined elements
+	abundance_type log_total = 0.0;
+	for (std::vector<ElementIsotopes>::const_iterator it = elements.begin();
+			it != elements.end(); ++it) {
+		abundance_type element_sum = 0.0;
+		for (std::vector<Isotope>::const_iterator isotope = it->isotopes.begin();
+				isotope != it->isotopes.end(); ++isotope) {
+			element_sum += std::exp(isotope->log_abundance);
+		}
+		log_total += it->count * std::log(element_sum);
+	}
+	coverage = std::min(coverage, std::exp(log_total));
+
+	// lowers the threshold layer by layer, until the isotopologues above it
+	// cover enough, a layer adds no isotopologues (the sums stay below the
+	// coverage by rounding errors) or the threshold cannot be represented
+	// any more
+	const abundance_type log_factor = std::log(LAYER_THRESHOLD_FACTOR);
+	const abundance_type min_log_threshold = std::log(std::numeric_limits<abundance_type>::min());
+	configurations_type isotopologues;
+	configurations_type::size_type previous_size = 0;
+	abundance_type log_threshold = mode_log_abundance;
+	while (mode_log_abundance > min_log_threshold) {
+		log_threshold += log_factor;
+		isotopologues.clear();
+		getIsotopologues(log_threshold, isotopologues);
+		abundance_type sum = 0.0;
+		for (configurations_type::const_iterator it = isotopologues.begin();
+				it != isotopologues.end(); ++it) {
+			sum += std::exp(it->log_abundance);
+		}
+		if (sum >= coverage || isotopologues.size() == previous_size ||
+				log_threshold < min_log_threshold) {
+			break;
+		}
+		previous_size = isotopologues.size();
+	}
+
+	// keeps the most abundant isotopologues of the last layer reaching the coverage
+	std::sort(isotopologues.begin(), isotopologues.end(), MoreAbundant<Configuration>());
+	abundance_type sum = 0.0;
+	configurations_type::size_type size = 0;
+	while (size < isotopologues.size() && sum < coverage) {
+		sum += std::exp(isotopologues[size++].log_abundance);
+	}
+	isotopologues.resize(size);
+	std::sort(isotopologues.begin(), isotopologues.end(), Lighter<Configuration>());
+
+	species_type::peaks_container peaks;
+	for (configurations_type::const_iterator it = isotopologues.begin();
+			it != isotopologues.end(); ++it) {
+		peaks.push_back(species_type::peak_type(it->mass, std::exp(it->log_abundance)));
+	}
+	return species_type(peaks);
+}
+
+
+FineStructureCalculator::abundance_type
+FineStructureCalculator::getLogAbundance(const ElementIsotopes& element,
+					 const std::vector<unsigned int>& counts) {
+	// multinomial: count! / prod(counts[i]!) * prod(abundance[i]^counts[i])
+	abundance_type log_abundance = element.log_factorial;
+	for (std::vector<unsigned int>::size_type i = 0; i < counts.size(); ++i) {
+		log_abundance += counts[i] * element.isotopes[i].log_abundance - std::lgamma(counts[i] + 1.0);
+	}
+	return log_abundance;
+}
+
+
+void FineStructureCalculator::findMode(ElementIsotopes& element) {
+	typedef std::vector<unsigned int>::size_type index_type;
+	const index_type size = element.isotopes.size();
+
+	// starts with the expected counts rounded down, the remaining atoms
+	// are given to the most abundant isotope
+	std::vector<unsigned int>& counts = element.mode;
+	counts.assign(size, 0);
+	abundance_type sum = 0.0;
+	for (index_type i = 0; i < size; ++i) {
+		sum += std::exp(element.isotopes[i].log_abundance);
+	}
+	unsigned int assigned = 0;
+	index_type most_abundant = 0;
+	for (index_type i = 0; i < size; ++i) {
+		const abundance_type abundance = std::exp(element.isotopes[i].log_abundance) / sum;
+		counts[i] = static_cast<unsigned int>(std::floor(element.count * abundance));
+		if (counts[i] > element.count - assigned) {
+			counts[i] = element.count - assigned;
+		}
+		assigned += counts[i];
+		if (element.isotopes[i].log_abundance > element.isotopes[most_abundant].log_abundance) {
+			most_abundant = i;
+		}
+	}
+	counts[most_abundant] += element.count - assigned;
+
+	// moves single atoms between isotopes as long as the abundance increases,
+	// multinomial distributions are log-concave, so this ends in the mode
+	bool improved = true;
+	while (improved) {
+		improved = false;
+		for (index_type i = 0; i < size; ++i) {
+			for (index_type j = 0; j < size; ++j) {
+				if (i == j || counts[i] == 0) {
+					continue;
+				}
+				const abundance_type change = std::log(static_cast<abundance_type>(counts[i])) -
+					std::log(counts[j] + 1.0) + element.isotopes[j].log_abundance -
+					element.isotopes[i].log_abundance;
+				if (change > 1e-12) {
+					--counts[i];
+					++counts[j];
+					improved = true;
+				}
+			}
+		}
+	}
+	element.mode_log_abundance = getLogAbundance(element, counts);
+}
+
+
+void FineStructureCalculator::getConfigurations(const ElementIsotopes& element,
+		abundance_type log_threshold, configurations_type& configurations) {
+	typedef std::vector<unsigned int> counts_type;
+	typedef counts_type::size_type index_type;
+	const index_type size = element.isotopes.size();
+
+	configurations.clear();
+	if (element.mode_log_abundance < log_threshold) {
+		return;
+	}
+
+	// walks from the mode to the neighbouring configurations (one atom moved
+	// to another isotope) as long as they are above the threshold
+	std::set<counts_type> visited;
+	std::vector< std::pair<counts_type, abundance_type> > pending;
+	visited.insert(element.mode);
+	pending.push_back(std::make_pair(element.mode, element.mode_log_abundance));
+	while (!pending.empty()) {
+		const counts_type counts = pending.back().first;
+		const abundance_type log_abundance = pending.back().second;
+		pending.pop_back();
+
+		Configuration configuration = { 0.0, log_abundance };
+		for (index_type i = 0; i < size; ++i) {
+			configuration.mass += counts[i] * element.isotopes[i].mass;
+		}
+		configurations.push_back(configuration);
+
+		for (index_type i = 0; i < size; ++i) {
+			if (counts[i] == 0) {
+				continue;
+			}
+			for (index_type j = 0; j < size; ++j) {
+				if (i == j) {
+					continue;
+				}
+				counts_type neighbour(counts);
+				--neighbour[i];
+				++neighbour[j];
+				const abundance_type neighbour_log_abundance = getLogAbundance(element, neighbour);
+				if (neighbour_log_abundance >= log_threshold && visited.insert(neighbour).second) {
+					pending.push_back(std::make_pair(neighbour, neighbour_log_abundance));
+				}
+			}
+		}
+	}
+	std::sort(configurations.begin(), configurations.end(), MoreAbundant<Configuration>());
+}
+
+
+namespace {
+
+/**
+ * Combines the configurations of elements @c index and above with the
+ * partial isotopologue given by @c mass and @c log_abundance.
+ */
+template <typename Configuration>
+void combineConfigurations(typename std::vector<Configuration>::size_type index,
+		double mass, double log_abundance, double log_threshold,
+		const std::vector< std::vector<Configuration> >& configurations,
+		const std::vector<double>& remaining_mode_log_abundances,
+		std::vector<Configuration>& isotopologues) {
+	if (index == configurations.size()) {
+		Configuration isotopologue = { mass, log_abundance };
+		isotopologues.push_back(isotopologue);
+		return;
+	}
+	const double remaining = remaining_mode_log_abundances[index+1];
+	const std::vector<Configuration>& element_configurations = configurations[index];
+	for (typename std::vector<Configuration>::const_iterator it = element_configurations.begin();
+			it != element_configurations.end(); ++it) {
+		// configurations are sorted by decreasing abundance, so the
+		// following ones cannot reach the threshold either
+		if (log_abundance + it->log_abundance + remaining < log_threshold) {
+			break;
+		}
+		combineConfigurations(index + 1, mass + it->mass, log_abundance + it->log_abundance,
+				log_threshold, configurations, remaining_mode_log_abundances, isotopologues);
+	}
+}
+
+}
+
+
+void FineStructureCalculator::getIsotopologues(abundance_type log_threshold,
+		configurations_type& isotopologues) const {
+	if (elements.empty() || mode_log_abundance < log_threshold) {
+		return;
+	}
+
+	// an element configuration can only be part of an isotopologue above the
+	// threshold, if it is above it together with the modes of the other elements
+	std::vector<configurations_type> configurations(elements.size());
+	for (std::vector<ElementIsotopes>::size_type i = 0; i < elements.size(); ++i) {
+		getConfigurations(elements[i], log_threshold -
+			(mode_log_abundance - elements[i].mode_log_abundance), configurations[i]);
+	}
+
+	std::vector<abundance_type> remaining_mode_log_abundances(elements.size() + 1, 0.0);
+	for (std::vector<ElementIsotopes>::size_type i = elements.size(); i > 0; --i) {
+		remaining_mode_log_abundances[i-1] = remaining_mode_log_abundances[i] +
+							elements[i-1].mode_log_abundance;
+	}
+
+	combineConfigurations<Configuration>(0, 0.0, 0.0, log_threshold, configurations,
+			remaining_mode_log_abundances, isotopologues);
+}
+
+} // namespace ims
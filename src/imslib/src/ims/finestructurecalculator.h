@@ -0,0 +1,165 @@
+#ifndef IMS_FINE_STRUCTURE_CALCULATOR_H
+#define IMS_FINE_STRUCTURE_CALCULATOR_H
+
+#include <vector>
+#include <ims/composedelement.h>
+#include <ims/isotopespecies.h>
+
+namespace ims {
+
+/**
+ * @brief Calculates the isotopic fine structure of a molecule, i.e. the
+ * abundances of its isotopologues, restricted to the most abundant ones.
+ *
+ * Unlike folding @c IsotopeSpecies with themselves, which expands all
+ * isotopologues and filters them afterwards, isotopologues below an
+ * abundance threshold are never generated:
+ * - the configurations of every element (how many atoms are of which
+ *   isotope) are enumerated from the most abundant configuration
+ *   outwards, moving one atom to another isotope at a time. Configurations
+ *   of multinomial distributions above a threshold are connected this way,
+ *   so the enumeration stops at the threshold.
+ * - configurations of the elements are combined in decreasing order of
+ *   abundance, stopping as soon as the most abundant configurations of
+ *   the remaining elements cannot lift the abundance above the threshold.
+ *
+ * To cover a given share of the total abundance instead, the threshold is
+ * lowered layer by layer until the isotopologues found reach the coverage,
+ * or a layer finds no more isotopologues.
+ * This follows the ordered enumeration of IsoSpec: Lacki et al. "IsoSpec:
+ * Hyperfast Fine Structure Calculator" Anal. Chem. 2017.
+ *
+ * @see IsotopeSpecies
+ * @see IsotopeDistribution
+ *
+ * @ingroup alphabet
+ */
+class FineStructureCalculator {
+	public:
+		/**
+		 * Type of isotopic fine structure.
+		 */
+		typedef IsotopeSpecies species_type;
+
+		/**
+		 * Type of isotope mass.
+		 */
+		typedef species_type::mass_type mass_type;
+
+		/**
+		 * Type of isotope abundance.
+		 */
+		typedef species_type::abundance_type abundance_type;
+
+		/**
+		 * Type of sizes.
+		 */
+		typedef species_type::size_type size_type;
+
+		/**
+		 * Constructor with a @c molecule. The isotopes of its elements are
+		 * taken from their isotope distributions.
+		 */
+		explicit FineStructureCalculator(const ComposedElement& molecule);
+
+		/**
+		 * Gets all isotopologues with an abundance of at least @c threshold,
+		 * sorted by mass.
+		 *
+		 * @param threshold Smallest abundance of an isotopologue, must be positive.
+		 * @return Isotopologues (masses and abundances) sorted by mass.
+		 * @throws InvalidArgumentException if @c threshold is not positive.
+		 */
+		species_type getSpecies(abundance_type threshold) const;
+
+		/**
+		 * Gets the smallest set of the most abundant isotopologues whose
+		 * abundances sum up to at least @c coverage, sorted by mass. If the
+		 * isotope abundances of the elements sum up to less than one, the
+		 * coverage is limited to the total abundance of the isotopologues.
+		 *
+		 * @param coverage Share of the total abundance, in (0, 1).
+		 * @return Isotopologues (masses and abundances) sorted by mass.
+		 * @throws InvalidArgumentException if @c coverage is not in (0, 1).
+		 */
+		species_type getSpeciesWithCoverage(abundance_type coverage) const;
+
+	private:
+		/**
+		 * Isotope of an element.
+		 */
+		struct Isotope {
+			mass_type mass;
+			abundance_type log_abundance;
+		};
+
+		/**
+		 * Element of the molecule with its isotopes and number of atoms.
+		 */
+		struct ElementIsotopes {
+			std::vector<Isotope> isotopes;
+			unsigned int count;
+			/**
+			 * Logarithm of count!, shared by all configurations.
+			 */
+			abundance_type log_factorial;
+			/**
+			 * Most abundant configuration and the logarithm of its abundance.
+			 */
+			std::vector<unsigned int> mode;
+			abundance_type mode_log_abundance;
+		};
+
+		/**
+		 * Configuration of an element (or a molecule): its mass and the
+		 * logarithm of its abundance.
+		 */
+		struct Configuration {
+			mass_type mass;
+			abundance_type log_abundance;
+		};
+
+		typedef std::vector<Configuration> configurations_type;
+
+		/**
+		 * Logarithm of the abundance of the configuration with @c counts
+		 * atoms of each isotope of @c element.
+		 */
+		static abundance_type getLogAbundance(const ElementIsotopes& element,
+						      const std::vector<unsigned int>& counts);
+
+		/**
+		 * Finds the most abundant configuration of @c element.
+		 */
+		static void findMode(ElementIsotopes& element);
+
+		/**
+		 * Collects the configurations of @c element with a logarithm of
+		 * abundance of at least @c log_threshold, in decreasing order of
+		 * abundance.
+		 */
+		static void getConfigurations(const ElementIsotopes& element,
+					      abundance_type log_threshold,
+					      configurations_type& configurations);
+
+		/**
+		 * Collects the isotopologues with a logarithm of abundance of at
+		 * least @c log_threshold.
+		 */
+		void getIsotopologues(abundance_type log_threshold,
+				      configurations_type& isotopologues) const;
+
+		/**
+		 * Elements of the molecule.
+		 */
+		std::vector<ElementIsotopes> elements;
+
+		/**
+		 * Logarithm of the abundance of the most abundant isotopologue.
+		 */
+		abundance_type mode_log_abundance;
+};
+
+} // namespace ims
+
+#endif // IMS_FINE_STRUCTURE_CALCULATOR_H
@@ -5,6 +5,7 @@
  *
  */
 
+#include <algorithm>
 #include <functional>
 #include <numeric>
 #include <iostream>
@@ -13,15 +14,16 @@
 
 namespace ims {
 
-IsotopeDistribution::size_type IsotopeDistribution::SIZE;
+const IsotopeDistribution::size_type IsotopeDistribution::DEFAULT_SIZE;
 
-IsotopeDistribution::abundance_type IsotopeDistribution::ABUNDANCES_SUM_ERROR;
+const IsotopeDistribution::abundance_type IsotopeDistribution::DEFAULT_ABUNDANCES_SUM_ERROR = 0.0001;
 
 /**
  * Constructor with single isotope. It sets isotopes consist of one entry 
  * with given mass and 100% abundance.
  */
-IsotopeDistribution::IsotopeDistribution(mass_type mass): nominalMass(0) {
+IsotopeDistribution::IsotopeDistribution(mass_type mass, const settings_type& settings): 
+		nominalMass(0), settings(settings) {
 	peaks.push_back(peaks_container::value_type(mass, 1.0));
 }
 
@@ -31,6 +33,7 @@ IsotopeDistribution& IsotopeDistribution::operator =(
 	if (this != &distribution) {
 		peaks = distribution.peaks;
 		nominalMass = distribution.nominalMass;
+		settings = distribution.settings;
 	}
 	return *this;
 }
@@ -50,69 +53,104 @@ bool IsotopeDistribution::operator !=(
 }
 
 
+namespace {
+
+/**
+ * Number of peaks folded in buffers on the stack, larger distributions
+ * use buffers on the heap.
+ */
+const IsotopeDistribution::size_type INLINE_FOLDING_SIZE = 16;
+
+}
+
 IsotopeDistribution& IsotopeDistribution::operator *=(
 					const IsotopeDistribution& distribution) {
+	fold(*this, distribution, *this);
+	return *this;
+}
+
+
+IsotopeDistribution& IsotopeDistribution::operator *=(unsigned int power) {
+	if (power > 1) {
+		IsotopeDistribution workspace(nominal_mass_type(0), settings);
+		IsotopeDistribution::power(*this, power, *this, workspace);
+	}
+	return *this;
+}
+
 
-	if (distribution.empty()) {
-		return *this;
-	}
-	if (this->empty()) {
-		return operator =(distribution);
-	}
-	// creates a temporary destination container to store peaks 
-	// (abundances and masses)
-	peaks_container dest(SIZE);
-	// checks if the size of abundances and masses containers coincides with 
-	// the static variable SIZE (meant to be set by client for distribution)
-	setMinimumSize();
-	// creates a non-const equivalent of a const parameter - it's needed to 
-	// get non-const iterators out of it
-	IsotopeDistribution& non_const_distribution = 
-							const_cast<IsotopeDistribution&>(distribution);
-	non_const_distribution.setMinimumSize();
-
-	// sets up different iterators for an efficient folding:
-	// it2_dest - iterator on a destination container,
-	// it2_begin, it2_end - iterators on begin and end of the second 
-	//							source container (function parameter)
-	// it1 - iterator on the first source container
-	// it2 - iterator on the second source container
-	peaks_iterator it2_begin = non_const_distribution.peaks.begin();
-	peaks_iterator it1, it2,
-			it_dest = dest.begin(),
-			it2_end = it2_begin;
-	abundance_type abundances_sum, masses_mult_abundances_sum;
-
-	for (; it_dest != dest.end(); ++it_dest, ++it2_end) {
-
-		abundances_sum = 0;
-		masses_mult_abundances_sum = 0;
-		it1 = peaks.begin();
-		it2 = it2_end;
-
-		for (; it2 != it2_begin; ++it1, --it2) {			
-			abundances_sum += it1->abundance * it2->abundance;
-			masses_mult_abundances_sum += 
-					it1->abundance * it2->abundance * (it1->mass + it2->mass);
+void IsotopeDistribution::fold(const IsotopeDistribution& distribution1,
+		const IsotopeDistribution& distribution2, IsotopeDistribution& result) {
+
+	if (distribution2.empty()) {
+		if (&result != &distribution1) {
+			result.assignPeaks(distribution1);
 		}
-		// adds last element
-		abundances_sum += it1->abundance * it2->abundance;
-		masses_mult_abundances_sum += 
-					it1->abundance * it2->abundance * (it1->mass + it2->mass);
-
-		// assigns results to containers through iterators
-		it_dest->abundance = abundances_sum;
-		it_dest->mass = (abundances_sum != 0) ?
+		return;
+	}
+	if (distribution1.empty()) {
+		// keeps the settings of the result
+		result.assignPeaks(distribution2);
+		return;
+	}
+
+	// missing peaks of both distributions are treated as zero peaks,
+	// peaks beyond the size of the settings do not contribute
+	const size_type size = result.settings.size;
+	const size_type size1 = std::min(distribution1.peaks.size(), size);
+	const size_type size2 = std::min(distribution2.peaks.size(), size);
+
+	// copies the peaks of both distributions into arrays of masses and
+	// abundances (the result may be one of them), which are kept on the
+	// stack for the usual small sizes
+	mass_type inline_buffer[4 * INLINE_FOLDING_SIZE];
+	std::vector<mass_type> heap_buffer;
+	mass_type* buffer = inline_buffer;
+	if (size > INLINE_FOLDING_SIZE) {
+		heap_buffer.resize(4 * size);
+		buffer = &heap_buffer[0];
+	}
+	abundance_type* const abundances1 = buffer;
+	mass_type* const masses1 = buffer + size;
+	abundance_type* const abundances2 = buffer + 2 * size;
+	mass_type* const masses2 = buffer + 3 * size;
+
+	for (size_type j = 0; j < size1; ++j) {
+		abundances1[j] = distribution1.peaks[j].abundance;
+		masses1[j] = distribution1.peaks[j].mass;
+	}
+	for (size_type j = 0; j < size2; ++j) {
+		abundances2[j] = distribution2.peaks[j].abundance;
+		masses2[j] = distribution2.peaks[j].mass;
+	}
+	const nominal_mass_type nominalMass = distribution1.nominalMass + distribution2.nominalMass;
+
+	// peaks are overwritten in place, reusing their memory
+	peaks_container& peaks = result.peaks;
+	peaks.resize(size);
+
+	for (size_type i = 0; i < size; ++i) {
+		// peak i collects all pairs of peaks (j, i-j), the range of j is
+		// clamped to the existing peaks instead of checking every pair
+		const size_type first = (i >= size2) ? i - size2 + 1 : 0;
+		const size_type last = std::min(i + 1, size1);
+
+		abundance_type abundances_sum = 0;
+		mass_type masses_mult_abundances_sum = 0;
+		for (size_type j = first; j < last; ++j) {
+			const abundance_type abundance = abundances1[j] * abundances2[i - j];
+			abundances_sum += abundance;
+			masses_mult_abundances_sum += abundance * (masses1[j] + masses2[i - j]);
+		}
+
+		peaks[i].abundance = abundances_sum;
+		peaks[i].mass = (abundances_sum != 0) ?
 							masses_mult_abundances_sum / abundances_sum : 0;
 	}
 
-	nominalMass += distribution.nominalMass;
-	
-	peaks.swap(dest);
-	
-	this->normalize();
+	result.nominalMass = nominalMass;
 
-	return *this;
+	result.normalize();
 }
 
 /**
@@ -120,54 +158,38 @@ IsotopeDistribution& IsotopeDistribution::operator *=(
  * Russian Multiplication Scheme by this reducing the number of 
  * folding operations. For the sake of performance folding is 
  * implemented iteratively, not recursively.
- * 
- * @return The distribution folded with itself @c power times.
  */
-IsotopeDistribution& IsotopeDistribution::operator *=(unsigned int power) {
+void IsotopeDistribution::power(const IsotopeDistribution& distribution, unsigned int power,
+		IsotopeDistribution& result, IsotopeDistribution& workspace) {
 	if (power <= 1) {
-		return *this;
-	}
-	
-	// folding proceeds a following:
-	// - first, binary representation of power is calculated, i.e. 
-	// power = 138 -----> binary representation = [0, 1, 0, 1, 0, 0, 0, 1]
-	// - then, one loops through array every time folding the copy
-	// of this distribution with itself into lets say this_power_two_index distribution. 
-	// Additionally, if the current index is equal to 1, then result distribution
-	// is folded with the current this_power_two_index distribution.
-	// At the end, the result distribution is outputted.
-	
-	// calculates binary representation of power
-	std::vector<unsigned int> binary;
-	while (power > 0) {
-		binary.push_back(power % 2);
-		power >>= 1;
+		if (&result != &distribution) {
+			result.assignPeaks(distribution);
+		}
+		return;
 	}
-	
-	// initializes distribution which will folded iteratively upto each entry
-	IsotopeDistribution this_power_two_index(*this);
-	
-	// initializes result distribution where foldings will be collected
-	IsotopeDistribution result;
-	
-	// starts folding based on binary representation
-	if (binary[0]) {
-		result = this_power_two_index;
-	}
-		
-	std::vector<unsigned int>::size_type index = 0;
-	while (++index < binary.size()) {
-		// folds distribution with itself iteratively
-		this_power_two_index *= this_power_two_index;
-		
-		if (binary[index]) {
-			// collects distribution in the result
-			result *= this_power_two_index;
+
+	// folding proceeds by the bits of power, from the lowest to the highest one:
+	// the workspace holds the distribution folded with itself 2^index times,
+	// which is collected in the result if bit index of power is set.
+	// E.g. power = 138 = 0b10001010 collects the powers 2, 8 and 128.
+	workspace.settings = result.settings;
+	workspace.assignPeaks(distribution);
+
+	// starts with an empty result, the first collected power is copied into it
+	result.peaks.clear();
+	result.nominalMass = 0;
+
+	while (true) {
+		if (power & 1) {
+			fold(result, workspace, result);
 		}
+		power >>= 1;
+		if (power == 0) {
+			break;
+		}
+		// folds distribution with itself iteratively
+		fold(workspace, workspace, workspace);
 	}
-		
-	return operator=(result);
-		
 }
 
 
@@ -204,7 +226,7 @@ void IsotopeDistribution::normalize() {
 	for (const_peaks_iterator cit = peaks.begin(); cit < peaks.end(); ++cit) {
 		sum += cit->abundance;
 	}
-	if (sum > 0 && std::fabs(sum - 1) > ABUNDANCES_SUM_ERROR) {
+	if (sum > 0 && std::fabs(sum - 1) > settings.abundances_sum_error) {
 		abundance_type scale = 1/sum;
 		for (peaks_iterator it = peaks.begin(); it < peaks.end(); ++it) {
 			it->abundance *= scale;
@@ -213,13 +235,6 @@ void IsotopeDistribution::normalize() {
 }
 
 
-void IsotopeDistribution::setMinimumSize() {
-	if (peaks.size() < SIZE) {
-		peaks.resize(SIZE);
-	}
-}
-
-
 std::ostream& operator <<(std::ostream& os, 
 							const IsotopeDistribution& distribution) {
 	for (IsotopeDistribution::size_type i = 0; i < distribution.size(); ++i) {
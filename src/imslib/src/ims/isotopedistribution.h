@@ -30,8 +30,8 @@ namespace ims {
  * 		(20.00831; 0.036 %)
  * 
  * To the sake of faster computations distribution is restricted 
- * to the first K elements, where K can be set by adjusting size 
- * @c SIZE of distribution. @note For the elements most abundant in
+ * to the first K elements, where K is given by the @c Settings of the
+ * distribution. @note For the elements most abundant in
  * living beings (CHNOPS) this restriction is negligible, since abundances
  * decrease dramatically in isotopes order and are usually of no interest
  * starting from +10 isotope.
@@ -42,6 +42,11 @@ namespace ims {
  * 
  * Folding with itself is done using Russian Multiplication Scheme.
  * 
+ * Every distribution carries its own @c Settings, which are used when it
+ * is folded and copied to the distributions derived from it. There is no
+ * shared mutable state, so distributions with different settings can be
+ * folded concurrently in different threads.
+ * 
  * @author Anton Pervukhin <Anton.Pervukhin@CeBiTec.Uni-Bielefeld.DE>  
  */
 class IsotopeDistribution {
@@ -130,40 +135,72 @@ class IsotopeDistribution {
 		typedef abundances_container::const_iterator const_abundances_iterator;
 
 		/**
-		 * Error to be allowed for isotope distribution.
+		 * Default length of isotope distribution.
 		 */
-		static abundance_type ABUNDANCES_SUM_ERROR;
-		
+		static const size_type DEFAULT_SIZE = 10;
+
 		/**
-		 * Length of isotope distribution.
+		 * Default error to be allowed for the sum of abundances.
 		 */
-		static size_type SIZE;
+		static const abundance_type DEFAULT_ABUNDANCES_SUM_ERROR;
+
+		/**
+		 * Settings used for folding and normalizing a distribution.
+		 */
+		struct Settings {
+			Settings(size_type size = DEFAULT_SIZE, 
+				abundance_type abundances_sum_error = DEFAULT_ABUNDANCES_SUM_ERROR) :
+						size(size), abundances_sum_error(abundances_sum_error) { }
+			bool operator ==(const Settings& settings) const {
+				return (settings.size == size && 
+						settings.abundances_sum_error == abundances_sum_error);
+			}
+			/**
+			 * Length of isotope distribution.
+			 */
+			size_type size;
+			/**
+			 * Error to be allowed for the sum of abundances.
+			 */
+			abundance_type abundances_sum_error;
+		};
+
+		/**
+		 * Type of distribution settings.
+		 */
+		typedef Settings settings_type;
 
 		/**
 		 * Constructor with nominal mass.
 		 */
-		IsotopeDistribution(nominal_mass_type nominalMass = 0) :
-					nominalMass(nominalMass) {}
+		IsotopeDistribution(nominal_mass_type nominalMass = 0,
+				    const settings_type& settings = settings_type()) :
+					nominalMass(nominalMass),
+					settings(settings) {}
 
 		/**
 		 * Constructor with single isotope.
 		 */
-		IsotopeDistribution(mass_type mass);
+		IsotopeDistribution(mass_type mass, 
+				    const settings_type& settings = settings_type());
 
 		/**
 		 * Constructor with isotopes and nominal mass.
 		 */
 		IsotopeDistribution(const peaks_container& peaks,
-				    nominal_mass_type nominalMass = 0) :
+				    nominal_mass_type nominalMass = 0,
+				    const settings_type& settings = settings_type()) :
 					peaks(peaks),
-					nominalMass(nominalMass) {}
+					nominalMass(nominalMass),
+					settings(settings) {}
 
 		/**
 		 * Copy constructor.
 		 */
 		IsotopeDistribution(const IsotopeDistribution& distribution) :
 					peaks(distribution.peaks),
-					nominalMass(distribution.nominalMass) {}
+					nominalMass(distribution.nominalMass),
+					settings(distribution.settings) {}
 
 		/**
 		 * Destructor.
@@ -171,12 +208,27 @@ class IsotopeDistribution {
 		~IsotopeDistribution() {}
 
 		/**
-		 * Gets size of isotope distribution. @note Size is not smaller than
-		 * predefined @c SIZE.
+		 * Gets size of isotope distribution. @note Size is not larger than
+		 * the size given by the settings.
 		 * 
 		 * @return Size of isotope distribution.
 		 */
-		size_type size() const { return std::min(peaks.size(), SIZE); }
+		size_type size() const { return std::min(peaks.size(), settings.size); }
+
+		/**
+		 * Gets settings of the distribution.
+		 * 
+		 * @return Settings of the distribution.
+		 */
+		const settings_type& getSettings() const { return settings; }
+
+		/**
+		 * Sets settings of the distribution, they take effect with the next
+		 * folding.
+		 * 
+		 * @param settings New settings of the distribution.
+		 */
+		void setSettings(const settings_type& settings) { this->settings = settings; }
 
 		/**
 		 * Assignment operator.
@@ -208,7 +260,7 @@ class IsotopeDistribution {
 		/**
 		 * Operator for folding this distributoin with a given @c distribution.
 		 * @note Operator is unary, so result is stored in this 
-		 * object itself.
+		 * object itself. The settings of this distribution are used.
 		 * 
 		 * @param distribution Distribution to be folded with this one.
 		 * @return Reference to this object.
@@ -230,6 +282,39 @@ class IsotopeDistribution {
 		 */
 		IsotopeDistribution& operator *=(unsigned int pow);
 
+		/**
+		 * Folds @c distribution1 with @c distribution2 and stores the result
+		 * in @c result, using the settings of @c result. The inputs are not
+		 * modified, @c result may be one of them. No memory is allocated
+		 * once the peaks of @c result have grown to the size of the settings.
+		 * 
+		 * @param distribution1 First distribution to be folded.
+		 * @param distribution2 Second distribution to be folded.
+		 * @param result Distribution to store the result in.
+		 * 
+		 * @see IsotopeDistribution& operator *=(const IsotopeDistribution&)
+		 */
+		static void fold(const IsotopeDistribution& distribution1,
+				 const IsotopeDistribution& distribution2,
+				 IsotopeDistribution& result);
+
+		/**
+		 * Folds @c distribution with itself @c pow times and stores the result
+		 * in @c result, using the settings of @c result. The intermediate
+		 * powers are kept in @c workspace, so that repeated calls with the
+		 * same @c result and @c workspace allocate no memory. @c result may
+		 * be @c distribution, @c workspace has to be another distribution.
+		 * 
+		 * @param distribution Distribution to be folded with itself.
+		 * @param pow Number of times the distribution is folded with itself.
+		 * @param result Distribution to store the result in.
+		 * @param workspace Distribution to store intermediate results in.
+		 * 
+		 * @see IsotopeDistribution& operator *=(unsigned int)
+		 */
+		static void power(const IsotopeDistribution& distribution, unsigned int pow,
+				  IsotopeDistribution& result, IsotopeDistribution& workspace);
+
 		/**
 		 * Gets a mass of isotope @c i.
 		 * 
@@ -287,7 +372,7 @@ class IsotopeDistribution {
 		/**
 		 * Normalizes distribution, 
 		 * i.e. scaling abundances to be summed up to 1 with an error 
-		 * @c ABUNDANCES_SUM_ERROR allowed.
+		 * given by the settings allowed.
 		 */
 		void normalize();
 
@@ -299,6 +384,15 @@ class IsotopeDistribution {
 		bool empty() const { return peaks.empty(); }
 				
 	private:
+		/**
+		 * Sets peaks and nominal mass to the ones of @c distribution,
+		 * keeping the settings of this distribution.
+		 */
+		void assignPeaks(const IsotopeDistribution& distribution) {
+			peaks = distribution.peaks;
+			nominalMass = distribution.nominalMass;
+		}
+
 		/**
 		 * Container for isotopes.
 		 */
@@ -310,9 +404,9 @@ class IsotopeDistribution {
 		nominal_mass_type nominalMass;
 
 		/**
-		 * Sets peaks/isotopes container minimum size.
+		 * Settings of distribution.
 		 */
-		void setMinimumSize();
+		settings_type settings;
 };
 
 /**
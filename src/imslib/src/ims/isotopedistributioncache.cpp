@@ -0,0 +1,47 @@
+/**
+ * isotopedistributioncache.cpp
+ */
+#include <ims/isotopedistributioncache.h>
+
+namespace ims {
+
+const IsotopeDistributionCache::size_type IsotopeDistributionCache::DEFAULT_CAPACITY;
+
+IsotopeDistributionCache::distribution_pointer
+IsotopeDistributionCache::getPower(const Element& element, unsigned int count,
+				const settings_type& settings) {
+	const distribution_type& element_distribution = element.getIsotopeDistribution();
+	key_type key(element.getName(), count, settings.size, settings.abundances_sum_error);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		Entry* entry = cache.find(key);
+		if (entry != 0 && entry->element_distribution == element_distribution) {
+			return entry->power;
+		}
+	}
+
+	// folds outside of the lock, concurrent misses of the same power
+	// compute it twice, but give the same result
+	std::shared_ptr<distribution_type> power(
+			new distribution_type(distribution_type::nominal_mass_type(0), settings));
+	distribution_type workspace(distribution_type::nominal_mass_type(0), settings);
+	distribution_type::power(element_distribution, count, *power, workspace);
+	Entry entry = { element_distribution, power };
+
+	std::lock_guard<std::mutex> lock(mutex);
+	return cache.insert(key, entry).power;
+}
+
+
+void IsotopeDistributionCache::clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+	cache.clear();
+}
+
+
+IsotopeDistributionCache::size_type IsotopeDistributionCache::size() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return cache.size();
+}
+
+} // namespace ims
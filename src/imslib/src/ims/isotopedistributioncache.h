@@ -0,0 +1,118 @@
+#ifndef IMS_ISOTOPE_DISTRIBUTION_CACHE_H
+#define IMS_ISOTOPE_DISTRIBUTION_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <ims/element.h>
+#include <ims/isotopedistribution.h>
+#include <ims/utils/lrucache.h>
+
+namespace ims {
+
+/**
+ * @brief Bounded memo table of isotope distributions of elements folded
+ * with themselves.
+ *
+ * Candidate molecules of one mass mostly share the same element abundances
+ * (C30, H50, ...), so the powers of element distributions computed by the
+ * Russian Multiplication Scheme are cached here, keyed by element name,
+ * count and settings. Folding the isotope distribution of a molecule then
+ * takes one folding per element.
+ *
+ * The cache is bounded, the least recently used powers are evicted. It is
+ * safe to use a cache from several threads, the foldings are done outside
+ * of the lock.
+ *
+ * @see ComposedElement::updateIsotopeDistribution(const isotopes_type::settings_type&, IsotopeDistributionCache&)
+ *
+ * @ingroup alphabet
+ */
+class IsotopeDistributionCache {
+	public:
+		/**
+		 * Type of isotope distribution.
+		 */
+		typedef IsotopeDistribution distribution_type;
+
+		/**
+		 * Type of shared pointer to a cached distribution.
+		 */
+		typedef std::shared_ptr<const distribution_type> distribution_pointer;
+
+		/**
+		 * Type of distribution settings.
+		 */
+		typedef distribution_type::settings_type settings_type;
+
+		/**
+		 * Type of cache size.
+		 */
+		typedef std::size_t size_type;
+
+		/**
+		 * Default maximal number of cached distributions.
+		 */
+		static const size_type DEFAULT_CAPACITY = 4096;
+
+		/**
+		 * Constructor with the maximal number of cached distributions.
+		 */
+		explicit IsotopeDistributionCache(size_type capacity = DEFAULT_CAPACITY) :
+					cache(capacity) {}
+
+		/**
+		 * Gets the isotope distribution of @c element folded with itself
+		 * @c count times using @c settings, computing and caching it if it
+		 * is not cached yet.
+		 *
+		 * @param element Element whose distribution is folded.
+		 * @param count Number of times the distribution is folded with itself.
+		 * @param settings Settings for folding.
+		 * @return Folded distribution.
+		 */
+		distribution_pointer getPower(const Element& element, unsigned int count,
+						const settings_type& settings);
+
+		/**
+		 * Removes all cached distributions.
+		 */
+		void clear();
+
+		/**
+		 * Returns the number of cached distributions.
+		 */
+		size_type size();
+
+	private:
+		/**
+		 * Type of keys: element name, count and settings.
+		 */
+		typedef std::tuple<std::string, unsigned int, size_type,
+					distribution_type::abundance_type> key_type;
+
+		/**
+		 * Cached power together with the distribution of the element it
+		 * was folded from. Elements are identified by name, the distribution
+		 * is compared to tell elements of different alphabets apart.
+		 */
+		struct Entry {
+			distribution_type element_distribution;
+			distribution_pointer power;
+		};
+
+		/**
+		 * Guards the cache.
+		 */
+		std::mutex mutex;
+
+		/**
+		 * Cached powers, least recently used evicted first.
+		 */
+		LRUCache<key_type, Entry> cache;
+};
+
+} // namespace ims
+
+#endif // IMS_ISOTOPE_DISTRIBUTION_CACHE_H
@@ -0,0 +1,77 @@
+/**
+ * isotopedistributionfolder.cpp
+ */
+#include <ims/isotopedistributionfolder.h>
+#include <ims/isotopedistributioncache.h>
+
+namespace ims {
+
+IsotopeDistributionFolder::IsotopeDistributionFolder(const Alphabet& alphabet,
+		const settings_type& settings, IsotopeDistributionCache* cache) :
+			alphabet(&alphabet), settings(settings), cache(cache), powers(alphabet.size()),
+			folded(alphabet.size() + 1, distribution_type(distribution_type::nominal_mass_type(0), settings)),
+			counts(alphabet.size(), 0), valid_from(alphabet.size()),
+			result(distribution_type::nominal_mass_type(0), settings), foldings(0) {}
+
+
+const IsotopeDistributionFolder::distribution_type&
+IsotopeDistributionFolder::fold(const decomposition_type& decomposition) {
+	const size_type size = counts.size();
+	if (size == 0) {
+		return result;
+	}
+
+	// finds the distribution of the heavier elements, whose counts did not change
+	size_type index = size;
+	while (index > valid_from && index > 1 &&
+			counts[index-1] == ((index-1 < decomposition.size()) ? decomposition[index-1] : 0)) {
+		--index;
+	}
+
+	// folds the lighter elements on top of it, except for the lightest one
+	// whose count differs between neighbouring decompositions most of the time
+	for (; index > 1; --index) {
+		const unsigned int count = (index-1 < decomposition.size()) ? decomposition[index-1] : 0;
+		foldElement(folded[index], index-1, count, folded[index-1]);
+		counts[index-1] = count;
+	}
+	valid_from = 1;
+
+	foldElement(folded[1], 0, decomposition.empty() ? 0 : decomposition[0], result);
+	return result;
+}
+
+
+void IsotopeDistributionFolder::foldElement(const distribution_type& distribution,
+		size_type index, unsigned int count, distribution_type& result) {
+	if (count == 0) {
+		result = distribution;
+		return;
+	}
+	++foldings;
+	const Element& element = alphabet->getElement(index);
+	if (count == 1) {
+		distribution_type::fold(distribution, element.getIsotopeDistribution(), result);
+		return;
+	}
+	std::vector< std::shared_ptr<const distribution_type> >& element_powers = powers[index];
+	if (count >= element_powers.size()) {
+		element_powers.resize(count + 1);
+	}
+	std::shared_ptr<const distribution_type>& power = element_powers[count];
+	if (!power) {
+		if (cache != 0) {
+			power = cache->getPower(element, count, settings);
+		} else {
+			std::shared_ptr<distribution_type> element_power(
+					new distribution_type(distribution_type::nominal_mass_type(0), settings));
+			distribution_type workspace(distribution_type::nominal_mass_type(0), settings);
+			distribution_type::power(element.getIsotopeDistribution(), count,
+						*element_power, workspace);
+			power = element_power;
+		}
+	}
+	distribution_type::fold(distribution, *power, result);
+}
+
+} // namespace ims
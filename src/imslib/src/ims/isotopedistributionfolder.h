@@ -0,0 +1,139 @@
+#ifndef IMS_ISOTOPE_DISTRIBUTION_FOLDER_H
+#define IMS_ISOTOPE_DISTRIBUTION_FOLDER_H
+
+#include <vector>
+#include <memory>
+#include <ims/alphabet.h>
+#include <ims/isotopedistribution.h>
+
+namespace ims {
+
+class IsotopeDistributionCache;
+
+/**
+ * @brief Folds isotope distributions of decompositions visited one after
+ * another, reusing the foldings of elements whose counts did not change.
+ *
+ * Mass decomposers fix the counts of alphabet elements from the heaviest
+ * element down to the lightest one, hence decompositions visited one after
+ * another share the counts of their heavier elements. For every index @c k
+ * the folder keeps the distribution of the elements with index @c k and
+ * above, so that a decomposition differing from the previous one only in
+ * the count of the lightest element is folded with a single folding.
+ * Decompositions may be given in any order, but the more heavier counts
+ * they share with their predecessor, the less foldings are needed.
+ *
+ * The folder is not thread-safe, every thread (or copy of a visitor)
+ * needs its own one. The powers of element distributions can be shared
+ * between threads by an @c IsotopeDistributionCache though.
+ *
+ * @see ComposedElement::updateIsotopeDistribution(const isotopes_type::settings_type&)
+ *
+ * @ingroup alphabet
+ */
+class IsotopeDistributionFolder {
+	public:
+		/**
+		 * Type of isotope distribution.
+		 */
+		typedef IsotopeDistribution distribution_type;
+
+		/**
+		 * Type of distribution settings.
+		 */
+		typedef distribution_type::settings_type settings_type;
+
+		/**
+		 * Type of decomposition, the counts of the alphabet elements.
+		 */
+		typedef std::vector<unsigned int> decomposition_type;
+
+		/**
+		 * Type of alphabet indices.
+		 */
+		typedef decomposition_type::size_type size_type;
+
+		/**
+		 * Constructor with an @c alphabet whose elements are counted by
+		 * decompositions, the @c settings to fold with and an optional
+		 * @c cache of element distributions folded with themselves. The
+		 * alphabet and the cache have to outlive the folder.
+		 */
+		IsotopeDistributionFolder(const Alphabet& alphabet, const settings_type& settings,
+					IsotopeDistributionCache* cache = 0);
+
+		/**
+		 * Gets the isotope distribution of the molecule given by
+		 * @c decomposition, the counts of the alphabet elements.
+		 *
+		 * @param decomposition Counts of the alphabet elements.
+		 * @return Isotope distribution of the decomposition, valid until
+		 * the next call.
+		 */
+		const distribution_type& fold(const decomposition_type& decomposition);
+
+		/**
+		 * Gets the number of foldings done since construction.
+		 */
+		unsigned long getNumberOfFoldings() const { return foldings; }
+
+	private:
+		/**
+		 * Folds @c distribution with the distribution of element @c index
+		 * folded with itself @c count times into @c result.
+		 */
+		void foldElement(const distribution_type& distribution, size_type index,
+				 unsigned int count, distribution_type& result);
+
+		/**
+		 * Alphabet whose elements are counted by decompositions.
+		 */
+		const Alphabet* alphabet;
+
+		/**
+		 * Settings to fold with.
+		 */
+		settings_type settings;
+
+		/**
+		 * Cache of element distributions folded with themselves or 0.
+		 */
+		IsotopeDistributionCache* cache;
+
+		/**
+		 * Powers of element distributions by element index and count, taken
+		 * from (or put into) @c cache once and looked up here afterwards
+		 * without locking.
+		 */
+		std::vector< std::vector< std::shared_ptr<const distribution_type> > > powers;
+
+		/**
+		 * Distribution of the elements with index @c k and above, folded
+		 * with the counts in @c counts, valid for @c k >= @c valid_from.
+		 */
+		std::vector<distribution_type> folded;
+
+		/**
+		 * Counts the distributions in @c folded were folded with.
+		 */
+		decomposition_type counts;
+
+		/**
+		 * Smallest index of valid distributions in @c folded.
+		 */
+		size_type valid_from;
+
+		/**
+		 * Distribution of the last decomposition.
+		 */
+		distribution_type result;
+
+		/**
+		 * Number of foldings done.
+		 */
+		unsigned long foldings;
+};
+
+} // namespace ims
+
+#endif // IMS_ISOTOPE_DISTRIBUTION_FOLDER_H
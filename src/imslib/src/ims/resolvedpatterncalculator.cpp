@@ -0,0 +1,176 @@
+/**
+ * resolvedpatterncalculator.cpp
+ */
+#include <cmath>
+#include <algorithm>
+#include <ims/resolvedpatterncalculator.h>
+#include <ims/base/exception/invalidargumentexception.h>
+
+namespace ims {
+
+namespace {
+
+struct Lighter {
+	bool operator()(const IsotopeSpecies::peak_type& left,
+			const IsotopeSpecies::peak_type& right) const {
+		return left.mass < right.mass;
+	}
+};
+
+}
+
+
+ResolvingPower::ResolvingPower(double resolving_power, mass_type reference_mass,
+				scaling_type scaling) :
+			resolving_power(resolving_power), reference_mass(reference_mass),
+			scaling(scaling) {
+	if (!(resolving_power > 0)) {
+		throw InvalidArgumentException("resolving power has to be positive");
+	}
+	if (!(reference_mass > 0)) {
+		throw InvalidArgumentException("reference mass has to be positive");
+	}
+}
+
+
+ResolvingPower::mass_type ResolvingPower::getPeakWidth(mass_type mass) const {
+	if (mass <= 0) {
+		return 0.0;
+	}
+	// FWHM = m / R(m) with R(m) = R(m0) * (m0 / m)^k
+	switch (scaling) {
+		case ORBITRAP:
+			return mass * std::sqrt(mass / reference_mass) / resolving_power;
+		case FT_ICR:
+			return mass * mass / (reference_mass * resolving_power);
+		case CONSTANT:
+		default:
+			return mass / resolving_power;
+	}
+}
+
+
+const ResolvedPatternCalculator::abundance_type
+ResolvedPatternCalculator::DEFAULT_MIN_ABUNDANCE = 1.0e-9;
+
+
+ResolvedPatternCalculator::ResolvedPatternCalculator(const ResolvingPower& resolving_power,
+		size_type max_nominal_masses, abundance_type min_abundance) :
+			resolving_power(resolving_power), max_nominal_masses(max_nominal_masses),
+			min_abundance(min_abundance) {}
+
+
+ResolvedPatternCalculator::pattern_type
+ResolvedPatternCalculator::getPattern(const ComposedElement& molecule) const {
+	Peaks pattern, folded;
+	pattern.peaks.push_back(peak_type(0.0, 1.0));
+	pattern.monoisotopic_mass = 0.0;
+
+	const ComposedElement::container& elements = molecule.getElements();
+	for (ComposedElement::container::const_iterator it = elements.begin();
+			it != elements.end(); ++it) {
+		if (it->second > 0) {
+			fold(pattern, *getPower(it->first, it->second), folded);
+			std::swap(pattern, folded);
+		}
+	}
+	return pattern_type(pattern.peaks);
+}
+
+
+std::shared_ptr<const ResolvedPatternCalculator::Peaks>
+ResolvedPatternCalculator::getPower(const Element& element, unsigned int count) const {
+	const IsotopeDistribution& distribution = element.getIsotopeDistribution();
+	const std::pair<std::string, unsigned int> key(element.getName(), count);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::map<std::pair<std::string, unsigned int>, Power>::const_iterator it = powers.find(key);
+		if (it != powers.end() && it->second.element_distribution == distribution) {
+			return it->second.peaks;
+		}
+	}
+
+	Peaks base;
+	for (IsotopeDistribution::size_type i = 0; i < distribution.size(); ++i) {
+		if (distribution.getAbundance(i) > 0) {
+			base.peaks.push_back(peak_type(distribution.getMass(i), distribution.getAbundance(i)));
+		}
+	}
+	base.monoisotopic_mass = base.peaks.empty() ? 0.0 : base.peaks.front().mass;
+
+	// folds by squaring, merging peaks after every folding
+	Peaks result, folded;
+	result.peaks.push_back(peak_type(0.0, 1.0));
+	result.monoisotopic_mass = 0.0;
+	while (count > 0) {
+		if (count & 1) {
+			fold(result, base, folded);
+			std::swap(result, folded);
+		}
+		count >>= 1;
+		if (count > 0) {
+			fold(base, base, folded);
+			std::swap(base, folded);
+		}
+	}
+
+	// folds outside of the lock, concurrent misses of the same power
+	// compute it twice, but give the same result
+	Power power = { distribution, std::make_shared<const Peaks>(std::move(result)) };
+	std::lock_guard<std::mutex> lock(mutex);
+	powers[key] = power;
+	return power.peaks;
+}
+
+
+void ResolvedPatternCalculator::fold(const Peaks& left, const Peaks& right, Peaks& result) const {
+	result.monoisotopic_mass = left.monoisotopic_mass + right.monoisotopic_mass;
+	peaks_container& peaks = result.peaks;
+	peaks.clear();
+	peaks.reserve(left.peaks.size() * right.peaks.size());
+	for (peaks_container::const_iterator l = left.peaks.begin(); l != left.peaks.end(); ++l) {
+		for (peaks_container::const_iterator r = right.peaks.begin(); r != right.peaks.end(); ++r) {
+			peaks.push_back(peak_type(l->mass + r->mass, l->abundance * r->abundance));
+		}
+	}
+	std::sort(peaks.begin(), peaks.end(), Lighter());
+	merge(peaks);
+
+	// drops peaks after merging, so that many small unresolved
+	// isotopologues still add up to a peak
+	const mass_type max_mass = result.monoisotopic_mass + max_nominal_masses - 0.5;
+	peaks_container::size_type size = 0;
+	for (peaks_container::size_type i = 0; i < peaks.size(); ++i) {
+		if (peaks[i].abundance >= min_abundance && peaks[i].mass < max_mass) {
+			peaks[size++] = peaks[i];
+		}
+	}
+	peaks.resize(size);
+}
+
+
+void ResolvedPatternCalculator::merge(peaks_container& peaks) const {
+	if (peaks.empty()) {
+		return;
+	}
+	// merges peaks into the centroid before as long as they are closer
+	// to it than the peak width
+	peaks_container::size_type size = 1;
+	for (peaks_container::size_type i = 1; i < peaks.size(); ++i) {
+		peak_type& centroid = peaks[size-1];
+		const peak_type& peak = peaks[i];
+		if (peak.mass - centroid.mass < resolving_power.getPeakWidth(centroid.mass)) {
+			const abundance_type abundance = centroid.abundance + peak.abundance;
+			if (abundance > 0) {
+				centroid.mass = (centroid.mass * centroid.abundance +
+						peak.mass * peak.abundance) / abundance;
+			}
+			centroid.abundance = abundance;
+		} else {
+			peaks[size++] = peak;
+		}
+	}
+	peaks.resize(size);
+}
+
+} // namespace ims
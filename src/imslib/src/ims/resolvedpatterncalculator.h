@@ -0,0 +1,162 @@
+#ifndef IMS_RESOLVED_PATTERN_CALCULATOR_H
+#define IMS_RESOLVED_PATTERN_CALCULATOR_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ims/composedelement.h>
+#include <ims/isotopespecies.h>
+
+namespace ims {
+
+/**
+ * @brief Resolving power of a mass spectrometer, depending on the mass.
+ *
+ * The resolving power @c R(m) = @c m / @c FWHM(m) is given at a reference
+ * mass and scales with the mass as the analyzer does:
+ * - @c CONSTANT: the same resolving power at all masses (TOF),
+ * - @c ORBITRAP: @c R(m) proportional to 1 / sqrt(m),
+ * - @c FT_ICR: @c R(m) proportional to 1 / m.
+ *
+ * @ingroup alphabet
+ */
+class ResolvingPower {
+	public:
+		typedef IsotopeSpecies::mass_type mass_type;
+
+		/**
+		 * Type of scaling of the resolving power with the mass.
+		 */
+		enum scaling_type { CONSTANT, ORBITRAP, FT_ICR };
+
+		/**
+		 * Constructor with the @c resolving_power at @c reference_mass and
+		 * its @c scaling.
+		 *
+		 * @throws InvalidArgumentException if the resolving power or the
+		 * reference mass are not positive.
+		 */
+		ResolvingPower(double resolving_power, mass_type reference_mass = 200.0,
+				scaling_type scaling = CONSTANT);
+
+		/**
+		 * Gets the full width at half maximum of a peak at @c mass. Peaks
+		 * closer than this width are not resolved. The width increases with
+		 * the mass for all scalings.
+		 */
+		mass_type getPeakWidth(mass_type mass) const;
+
+	private:
+		double resolving_power;
+		mass_type reference_mass;
+		scaling_type scaling;
+};
+
+
+/**
+ * @brief Calculates isotope patterns as seen by a mass spectrometer of a
+ * given resolving power.
+ *
+ * Unlike @c IsotopeDistribution, which sums up all isotopologues of the
+ * same nominal mass, isotopologues are only merged into centroids
+ * (abundance-weighted mean masses) if they are not resolved, hence there
+ * may be several peaks per nominal mass.
+ *
+ * The pattern is folded from the element distributions as usual, but
+ * peaks are merged after every folding. As peak widths increase with the
+ * mass, peaks unresolved in a part of the molecule stay unresolved in the
+ * whole molecule, so the full fine structure is never generated. Peaks
+ * beyond the given number of nominal masses or less abundant than a
+ * threshold are dropped after every folding as well.
+ *
+ * Element distributions folded with themselves are kept by the calculator
+ * and shared by all calls. As in @c IsotopeDistributionCache, they are
+ * looked up under a lock and folded outside of it, so one calculator can
+ * be used from several threads, e.g. by the workers scoring candidates.
+ *
+ * @see FineStructureCalculator
+ *
+ * @ingroup alphabet
+ */
+class ResolvedPatternCalculator {
+	public:
+		typedef IsotopeSpecies pattern_type;
+		typedef pattern_type::mass_type mass_type;
+		typedef pattern_type::abundance_type abundance_type;
+		typedef pattern_type::peak_type peak_type;
+		typedef pattern_type::peaks_container peaks_container;
+		typedef pattern_type::size_type size_type;
+
+		/**
+		 * Default smallest abundance of peaks.
+		 */
+		static const abundance_type DEFAULT_MIN_ABUNDANCE;
+
+		/**
+		 * Constructor with the @c resolving_power, the number of nominal
+		 * masses (starting with the monoisotopic one) to calculate peaks
+		 * for and the smallest abundance of peaks.
+		 */
+		ResolvedPatternCalculator(const ResolvingPower& resolving_power,
+				size_type max_nominal_masses,
+				abundance_type min_abundance = DEFAULT_MIN_ABUNDANCE);
+
+		/**
+		 * Gets the pattern of @c molecule: centroids of unresolved
+		 * isotopologues with their absolute abundances, sorted by mass.
+		 */
+		pattern_type getPattern(const ComposedElement& molecule) const;
+
+	private:
+		/**
+		 * Peaks of a distribution and its monoisotopic mass.
+		 */
+		struct Peaks {
+			peaks_container peaks;
+			mass_type monoisotopic_mass;
+		};
+
+		/**
+		 * Element distribution folded with itself and the distribution
+		 * it was folded from.
+		 */
+		struct Power {
+			IsotopeDistribution element_distribution;
+			std::shared_ptr<const Peaks> peaks;
+		};
+
+		/**
+		 * Gets the peaks of @c element folded with itself @c count times.
+		 * The peaks are shared with the kept ones and stay valid even if
+		 * another thread replaces them.
+		 */
+		std::shared_ptr<const Peaks> getPower(const Element& element, unsigned int count) const;
+
+		/**
+		 * Folds @c left with @c right into @c result, merging unresolved
+		 * peaks and dropping the ones out of range.
+		 */
+		void fold(const Peaks& left, const Peaks& right, Peaks& result) const;
+
+		/**
+		 * Merges unresolved neighbouring peaks of @c peaks sorted by mass.
+		 */
+		void merge(peaks_container& peaks) const;
+
+		ResolvingPower resolving_power;
+		size_type max_nominal_masses;
+		abundance_type min_abundance;
+
+		/**
+		 * Element distributions folded with themselves, by element name
+		 * and count, guarded by @c mutex.
+		 */
+		mutable std::map<std::pair<std::string, unsigned int>, Power> powers;
+		mutable std::mutex mutex;
+};
+
+} // namespace ims
+
+#endif // IMS_RESOLVED_PATTERN_CALCULATOR_H
@@ -0,0 +1,93 @@
+#ifndef IMS_ERFC_H
+#define IMS_ERFC_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+namespace ims {
+
+/**
+ * Returns exp(@c y) for -708 <= @c y <= 0 without branches, so that loops
+ * calling it can be vectorized by the compiler. The relative error is
+ * below 1e-11. Beyond -708 exp() becomes subnormal and the result is
+ * undefined.
+ *
+ * @param y A number in [-708, 0].
+ * @return exp(@c y).
+ */
+inline double fastExpNonPositive(double y) {
+	const double log2e = 1.4426950408889634;
+	const double ln2_hi = 6.93147180369123816490e-01;
+	const double ln2_lo = 1.90821492927058770002e-10;
+	// adding 1.5 * 2^52 rounds to an integer kept in the low mantissa bits
+	const double shifter = 6755399441055744.0;
+
+	const double shifted = y * log2e + shifter;
+	const double k = shifted - shifter;
+	uint64_t k_bits;
+	std::memcpy(&k_bits, &shifted, sizeof(k_bits));
+
+	// exp(y) = 2^k * exp(r) with |r| <= ln(2) / 2
+	const double r = y - k * ln2_hi - k * ln2_lo;
+	const double p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 +
+			r * (1.0 / 120 + r * (1.0 / 720 + r * (1.0 / 5040 + r * (1.0 / 40320 +
+			r * (1.0 / 362880)))))))));
+
+	// 2^k, built from the exponent bits
+	const uint64_t scale_bits = (k_bits + 1023) << 52;
+	double scale;
+	std::memcpy(&scale, &scale_bits, sizeof(scale));
+	return p * scale;
+}
+
+
+/**
+ * Returns an approximation of the complementary error function erfc(@c z)
+ * for @c z >= 0 with a relative error below 1.2e-7, using the Chebyshev
+ * fit of Press et al., Numerical Recipes in C, 2nd ed., section 6.2.
+ * There are no branches, so that loops calling it can be vectorized.
+ * Beyond @c z = 26.5, where erfc(@c z) < 3e-307, erfc(26.5) is returned.
+ *
+ * Use erfc() from the standard library where results have to be exact.
+ *
+ * @param z A non-negative number.
+ * @return An approximation of erfc(@c z).
+ */
+inline double fastErfc(double z) {
+	// a constant bound would let the compiler branch to a constant result
+	const double clamped = std::min(z, std::copysign(26.5, z));
+	const double t = 1.0 / (1.0 + 0.5 * clamped);
+	return t * fastExpNonPositive(-clamped * clamped - 1.26551223 + t * (1.00002368 +
+			t * (0.37409196 + t * (0.09678418 + t * (-0.18628806 + t * (0.27886807 +
+			t * (-1.13520398 + t * (1.48851587 + t * (-0.82215223 + t * 0.17087277)))))))));
+}
+
+
+/**
+ * Returns the logarithm of the complementary error function erfc(@c z),
+ * also where erfc(@c z) underflows. Beyond @c z = 20 the asymptotic
+ * expansion
+ *
+ * erfc(z) = exp(-z^2) / (z sqrt(pi)) * (1 - w + 3 w^2 - 15 w^3 + 105 w^4 - ...),
+ * w = 1 / (2 z^2)
+ *
+ * is used, whose relative error is below 3e-12 there.
+ *
+ * @param z A number.
+ * @return log(erfc(@c z)).
+ */
+inline double logErfc(double z) {
+	if (!(z > 20.0)) {
+		return std::log(erfc(z));
+	}
+	const double sqrt_pi = 1.7724538509055160;
+	const double w = 1.0 / (2.0 * z * z);
+	return -z * z - std::log(z * sqrt_pi) +
+		log1p(-w * (1.0 - w * (3.0 - w * (15.0 - w * 105.0))));
+}
+
+} // namespace ims
+
+#endif // IMS_ERFC_H
@@ -0,0 +1,77 @@
+#ifndef IMS_LOGSUMEXP_H
+#define IMS_LOGSUMEXP_H
+
+#include <cmath>
+#include <limits>
+
+namespace ims {
+
+/**
+ * Sums up numbers given by their logarithms, without underflow: the
+ * logarithm of the sum is kept as the largest logarithm added plus the
+ * logarithm of the sum relative to it.
+ *
+ * A number whose logarithm is below getNegligibleBound() would not change
+ * the relative sum in floating point arithmetic, hence it may be skipped
+ * without changing the result.
+ */
+class LogSumExp {
+	public:
+		/**
+		 * Constructor of an empty sum.
+		 */
+		LogSumExp() : max(-std::numeric_limits<double>::infinity()), sum(0.0) {}
+
+		/**
+		 * Adds the number with the logarithm @c x.
+		 */
+		void add(double x) {
+			if (x <= max) {
+				if (x > -std::numeric_limits<double>::infinity()) {
+					sum += std::exp(x - max);
+				}
+			} else {
+				sum = sum * std::exp(max - x) + 1.0;
+				max = x;
+			}
+		}
+
+		/**
+		 * Adds the numbers summed up by @c other.
+		 */
+		void add(const LogSumExp& other) {
+			if (other.max <= max) {
+				if (other.max > -std::numeric_limits<double>::infinity()) {
+					sum += other.sum * std::exp(other.max - max);
+				}
+			} else {
+				sum = sum * std::exp(max - other.max) + other.sum;
+				max = other.max;
+			}
+		}
+
+		/**
+		 * Gets the logarithm of the sum, -infinity for an empty sum.
+		 */
+		double get() const {
+			return max + std::log(sum);
+		}
+
+		/**
+		 * Gets the logarithm below which numbers are negligible: their
+		 * relative value exp(x - max) is below 2^-54 of the relative sum,
+		 * less than half its precision, with a margin for the rounding of
+		 * exp() and log(). -infinity for an empty sum.
+		 */
+		double getNegligibleBound() const {
+			return max + std::log(sum) - 38.0;
+		}
+
+	private:
+		double max;
+		double sum;
+};
+
+} // namespace ims
+
+#endif // IMS_LOGSUMEXP_H
@@ -0,0 +1,154 @@
+#ifndef IMS_LRUCACHE_H
+#define IMS_LRUCACHE_H
+
+#include <list>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+namespace ims {
+
+/**
+ * A map with bounded size. When a new entry is inserted into a full cache,
+ * the least recently used entry is evicted. Both find() and insert() mark
+ * the entry as the most recently used one.
+ *
+ * Values should be cheap to copy (e.g. smart pointers), since find() returns
+ * pointers into the cache that are only valid until the next insert().
+ *
+ * @param Key Type of keys, must be less-than comparable.
+ * @param Value Type of cached values.
+ *
+ * @ingroup utils
+ */
+template <typename Key, typename Value>
+class LRUCache {
+	public:
+		/**
+		 * Type of keys.
+		 */
+		typedef Key key_type;
+
+		/**
+		 * Type of cached values.
+		 */
+		typedef Value value_type;
+
+		/**
+		 * Type of cache size.
+		 */
+		typedef std::size_t size_type;
+
+		/**
+		 * Constructor with the maximal number of entries.
+		 *
+		 * @param capacity Maximal number of entries kept in the cache.
+		 */
+		explicit LRUCache(size_type capacity) : capacity(capacity) { }
+
+		/**
+		 * Returns a pointer to the value cached for @c key or 0 if there is none.
+		 *
+		 * @param key Key to be looked up.
+		 * @return Cached value or 0.
+		 */
+		value_type* find(const key_type& key) {
+			typename index_type::iterator pos = index.find(key);
+			if (pos == index.end()) {
+				return 0;
+			}
+			entries.splice(entries.begin(), entries, pos->second);
+			return &pos->second->second;
+		}
+
+		/**
+		 * Inserts or replaces the value for @c key, evicting the least recently
+		 * used entry if the cache is full.
+		 *
+		 * @param key Key of the value.
+		 * @param value Value to be cached.
+		 * @return Reference to the cached value.
+		 */
+		value_type& insert(const key_type& key, const value_type& value) {
+			typename index_type::iterator pos = index.find(key);
+			if (pos != index.end()) {
+				pos->second->second = value;
+				entries.splice(entries.begin(), entries, pos->second);
+				return pos->second->second;
+			}
+			if (capacity == 0) {
+				// nothing can be cached, keeps the value in the single slot
+				clear();
+			} else {
+				while (entries.size() >= capacity) {
+					index.erase(entries.back().first);
+					entries.pop_back();
+				}
+			}
+			entries.push_front(std::make_pair(key, value));
+			index[key] = entries.begin();
+			return entries.front().second;
+		}
+
+		/**
+		 * Removes all entries.
+		 */
+		void clear() {
+			index.clear();
+			entries.clear();
+		}
+
+		/**
+		 * Returns the number of cached entries.
+		 */
+		size_type size() const { return entries.size(); }
+
+		/**
+		 * Returns the maximal number of entries.
+		 */
+		size_type getCapacity() const { return capacity; }
+
+		/**
+		 * Sets the maximal number of entries, evicting the least recently
+		 * used ones if there are too many.
+		 *
+		 * @param capacity New maximal number of entries.
+		 */
+		void setCapacity(size_type capacity) {
+			this->capacity = capacity;
+			while (entries.size() > capacity) {
+				index.erase(entries.back().first);
+				entries.pop_back();
+			}
+		}
+
+	private:
+		/**
+		 * Type of entries list, most recently used entry first.
+		 */
+		typedef std::list< std::pair<key_type, value_type> > entries_type;
+
+		/**
+		 * Type of index from keys to entries.
+		 */
+		typedef std::map<key_type, typename entries_type::iterator> index_type;
+
+		/**
+		 * Maximal number of entries.
+		 */
+		size_type capacity;
+
+		/**
+		 * Cached entries, most recently used entry first.
+		 */
+		entries_type entries;
+
+		/**
+		 * Index from keys to entries.
+		 */
+		index_type index;
+};
+
+} // namespace ims
+
+#endif // IMS_LRUCACHE_H
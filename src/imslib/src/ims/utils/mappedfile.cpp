@@ -0,0 +1,73 @@
+#include <fstream>
+#include <ims/utils/mappedfile.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace ims {
+
+#if !defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& filename) /*throw (IOException)*/ :
+		filename(filename), address(0), length(0) {
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw IOException("Cannot open file \"" + filename + "\"!");
+	}
+	struct stat status;
+	if (::fstat(fd, &status) != 0) {
+		::close(fd);
+		throw IOException("Cannot get the size of file \"" + filename + "\"!");
+	}
+	length = static_cast<size_type>(status.st_size);
+
+	// an empty file cannot be mapped, but has no contents either
+	if (length > 0) {
+		void* mapped = ::mmap(0, length, PROT_READ, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED) {
+			::close(fd);
+			throw IOException("Cannot map file \"" + filename + "\"!");
+		}
+		address = static_cast<const char*>(mapped);
+	}
+	// the mapping stays valid after closing the file
+	::close(fd);
+}
+
+
+MappedFile::~MappedFile() {
+	if (length > 0) {
+		::munmap(const_cast<char*>(address), length);
+	}
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename) /*throw (IOException)*/ :
+		filename(filename), address(0), length(0) {
+	std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file) {
+		throw IOException("Cannot open file \"" + filename + "\"!");
+	}
+	length = static_cast<size_type>(file.tellg());
+
+	// doubles keep the contents aligned like a mapping would
+	buffer.resize((length + sizeof(double) - 1) / sizeof(double));
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(buffer.data()), length)) {
+		throw IOException("Cannot read file \"" + filename + "\"!");
+	}
+	address = reinterpret_cast<const char*>(buffer.data());
+}
+
+
+MappedFile::~MappedFile() {
+}
+
+#endif
+
+} // namespace ims
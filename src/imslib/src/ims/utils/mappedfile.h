@@ -0,0 +1,85 @@
+#ifndef IMS_MAPPEDFILE_H
+#define IMS_MAPPEDFILE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <ims/base/exception/ioexception.h>
+
+namespace ims {
+
+/**
+ * A file mapped read-only into memory. Pages are loaded by the operating
+ * system when they are accessed and shared by all processes mapping the
+ * same file, so that large precomputed tables are available right away
+ * without reading them.
+ *
+ * On systems without @c mmap() the file is read into memory instead.
+ * The data stays valid as long as the @c MappedFile exists.
+ *
+ * @ingroup utils
+ */
+class MappedFile {
+	public:
+		/**
+		 * Type of sizes.
+		 */
+		typedef std::size_t size_type;
+
+		/**
+		 * Constructor, maps the file with the given name.
+		 *
+		 * @throws IOException if the file cannot be opened or mapped
+		 */
+		explicit MappedFile(const std::string& filename) /*throw (IOException)*/;
+
+		/**
+		 * Destructor, unmaps the file.
+		 */
+		~MappedFile();
+
+		/**
+		 * Gets the contents of the file, aligned to the page size
+		 * (or at least to the alignment of @c double).
+		 */
+		const char* data() const { return address; }
+
+		/**
+		 * Gets the size of the file in bytes.
+		 */
+		size_type size() const { return length; }
+
+		/**
+		 * Gets the name of the file.
+		 */
+		const std::string& getFilename() const { return filename; }
+
+	private:
+		// not copyable
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+		/**
+		 * Name of the file.
+		 */
+		std::string filename;
+
+		/**
+		 * Start of the mapped contents.
+		 */
+		const char* address;
+
+		/**
+		 * Size of the file in bytes.
+		 */
+		size_type length;
+
+		/**
+		 * Contents of the file if it cannot be mapped.
+		 */
+		std::vector<double> buffer;
+};
+
+} // namespace ims
+
+#endif // IMS_MAPPEDFILE_H
@@ -0,0 +1,271 @@
+#ifndef IMS_THREADPOOL_H
+#define IMS_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <cstddef>
+
+namespace ims {
+
+/**
+ * A fixed set of worker threads that run loops in parallel.
+ *
+ * parallelFor() distributes the loop indices in contiguous blocks over
+ * per-thread queues. A thread that has run out of work steals indices from
+ * the back of another thread's queue, so that tasks of very different
+ * running time (e.g. branches of a decomposition tree) are still balanced.
+ *
+ * The calling thread takes part in the work, a pool of size one therefore
+ * does not start any thread and runs everything in the caller. Calls of
+ * parallelFor() from inside a task are executed serially by the calling
+ * worker.
+ *
+ * Tasks must not throw across the pool, the first exception thrown by a task
+ * is rethrown by parallelFor() once all tasks have finished.
+ *
+ * @ingroup utils
+ */
+class ThreadPool {
+	public:
+		/**
+		 * Type of sizes and loop indices.
+		 */
+		typedef std::size_t size_type;
+
+		/**
+		 * Constructor with the number of threads, including the calling one.
+		 *
+		 * @param threads Number of threads, values less than one are treated as one.
+		 */
+		explicit ThreadPool(size_type threads = 1);
+
+		/**
+		 * Destructor, waits for the worker threads to finish.
+		 */
+		~ThreadPool();
+
+		/**
+		 * Returns the number of threads, including the calling one.
+		 */
+		size_type size() const { return queues.size(); }
+
+		/**
+		 * Calls @c function(i) for every i in [0, @c n) in parallel and returns
+		 * when all calls have finished. The order of calls is unspecified,
+		 * results should be written to slots indexed by i.
+		 *
+		 * @param n Number of loop indices.
+		 * @param function Function object to be called for every index.
+		 */
+		template <typename Function>
+		void parallelFor(size_type n, Function function);
+
+	private:
+		/**
+		 * Queue of loop indices of a single thread.
+		 */
+		struct Queue {
+			std::mutex mutex;
+			std::deque<size_type> indices;
+		};
+
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+
+		/**
+		 * Main loop of the worker threads.
+		 */
+		void work(size_type thread);
+
+		/**
+		 * Runs tasks of the current loop until no queue holds any index.
+		 */
+		void runTasks(size_type thread);
+
+		/**
+		 * Takes the next index from the own queue or steals one from another.
+		 */
+		bool nextIndex(size_type thread, size_type& index);
+
+		/**
+		 * Returns true if the calling thread is a worker of some pool.
+		 */
+		static bool& insideWorker() {
+			static thread_local bool inside = false;
+			return inside;
+		}
+
+		std::vector< std::unique_ptr<Queue> > queues;
+		std::vector<std::thread> threads;
+
+		std::mutex mutex;
+		std::condition_variable start_condition;
+		std::condition_variable done_condition;
+
+		/**
+		 * Task of the current loop.
+		 */
+		std::function<void(size_type)> task;
+
+		/**
+		 * Incremented for every loop, wakes up the workers.
+		 */
+		unsigned long generation;
+
+		/**
+		 * Number of worker threads still busy with the current loop.
+		 */
+		size_type busy;
+
+		bool stopping;
+
+		std::exception_ptr exception;
+};
+
+
+inline ThreadPool::ThreadPool(size_type threads) :
+		generation(0), busy(0), stopping(false) {
+	if (threads < 1) {
+		threads = 1;
+	}
+	for (size_type i = 0; i < threads; ++i) {
+		queues.push_back(std::unique_ptr<Queue>(new Queue));
+	}
+	// thread 0 is the one calling parallelFor()
+	for (size_type i = 1; i < threads; ++i) {
+		this->threads.push_back(std::thread(&ThreadPool::work, this, i));
+	}
+}
+
+
+inline ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	start_condition.notify_all();
+	for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it) {
+		it->join();
+	}
+}
+
+
+template <typename Function>
+void ThreadPool::parallelFor(size_type n, Function function) {
+	if (n == 0) {
+		return;
+	}
+	if (size() == 1 || n == 1 || insideWorker()) {
+		for (size_type i = 0; i < n; ++i) {
+			function(i);
+		}
+		return;
+	}
+
+	// distributes indices in contiguous blocks
+	for (size_type thread = 0; thread < size(); ++thread) {
+		Queue& queue = *queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (size_type i = thread * n / size(); i < (thread + 1) * n / size(); ++i) {
+			queue.indices.push_back(i);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		task = std::function<void(size_type)>(std::ref(function));
+		exception = std::exception_ptr();
+		busy = threads.size();
+		++generation;
+	}
+	start_condition.notify_all();
+
+	insideWorker() = true;
+	runTasks(0);
+	insideWorker() = false;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (busy > 0) {
+		done_condition.wait(lock);
+	}
+	task = std::function<void(size_type)>();
+	if (exception) {
+		std::exception_ptr thrown = exception;
+		exception = std::exception_ptr();
+		std::rethrow_exception(thrown);
+	}
+}
+
+
+inline void ThreadPool::work(size_type thread) {
+	insideWorker() = true;
+	unsigned long seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!stopping && generation == seen) {
+				start_condition.wait(lock);
+			}
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+		}
+		runTasks(thread);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			--busy;
+		}
+		done_condition.notify_all();
+	}
+}
+
+
+inline void ThreadPool::runTasks(size_type thread) {
+	size_type index;
+	while (nextIndex(thread, index)) {
+		try {
+			task(index);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!exception) {
+				exception = std::current_exception();
+			}
+		}
+	}
+}
+
+
+inline bool ThreadPool::nextIndex(size_type thread, size_type& index) {
+	// own queue: takes from the front to keep the order of a block
+	{
+		Queue& queue = *queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.indices.empty()) {
+			index = queue.indices.front();
+			queue.indices.pop_front();
+			return true;
+		}
+	}
+	// steals from the back of the other queues
+	for (size_type i = 1; i < size(); ++i) {
+		Queue& queue = *queues[(thread + i) % size()];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.indices.empty()) {
+			index = queue.indices.back();
+			queue.indices.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace ims
+
+#endif // IMS_THREADPOOL_H
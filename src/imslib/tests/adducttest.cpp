@@ -0,0 +1,169 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <string>
+#include <ims/adduct.h>
+#include <ims/alphabet.h>
+#include <ims/element.h>
+
+using namespace ims;
+
+class AdductTest : public CppUnit::TestFixture {
+	typedef Adduct::mass_type mass_type;
+	typedef Adduct::isotopes_type isotopes_type;
+	typedef isotopes_type::peaks_container peaks_container;
+
+	CPPUNIT_TEST_SUITE( AdductTest );
+	CPPUNIT_TEST( testParse );
+	CPPUNIT_TEST( testParseCharge );
+	CPPUNIT_TEST( testParseErrors );
+	CPPUNIT_TEST( testMasses );
+	CPPUNIT_TEST( testUnknownElement );
+	CPPUNIT_TEST( testAddedIsotopeDistribution );
+	CPPUNIT_TEST_SUITE_END();
+
+	Alphabet alphabet;
+
+public:
+	void setUp();
+	void tearDown() {};
+	void testParse();
+	void testParseCharge();
+	void testParseErrors();
+	void testMasses();
+	void testUnknownElement();
+	void testAddedIsotopeDistribution();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( AdductTest );
+
+void AdductTest::setUp() {
+	peaks_container peaksH;
+	peaksH.push_back(peaks_container::value_type(0.007825, 0.99985));
+	peaksH.push_back(peaks_container::value_type(0.014102, 0.00015));
+	peaks_container peaksN;
+	peaksN.push_back(peaks_container::value_type(0.003074, 0.99634));
+	peaksN.push_back(peaks_container::value_type(0.000109, 0.00366));
+	peaks_container peaksO;
+	peaksO.push_back(peaks_container::value_type(-0.005085, 0.99762));
+	peaksO.push_back(peaks_container::value_type(-0.000868, 0.00038));
+	peaksO.push_back(peaks_container::value_type(-0.000839, 0.002));
+	peaks_container peaksNa;
+	peaksNa.push_back(peaks_container::value_type(-0.01023, 1.0));
+	peaks_container peaksCl;
+	peaksCl.push_back(peaks_container::value_type(-0.031147, 0.7577));
+	peaksCl.push_back(peaks_container::value_type(0.0, 0.0));
+	peaksCl.push_back(peaks_container::value_type(-0.034097, 0.2423));
+
+	alphabet.clear();
+	alphabet.push_back(Element("H", isotopes_type(peaksH, 1)));
+	alphabet.push_back(Element("N", isotopes_type(peaksN, 14)));
+	alphabet.push_back(Element("O", isotopes_type(peaksO, 16)));
+	alphabet.push_back(Element("Na", isotopes_type(peaksNa, 23)));
+	alphabet.push_back(Element("Cl", isotopes_type(peaksCl, 35)));
+}
+
+void AdductTest::testParse() {
+	Adduct protonated("[M+H]+");
+	CPPUNIT_ASSERT_EQUAL(std::string("[M+H]+"), protonated.getName());
+	CPPUNIT_ASSERT_EQUAL(1u, protonated.getMassFactor());
+	CPPUNIT_ASSERT_EQUAL(1, protonated.getCharge());
+	CPPUNIT_ASSERT_EQUAL(static_cast<Adduct::elements_type::size_type>(1), protonated.getAddedElements().size());
+	CPPUNIT_ASSERT_EQUAL(1u, protonated.getAddedElements().find("H")->second);
+	CPPUNIT_ASSERT(protonated.getRemovedElements().empty());
+
+	Adduct dimer("[2M+NH4]+");
+	CPPUNIT_ASSERT_EQUAL(2u, dimer.getMassFactor());
+	CPPUNIT_ASSERT_EQUAL(1u, dimer.getAddedElements().find("N")->second);
+	CPPUNIT_ASSERT_EQUAL(4u, dimer.getAddedElements().find("H")->second);
+
+	Adduct loss("[M+H-H2O]+");
+	CPPUNIT_ASSERT_EQUAL(1u, loss.getAddedElements().find("H")->second);
+	CPPUNIT_ASSERT_EQUAL(2u, loss.getRemovedElements().find("H")->second);
+	CPPUNIT_ASSERT_EQUAL(1u, loss.getRemovedElements().find("O")->second);
+
+	// counts of groups multiply their atoms
+	Adduct doubly("[M+2H]2+");
+	CPPUNIT_ASSERT_EQUAL(2u, doubly.getAddedElements().find("H")->second);
+	CPPUNIT_ASSERT_EQUAL(2, doubly.getCharge());
+
+	Adduct radical("[M]+");
+	CPPUNIT_ASSERT(radical.getAddedElements().empty());
+	CPPUNIT_ASSERT(radical.getRemovedElements().empty());
+}
+
+void AdductTest::testParseCharge() {
+	CPPUNIT_ASSERT_EQUAL(-1, Adduct("[M-H]-").getCharge());
+	CPPUNIT_ASSERT_EQUAL(-2, Adduct("[M-2H]2-").getCharge());
+	CPPUNIT_ASSERT_EQUAL(-2, Adduct("[M-2H]--").getCharge());
+	CPPUNIT_ASSERT_EQUAL(3, Adduct("[M+3H]3+").getCharge());
+	CPPUNIT_ASSERT_EQUAL(3, Adduct("[M+3H]+++").getCharge());
+}
+
+void AdductTest::testParseErrors() {
+	CPPUNIT_ASSERT_THROW(Adduct(""), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("M+H+"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[M+H]"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[M+H]0+"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[M+H]2++"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[M+H]+x"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[H+M]+"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[0M+H]+"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[M+]+"), UnknownCharacterException);
+	CPPUNIT_ASSERT_THROW(Adduct("[M*H]+"), UnknownCharacterException);
+}
+
+void AdductTest::testMasses() {
+	const mass_type proton = 1.007825 - Element::ELECTRON_MASS_IN_U;
+	const mass_type mass = 147.053158;
+
+	Adduct protonated("[M+H]+");
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(proton, protonated.getMassShift(alphabet), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass + proton, protonated.getIonMass(mass, alphabet), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass, protonated.getMoleculeMass(mass + proton, alphabet), 1.0e-9);
+
+	Adduct deprotonated("[M-H]-");
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass - proton, deprotonated.getIonMass(mass, alphabet), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass, deprotonated.getMoleculeMass(mass - proton, alphabet), 1.0e-9);
+
+	// m/z of multiply charged ions
+	Adduct doubly("[M+2H]2+");
+	CPPUNIT_ASSERT_DOUBLES_EQUAL((mass + 2 * proton) / 2, doubly.getIonMass(mass, alphabet), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass, doubly.getMoleculeMass((mass + 2 * proton) / 2, alphabet), 1.0e-9);
+
+	Adduct dimer("[2M+Na]+");
+	const mass_type sodium = 22.98977 - Element::ELECTRON_MASS_IN_U;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2 * mass + sodium, dimer.getIonMass(mass, alphabet), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass, dimer.getMoleculeMass(2 * mass + sodium, alphabet), 1.0e-9);
+
+	Adduct loss("[M+H-H2O]+");
+	const mass_type water = 2 * 1.007825 + 15.994915;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mass + proton - water, loss.getIonMass(mass, alphabet), 1.0e-9);
+
+	// the monoisotopic mass is the one of the lightest isotope
+	Adduct chloride("[M+Cl]-");
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(34.968853 + Element::ELECTRON_MASS_IN_U,
+		chloride.getMassShift(alphabet), 1.0e-9);
+}
+
+void AdductTest::testUnknownElement() {
+	Adduct potassium("[M+K]+");
+	CPPUNIT_ASSERT_THROW(potassium.getMassShift(alphabet), UnknownCharacterException);
+}
+
+void AdductTest::testAddedIsotopeDistribution() {
+	isotopes_type::settings_type settings(4, 0.0001);
+
+	// chlorine isotopes shape the pattern of the ion
+	isotopes_type chlorine = Adduct("[M+Cl]-").getAddedIsotopeDistribution(alphabet, settings);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(34.968853, chlorine.getMass(0), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.7577, chlorine.getAbundance(0), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.2423, chlorine.getAbundance(2), 1.0e-9);
+
+	isotopes_type hydrogens = Adduct("[M+2H]2+").getAddedIsotopeDistribution(alphabet, settings);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(2 * 1.007825, hydrogens.getMass(0), 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.99985 * 0.99985, hydrogens.getAbundance(0), 1.0e-6);
+
+	// nothing added
+	CPPUNIT_ASSERT(Adduct("[M-H]-").getAddedIsotopeDistribution(alphabet, settings).empty());
+}
@@ -358,9 +358,6 @@ void AlphabetTest::testLoadThrow() {
 
 void AlphabetTest::initializeAlphabet(alphabet_type& chnops) {
 
-	isotopes_type::SIZE = 10;
-	isotopes_type::ABUNDANCES_SUM_ERROR = 0.0001;
-
 // Hydrogen
 	nominal_mass_type massH = 1;	
 	peaks_container peaksH;
@@ -0,0 +1,135 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <ims/chemicalrules.h>
+
+using namespace ims;
+
+class ChemicalRulesTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE( ChemicalRulesTest );
+	CPPUNIT_TEST( testGetValence );
+	CPPUNIT_TEST( testDoubleBondEquivalentRule );
+	CPPUNIT_TEST( testNitrogenRule );
+	CPPUNIT_TEST( testSeniorRules );
+	CPPUNIT_TEST( testElementRatioRules );
+	CPPUNIT_TEST_SUITE_END();
+
+	typedef DecompositionConstraints::decomposition_type decomposition_type;
+
+	Alphabet alphabet;
+	Weights weights;
+
+	/**
+	 * Returns true if the counts of H, C, N, O, P and S satisfy @c constraints.
+	 */
+	static bool isValid(const DecompositionConstraints& constraints, unsigned int h,
+						unsigned int c, unsigned int n, unsigned int o,
+						unsigned int p = 0, unsigned int s = 0);
+public:
+	void setUp();
+	void tearDown() {};
+	void testGetValence();
+	void testDoubleBondEquivalentRule();
+	void testNitrogenRule();
+	void testSeniorRules();
+	void testElementRatioRules();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ChemicalRulesTest );
+
+void ChemicalRulesTest::setUp() {
+	typedef Element::nominal_mass_type nominal_mass_type;
+	alphabet = Alphabet();
+	alphabet.push_back(Element("H", nominal_mass_type(1)));
+	alphabet.push_back(Element("C", nominal_mass_type(12)));
+	alphabet.push_back(Element("N", nominal_mass_type(14)));
+	alphabet.push_back(Element("O", nominal_mass_type(16)));
+	alphabet.push_back(Element("P", nominal_mass_type(31)));
+	alphabet.push_back(Element("S", nominal_mass_type(32)));
+
+	Weights::alphabet_masses_type masses;
+	masses.push_back(1.007825);
+	masses.push_back(12.0);
+	masses.push_back(14.003074);
+	masses.push_back(15.994915);
+	masses.push_back(30.973762);
+	masses.push_back(31.972071);
+	weights = Weights(masses, 0.00001);
+}
+
+bool ChemicalRulesTest::isValid(const DecompositionConstraints& constraints, unsigned int h,
+								unsigned int c, unsigned int n, unsigned int o,
+								unsigned int p, unsigned int s) {
+	decomposition_type decomposition;
+	decomposition.push_back(h);
+	decomposition.push_back(c);
+	decomposition.push_back(n);
+	decomposition.push_back(o);
+	decomposition.push_back(p);
+	decomposition.push_back(s);
+	return constraints.findViolatedRule(decomposition) == constraints.getNumberOfRules();
+}
+
+void ChemicalRulesTest::testGetValence() {
+	CPPUNIT_ASSERT_EQUAL(1u, ChemicalRules::getValence("H"));
+	CPPUNIT_ASSERT_EQUAL(1u, ChemicalRules::getValence("Cl"));
+	CPPUNIT_ASSERT_EQUAL(2u, ChemicalRules::getValence("O"));
+	CPPUNIT_ASSERT_EQUAL(3u, ChemicalRules::getValence("N"));
+	CPPUNIT_ASSERT_EQUAL(4u, ChemicalRules::getValence("C"));
+	CPPUNIT_ASSERT_EQUAL(2u, ChemicalRules::getValence("Fe"));
+}
+
+void ChemicalRulesTest::testDoubleBondEquivalentRule() {
+	DecompositionConstraints constraints(weights);
+	ChemicalRules::addDoubleBondEquivalentRule(constraints, alphabet, 0.0, 3.0);
+	CPPUNIT_ASSERT(constraints.getRuleName(0) == "DBE");
+	// glutamate C5H9NO4: 2, benzene C6H6: 4, C5H8NO4: 2.5
+	CPPUNIT_ASSERT(isValid(constraints, 9, 5, 1, 4));
+	CPPUNIT_ASSERT(!isValid(constraints, 6, 6, 0, 0));
+	CPPUNIT_ASSERT(isValid(constraints, 8, 5, 1, 4));
+
+	ChemicalRules::addIntegerDoubleBondEquivalentRule(constraints, alphabet);
+	CPPUNIT_ASSERT(isValid(constraints, 9, 5, 1, 4));
+	CPPUNIT_ASSERT(!isValid(constraints, 8, 5, 1, 4));
+}
+
+void ChemicalRulesTest::testNitrogenRule() {
+	DecompositionConstraints neutral(weights), charged(weights);
+	ChemicalRules::addNitrogenRule(neutral, alphabet, 0);
+	ChemicalRules::addNitrogenRule(charged, alphabet, 1);
+	// glutamate C5H9NO4 (147) and its protonated ion C5H10NO4 (148)
+	CPPUNIT_ASSERT(isValid(neutral, 9, 5, 1, 4));
+	CPPUNIT_ASSERT(!isValid(neutral, 10, 5, 1, 4));
+	CPPUNIT_ASSERT(!isValid(charged, 9, 5, 1, 4));
+	CPPUNIT_ASSERT(isValid(charged, 10, 5, 1, 4));
+	// ethane C2H6 (30)
+	CPPUNIT_ASSERT(isValid(neutral, 6, 2, 0, 0));
+}
+
+void ChemicalRulesTest::testSeniorRules() {
+	DecompositionConstraints constraints(weights);
+	ChemicalRules::addSeniorRules(constraints, alphabet);
+	CPPUNIT_ASSERT(constraints.getNumberOfRules() == 1);
+	CPPUNIT_ASSERT(isValid(constraints, 9, 5, 1, 4));
+	CPPUNIT_ASSERT(isValid(constraints, 0, 2, 0, 0));
+	// CH: odd sum of valences
+	CPPUNIT_ASSERT(!isValid(constraints, 1, 1, 0, 0));
+	// NH: sum of valences below twice the valence of N
+	CPPUNIT_ASSERT(!isValid(constraints, 1, 0, 1, 0));
+	// H4O3: sum of valences below twice the number of atoms minus one
+	CPPUNIT_ASSERT(!isValid(constraints, 4, 0, 0, 3));
+}
+
+void ChemicalRulesTest::testElementRatioRules() {
+	DecompositionConstraints constraints(weights);
+	ChemicalRules::addElementRatioRules(constraints, alphabet);
+	CPPUNIT_ASSERT(isValid(constraints, 9, 5, 1, 4));
+	CPPUNIT_ASSERT(isValid(constraints, 6, 2, 0, 0));
+	// CH4: H/C > 3.1
+	CPPUNIT_ASSERT(!isValid(constraints, 4, 1, 0, 0));
+	// C2H4N4: N/C > 1.3
+	CPPUNIT_ASSERT(!isValid(constraints, 4, 2, 4, 0));
+	// C6HP: H/C < 0.2, while C6H2P is fine
+	CPPUNIT_ASSERT(!isValid(constraints, 1, 6, 0, 0, 1));
+	CPPUNIT_ASSERT(isValid(constraints, 2, 6, 0, 0, 1));
+}
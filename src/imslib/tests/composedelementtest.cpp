@@ -7,6 +7,7 @@
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <ims/composedelement.h>	
 #include <ims/alphabet.h>
+#include <ims/isotopedistributioncache.h>
 
 using namespace ims;
 
@@ -33,6 +34,7 @@ class ComposedElementTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(testOperatorPlus);
 	CPPUNIT_TEST(testUpdateSequence);
 	CPPUNIT_TEST(testUpdateIsotopeDistribution);
+	CPPUNIT_TEST(testUpdateIsotopeDistributionCached);
 	CPPUNIT_TEST_SUITE_END();
 
 	Element *hydrogen;	
@@ -55,6 +57,7 @@ class ComposedElementTest : public CppUnit::TestFixture {
 		void testOperatorPlus();
 		void testUpdateSequence();
 		void testUpdateIsotopeDistribution();
+		void testUpdateIsotopeDistributionCached();
 };
 
 
@@ -316,6 +319,36 @@ void ComposedElementTest::testUpdateIsotopeDistribution() {
 }
 
 
+void ComposedElementTest::testUpdateIsotopeDistributionCached() {
+	Alphabet cho;
+	cho.push_back(*hydrogen);
+	cho.push_back(*carbon);
+	cho.push_back(*oxygen);
+
+	IsotopeDistributionCache cache;
+	isotopes_type::settings_type settings(5);
+
+	for (unsigned int c = 1; c < 40; c += 7) {
+		std::vector<unsigned int> decomposition;
+		decomposition.push_back(2 * c + 2);
+		decomposition.push_back(c);
+		decomposition.push_back(1);
+
+		composed_element_type molecule(decomposition, cho);
+		molecule.updateIsotopeDistribution(settings);
+		composed_element_type cached_molecule(decomposition, cho);
+		cached_molecule.updateIsotopeDistribution(settings, cache);
+		// the second time the powers are taken from the cache
+		composed_element_type cached_molecule2(decomposition, cho);
+		cached_molecule2.updateIsotopeDistribution(settings, cache);
+
+		CPPUNIT_ASSERT(molecule.getIsotopeDistribution() == cached_molecule.getIsotopeDistribution());
+		CPPUNIT_ASSERT(molecule.getIsotopeDistribution() == cached_molecule2.getIsotopeDistribution());
+		CPPUNIT_ASSERT(cached_molecule.getIsotopeDistribution().getSettings() == settings);
+	}
+}
+
+
 void ComposedElementTest::testGetElementAbundance() {
 	Element e1("A");
 	Element e2("B");
@@ -0,0 +1,131 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <string>
+#include <vector>
+#include <ims/composition.h>
+#include <ims/alphabet.h>
+
+using namespace ims;
+
+class CompositionTest : public CppUnit::TestFixture {
+	typedef Composition::container container;
+	typedef Composition::name_type name_type;
+	typedef Element::isotopes_type isotopes_type;
+	typedef isotopes_type::peaks_container peaks_container;
+
+	CPPUNIT_TEST_SUITE( CompositionTest );
+	CPPUNIT_TEST( testConstructorCounts );
+	CPPUNIT_TEST( testConstructorSequence );
+	CPPUNIT_TEST( testConstructorUnknownElement );
+	CPPUNIT_TEST( testGetElementAbundance );
+	CPPUNIT_TEST( testOperatorEqual );
+	CPPUNIT_TEST( testGetComposedElement );
+	CPPUNIT_TEST_SUITE_END();
+
+	Alphabet alphabet;
+
+public:
+	void setUp();
+	void tearDown() {};
+	void testConstructorCounts();
+	void testConstructorSequence();
+	void testConstructorUnknownElement();
+	void testGetElementAbundance();
+	void testOperatorEqual();
+	void testGetComposedElement();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( CompositionTest );
+
+void CompositionTest::setUp() {
+	peaks_container peaksH;
+	peaksH.push_back(peaks_container::value_type(0.007825, 0.99985));
+	peaksH.push_back(peaks_container::value_type(0.014102, 0.00015));
+	peaks_container peaksC;
+	peaksC.push_back(peaks_container::value_type(0.0, 0.9889));
+	peaksC.push_back(peaks_container::value_type(0.003355, 0.0111));
+	peaks_container peaksO;
+	peaksO.push_back(peaks_container::value_type(-0.005085, 0.99762));
+	peaksO.push_back(peaks_container::value_type(-0.000868, 0.00038));
+	peaksO.push_back(peaks_container::value_type(-0.000839, 0.002));
+
+	alphabet.clear();
+	alphabet.push_back(Element("H", isotopes_type(peaksH, 1)));
+	alphabet.push_back(Element("C", isotopes_type(peaksC, 12)));
+	alphabet.push_back(Element("O", isotopes_type(peaksO, 16)));
+}
+
+void CompositionTest::testConstructorCounts() {
+	container counts;
+	counts.push_back(4);
+	counts.push_back(2);
+
+	// missing counts are 0
+	Composition composition(counts, alphabet);
+	CPPUNIT_ASSERT_EQUAL(alphabet.size(), composition.size());
+	CPPUNIT_ASSERT_EQUAL(4u, composition[0]);
+	CPPUNIT_ASSERT_EQUAL(2u, composition[1]);
+	CPPUNIT_ASSERT_EQUAL(0u, composition[2]);
+	CPPUNIT_ASSERT(&alphabet == &composition.getAlphabet());
+
+	// counts beyond the alphabet are ignored
+	counts.push_back(2);
+	counts.push_back(7);
+	Composition other(counts, alphabet);
+	CPPUNIT_ASSERT_EQUAL(alphabet.size(), other.size());
+	CPPUNIT_ASSERT_EQUAL(2u, other[2]);
+}
+
+void CompositionTest::testConstructorSequence() {
+	Composition composition("C2H4O2", alphabet);
+	CPPUNIT_ASSERT_EQUAL(4u, composition[0]);
+	CPPUNIT_ASSERT_EQUAL(2u, composition[1]);
+	CPPUNIT_ASSERT_EQUAL(2u, composition[2]);
+
+	Composition empty("C0", alphabet);
+	CPPUNIT_ASSERT_EQUAL(0u, empty[0]);
+	CPPUNIT_ASSERT_EQUAL(0u, empty[1]);
+	CPPUNIT_ASSERT_EQUAL(0u, empty[2]);
+}
+
+void CompositionTest::testConstructorUnknownElement() {
+	CPPUNIT_ASSERT_THROW(Composition("C2N", alphabet), UnknownCharacterException);
+}
+
+void CompositionTest::testGetElementAbundance() {
+	Composition composition("CH4", alphabet);
+	CPPUNIT_ASSERT_EQUAL(4u, composition.getElementAbundance("H"));
+	CPPUNIT_ASSERT_EQUAL(1u, composition.getElementAbundance("C"));
+	CPPUNIT_ASSERT_EQUAL(0u, composition.getElementAbundance("O"));
+	CPPUNIT_ASSERT_EQUAL(0u, composition.getElementAbundance("N"));
+}
+
+void CompositionTest::testOperatorEqual() {
+	container counts;
+	counts.push_back(4);
+	counts.push_back(1);
+	Composition composition(counts, alphabet);
+	CPPUNIT_ASSERT(composition == Composition("CH4", alphabet));
+	CPPUNIT_ASSERT(composition != Composition("CH4O", alphabet));
+
+	Alphabet other_alphabet(alphabet);
+	CPPUNIT_ASSERT(composition != Composition(counts, other_alphabet));
+}
+
+void CompositionTest::testGetComposedElement() {
+	Composition composition("C2H4O2", alphabet);
+
+	std::vector<name_type> order;
+	order.push_back("C");
+	order.push_back("H");
+	order.push_back("O");
+	ComposedElement molecule = composition.getComposedElement(&order);
+	CPPUNIT_ASSERT_EQUAL(std::string("C2H4O2"), molecule.getSequence());
+	CPPUNIT_ASSERT_EQUAL(4u, molecule.getElementAbundance("H"));
+	CPPUNIT_ASSERT_EQUAL(2u, molecule.getElementAbundance("C"));
+	CPPUNIT_ASSERT_EQUAL(2u, molecule.getElementAbundance("O"));
+
+	// the same molecule as parsed from the sequence
+	CPPUNIT_ASSERT(molecule.getElements() == ComposedElement("C2H4O2", alphabet).getElements());
+}
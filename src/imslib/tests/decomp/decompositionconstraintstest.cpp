@@ -0,0 +1,172 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <limits>
+#include <ims/decomp/realmassdecomposer.h>
+#include <ims/decomp/decompositionconstraints.h>
+
+using namespace std;
+using namespace ims;
+
+class DecompositionConstraintsTest : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(DecompositionConstraintsTest);
+		CPPUNIT_TEST(testFindViolatedRule);
+		CPPUNIT_TEST(testFindViolatedRuleForBranches);
+		CPPUNIT_TEST(testVisitPrunedDecompositions);
+		CPPUNIT_TEST_SUITE_END();
+	private:
+		typedef RealMassDecomposer decomposer_type;
+		typedef decomposer_type::decomposition_type decomposition_type;
+		typedef decomposer_type::decompositions_type decompositions_type;
+		typedef DecompositionConstraints::size_type size_type;
+
+		/**
+		 * Collects the decompositions passing the constraints.
+		 */
+		struct DecompositionsCollector {
+			decompositions_type decompositions;
+
+			void operator()(const decomposition_type& decomposition) {
+				decompositions.push_back(decomposition);
+			}
+		};
+
+		Weights getCHNOPSWeights();
+
+		/**
+		 * Constraints on CHNOPS: double bond equivalent in [0, 8], even sum
+		 * of valences and N <= O.
+		 */
+		DecompositionConstraints getConstraints(const Weights& weights);
+
+	public:
+		void testFindViolatedRule();
+		void testFindViolatedRuleForBranches();
+		void testVisitPrunedDecompositions();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DecompositionConstraintsTest);
+
+Weights DecompositionConstraintsTest::getCHNOPSWeights() {
+	Weights::alphabet_masses_type mono_masses;
+	mono_masses.push_back(1.007825);
+	mono_masses.push_back(12.0);
+	mono_masses.push_back(14.003074);
+	mono_masses.push_back(15.994915);
+	mono_masses.push_back(30.973762);
+	mono_masses.push_back(31.972071);
+
+	Weights weights(mono_masses, 0.00001);
+	weights.divideByGCD();
+	return weights;
+}
+
+DecompositionConstraints DecompositionConstraintsTest::getConstraints(const Weights& weights) {
+	DecompositionConstraints constraints(weights);
+
+	const double dbe[] = { -0.5, 1.0, 0.5, 0.0, 0.5, 0.0 };
+	constraints.addLinearConstraint("DBE", DecompositionConstraints::coefficients_type(dbe, dbe + 6),
+									1.0, 0.0, 8.0);
+
+	const long valences[] = { 1, 4, 3, 2, 3, 2 };
+	constraints.addParityConstraint("parity",
+		DecompositionConstraints::parity_coefficients_type(valences, valences + 6), 0);
+
+	DecompositionConstraints::coefficients_type nitrogen(3, 0.0);
+	nitrogen[2] = 1.0;
+	nitrogen.push_back(-1.0);
+	constraints.addLinearConstraint("ratio", nitrogen, 0.0,
+									-numeric_limits<double>::infinity(), 0.0);
+	return constraints;
+}
+
+void DecompositionConstraintsTest::testFindViolatedRule() {
+	DecompositionConstraints constraints = getConstraints(getCHNOPSWeights());
+	CPPUNIT_ASSERT(constraints.getNumberOfRules() == 3);
+	CPPUNIT_ASSERT(constraints.getRuleName(0) == "DBE");
+	CPPUNIT_ASSERT(constraints.getRuleName(2) == "ratio");
+
+	// glutamate C5H9NO4: DBE 2
+	const unsigned int glutamate[] = { 9, 5, 1, 4, 0, 0 };
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition_type(glutamate, glutamate + 6)) == 3);
+
+	// C5H8NO4: DBE 2.5, odd sum of valences
+	const unsigned int radical[] = { 8, 5, 1, 4, 0, 0 };
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition_type(radical, radical + 6)) == 1);
+
+	// C12H2: DBE 12
+	const unsigned int unsaturated[] = { 2, 12, 0, 0, 0, 0 };
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition_type(unsaturated, unsaturated + 6)) == 0);
+
+	// CH2N2O
+	const unsigned int nitrogen[] = { 2, 1, 2, 1, 0, 0 };
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition_type(nitrogen, nitrogen + 6)) == 2);
+}
+
+void DecompositionConstraintsTest::testFindViolatedRuleForBranches() {
+	Weights weights = getCHNOPSWeights();
+	DecompositionConstraints constraints = getConstraints(weights);
+
+	// N is fixed to 3, no O can follow (O has a larger index than N)
+	decomposition_type decomposition(6, 0);
+	decomposition[2] = 3;
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition, 1, 0, 10 * weights.getWeight(1)) == 2);
+
+	// DBE of C20 cannot be brought down to 8 by less than 20 H
+	decomposition.assign(6, 0);
+	decomposition[1] = 20;
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition, 0, 0, 19 * weights.getWeight(0)) == 0);
+	CPPUNIT_ASSERT(constraints.findViolatedRule(decomposition, 0, 0, 30 * weights.getWeight(0)) == 3);
+}
+
+void DecompositionConstraintsTest::testVisitPrunedDecompositions() {
+	Weights weights = getCHNOPSWeights();
+	decomposer_type decomposer(weights);
+	DecompositionConstraints constraints = getConstraints(weights);
+	ThreadPool pool(4);
+
+	const size_type rules = constraints.getNumberOfRules();
+	double masses[] = { 147.0529, 523.2 }, error = 0.005;
+	for (unsigned i = 0; i < sizeof(masses) / sizeof(masses[0]); ++i) {
+		decompositions_type expected;
+		decompositions_type decompositions = decomposer.getDecompositions(masses[i], error);
+		for (decompositions_type::const_iterator it = decompositions.begin();
+											it != decompositions.end(); ++it) {
+			if (constraints.findViolatedRule(*it) == rules) {
+				expected.push_back(*it);
+			}
+		}
+		CPPUNIT_ASSERT(!expected.empty());
+		CPPUNIT_ASSERT(expected.size() < decompositions.size());
+
+		ConstrainedVisitor<DecompositionsCollector> visitor(constraints, DecompositionsCollector());
+		ConstrainedVisitor<DecompositionsCollector> serial =
+			decomposer.visitPrunedDecompositions(masses[i], error, decomposer_type::bounds_type(), visitor);
+		CPPUNIT_ASSERT(serial.visitor.decompositions == expected);
+
+		// subtrees are pruned, so less decompositions are discarded than filtered out
+		DecompositionConstraints::counter_type pruned = 0, discarded = 0;
+		for (size_type rule = 0; rule < rules; ++rule) {
+			pruned += serial.statistics.pruned[rule];
+			discarded += serial.statistics.discarded[rule];
+		}
+		CPPUNIT_ASSERT(pruned > 0);
+		CPPUNIT_ASSERT(discarded < decompositions.size() - expected.size());
+
+		// parallel traversal finds the same decompositions and prunes the same subtrees
+		std::vector< ConstrainedVisitor<DecompositionsCollector> > parts =
+			decomposer.visitPrunedDecompositions(masses[i], error, decomposer_type::bounds_type(),
+												 visitor, pool);
+		decompositions_type joined;
+		DecompositionConstraints::statistics_type statistics;
+		for (std::vector< ConstrainedVisitor<DecompositionsCollector> >::const_iterator it = parts.begin();
+															it != parts.end(); ++it) {
+			joined.insert(joined.end(), it->visitor.decompositions.begin(),
+						  it->visitor.decompositions.end());
+			statistics += it->statistics;
+		}
+		CPPUNIT_ASSERT(joined == expected);
+		CPPUNIT_ASSERT(statistics.pruned == serial.statistics.pruned);
+		CPPUNIT_ASSERT(statistics.discarded == serial.statistics.discarded);
+	}
+}
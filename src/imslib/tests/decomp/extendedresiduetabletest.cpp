@@ -0,0 +1,186 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <stdint.h>
+#include <ims/weights.h>
+#include <ims/utils/threadpool.h>
+#include <ims/decomp/extendedresiduetable.h>
+
+using namespace ims;
+
+class ExtendedResidueTableTest : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(ExtendedResidueTableTest);
+		CPPUNIT_TEST(testMasses);
+		CPPUNIT_TEST(testEntryWidths);
+		CPPUNIT_TEST(testExternalEntries);
+		CPPUNIT_TEST(testOverflow);
+		CPPUNIT_TEST(testWitnesses);
+		CPPUNIT_TEST(testThreads);
+		CPPUNIT_TEST_SUITE_END();
+	private:
+		typedef ExtendedResidueTable<long unsigned int> table_type;
+		typedef table_type::value_type value_type;
+		typedef table_type::column_type column_type;
+		typedef std::vector< std::pair<std::size_t, unsigned int> > witness_vector_type;
+
+		/**
+		 * Weights 6, 7, 11, 15.
+		 */
+		Weights getWeights();
+
+	public:
+		void testMasses();
+		void testEntryWidths();
+		void testExternalEntries();
+		void testOverflow();
+		void testWitnesses();
+		void testThreads();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ExtendedResidueTableTest);
+
+Weights ExtendedResidueTableTest::getWeights() {
+	Weights::alphabet_masses_type masses;
+	masses.push_back(0.6);
+	masses.push_back(0.7);
+	masses.push_back(1.1);
+	masses.push_back(1.5);
+	return Weights(masses, 0.1);
+}
+
+void ExtendedResidueTableTest::testMasses() {
+	Weights weights = getWeights();
+	column_type lcms(weights.size()), mass_in_lcms(weights.size());
+	witness_vector_type witness_vector;
+	table_type table(weights, lcms, mass_in_lcms, witness_vector);
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<std::size_t>(4), table.getNumberOfColumns());
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(6), table.getNumberOfResidues());
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(90), table.infinity());
+	CPPUNIT_ASSERT_EQUAL(static_cast<std::size_t>(6), witness_vector.size());
+
+	// smallest masses decomposable over {6}, {6, 7}, {6, 7, 11} and all weights
+	const value_type infty = table.infinity();
+	const value_type expected[4][6] = {
+		{ 0, infty, infty, infty, infty, infty },
+		{ 0, 7, 14, 21, 28, 35 },
+		{ 0, 7, 14, 21, 22, 11 },
+		{ 0, 7, 14, 15, 22, 11 }
+	};
+	for (std::size_t i = 0; i < 4; ++i) {
+		column_type masses;
+		table.getMasses(i, masses);
+		for (value_type r = 0; r < 6; ++r) {
+			CPPUNIT_ASSERT_EQUAL(expected[i][r], table.get(i, r));
+			CPPUNIT_ASSERT_EQUAL(expected[i][r], masses[r]);
+		}
+	}
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(42), lcms[1]);
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(6), mass_in_lcms[1]);
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(30), lcms[3]);
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(2), mass_in_lcms[3]);
+
+	// columns are set from masses
+	table_type copy(4, 6, infty);
+	for (std::size_t i = 0; i < 4; ++i) {
+		column_type masses;
+		table.getMasses(i, masses);
+		copy.setMasses(i, masses);
+	}
+	CPPUNIT_ASSERT(std::equal(table.data(), table.data() + table.size(), copy.data()));
+}
+
+void ExtendedResidueTableTest::testEntryWidths() {
+	Weights weights = getWeights();
+	column_type lcms(weights.size()), mass_in_lcms(weights.size());
+	witness_vector_type witness_vector, witness_vector64;
+	table_type table(weights, lcms, mass_in_lcms, witness_vector);
+	ExtendedResidueTable<long unsigned int, uint64_t> table64(weights, lcms, mass_in_lcms,
+															  witness_vector64);
+
+	CPPUNIT_ASSERT(witness_vector == witness_vector64);
+	for (std::size_t i = 0; i < 4; ++i) {
+		for (value_type r = 0; r < 6; ++r) {
+			CPPUNIT_ASSERT_EQUAL(table64.get(i, r), table.get(i, r));
+		}
+	}
+}
+
+void ExtendedResidueTableTest::testExternalEntries() {
+	Weights weights = getWeights();
+	column_type lcms(weights.size()), mass_in_lcms(weights.size());
+	witness_vector_type witness_vector;
+	table_type table(weights, lcms, mass_in_lcms, witness_vector);
+
+	std::vector<table_type::residue_type> entries(table.data(), table.data() + table.size());
+	table_type external(4, 6, table.infinity(), entries.data());
+	CPPUNIT_ASSERT(external.data() == entries.data());
+	table_type copy(external);
+	CPPUNIT_ASSERT(copy.data() == entries.data());
+	for (std::size_t i = 0; i < 4; ++i) {
+		for (value_type r = 0; r < 6; ++r) {
+			CPPUNIT_ASSERT_EQUAL(table.get(i, r), copy.get(i, r));
+		}
+	}
+}
+
+void ExtendedResidueTableTest::testOverflow() {
+	Weights::alphabet_masses_type masses;
+	masses.push_back(1.0);
+	masses.push_back(300.0);
+	Weights weights(masses, 1.0);
+	column_type lcms(2), mass_in_lcms(2);
+	witness_vector_type witness_vector;
+
+	// quotients up to the largest weight do not fit into 8 bits
+	CPPUNIT_ASSERT_THROW((ExtendedResidueTable<long unsigned int, uint8_t>(weights, lcms,
+		mass_in_lcms, witness_vector)), std::overflow_error);
+	CPPUNIT_ASSERT_NO_THROW((ExtendedResidueTable<long unsigned int, uint16_t>(weights, lcms,
+		mass_in_lcms, witness_vector)));
+}
+
+void ExtendedResidueTableTest::testWitnesses() {
+	// 26 = 11 + 15, where gcd(6, 15) = 3
+	Weights::alphabet_masses_type masses;
+	masses.push_back(6.0);
+	masses.push_back(11.0);
+	masses.push_back(15.0);
+	Weights weights(masses, 1.0);
+	column_type lcms(weights.size()), mass_in_lcms(weights.size());
+	witness_vector_type witness_vector;
+	table_type table(weights, lcms, mass_in_lcms, witness_vector);
+
+	CPPUNIT_ASSERT_EQUAL(static_cast<value_type>(26), table.get(2, 2));
+	CPPUNIT_ASSERT(witness_vector[2] == std::make_pair(static_cast<std::size_t>(2), 1u));
+	// every finite mass but 0 has a witness
+	for (value_type r = 1; r < 6; ++r) {
+		CPPUNIT_ASSERT(witness_vector[r].second > 0);
+	}
+}
+
+void ExtendedResidueTableTest::testThreads() {
+	// CHNOPS, cycles of several segments
+	Weights::alphabet_masses_type masses;
+	masses.push_back(1.007825);
+	masses.push_back(12.0);
+	masses.push_back(14.003074);
+	masses.push_back(15.994915);
+	masses.push_back(30.973762);
+	masses.push_back(31.972071);
+	Weights weights(masses, 0.00001);
+	column_type lcms(weights.size()), mass_in_lcms(weights.size());
+	column_type threaded_lcms(weights.size()), threaded_mass_in_lcms(weights.size());
+	witness_vector_type witness_vector, threaded_witness_vector;
+	table_type table(weights, lcms, mass_in_lcms, witness_vector);
+	ThreadPool pool(4);
+	table_type threaded(weights, threaded_lcms, threaded_mass_in_lcms, threaded_witness_vector, pool);
+
+	CPPUNIT_ASSERT_EQUAL(table.size(), threaded.size());
+	CPPUNIT_ASSERT(std::equal(table.data(), table.data() + table.size(), threaded.data()));
+	CPPUNIT_ASSERT(witness_vector == threaded_witness_vector);
+	CPPUNIT_ASSERT(lcms == threaded_lcms);
+	CPPUNIT_ASSERT(mass_in_lcms == threaded_mass_in_lcms);
+}
@@ -0,0 +1,238 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <cstdio>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <ims/alphabet.h>
+#include <ims/weights.h>
+#include <ims/decomp/formulaindex.h>
+#include <ims/decomp/realmassdecomposer.h>
+#include <ims/decomp/decompositionconstraints.h>
+
+using namespace std;
+using namespace ims;
+
+class FormulaIndexTest : public CppUnit::TestFixture {
+		CPPUNIT_TEST_SUITE(FormulaIndexTest);
+		CPPUNIT_TEST(testFind);
+		CPPUNIT_TEST(testTables);
+		CPPUNIT_TEST(testSaveAndMap);
+		CPPUNIT_TEST(testRejectedFiles);
+		CPPUNIT_TEST(testInvalidRange);
+		CPPUNIT_TEST_SUITE_END();
+	private:
+		typedef FormulaIndex::decomposition_type decomposition_type;
+		typedef RealMassDecomposer::decompositions_type decompositions_type;
+		typedef FormulaIndex::size_type size_type;
+		typedef Element::isotopes_type isotopes_type;
+		typedef isotopes_type::peaks_container peaks_container;
+
+		/**
+		 * Collects the decompositions passing the constraints.
+		 */
+		struct DecompositionsCollector {
+			decompositions_type decompositions;
+
+			void operator()(const decomposition_type& decomposition) {
+				decompositions.push_back(decomposition);
+			}
+		};
+
+		/**
+		 * CHNO with their isotopes, sorted by mass.
+		 */
+		Alphabet getCHNOAlphabet(double mass_C = 0.0);
+
+		/**
+		 * Double bond equivalent in [0, 8].
+		 */
+		DecompositionConstraints getConstraints(const Weights& weights);
+
+		static const char* FILENAME;
+
+	public:
+		void tearDown() { remove(FILENAME); }
+		void testFind();
+		void testTables();
+		void testSaveAndMap();
+		void testRejectedFiles();
+		void testInvalidRange();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FormulaIndexTest);
+
+const char* FormulaIndexTest::FILENAME = "formulaindextest.idx";
+
+Alphabet FormulaIndexTest::getCHNOAlphabet(double mass_C) {
+	peaks_container peaksH;
+	peaksH.push_back(peaks_container::value_type(0.007825, 0.99985));
+	peaksH.push_back(peaks_container::value_type(0.014102, 0.00015));
+	peaks_container peaksC;
+	peaksC.push_back(peaks_container::value_type(mass_C, 0.9889));
+	peaksC.push_back(peaks_container::value_type(0.003355, 0.0111));
+	peaks_container peaksN;
+	peaksN.push_back(peaks_container::value_type(0.003074, 0.99634));
+	peaksN.push_back(peaks_container::value_type(0.000109, 0.00366));
+	peaks_container peaksO;
+	peaksO.push_back(peaks_container::value_type(-0.005085, 0.99762));
+	peaksO.push_back(peaks_container::value_type(-0.000868, 0.00038));
+	peaksO.push_back(peaks_container::value_type(-0.000839, 0.002));
+
+	Alphabet alphabet;
+	alphabet.push_back(Element("H", isotopes_type(peaksH, 1)));
+	alphabet.push_back(Element("C", isotopes_type(peaksC, 12)));
+	alphabet.push_back(Element("N", isotopes_type(peaksN, 14)));
+	alphabet.push_back(Element("O", isotopes_type(peaksO, 16)));
+	return alphabet;
+}
+
+DecompositionConstraints FormulaIndexTest::getConstraints(const Weights& weights) {
+	DecompositionConstraints constraints(weights);
+	const double dbe[] = { -0.5, 1.0, 0.5, 0.0 };
+	constraints.addLinearConstraint("DBE", DecompositionConstraints::coefficients_type(dbe, dbe + 4),
+									1.0, 0.0, 8.0);
+	return constraints;
+}
+
+void FormulaIndexTest::testFind() {
+	Alphabet alphabet = getCHNOAlphabet();
+	Weights weights(alphabet.getMasses(), 0.00001);
+	weights.divideByGCD();
+	RealMassDecomposer decomposer(weights);
+	DecompositionConstraints constraints = getConstraints(weights);
+	RealMassDecomposer::bounds_type bounds;
+	bounds.lower.assign(4, 0);
+	bounds.upper.assign(4, 20);
+	ThreadPool pool(3);
+
+	FormulaIndex index(alphabet, decomposer, 100.0, 160.0, bounds, constraints, "DBE", pool);
+	CPPUNIT_ASSERT(index.size() > 0);
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_type>(4), index.getNumberOfElements());
+	CPPUNIT_ASSERT(!index.isMapped());
+
+	// the index finds the decompositions the decomposer finds
+	const double masses[] = { 100.0, 120.0575, 147.0532, 147.0532, 159.9 };
+	const double errors[] = { 0.001, 0.0001, 0.0003, 0.05, 0.1 };
+	for (size_type m = 0; m < 5; ++m) {
+		DecompositionsCollector decomposed = decomposer.visitPrunedDecompositions(masses[m], errors[m],
+			bounds, ConstrainedVisitor<DecompositionsCollector>(constraints, DecompositionsCollector())).visitor;
+
+		decompositions_type found;
+		FormulaIndex::range_type range = index.find(masses[m], errors[m]);
+		for (size_type i = range.first; i < range.second; ++i) {
+			decomposition_type decomposition;
+			index.getDecomposition(i, decomposition);
+			found.push_back(decomposition);
+		}
+		sort(decomposed.decompositions.begin(), decomposed.decompositions.end());
+		sort(found.begin(), found.end());
+		CPPUNIT_ASSERT(decomposed.decompositions == found);
+		CPPUNIT_ASSERT(index.covers(masses[m], errors[m]) == (m != 0 && m != 4));
+	}
+}
+
+void FormulaIndexTest::testTables() {
+	Alphabet alphabet = getCHNOAlphabet();
+	Weights weights(alphabet.getMasses(), 0.00001);
+	weights.divideByGCD();
+	RealMassDecomposer decomposer(weights);
+	ThreadPool pool(1);
+
+	FormulaIndex index(alphabet, decomposer, 140.0, 150.0, RealMassDecomposer::bounds_type(),
+					   DecompositionConstraints(weights), "", pool);
+
+	// sorted by mass
+	for (size_type i = 1; i < index.size(); ++i) {
+		CPPUNIT_ASSERT(index.getMass(i - 1) <= index.getMass(i));
+	}
+	CPPUNIT_ASSERT(index.getMass(0) >= 140.0);
+	CPPUNIT_ASSERT(index.getMass(index.size() - 1) < 150.0);
+
+	// glutamate C5H9NO4
+	FormulaIndex::range_type range = index.find(147.053158, 0.000001);
+	CPPUNIT_ASSERT_EQUAL(range.first + 1, range.second);
+	size_type i = range.first;
+	CPPUNIT_ASSERT_EQUAL(static_cast<FormulaIndex::count_type>(9), index.getCount(i, 0));
+	CPPUNIT_ASSERT_EQUAL(static_cast<FormulaIndex::count_type>(5), index.getCount(i, 1));
+	CPPUNIT_ASSERT_EQUAL(static_cast<FormulaIndex::count_type>(1), index.getCount(i, 2));
+	CPPUNIT_ASSERT_EQUAL(static_cast<FormulaIndex::count_type>(4), index.getCount(i, 3));
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(147.053158, index.getMass(i), 1.0e-6);
+	CPPUNIT_ASSERT_EQUAL(2.0, index.getDoubleBondEquivalent(i));
+
+	// M+1 comes from exactly one heavier isotope
+	double ratio = 9 * 0.00015 / 0.99985 + 5 * 0.0111 / 0.9889 +
+		0.00366 / 0.99634 + 4 * 0.00038 / 0.99762;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(ratio, index.getIsotopeRatio(i, 1), 1.0e-6);
+	CPPUNIT_ASSERT(index.getIsotopeRatio(i, 2) > 4 * 0.002 / 0.99762);
+}
+
+void FormulaIndexTest::testSaveAndMap() {
+	Alphabet alphabet = getCHNOAlphabet();
+	Weights weights(alphabet.getMasses(), 0.00001);
+	weights.divideByGCD();
+	RealMassDecomposer decomposer(weights);
+	ThreadPool pool(2);
+
+	FormulaIndex index(alphabet, decomposer, 50.0, 120.0, RealMassDecomposer::bounds_type(),
+					   getConstraints(weights), "DBE", pool);
+	index.save(FILENAME);
+
+	FormulaIndex mapped(FILENAME, alphabet, "DBE");
+	CPPUNIT_ASSERT(mapped.isMapped());
+	CPPUNIT_ASSERT_EQUAL(index.size(), mapped.size());
+	CPPUNIT_ASSERT_EQUAL(index.getNumberOfElements(), mapped.getNumberOfElements());
+	CPPUNIT_ASSERT_EQUAL(50.0, mapped.getMinMass());
+	CPPUNIT_ASSERT_EQUAL(120.0, mapped.getMaxMass());
+	CPPUNIT_ASSERT_EQUAL(string("DBE"), mapped.getParameters());
+	for (size_type i = 0; i < index.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(index.getMass(i), mapped.getMass(i));
+		CPPUNIT_ASSERT_EQUAL(index.getDoubleBondEquivalent(i), mapped.getDoubleBondEquivalent(i));
+		CPPUNIT_ASSERT(mapped.getDoubleBondEquivalent(i) >= 0.0 && mapped.getDoubleBondEquivalent(i) <= 8.0);
+		CPPUNIT_ASSERT_EQUAL(index.getIsotopeRatio(i, 1), mapped.getIsotopeRatio(i, 1));
+		CPPUNIT_ASSERT_EQUAL(index.getIsotopeRatio(i, 2), mapped.getIsotopeRatio(i, 2));
+		for (size_type e = 0; e < index.getNumberOfElements(); ++e) {
+			CPPUNIT_ASSERT_EQUAL(index.getCount(i, e), mapped.getCount(i, e));
+		}
+	}
+	CPPUNIT_ASSERT(index.find(100.0, 0.5) == mapped.find(100.0, 0.5));
+}
+
+void FormulaIndexTest::testRejectedFiles() {
+	Alphabet alphabet = getCHNOAlphabet();
+	Weights weights(alphabet.getMasses(), 0.00001);
+	weights.divideByGCD();
+	RealMassDecomposer decomposer(weights);
+	ThreadPool pool(1);
+
+	CPPUNIT_ASSERT_THROW(FormulaIndex(FILENAME, alphabet, ""), IOException);
+
+	FormulaIndex(alphabet, decomposer, 50.0, 60.0, RealMassDecomposer::bounds_type(),
+				 DecompositionConstraints(weights), "", pool).save(FILENAME);
+	CPPUNIT_ASSERT_NO_THROW(FormulaIndex(FILENAME, alphabet, ""));
+
+	// other parameters or element masses
+	CPPUNIT_ASSERT_THROW(FormulaIndex(FILENAME, alphabet, "DBE"), IOException);
+	CPPUNIT_ASSERT_THROW(FormulaIndex(FILENAME, getCHNOAlphabet(0.0001), ""), IOException);
+
+	// no index at all
+	{
+		ofstream out(FILENAME);
+		out << "C5H9NO4";
+	}
+	CPPUNIT_ASSERT_THROW(FormulaIndex(FILENAME, alphabet, ""), IOException);
+}
+
+void FormulaIndexTest::testInvalidRange() {
+	Alphabet alphabet = getCHNOAlphabet();
+	Weights weights(alphabet.getMasses(), 0.00001);
+	RealMassDecomposer decomposer(weights);
+	ThreadPool pool(1);
+
+	CPPUNIT_ASSERT_THROW(FormulaIndex(alphabet, decomposer, 60.0, 50.0, RealMassDecomposer::bounds_type(),
+									  DecompositionConstraints(weights), "", pool), invalid_argument);
+	// too many hydrogens for the counts of the index
+	CPPUNIT_ASSERT_THROW(FormulaIndex(alphabet, decomposer, 70000.0, 70001.0, RealMassDecomposer::bounds_type(),
+									  DecompositionConstraints(weights), "", pool), invalid_argument);
+}
@@ -9,6 +9,8 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <cstdio>
 #include <ims/decomp/integermassdecomposer.h>
 #include <ims/weights.h>
 
@@ -22,6 +24,12 @@ class IntegerMassDecomposerTest : public CppUnit::TestFixture {
 		CPPUNIT_TEST(testGetDecomposition);
 		CPPUNIT_TEST(testGetNumberOfDecompositions);
 		CPPUNIT_TEST(testGetAllDecompositions);
+		CPPUNIT_TEST(testGetAllDecompositionsInRange);
+		CPPUNIT_TEST(testGetAllDecompositionsFlat);
+		CPPUNIT_TEST(testVisitDecompositionsWithBounds);
+		CPPUNIT_TEST(testSaveAndMap);
+		CPPUNIT_TEST(testParallelSplit);
+		CPPUNIT_TEST(testCountDecompositions);
 		CPPUNIT_TEST_SUITE_END();
 	private:
 		typedef DecomposerType decomposer_type;
@@ -36,11 +44,47 @@ class IntegerMassDecomposerTest : public CppUnit::TestFixture {
 		typedef typename Weights::alphabet_masses_type 
 											alphabet_masses_type;
 		typedef typename Weights::weights_type weights_type;
+
+		/**
+		 * Collects the decompositions it visits.
+		 */
+		struct DecompositionsCollector {
+			decompositions_type decompositions;
+			void operator()(const decomposition_type& decomposition) {
+				decompositions.push_back(decomposition);
+			}
+		};
 		
+		/**
+		 * Counts the branches it is asked for.
+		 */
+		struct BranchCounter {
+			typename decompositions_type::size_type* branches;
+			explicit BranchCounter(typename decompositions_type::size_type* branches) :
+				branches(branches) { }
+			bool acceptsBranch(const decomposition_type&, typename decomposition_type::size_type,
+							   value_type, value_type) {
+				++*branches;
+				return true;
+			}
+			void operator()(const decomposition_type&) { }
+		};
+
+		/**
+		 * Weights of the elements C, H, N, O, P and S.
+		 */
+		static Weights getCHNOPSWeights(alphabet_mass_type precision);
+
 		void checkDecomposition(const decomposition_value_type* elements,
 			const decompositions_type& decompositions);
 	
 		void checkDecomposition(decomposer_type *decomposer, value_type mass);
+
+		void checkDecompositionsInRange(decomposer_type *decomposer,
+			value_type lo, value_type hi);
+
+		void checkDecompositionsWithBounds(decomposer_type *decomposer,
+			value_type lo, value_type hi, const typename decomposer_type::bounds_type& bounds);
 		
 		Weights* weights;
 	public:
@@ -51,6 +95,12 @@ class IntegerMassDecomposerTest : public CppUnit::TestFixture {
 		void testGetDecomposition();
 		void testGetNumberOfDecompositions();
 		void testGetAllDecompositions();		
+		void testGetAllDecompositionsInRange();
+		void testGetAllDecompositionsFlat();
+		void testVisitDecompositionsWithBounds();
+		void testSaveAndMap();
+		void testParallelSplit();
+		void testCountDecompositions();
 };
 
 typedef IntegerMassDecomposerTest<IntegerMassDecomposer<> > 	DecomposerType;
@@ -188,3 +238,269 @@ checkDecomposition(const decomposition_value_type* elements,
 	CPPUNIT_ASSERT(decompositionPos2 == decompositions.end());		
 }
 
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::testGetAllDecompositionsInRange() {
+	decomposer_type *decomposer = new decomposer_type(*weights);
+
+	CPPUNIT_ASSERT(decomposer->getAllDecompositions(45, 44).empty());
+	CPPUNIT_ASSERT(decomposer->getAllDecompositions(44, 44).size() == 6);
+	CPPUNIT_ASSERT(decomposer->getAllDecompositions(16, 16).empty());
+
+	checkDecompositionsInRange(decomposer, 0, 0);
+	checkDecompositionsInRange(decomposer, 0, 20);
+	checkDecompositionsInRange(decomposer, 40, 44);
+	checkDecompositionsInRange(decomposer, 97, 100);
+	// interval wider than the smallest weight
+	checkDecompositionsInRange(decomposer, 90, 130);
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::
+checkDecompositionsInRange(decomposer_type *decomposer, value_type lo, value_type hi) {
+	decompositions_type expected;
+	for (value_type mass = lo; mass <= hi; ++mass) {
+		decompositions_type decompositions = decomposer->getAllDecompositions(mass);
+		expected.insert(expected.end(), decompositions.begin(), decompositions.end());
+	}
+	decompositions_type decompositions = decomposer->getAllDecompositions(lo, hi);
+
+	sort(expected.begin(), expected.end());
+	sort(decompositions.begin(), decompositions.end());
+	CPPUNIT_ASSERT(decompositions == expected);
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::testGetAllDecompositionsFlat() {
+	decomposer_type *decomposer = new decomposer_type(*weights);
+	decompositions_type decompositions = decomposer->getAllDecompositions(40, 100);
+
+	typename decomposer_type::flat_decompositions_type flat;
+	decomposer->getAllDecompositions(40, 100, flat);
+	CPPUNIT_ASSERT(flat.size() == decompositions.size() * weights->size());
+	for (typename decompositions_type::size_type i = 0; i < decompositions.size(); ++i) {
+		CPPUNIT_ASSERT(std::equal(decompositions[i].begin(), decompositions[i].end(),
+								  flat.begin() + i * weights->size()));
+	}
+
+	typename decompositions_type::size_type visited = 0;
+	decomposer->visitDecompositions(100, 100, [&visited](const decomposition_type&) {
+		++visited;
+	});
+	CPPUNIT_ASSERT(visited == 40);
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::testVisitDecompositionsWithBounds() {
+	decomposer_type *decomposer = new decomposer_type(*weights);
+	typename decomposer_type::bounds_type bounds;
+
+	// no bounds
+	checkDecompositionsWithBounds(decomposer, 90, 130, bounds);
+
+	// upper bounds only, missing entries are unbounded
+	bounds.upper.push_back(3);
+	bounds.upper.push_back(20);
+	bounds.upper.push_back(1);
+	checkDecompositionsWithBounds(decomposer, 90, 130, bounds);
+	checkDecompositionsWithBounds(decomposer, 100, 100, bounds);
+
+	// lower and upper bounds
+	bounds.lower.push_back(1);
+	bounds.lower.push_back(0);
+	bounds.lower.push_back(1);
+	bounds.upper.push_back(2);
+	checkDecompositionsWithBounds(decomposer, 0, 200, bounds);
+	checkDecompositionsWithBounds(decomposer, 17, 17, bounds);
+
+	// lower bounds exceed the masses
+	CPPUNIT_ASSERT(decomposer->visitDecompositions(0, 16, bounds, 
+		DecompositionsCollector()).decompositions.empty());
+
+	CPPUNIT_ASSERT(decomposer->getNumberOfDecompositions(0, 16, bounds) == 0);
+
+	// contradicting bounds
+	bounds.lower[0] = 4;
+	CPPUNIT_ASSERT(decomposer->visitDecompositions(0, 200, bounds, 
+		DecompositionsCollector()).decompositions.empty());
+	CPPUNIT_ASSERT(decomposer->getNumberOfDecompositions(0, 200, bounds) == 0);
+	delete decomposer;
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::
+checkDecompositionsWithBounds(decomposer_type *decomposer, value_type lo, value_type hi,
+							  const typename decomposer_type::bounds_type& bounds) {
+	// bounded traversal gives the unbounded decompositions within the bounds, in the same order
+	decompositions_type expected;
+	decompositions_type all = decomposer->getAllDecompositions(lo, hi);
+	for (typename decompositions_type::const_iterator it = all.begin(); it != all.end(); ++it) {
+		bool within = true;
+		for (typename decomposition_type::size_type i = 0; i < it->size(); ++i) {
+			if ((i < bounds.lower.size() && (*it)[i] < bounds.lower[i]) ||
+				(i < bounds.upper.size() && (*it)[i] > bounds.upper[i])) {
+				within = false;
+			}
+		}
+		if (within) {
+			expected.push_back(*it);
+		}
+	}
+
+	decompositions_type decompositions;
+	decomposer->visitDecompositions(lo, hi, bounds, [&decompositions](const decomposition_type& decomposition) {
+		decompositions.push_back(decomposition);
+	});
+	CPPUNIT_ASSERT(decompositions == expected);
+
+	ThreadPool pool(3);
+	std::vector<DecompositionsCollector> parts = 
+		decomposer->visitDecompositions(lo, hi, bounds, DecompositionsCollector(), pool);
+	decompositions.clear();
+	for (typename std::vector<DecompositionsCollector>::const_iterator it = parts.begin(); 
+															it != parts.end(); ++it) {
+		decompositions.insert(decompositions.end(), it->decompositions.begin(), it->decompositions.end());
+	}
+	CPPUNIT_ASSERT(decompositions == expected);
+
+	// counting without enumerating gives the same number
+	CPPUNIT_ASSERT(decomposer->getNumberOfDecompositions(lo, hi, bounds) == expected.size());
+	CPPUNIT_ASSERT(decomposer->getNumberOfDecompositions(lo, hi, bounds, pool) == expected.size());
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::testSaveAndMap() {
+	const char* filename = "integermassdecomposertest.ert";
+	decomposer_type decomposer(*weights);
+	CPPUNIT_ASSERT(!decomposer.isMapped());
+	decomposer.save(filename);
+
+	// the mapped table decomposes like the computed one
+	decomposer_type mapped(*weights, filename);
+	CPPUNIT_ASSERT(mapped.isMapped());
+	for (value_type mass = 0; mass <= 100; ++mass) {
+		CPPUNIT_ASSERT(mapped.exist(mass) == decomposer.exist(mass));
+		CPPUNIT_ASSERT(mapped.getDecomposition(mass) == decomposer.getDecomposition(mass));
+	}
+	CPPUNIT_ASSERT(mapped.getAllDecompositions(90, 130) == decomposer.getAllDecompositions(90, 130));
+	CPPUNIT_ASSERT(mapped.getNumberOfDecompositions(100) == 40);
+
+	// copies share the mapping
+	decomposer_type copy(mapped);
+	CPPUNIT_ASSERT(copy.isMapped());
+	CPPUNIT_ASSERT(copy.getAllDecompositions(44).size() == 6);
+
+	// intervals are searched in the mapped table, over blocks of residues and
+	// wrapping around, and pruned like with the computed residue tables
+	Weights large = getCHNOPSWeights(0.001);
+	const char* largeFilename = "integermassdecomposertest-chnops.ert";
+	decomposer_type computed(large);
+	computed.save(largeFilename);
+	decomposer_type mappedLarge(large, largeFilename);
+	for (value_type width = 0; width <= 2100; width = 2 * width + 7) {
+		const value_type lo = 180000 + width;
+		decompositions_type expected = computed.getAllDecompositions(lo, lo + width);
+		CPPUNIT_ASSERT(mappedLarge.getAllDecompositions(lo, lo + width) == expected);
+
+		typename decompositions_type::size_type computedBranches = 0, mappedBranches = 0;
+		computed.visitPrunedDecompositions(lo, lo + width, typename decomposer_type::bounds_type(),
+			BranchCounter(&computedBranches));
+		mappedLarge.visitPrunedDecompositions(lo, lo + width, typename decomposer_type::bounds_type(),
+			BranchCounter(&mappedBranches));
+		CPPUNIT_ASSERT(computedBranches > 0 && mappedBranches == computedBranches);
+	}
+	CPPUNIT_ASSERT(mappedLarge.getNumberOfDecompositions(180000, 182100,
+		typename decomposer_type::bounds_type()) > 0);
+	std::remove(largeFilename);
+
+	// tables of other weights
+	alphabet_masses_type masses;
+	masses.push_back(0.6);
+	masses.push_back(0.7);
+	masses.push_back(1.1);
+	masses.push_back(1.6);
+	CPPUNIT_ASSERT_THROW(decomposer_type(Weights(masses, 0.1), filename), IOException);
+	CPPUNIT_ASSERT_THROW(decomposer_type(Weights(masses, 0.05), filename), IOException);
+
+	// no residue table at all
+	{
+		std::ofstream out(filename);
+		out << "C5H9NO4";
+	}
+	CPPUNIT_ASSERT_THROW(decomposer_type(*weights, filename), IOException);
+	std::remove(filename);
+	CPPUNIT_ASSERT_THROW(decomposer_type(*weights, filename), IOException);
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::testParallelSplit() {
+	decomposer_type decomposer(getCHNOPSWeights(0.001));
+	ThreadPool single(1), pool(2), other(4);
+
+	// a single thread does not split the traversal
+	std::vector<DecompositionsCollector> parts =
+		decomposer.visitDecompositions(180000, 180010, DecompositionsCollector(), single);
+	CPPUNIT_ASSERT(parts.size() == 1);
+	CPPUNIT_ASSERT(parts[0].decompositions == decomposer.getAllDecompositions(180000, 180010));
+
+	// neither do threads for narrow intervals
+	CPPUNIT_ASSERT(decomposer.visitDecompositions(180000, 180010,
+		DecompositionsCollector(), pool).size() == 1);
+
+	// wide intervals are split in the same way for any number of threads
+	parts = decomposer.visitDecompositions(180000, 200000, DecompositionsCollector(), pool);
+	std::vector<DecompositionsCollector> otherParts =
+		decomposer.visitDecompositions(180000, 200000, DecompositionsCollector(), other);
+	CPPUNIT_ASSERT(parts.size() > 16 && parts.size() == otherParts.size());
+	decompositions_type decompositions;
+	for (typename std::vector<DecompositionsCollector>::size_type i = 0; i < parts.size(); ++i) {
+		CPPUNIT_ASSERT(parts[i].decompositions == otherParts[i].decompositions);
+		decompositions.insert(decompositions.end(), parts[i].decompositions.begin(),
+							  parts[i].decompositions.end());
+	}
+	CPPUNIT_ASSERT(decompositions == decomposer.getAllDecompositions(180000, 200000));
+}
+
+template <typename DecomposerType>
+void IntegerMassDecomposerTest<DecomposerType>::testCountDecompositions() {
+	decomposer_type decomposer(getCHNOPSWeights(0.001));
+	typename decomposer_type::bounds_type bounds;
+
+	// counted by the table of the three smallest masses, which grows with the masses
+	checkDecompositionsWithBounds(&decomposer, 100000, 100500, bounds);
+	checkDecompositionsWithBounds(&decomposer, 250000, 250200, bounds);
+	checkDecompositionsWithBounds(&decomposer, 0, 2000, bounds);
+	CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(0) == 1);
+	CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(1008) == 1);
+
+	// copies share the table
+	decomposer_type copy(decomposer);
+	CPPUNIT_ASSERT(copy.getNumberOfDecompositions(180000, 180100, bounds) ==
+		decomposer.getAllDecompositions(180000, 180100).size());
+
+	// bounds of the larger masses keep the table
+	bounds.upper.resize(4, 20);
+	bounds.upper[3] = 2;
+	bounds.lower.resize(4, 0);
+	bounds.lower[3] = 1;
+	checkDecompositionsWithBounds(&decomposer, 150000, 150500, bounds);
+
+	// bounds of the three smallest masses are counted without it
+	bounds.upper[1] = 3;
+	checkDecompositionsWithBounds(&decomposer, 150000, 150500, bounds);
+	bounds.upper[1] = 20;
+	bounds.upper[0] = 10;
+	checkDecompositionsWithBounds(&decomposer, 150000, 150500, bounds);
+}
+
+template <typename DecomposerType>
+Weights IntegerMassDecomposerTest<DecomposerType>::getCHNOPSWeights(alphabet_mass_type precision) {
+	alphabet_masses_type masses;
+	masses.push_back(1.007825);
+	masses.push_back(12.0);
+	masses.push_back(14.003074);
+	masses.push_back(15.994915);
+	masses.push_back(30.973762);
+	masses.push_back(31.972071);
+	return Weights(masses, precision);
+}
@@ -17,18 +17,26 @@ using namespace ims;
 class RealMassDecomposerTest : public CppUnit::TestFixture {
 		CPPUNIT_TEST_SUITE(RealMassDecomposerTest);
 		CPPUNIT_TEST(testGetDecompositions);
+		CPPUNIT_TEST(testGetDecompositionsInParallel);
+		CPPUNIT_TEST(testGetDecompositionsWithBounds);
+		CPPUNIT_TEST(testGetNumberOfDecompositions);
 		CPPUNIT_TEST_SUITE_END();
 	private:
 		typedef RealMassDecomposer decomposer_type;
 		typedef decomposer_type::decompositions_type decompositions_type;
 
+		Weights getCHNOPSWeights();
+
 	public:
 		void testGetDecompositions();
+		void testGetDecompositionsInParallel();
+		void testGetDecompositionsWithBounds();
+		void testGetNumberOfDecompositions();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(RealMassDecomposerTest);
 
-void RealMassDecomposerTest::testGetDecompositions() {
+Weights RealMassDecomposerTest::getCHNOPSWeights() {
 	typedef Weights::alphabet_mass_type alphabet_mass_type;
 	typedef Weights::alphabet_masses_type alphabet_masses_type;
 
@@ -44,7 +52,11 @@ void RealMassDecomposerTest::testGetDecompositions() {
 	mono_masses.push_back(mono_mass_P);
 	mono_masses.push_back(mono_mass_S);
 
-	Weights alphabet_weights(mono_masses, 0.00001);
+	return Weights(mono_masses, 0.00001);
+}
+
+void RealMassDecomposerTest::testGetDecompositions() {
+	Weights alphabet_weights = getCHNOPSWeights();
 
 	decomposer_type decomposer(alphabet_weights);
 
@@ -60,3 +72,85 @@ void RealMassDecomposerTest::testGetDecompositions() {
 		}
 	}
 }
+
+void RealMassDecomposerTest::testGetDecompositionsInParallel() {
+	Weights alphabet_weights = getCHNOPSWeights();
+	alphabet_weights.divideByGCD();
+
+	decomposer_type decomposer(alphabet_weights);
+	ThreadPool serial(1), parallel(4);
+
+	double masses[] = { 147.0529, 523.2, 1022.4 }, error = 0.002;
+	for (unsigned i = 0; i < sizeof(masses) / sizeof(masses[0]); ++i) {
+		decompositions_type decompositions = decomposer.getDecompositions(masses[i], error);
+		CPPUNIT_ASSERT(decompositions == decomposer.getDecompositions(masses[i], error, serial));
+		CPPUNIT_ASSERT(decompositions == decomposer.getDecompositions(masses[i], error, parallel));
+		CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(masses[i], error, parallel) == 
+					   decompositions.size());
+	}
+}
+
+void RealMassDecomposerTest::testGetDecompositionsWithBounds() {
+	Weights alphabet_weights = getCHNOPSWeights();
+	alphabet_weights.divideByGCD();
+
+	decomposer_type decomposer(alphabet_weights);
+	ThreadPool pool(4);
+
+	// at most 40 H and 100 C, N or O, at least one N, at most two P and one S
+	decomposer_type::bounds_type bounds;
+	bounds.lower.push_back(0);
+	bounds.lower.push_back(0);
+	bounds.lower.push_back(1);
+	bounds.upper.push_back(40);
+	bounds.upper.push_back(100);
+	bounds.upper.push_back(100);
+	bounds.upper.push_back(100);
+	bounds.upper.push_back(2);
+	bounds.upper.push_back(1);
+
+	double mass = 523.2, error = 0.005;
+	decompositions_type expected;
+	decompositions_type decompositions = decomposer.getDecompositions(mass, error);
+	for (decompositions_type::const_iterator it = decompositions.begin(); 
+										it != decompositions.end(); ++it) {
+		if ((*it)[0] <= 40 && (*it)[1] <= 100 && (*it)[2] >= 1 && (*it)[2] <= 100 &&
+			(*it)[3] <= 100 && (*it)[4] <= 2 && (*it)[5] <= 1) {
+			expected.push_back(*it);
+		}
+	}
+	CPPUNIT_ASSERT(!expected.empty());
+	CPPUNIT_ASSERT(expected.size() < decompositions.size());
+	CPPUNIT_ASSERT(expected == decomposer.getDecompositions(mass, error, bounds, pool));
+	CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(mass, error, bounds) == expected.size());
+	CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(mass, error, bounds, pool) == expected.size());
+}
+
+void RealMassDecomposerTest::testGetNumberOfDecompositions() {
+	Weights alphabet_weights = getCHNOPSWeights();
+	alphabet_weights.divideByGCD();
+
+	decomposer_type decomposer(alphabet_weights);
+	decomposer_type::bounds_type bounds;
+	ThreadPool pool(4);
+
+	// wide errors have integer masses certainly within the error, 
+	// narrow ones only integer masses to be checked
+	double masses[] = { 147.0529, 523.2, 1022.4 }, errors[] = { 0.0002, 0.002, 0.05 };
+	for (unsigned i = 0; i < sizeof(masses) / sizeof(masses[0]); ++i) {
+		for (unsigned j = 0; j < sizeof(errors) / sizeof(errors[0]); ++j) {
+			decomposer_type::number_of_decompositions_type number = 
+				decomposer.getDecompositions(masses[i], errors[j]).size();
+			CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(masses[i], errors[j]) == number);
+			CPPUNIT_ASSERT(decomposer.getNumberOfDecompositions(masses[i], errors[j], pool) == number);
+
+			std::pair<decomposer_type::number_of_decompositions_type, 
+					  decomposer_type::number_of_decompositions_type> range = 
+				decomposer.getNumberOfDecompositionsBounds(masses[i], errors[j], bounds);
+			CPPUNIT_ASSERT(range.first <= number && number <= range.second);
+			CPPUNIT_ASSERT(range == decomposer.getNumberOfDecompositionsBounds(masses[i], errors[j], 
+																			   bounds, pool));
+		}
+	}
+	CPPUNIT_ASSERT(decomposer.getNumberOfDecompositionsBounds(1022.4, 0.05, bounds).first > 0);
+}
@@ -1,7 +1,11 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
 
+#include <cmath>
+#include <ims/alphabet.h>
+#include <ims/composedelement.h>
 #include <ims/distributionprobabilityscorer.h>
+#include <ims/utils/erfc.h>
 
 using namespace ims;
 
@@ -9,10 +13,22 @@ class DistributionProbabilityScorerTest : public CppUnit::TestFixture
 {
 	CPPUNIT_TEST_SUITE(DistributionProbabilityScorerTest);
 	CPPUNIT_TEST(testScore);
+	CPPUNIT_TEST(testScoreStaged);
+	CPPUNIT_TEST(testScoreBatch);
+	CPPUNIT_TEST(testFastErfc);
+	CPPUNIT_TEST(testLogErfc);
+	CPPUNIT_TEST(testLogScore);
+	CPPUNIT_TEST(testLogScoreIsotopeRatio);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void testScore();
+	void testScoreStaged();
+	void testScoreBatch();
+	void testFastErfc();
+	void testLogErfc();
+	void testLogScore();
+	void testLogScoreIsotopeRatio();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(DistributionProbabilityScorerTest);
@@ -42,3 +58,241 @@ void DistributionProbabilityScorerTest::testScore() {
 	//printf("dps.score(measured_distribution) = %.30f\n", dps.score(measured_distribution));
 	//CPPUNIT_ASSERT_DOUBLES_EQUAL(3.0, dps.score(measured_distribution), 1e-10);
 }
+
+void DistributionProbabilityScorerTest::testScoreStaged() {
+	typedef IsotopeDistribution::peaks_container peaks_container;
+	typedef DistributionProbabilityScorer::masses_container masses_container;
+	typedef DistributionProbabilityScorer::abundances_container abundances_container;
+
+	Alphabet alphabet;
+	peaks_container peaks;
+	peaks.push_back(peaks_container::value_type(0.007825, 0.99985));
+	peaks.push_back(peaks_container::value_type(0.014102, 0.00015));
+	alphabet.push_back(Element("H", IsotopeDistribution(peaks, 1)));
+	peaks.clear();
+	peaks.push_back(peaks_container::value_type(0.0, 0.9889));
+	peaks.push_back(peaks_container::value_type(0.003355, 0.0111));
+	alphabet.push_back(Element("C", IsotopeDistribution(peaks, 12)));
+	peaks.clear();
+	peaks.push_back(peaks_container::value_type(-0.005085, 0.99762));
+	peaks.push_back(peaks_container::value_type(-0.000868, 0.00038));
+	peaks.push_back(peaks_container::value_type(-0.000839, 0.002));
+	alphabet.push_back(Element("O", IsotopeDistribution(peaks, 16)));
+
+	// measured glucose
+	masses_container measured_masses;
+	measured_masses.push_back(180.06339);
+	measured_masses.push_back(181.06674);
+	measured_masses.push_back(182.06812);
+	abundances_container measured_abundances;
+	measured_abundances.push_back(0.9210);
+	measured_abundances.push_back(0.0660);
+	measured_abundances.push_back(0.0130);
+	DistributionProbabilityScorer scorer(measured_masses, measured_abundances);
+
+	const char* formulas[] = { "C6H12O6", "C7H16O5", "C10H20", "C2H4O" };
+	for (unsigned int f = 0; f < sizeof(formulas) / sizeof(formulas[0]); ++f) {
+		ComposedElement molecule(formulas[f], alphabet);
+		molecule.updateIsotopeDistribution();
+		const IsotopeDistribution& distribution = molecule.getIsotopeDistribution();
+
+		// candidate abundances normalized over the measured peaks
+		masses_container masses = distribution.getMasses();
+		abundances_container abundances = distribution.getAbundances();
+		double sum = abundances[0] + abundances[1] + abundances[2];
+		for (unsigned int i = 0; i < 3; ++i) {
+			abundances[i] *= 1 / sum;
+		}
+
+		// the same factors in the same order
+		CPPUNIT_ASSERT_EQUAL(scorer.score(masses, abundances), scorer.score(distribution, 3, 1 / sum));
+		CPPUNIT_ASSERT_EQUAL(scorer.scores(masses, abundances)[0], scorer.scoreMonoisotopicMass(masses[0]));
+		CPPUNIT_ASSERT(scorer.score(distribution, 3, 1 / sum) <= scorer.scoreMonoisotopicMass(masses[0]));
+	}
+	// far from the measured mass
+	ComposedElement molecule("C2H4O", alphabet);
+	molecule.updateIsotopeDistribution();
+	CPPUNIT_ASSERT_EQUAL(0.0, scorer.scoreMonoisotopicMass(molecule.getIsotopeDistribution().getMass(0)));
+	CPPUNIT_ASSERT_EQUAL(0.0, scorer.score(molecule.getIsotopeDistribution(), 3));
+}
+
+void DistributionProbabilityScorerTest::testScoreBatch() {
+	typedef DistributionProbabilityScorer::masses_container masses_container;
+	typedef DistributionProbabilityScorer::abundances_container abundances_container;
+	typedef DistributionProbabilityScorer::score_type score_type;
+
+	masses_container measured_masses;
+	measured_masses.push_back(180.06339);
+	measured_masses.push_back(181.06674);
+	measured_masses.push_back(182.06812);
+	abundances_container measured_abundances;
+	measured_abundances.push_back(0.9210);
+	measured_abundances.push_back(0.0660);
+	measured_abundances.push_back(0.0130);
+	DistributionProbabilityScorer scorer(measured_masses, measured_abundances);
+	scorer.setMassPrecision(5);
+
+	// candidates shifted against the measured peaks, one per row
+	const unsigned int candidates = 7, peaks = 3;
+	std::vector<double> masses(candidates * peaks), abundances(candidates * peaks);
+	for (unsigned int c = 0; c < candidates; ++c) {
+		for (unsigned int i = 0; i < peaks; ++i) {
+			masses[i * candidates + c] = measured_masses[i] + 0.0002 * c * (i + 1);
+			abundances[i * candidates + c] = measured_abundances[i] * (1.0 + 0.03 * c * i);
+		}
+	}
+
+	std::vector<score_type> exact_scores(candidates), fast_scores(candidates);
+	scorer.scoreBatch(&masses[0], &abundances[0], candidates, peaks, &exact_scores[0], true);
+	scorer.scoreBatch(&masses[0], &abundances[0], candidates, peaks, &fast_scores[0]);
+	for (unsigned int c = 0; c < candidates; ++c) {
+		masses_container candidate_masses;
+		abundances_container candidate_abundances;
+		for (unsigned int i = 0; i < peaks; ++i) {
+			candidate_masses.push_back(masses[i * candidates + c]);
+			candidate_abundances.push_back(abundances[i * candidates + c]);
+		}
+		const score_type score = scorer.score(candidate_masses, candidate_abundances);
+		CPPUNIT_ASSERT_EQUAL(score, exact_scores[c]);
+		// 7 factors, each with a relative error below 1.2e-7
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(score, fast_scores[c], score * 1.0e-6);
+	}
+	CPPUNIT_ASSERT(exact_scores[0] > exact_scores[candidates - 1]);
+}
+
+void DistributionProbabilityScorerTest::testFastErfc() {
+	for (double z = 0.0; z < 26.0; z += 0.001) {
+		const double exact = erfc(z);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(exact, fastErfc(z), exact * 1.2e-7);
+	}
+	CPPUNIT_ASSERT(fastErfc(30.0) < 3.0e-307);
+	CPPUNIT_ASSERT(fastErfc(HUGE_VAL) < 3.0e-307);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(std::exp(-700.0), fastExpNonPositive(-700.0), std::exp(-700.0) * 1.0e-11);
+}
+
+void DistributionProbabilityScorerTest::testLogErfc() {
+	for (double z = 0.0; z < 26.0; z += 0.01) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(std::log(erfc(z)), logErfc(z), 1.0e-12 * (1.0 + z * z));
+	}
+	// where erfc() underflows, compared with its continued fraction
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-903.9741171106439, logErfc(30.0), 1.0e-12 * 900.0);
+	CPPUNIT_ASSERT(logErfc(1000.0) < logErfc(100.0));
+}
+
+void DistributionProbabilityScorerTest::testLogScore() {
+	typedef IsotopeDistribution::peaks_container peaks_container;
+	typedef DistributionProbabilityScorer::masses_container masses_container;
+	typedef DistributionProbabilityScorer::abundances_container abundances_container;
+	typedef DistributionProbabilityScorer::score_type score_type;
+
+	Alphabet alphabet;
+	peaks_container peaks;
+	peaks.push_back(peaks_container::value_type(0.007825, 0.99985));
+	peaks.push_back(peaks_container::value_type(0.014102, 0.00015));
+	alphabet.push_back(Element("H", IsotopeDistribution(peaks, 1)));
+	peaks.clear();
+	peaks.push_back(peaks_container::value_type(0.0, 0.9889));
+	peaks.push_back(peaks_container::value_type(0.003355, 0.0111));
+	alphabet.push_back(Element("C", IsotopeDistribution(peaks, 12)));
+	peaks.clear();
+	peaks.push_back(peaks_container::value_type(-0.005085, 0.99762));
+	peaks.push_back(peaks_container::value_type(-0.000868, 0.00038));
+	peaks.push_back(peaks_container::value_type(-0.000839, 0.002));
+	alphabet.push_back(Element("O", IsotopeDistribution(peaks, 16)));
+
+	// measured glucose
+	masses_container measured_masses;
+	measured_masses.push_back(180.06339);
+	measured_masses.push_back(181.06674);
+	measured_masses.push_back(182.06812);
+	abundances_container measured_abundances;
+	measured_abundances.push_back(0.9210);
+	measured_abundances.push_back(0.0660);
+	measured_abundances.push_back(0.0130);
+	DistributionProbabilityScorer scorer(measured_masses, measured_abundances);
+
+	ComposedElement glucose("C6H12O6", alphabet);
+	glucose.updateIsotopeDistribution();
+	const IsotopeDistribution& distribution = glucose.getIsotopeDistribution();
+	double sum = distribution.getAbundance(0) + distribution.getAbundance(1) + distribution.getAbundance(2);
+	const score_type score = scorer.score(distribution, 3, 1 / sum);
+	const score_type log_score = scorer.logScore(distribution, 3, 1 / sum);
+	CPPUNIT_ASSERT(score > 0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(std::log(score), log_score, 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(std::log(scorer.scoreMonoisotopicMass(distribution.getMass(0))),
+					scorer.logScoreMonoisotopicMass(distribution.getMass(0)), 1.0e-12);
+
+	// far candidates score 0, but are still ranked in log space
+	ComposedElement near("C7H16O5", alphabet), far("C2H4O", alphabet);
+	near.updateIsotopeDistribution();
+	far.updateIsotopeDistribution();
+	CPPUNIT_ASSERT_EQUAL(0.0, scorer.score(far.getIsotopeDistribution(), 3));
+	const score_type log_near = scorer.logScore(near.getIsotopeDistribution(), 3);
+	const score_type log_far = scorer.logScore(far.getIsotopeDistribution(), 3);
+	CPPUNIT_ASSERT(log_far > -std::numeric_limits<score_type>::infinity());
+	CPPUNIT_ASSERT(log_far < log_near);
+	CPPUNIT_ASSERT(log_near < log_score);
+
+	// scoring stops below the bound, with an upper bound of the log score
+	const score_type bound = log_near + 1.0;
+	const score_type partial = scorer.logScore(near.getIsotopeDistribution(), 3, 1.0, bound);
+	CPPUNIT_ASSERT(partial < bound);
+	CPPUNIT_ASSERT(partial >= log_near);
+	CPPUNIT_ASSERT_EQUAL(log_score, scorer.logScore(distribution, 3, 1 / sum, log_score));
+}
+
+void DistributionProbabilityScorerTest::testLogScoreIsotopeRatio() {
+	typedef IsotopeDistribution::peaks_container peaks_container;
+	typedef DistributionProbabilityScorer::masses_container masses_container;
+	typedef DistributionProbabilityScorer::abundances_container abundances_container;
+	typedef DistributionProbabilityScorer::score_type score_type;
+
+	Alphabet alphabet;
+	peaks_container peaks;
+	peaks.push_back(peaks_container::value_type(0.007825, 0.99985));
+	peaks.push_back(peaks_container::value_type(0.014102, 0.00015));
+	alphabet.push_back(Element("H", IsotopeDistribution(peaks, 1)));
+	peaks.clear();
+	peaks.push_back(peaks_container::value_type(0.0, 0.9889));
+	peaks.push_back(peaks_container::value_type(0.003355, 0.0111));
+	alphabet.push_back(Element("C", IsotopeDistribution(peaks, 12)));
+	peaks.clear();
+	peaks.push_back(peaks_container::value_type(-0.005085, 0.99762));
+	peaks.push_back(peaks_container::value_type(-0.000868, 0.00038));
+	peaks.push_back(peaks_container::value_type(-0.000839, 0.002));
+	alphabet.push_back(Element("O", IsotopeDistribution(peaks, 16)));
+
+	// measured glucose
+	masses_container measured_masses;
+	measured_masses.push_back(180.06339);
+	measured_masses.push_back(181.06674);
+	measured_masses.push_back(182.06812);
+	abundances_container measured_abundances;
+	measured_abundances.push_back(0.9210);
+	measured_abundances.push_back(0.0660);
+	measured_abundances.push_back(0.0130);
+	DistributionProbabilityScorer scorer(measured_masses, measured_abundances);
+
+	// the bounds of M+1 and M+2 hold for any scale of the candidates
+	const char* formulas[] = { "C6H12O6", "C7H16O5", "C12H22O", "C2H4O" };
+	const double scales[] = { 0.5, 1.0, 3.0 };
+	for (int f = 0; f < 4; ++f) {
+		ComposedElement molecule(formulas[f], alphabet);
+		molecule.updateIsotopeDistribution();
+		const IsotopeDistribution& distribution = molecule.getIsotopeDistribution();
+		for (DistributionProbabilityScorer::size_type i = 1; i <= 2; ++i) {
+			const double ratio = distribution.getAbundance(i) / distribution.getAbundance(0);
+			const score_type bound = scorer.logScoreIsotopeRatio(i, ratio);
+			CPPUNIT_ASSERT(bound <= 0.0);
+			for (int s = 0; s < 3; ++s) {
+				CPPUNIT_ASSERT(scorer.logScore(distribution, 3, scales[s]) <= bound);
+			}
+			CPPUNIT_ASSERT(scorer.logScoreIsotopeRatio(i, ratio, 1.0) >= bound);
+		}
+	}
+
+	// far ratios are bounded far below, peaks without intensity terms not at all
+	CPPUNIT_ASSERT(scorer.logScoreIsotopeRatio(1, 1.0) < -100.0);
+	CPPUNIT_ASSERT_EQUAL(0.0, scorer.logScoreIsotopeRatio(3, 1.0));
+	CPPUNIT_ASSERT_EQUAL(0.0, scorer.logScoreIsotopeRatio(1, 0.0));
+}
@@ -0,0 +1,204 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <cmath>
+#include <map>
+#include <ims/alphabet.h>
+#include <ims/composedelement.h>
+#include <ims/finestructurecalculator.h>
+#include <ims/base/exception/invalidargumentexception.h>
+
+using namespace ims;
+
+class FineStructureCalculatorTest : public CppUnit::TestFixture {
+	typedef FineStructureCalculator::species_type species_type;
+
+	CPPUNIT_TEST_SUITE( FineStructureCalculatorTest );
+	CPPUNIT_TEST( testGetSpecies );
+	CPPUNIT_TEST( testGetSpeciesWithCoverage );
+	CPPUNIT_TEST( testLargeMolecule );
+	CPPUNIT_TEST( testIncompleteAbundances );
+	CPPUNIT_TEST_EXCEPTION( testInvalidThreshold, InvalidArgumentException );
+	CPPUNIT_TEST_EXCEPTION( testInvalidCoverage, InvalidArgumentException );
+	CPPUNIT_TEST_SUITE_END();
+
+	Alphabet alphabet;
+
+public:
+	void setUp();
+	void tearDown() {};
+	void testGetSpecies();
+	void testGetSpeciesWithCoverage();
+	void testLargeMolecule();
+	void testIncompleteAbundances();
+	void testInvalidThreshold();
+	void testInvalidCoverage();
+
+private:
+	species_type expand(const ComposedElement& molecule, double threshold);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( FineStructureCalculatorTest );
+
+namespace {
+
+Element createElement(const Element::name_type& name, unsigned int nominal_mass,
+			double mass0, double abundance0, double mass1, double abundance1,
+			double mass2 = 0.0, double abundance2 = 0.0) {
+	IsotopeDistribution::peaks_container peaks;
+	peaks.push_back(IsotopeDistribution::peak_type(mass0, abundance0));
+	peaks.push_back(IsotopeDistribution::peak_type(mass1, abundance1));
+	if (abundance2 > 0) {
+		peaks.push_back(IsotopeDistribution::peak_type(mass2, abundance2));
+	}
+	return Element(name, IsotopeDistribution(peaks, nominal_mass));
+}
+
+}
+
+void FineStructureCalculatorTest::setUp() {
+	alphabet.push_back(createElement("H", 1, 0.007825, 0.99985, 0.014102, 0.00015));
+	alphabet.push_back(createElement("C", 12, 0.0, 0.9889, 0.003355, 0.0111));
+	alphabet.push_back(createElement("O", 16, -0.005085, 0.99762, -0.000868, 0.00038, -0.000839, 0.002));
+}
+
+/**
+ * Expands all isotopologues by choosing the isotope of every atom,
+ * merging the ones with the same mass.
+ */
+FineStructureCalculatorTest::species_type
+FineStructureCalculatorTest::expand(const ComposedElement& molecule, double threshold) {
+	std::map<long, species_type::peak_type> isotopologues;
+	isotopologues[0] = species_type::peak_type(0.0, 1.0);
+	const ComposedElement::container& elements = molecule.getElements();
+	for (ComposedElement::container::const_iterator it = elements.begin(); it != elements.end(); ++it) {
+		const IsotopeDistribution& distribution = it->first.getIsotopeDistribution();
+		for (unsigned int atom = 0; atom < it->second; ++atom) {
+			std::map<long, species_type::peak_type> expanded;
+			for (std::map<long, species_type::peak_type>::const_iterator peak = isotopologues.begin();
+					peak != isotopologues.end(); ++peak) {
+				for (IsotopeDistribution::size_type i = 0; i < distribution.size(); ++i) {
+					if (distribution.getAbundance(i) <= 0) {
+						continue;
+					}
+					double mass = peak->second.mass + distribution.getMass(i);
+					species_type::peak_type& isotopologue = expanded[std::lround(mass * 1.0e6)];
+					isotopologue.mass = mass;
+					isotopologue.abundance += peak->second.abundance * distribution.getAbundance(i);
+				}
+			}
+			isotopologues.swap(expanded);
+		}
+	}
+
+	species_type::peaks_container peaks;
+	for (std::map<long, species_type::peak_type>::const_iterator peak = isotopologues.begin();
+			peak != isotopologues.end(); ++peak) {
+		if (peak->second.abundance >= threshold) {
+			peaks.push_back(peak->second);
+		}
+	}
+	return species_type(peaks);
+}
+
+void FineStructureCalculatorTest::testGetSpecies() {
+	ComposedElement molecule("C2H6O2", alphabet);
+	molecule.updateIsotopeDistribution();
+	FineStructureCalculator calculator(molecule);
+
+	const double thresholds[] = { 0.5, 1.0e-3, 1.0e-6, 1.0e-12 };
+	for (unsigned int t = 0; t < sizeof(thresholds) / sizeof(thresholds[0]); ++t) {
+		species_type expected = expand(molecule, thresholds[t]);
+		species_type species = calculator.getSpecies(thresholds[t]);
+		CPPUNIT_ASSERT_EQUAL(expected.size(), species.size());
+		for (species_type::size_type i = 0; i < species.size(); ++i) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getMass(i), species.getMass(i), 1.0e-9);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getAbundance(i), species.getAbundance(i), 1.0e-12);
+		}
+	}
+	// monoisotopic isotopologue first
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(molecule.getIsotopeDistribution().getMass(0), calculator.getSpecies(0.01).getMass(0), 1.0e-9);
+}
+
+void FineStructureCalculatorTest::testGetSpeciesWithCoverage() {
+	ComposedElement molecule("C6H12O6", alphabet);
+	FineStructureCalculator calculator(molecule);
+
+	const double coverages[] = { 0.5, 0.9, 0.99, 0.999999 };
+	for (unsigned int c = 0; c < sizeof(coverages) / sizeof(coverages[0]); ++c) {
+		species_type species = calculator.getSpeciesWithCoverage(coverages[c]);
+		double sum = 0.0, smallest = 1.0;
+		for (species_type::size_type i = 0; i < species.size(); ++i) {
+			sum += species.getAbundance(i);
+			smallest = std::min(smallest, species.getAbundance(i));
+			if (i > 0) {
+				CPPUNIT_ASSERT(species.getMass(i-1) < species.getMass(i));
+			}
+		}
+		// covers enough, but not more isotopologues than needed
+		CPPUNIT_ASSERT(sum >= coverages[c]);
+		CPPUNIT_ASSERT(sum - smallest < coverages[c]);
+
+		// the same as the most abundant isotopologues of all
+		CPPUNIT_ASSERT_EQUAL(calculator.getSpecies(smallest * (1.0 - 1.0e-9)).size(), species.size());
+	}
+}
+
+void FineStructureCalculatorTest::testLargeMolecule() {
+	ComposedElement molecule("C200H400O100", alphabet);
+	molecule.updateIsotopeDistribution();
+	FineStructureCalculator calculator(molecule);
+
+	species_type species = calculator.getSpeciesWithCoverage(0.99);
+	double sum = 0.0;
+	species_type::size_type most_abundant = 0;
+	for (species_type::size_type i = 0; i < species.size(); ++i) {
+		sum += species.getAbundance(i);
+		if (species.getAbundance(i) > species.getAbundance(most_abundant)) {
+			most_abundant = i;
+		}
+	}
+	CPPUNIT_ASSERT(sum >= 0.99 && sum <= 1.0 + 1.0e-9);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(molecule.getIsotopeDistribution().getMass(0), species.getMass(0), 1.0e-9);
+	// the monoisotopic isotopologue is not the most abundant one any more
+	CPPUNIT_ASSERT(species.getMass(most_abundant) > molecule.getIsotopeDistribution().getMass(0) + 0.5);
+
+	// three 13C and nothing else
+	double abundance = std::exp(std::lgamma(201.0) - std::lgamma(4.0) - std::lgamma(198.0)) *
+		std::pow(0.0111, 3) * std::pow(0.9889, 197) * std::pow(0.99985, 400) * std::pow(0.99762, 100);
+	double mass = molecule.getIsotopeDistribution().getMass(0) + 3 * 1.003355;
+	bool found = false;
+	for (species_type::size_type i = 0; i < species.size(); ++i) {
+		if (std::fabs(species.getMass(i) - mass) < 1.0e-9) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(abundance, species.getAbundance(i), 1.0e-12);
+			found = true;
+		}
+	}
+	CPPUNIT_ASSERT(found);
+}
+
+void FineStructureCalculatorTest::testIncompleteAbundances() {
+	// isotopes of a user-defined element sum up to 0.9, so no more than
+	// 0.9^10 of the abundance can be covered
+	Alphabet incomplete(alphabet);
+	incomplete.push_back(createElement("X", 50, 0.0, 0.6, 1.0, 0.3));
+	FineStructureCalculator calculator(ComposedElement("C100H200X10", incomplete));
+
+	const double total = std::pow(0.9, 10);
+	species_type species = calculator.getSpeciesWithCoverage(0.99);
+	double sum = 0.0;
+	for (species_type::size_type i = 0; i < species.size(); ++i) {
+		sum += species.getAbundance(i);
+	}
+	CPPUNIT_ASSERT(sum >= total * (1.0 - 1.0e-9) && sum <= total * (1.0 + 1.0e-9));
+}
+
+void FineStructureCalculatorTest::testInvalidThreshold() {
+	FineStructureCalculator calculator(ComposedElement("C2H6O", alphabet));
+	calculator.getSpecies(0.0);
+}
+
+void FineStructureCalculatorTest::testInvalidCoverage() {
+	FineStructureCalculator calculator(ComposedElement("C2H6O", alphabet));
+	calculator.getSpeciesWithCoverage(1.0);
+}
@@ -0,0 +1,82 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <ims/isotopedistributioncache.h>
+
+using namespace ims;
+
+class IsotopeDistributionCacheTest : public CppUnit::TestFixture {
+	typedef IsotopeDistributionCache::distribution_type distribution_type;
+
+	CPPUNIT_TEST_SUITE( IsotopeDistributionCacheTest );
+	CPPUNIT_TEST( testGetPower );
+	CPPUNIT_TEST( testElementIdentity );
+	CPPUNIT_TEST( testEviction );
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp() {};
+	void tearDown() {};
+	void testGetPower();
+	void testElementIdentity();
+	void testEviction();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( IsotopeDistributionCacheTest );
+
+namespace {
+
+Element createCarbon(double abundance13C = 0.0107) {
+	IsotopeDistribution::peaks_container peaks;
+	peaks.push_back(IsotopeDistribution::peak_type(0.0, 1 - abundance13C));
+	peaks.push_back(IsotopeDistribution::peak_type(0.003355, abundance13C));
+	return Element("C", IsotopeDistribution(peaks, 12));
+}
+
+}
+
+void IsotopeDistributionCacheTest::testGetPower() {
+	IsotopeDistributionCache cache;
+	distribution_type::settings_type settings(5);
+	Element carbon = createCarbon();
+
+	distribution_type expected(carbon.getIsotopeDistribution());
+	expected.setSettings(settings);
+	expected *= 30;
+
+	IsotopeDistributionCache::distribution_pointer power = cache.getPower(carbon, 30, settings);
+	CPPUNIT_ASSERT(*power == expected);
+	CPPUNIT_ASSERT(power->getSettings() == settings);
+	CPPUNIT_ASSERT(cache.size() == 1);
+	// a cached power is shared
+	CPPUNIT_ASSERT(cache.getPower(carbon, 30, settings) == power);
+	// other settings are cached separately
+	CPPUNIT_ASSERT(cache.getPower(carbon, 30, distribution_type::settings_type(3)) != power);
+	CPPUNIT_ASSERT(cache.size() == 2);
+	cache.clear();
+	CPPUNIT_ASSERT(cache.size() == 0);
+}
+
+void IsotopeDistributionCacheTest::testElementIdentity() {
+	IsotopeDistributionCache cache;
+	distribution_type::settings_type settings;
+	Element carbon = createCarbon();
+	Element enriched_carbon = createCarbon(0.5);
+
+	IsotopeDistributionCache::distribution_pointer power = cache.getPower(carbon, 5, settings);
+	// an element with the same name, but another distribution is not mixed up
+	IsotopeDistributionCache::distribution_pointer enriched_power = 
+			cache.getPower(enriched_carbon, 5, settings);
+	CPPUNIT_ASSERT(*enriched_power != *power);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0 / 32, enriched_power->getAbundance(1), 1.0e-9);
+}
+
+void IsotopeDistributionCacheTest::testEviction() {
+	IsotopeDistributionCache cache(2);
+	distribution_type::settings_type settings;
+	Element carbon = createCarbon();
+
+	cache.getPower(carbon, 2, settings);
+	cache.getPower(carbon, 3, settings);
+	cache.getPower(carbon, 4, settings);
+	CPPUNIT_ASSERT(cache.size() == 2);
+}
@@ -0,0 +1,103 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <cmath>
+#include <ims/alphabet.h>
+#include <ims/composedelement.h>
+#include <ims/isotopedistributioncache.h>
+#include <ims/isotopedistributionfolder.h>
+
+using namespace ims;
+
+class IsotopeDistributionFolderTest : public CppUnit::TestFixture {
+	typedef IsotopeDistributionFolder::distribution_type distribution_type;
+	typedef IsotopeDistributionFolder::decomposition_type decomposition_type;
+
+	CPPUNIT_TEST_SUITE( IsotopeDistributionFolderTest );
+	CPPUNIT_TEST( testFoldInTraversalOrder );
+	CPPUNIT_TEST( testFoldInAnyOrder );
+	CPPUNIT_TEST_SUITE_END();
+
+	Alphabet alphabet;
+
+public:
+	void setUp();
+	void tearDown() {};
+	void testFoldInTraversalOrder();
+	void testFoldInAnyOrder();
+
+private:
+	void checkFold(IsotopeDistributionFolder& folder, const decomposition_type& decomposition);
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( IsotopeDistributionFolderTest );
+
+namespace {
+
+Element createElement(const Element::name_type& name, unsigned int nominal_mass,
+			double mass0, double abundance0, double mass1, double abundance1,
+			double mass2 = 0.0, double abundance2 = 0.0) {
+	IsotopeDistribution::peaks_container peaks;
+	peaks.push_back(IsotopeDistribution::peak_type(mass0, abundance0));
+	peaks.push_back(IsotopeDistribution::peak_type(mass1, abundance1));
+	if (abundance2 > 0) {
+		peaks.push_back(IsotopeDistribution::peak_type(mass2, abundance2));
+	}
+	return Element(name, IsotopeDistribution(peaks, nominal_mass));
+}
+
+}
+
+void IsotopeDistributionFolderTest::setUp() {
+	// sorted by mass, as the alphabets of mass decomposers
+	alphabet.push_back(createElement("H", 1, 0.007825, 0.99985, 0.014102, 0.00015));
+	alphabet.push_back(createElement("C", 12, 0.0, 0.9889, 0.003355, 0.0111));
+	alphabet.push_back(createElement("N", 14, 0.003074, 0.99634, 0.000109, 0.00366));
+	alphabet.push_back(createElement("O", 16, -0.005085, 0.99762, -0.000868, 0.00038, -0.000839, 0.002));
+}
+
+void IsotopeDistributionFolderTest::checkFold(IsotopeDistributionFolder& folder,
+					const decomposition_type& decomposition) {
+	ComposedElement molecule(decomposition, alphabet);
+	molecule.updateIsotopeDistribution(distribution_type::settings_type(6));
+	const distribution_type& expected = molecule.getIsotopeDistribution();
+
+	const distribution_type& distribution = folder.fold(decomposition);
+	CPPUNIT_ASSERT_EQUAL(expected.size(), distribution.size());
+	CPPUNIT_ASSERT_EQUAL(expected.getNominalMass(), distribution.getNominalMass());
+	for (distribution_type::size_type i = 0; i < expected.size(); ++i) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getMass(i), distribution.getMass(i), 1.0e-9);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getAbundance(i), distribution.getAbundance(i), 1.0e-12);
+	}
+}
+
+void IsotopeDistributionFolderTest::testFoldInTraversalOrder() {
+	IsotopeDistributionCache cache;
+	IsotopeDistributionFolder folder(alphabet, distribution_type::settings_type(6), &cache);
+
+	// counts are fixed from the heaviest element down, like decomposers do
+	unsigned long decompositions = 0;
+	decomposition_type decomposition(4);
+	for (decomposition[3] = 0; decomposition[3] < 4; ++decomposition[3]) {
+		for (decomposition[2] = 0; decomposition[2] < 3; ++decomposition[2]) {
+			for (decomposition[1] = 1; decomposition[1] < 12; decomposition[1] += 2) {
+				for (decomposition[0] = 0; decomposition[0] < 25; ++decomposition[0]) {
+					checkFold(folder, decomposition);
+					++decompositions;
+				}
+			}
+		}
+	}
+	// about one folding per decomposition instead of one per element
+	CPPUNIT_ASSERT(folder.getNumberOfFoldings() < decompositions + decompositions / 10);
+}
+
+void IsotopeDistributionFolderTest::testFoldInAnyOrder() {
+	IsotopeDistributionFolder folder(alphabet, distribution_type::settings_type(6));
+
+	unsigned int counts[][4] = { {4, 2, 0, 1}, {5, 2, 0, 1}, {5, 3, 0, 1}, {0, 0, 0, 0},
+				     {0, 3, 1, 0}, {7, 3, 1, 2}, {7, 3, 1, 2}, {1, 0, 0, 0} };
+	for (unsigned int i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+		checkFold(folder, decomposition_type(counts[i], counts[i] + 4));
+	}
+}
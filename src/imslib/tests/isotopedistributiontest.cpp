@@ -16,18 +16,22 @@ using namespace ims;
 class IsotopeDistributionTest : public CppUnit::TestFixture {
 		CPPUNIT_TEST_SUITE( IsotopeDistributionTest );
 		CPPUNIT_TEST( testConstructor );
+		CPPUNIT_TEST( testSettings );
+		CPPUNIT_TEST( testFold );
+		CPPUNIT_TEST( testFoldIntoResult );
 		CPPUNIT_TEST_SUITE_END();
 	public:
 		void setUp();
 		void testConstructor();
+		void testSettings();
+		void testFold();
+		void testFoldIntoResult();
 		void tearDown();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(IsotopeDistributionTest);
 
 void IsotopeDistributionTest::setUp() {
-	IsotopeDistribution::SIZE = 10;
-	IsotopeDistribution::ABUNDANCES_SUM_ERROR = 0.0001;
 }
 
 void IsotopeDistributionTest::tearDown() {
@@ -62,3 +66,116 @@ void IsotopeDistributionTest::testConstructor() {
 	CPPUNIT_ASSERT_DOUBLES_EQUAL(distributionO.getMass(2), massO + massShift2 + 2, 1.0e-6);
 }
 
+
+void IsotopeDistributionTest::testSettings() {
+	typedef IsotopeDistribution::peaks_container peaks_container;
+	typedef IsotopeDistribution::settings_type settings_type;
+
+	peaks_container peaksC;
+	peaksC.push_back(peaks_container::value_type(0.0, 0.9889));
+	peaksC.push_back(peaks_container::value_type(0.003355, 0.0111));
+
+	IsotopeDistribution distributionC(peaksC, 12);
+	CPPUNIT_ASSERT(distributionC.getSettings() == settings_type());
+	
+	// the same distribution folded with different settings
+	IsotopeDistribution short_distribution(peaksC, 12, settings_type(2, 0.0001));
+	IsotopeDistribution long_distribution(peaksC, 12, settings_type(5, 0.0001));
+	short_distribution *= 3;
+	long_distribution *= 3;
+
+	CPPUNIT_ASSERT_EQUAL(IsotopeDistribution::size_type(2), short_distribution.size());
+	CPPUNIT_ASSERT_EQUAL(IsotopeDistribution::size_type(5), long_distribution.size());
+	CPPUNIT_ASSERT_EQUAL(36u, short_distribution.getNominalMass());
+	CPPUNIT_ASSERT_EQUAL(36u, long_distribution.getNominalMass());
+	CPPUNIT_ASSERT(short_distribution.getSettings() == settings_type(2, 0.0001));
+
+	// C3: 0.9889^3, 3 * 0.9889^2 * 0.0111, 3 * 0.9889 * 0.0111^2, 0.0111^3
+	double sum = 0.9889 * 0.9889 * 0.9889 + 3 * 0.9889 * 0.9889 * 0.0111;
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.9889 * 0.9889 * 0.9889 / sum, short_distribution.getAbundance(0), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.9889 * 0.9889 * 0.9889, long_distribution.getAbundance(0), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0111 * 0.0111 * 0.0111, long_distribution.getAbundance(3), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, long_distribution.getAbundance(4), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(39.010065, long_distribution.getMass(3), 1.0e-5);
+}
+
+
+void IsotopeDistributionTest::testFold() {
+	typedef IsotopeDistribution::peaks_container peaks_container;
+	typedef IsotopeDistribution::settings_type settings_type;
+
+	peaks_container peaks1;
+	peaks1.push_back(peaks_container::value_type(0.1, 0.5));
+	peaks1.push_back(peaks_container::value_type(0.2, 0.3));
+	peaks1.push_back(peaks_container::value_type(0.3, 0.2));
+	peaks_container peaks2;
+	peaks2.push_back(peaks_container::value_type(0.01, 0.9));
+	peaks2.push_back(peaks_container::value_type(0.02, 0.1));
+
+	// distributions of different lengths, with more peaks in the settings
+	// than both of them and than fit into the buffers on the stack
+	const IsotopeDistribution::size_type sizes[] = { 3, 40 };
+	for (unsigned int s = 0; s < 2; ++s) {
+		const IsotopeDistribution::size_type size = sizes[s];
+		IsotopeDistribution distribution1(peaks1, 10, settings_type(size));
+		IsotopeDistribution distribution2(peaks2, 20, settings_type(size));
+		distribution1 *= distribution2;
+
+		CPPUNIT_ASSERT_EQUAL(size, distribution1.size());
+		CPPUNIT_ASSERT_EQUAL(30u, distribution1.getNominalMass());
+
+		// the last peak (0.3 + 0.02 at +3) is cut off by the short settings
+		double abundance1 = 0.5 * 0.1 + 0.3 * 0.9;
+		double scale = (size == 3) ? 1 / (1 - 0.2 * 0.1) : 1;
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5 * 0.9 * scale, distribution1.getAbundance(0), 1.0e-12);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(abundance1 * scale, distribution1.getAbundance(1), 1.0e-12);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(31 + (0.5 * 0.1 * 0.12 + 0.3 * 0.9 * 0.21) / abundance1,
+						distribution1.getMass(1), 1.0e-12);
+		if (size > 3) {
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(0.2 * 0.1, distribution1.getAbundance(3), 1.0e-12);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, distribution1.getAbundance(4), 1.0e-12);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, distribution1.getAbundance(39), 1.0e-12);
+		}
+	}
+}
+
+
+void IsotopeDistributionTest::testFoldIntoResult() {
+	typedef IsotopeDistribution::peaks_container peaks_container;
+	typedef IsotopeDistribution::settings_type settings_type;
+
+	peaks_container peaksS;
+	peaksS.push_back(peaks_container::value_type(-0.027929, 0.9493));
+	peaksS.push_back(peaks_container::value_type(-0.028541, 0.0076));
+	peaksS.push_back(peaks_container::value_type(-0.032133, 0.0429));
+	const IsotopeDistribution distributionS(peaksS, 32);
+	const IsotopeDistribution original(distributionS);
+
+	// inputs are left untouched, even if the settings are longer
+	IsotopeDistribution result(IsotopeDistribution::nominal_mass_type(0), settings_type(6));
+	IsotopeDistribution workspace;
+	IsotopeDistribution::power(distributionS, 5, result, workspace);
+	CPPUNIT_ASSERT(distributionS == original);
+	CPPUNIT_ASSERT_EQUAL(IsotopeDistribution::size_type(3), distributionS.size());
+
+	IsotopeDistribution expected(distributionS);
+	expected.setSettings(settings_type(6));
+	expected *= 5;
+	CPPUNIT_ASSERT(result == expected);
+	CPPUNIT_ASSERT(result.getSettings() == settings_type(6));
+	CPPUNIT_ASSERT_EQUAL(160u, result.getNominalMass());
+
+	// folding into one of the inputs
+	IsotopeDistribution folded(result);
+	IsotopeDistribution::fold(folded, distributionS, folded);
+	expected *= distributionS;
+	CPPUNIT_ASSERT(folded == expected);
+	IsotopeDistribution::power(folded, 2, folded, workspace);
+	expected *= expected;
+	CPPUNIT_ASSERT(folded == expected);
+
+	// folding with an empty distribution copies the other one
+	IsotopeDistribution::fold(IsotopeDistribution(), distributionS, result);
+	CPPUNIT_ASSERT(result == distributionS);
+	CPPUNIT_ASSERT(result.getSettings() == settings_type(6));
+}
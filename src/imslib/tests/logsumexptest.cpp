@@ -0,0 +1,80 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <cmath>
+#include <limits>
+#include <ims/utils/logsumexp.h>
+
+using namespace ims;
+
+class LogSumExpTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE( LogSumExpTest );
+	CPPUNIT_TEST( testEmpty );
+	CPPUNIT_TEST( testAdd );
+	CPPUNIT_TEST( testUnderflow );
+	CPPUNIT_TEST( testNegligible );
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp() {};
+	void tearDown() {};
+	void testEmpty();
+	void testAdd();
+	void testUnderflow();
+	void testNegligible();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LogSumExpTest );
+
+void LogSumExpTest::testEmpty() {
+	const double infinity = std::numeric_limits<double>::infinity();
+	LogSumExp sum;
+	CPPUNIT_ASSERT_EQUAL(-infinity, sum.get());
+	CPPUNIT_ASSERT_EQUAL(-infinity, sum.getNegligibleBound());
+	sum.add(-infinity);
+	sum.add(LogSumExp());
+	CPPUNIT_ASSERT_EQUAL(-infinity, sum.get());
+}
+
+void LogSumExpTest::testAdd() {
+	LogSumExp sum, other;
+	sum.add(std::log(0.25));
+	sum.add(std::log(0.5));
+	other.add(std::log(0.125));
+	other.add(std::log(0.0625));
+	sum.add(other);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(std::log(0.9375), sum.get(), 1.0e-15);
+
+	// the larger sum is added to the smaller one
+	LogSumExp reverse;
+	reverse.add(std::log(0.0625));
+	LogSumExp larger;
+	larger.add(std::log(0.5));
+	larger.add(std::log(0.25));
+	larger.add(std::log(0.125));
+	reverse.add(larger);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(std::log(0.9375), reverse.get(), 1.0e-15);
+}
+
+void LogSumExpTest::testUnderflow() {
+	// exp(-1000) underflows, the sum of two of them does not
+	LogSumExp sum;
+	sum.add(-1000.0);
+	sum.add(-1000.0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-1000.0 + std::log(2.0), sum.get(), 1.0e-12);
+	sum.add(-2000.0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-1000.0 + std::log(2.0), sum.get(), 1.0e-12);
+}
+
+void LogSumExpTest::testNegligible() {
+	LogSumExp sum;
+	sum.add(-1.0);
+	sum.add(-3.0);
+	const double bound = sum.getNegligibleBound();
+	CPPUNIT_ASSERT(bound < sum.get() - 36.0);
+
+	// adding a number below the bound does not change the sum
+	LogSumExp added = sum;
+	added.add(bound - 1.0e-9);
+	added.add(bound - 10.0);
+	CPPUNIT_ASSERT_EQUAL(sum.get(), added.get());
+}
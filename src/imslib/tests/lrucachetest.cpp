@@ -0,0 +1,59 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <string>
+#include <ims/utils/lrucache.h>
+
+using namespace ims;
+
+class LRUCacheTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE( LRUCacheTest );
+	CPPUNIT_TEST( testFind );
+	CPPUNIT_TEST( testEviction );
+	CPPUNIT_TEST( testSetCapacity );
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp() {};
+	void tearDown() {};
+	void testFind();
+	void testEviction();
+	void testSetCapacity();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LRUCacheTest );
+
+void LRUCacheTest::testFind() {
+	LRUCache<std::string, int> cache(2);
+	CPPUNIT_ASSERT(cache.find("C") == 0);
+	cache.insert("C", 12);
+	CPPUNIT_ASSERT(cache.find("C") != 0);
+	CPPUNIT_ASSERT_EQUAL(12, *cache.find("C"));
+	cache.insert("C", 13);
+	CPPUNIT_ASSERT_EQUAL(13, *cache.find("C"));
+	CPPUNIT_ASSERT(cache.size() == 1);
+}
+
+void LRUCacheTest::testEviction() {
+	LRUCache<std::string, int> cache(2);
+	cache.insert("C", 12);
+	cache.insert("H", 1);
+	// C becomes the most recently used entry, so H is evicted
+	cache.find("C");
+	cache.insert("N", 14);
+	CPPUNIT_ASSERT(cache.size() == 2);
+	CPPUNIT_ASSERT(cache.find("H") == 0);
+	CPPUNIT_ASSERT(cache.find("C") != 0);
+	CPPUNIT_ASSERT(cache.find("N") != 0);
+}
+
+void LRUCacheTest::testSetCapacity() {
+	LRUCache<std::string, int> cache(3);
+	cache.insert("C", 12);
+	cache.insert("H", 1);
+	cache.insert("N", 14);
+	cache.setCapacity(1);
+	CPPUNIT_ASSERT(cache.size() == 1);
+	CPPUNIT_ASSERT(cache.find("N") != 0);
+	cache.clear();
+	CPPUNIT_ASSERT(cache.size() == 0);
+}
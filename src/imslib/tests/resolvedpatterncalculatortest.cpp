@@ -0,0 +1,166 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <ims/alphabet.h>
+#include <ims/composedelement.h>
+#include <ims/finestructurecalculator.h>
+#include <ims/resolvedpatterncalculator.h>
+#include <ims/base/exception/invalidargumentexception.h>
+
+using namespace ims;
+
+class ResolvedPatternCalculatorTest : public CppUnit::TestFixture {
+	typedef ResolvedPatternCalculator::pattern_type pattern_type;
+
+	CPPUNIT_TEST_SUITE( ResolvedPatternCalculatorTest );
+	CPPUNIT_TEST( testPeakWidth );
+	CPPUNIT_TEST( testLowResolution );
+	CPPUNIT_TEST( testHighResolution );
+	CPPUNIT_TEST( testPartlyResolved );
+	CPPUNIT_TEST( testThreads );
+	CPPUNIT_TEST_EXCEPTION( testInvalidResolvingPower, InvalidArgumentException );
+	CPPUNIT_TEST_SUITE_END();
+
+	Alphabet alphabet;
+
+public:
+	void setUp();
+	void tearDown() {};
+	void testPeakWidth();
+	void testLowResolution();
+	void testHighResolution();
+	void testPartlyResolved();
+	void testThreads();
+	void testInvalidResolvingPower();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ResolvedPatternCalculatorTest );
+
+namespace {
+
+Element createElement(const Element::name_type& name, unsigned int nominal_mass,
+			double mass0, double abundance0, double mass1, double abundance1,
+			double mass2 = 0.0, double abundance2 = 0.0) {
+	IsotopeDistribution::peaks_container peaks;
+	peaks.push_back(IsotopeDistribution::peak_type(mass0, abundance0));
+	peaks.push_back(IsotopeDistribution::peak_type(mass1, abundance1));
+	if (abundance2 > 0) {
+		peaks.push_back(IsotopeDistribution::peak_type(mass2, abundance2));
+	}
+	return Element(name, IsotopeDistribution(peaks, nominal_mass));
+}
+
+}
+
+void ResolvedPatternCalculatorTest::setUp() {
+	alphabet.push_back(createElement("H", 1, 0.007825, 0.99985, 0.014102, 0.00015));
+	alphabet.push_back(createElement("C", 12, 0.0, 0.9889, 0.003355, 0.0111));
+	alphabet.push_back(createElement("O", 16, -0.005085, 0.99762, -0.000868, 0.00038, -0.000839, 0.002));
+}
+
+void ResolvedPatternCalculatorTest::testPeakWidth() {
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.002, ResolvingPower(100000.0).getPeakWidth(200.0), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.004, ResolvingPower(100000.0).getPeakWidth(400.0), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.016,
+		ResolvingPower(100000.0, 200.0, ResolvingPower::ORBITRAP).getPeakWidth(800.0), 1.0e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.008,
+		ResolvingPower(100000.0, 200.0, ResolvingPower::FT_ICR).getPeakWidth(400.0), 1.0e-12);
+}
+
+void ResolvedPatternCalculatorTest::testLowResolution() {
+	// resolves nominal masses only, as IsotopeDistribution does
+	ComposedElement molecule("C6H12O6", alphabet);
+	molecule.updateIsotopeDistribution(IsotopeDistribution::settings_type(4));
+	const IsotopeDistribution& expected = molecule.getIsotopeDistribution();
+
+	ResolvedPatternCalculator calculator(ResolvingPower(1000.0), 4);
+	pattern_type pattern = calculator.getPattern(molecule);
+	CPPUNIT_ASSERT_EQUAL(expected.size(), pattern.size());
+	for (pattern_type::size_type i = 0; i < pattern.size(); ++i) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getMass(i), pattern.getMass(i), 1.0e-6);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getAbundance(i), pattern.getAbundance(i), 1.0e-6);
+	}
+
+	// calculated again from the kept element distributions
+	pattern_type again = calculator.getPattern(molecule);
+	CPPUNIT_ASSERT_EQUAL(pattern.size(), again.size());
+	CPPUNIT_ASSERT_EQUAL(pattern.getMass(1), again.getMass(1));
+}
+
+void ResolvedPatternCalculatorTest::testHighResolution() {
+	// resolves all isotopologues, as the fine structure
+	ComposedElement molecule("C2H6O2", alphabet);
+	pattern_type expected = FineStructureCalculator(molecule).getSpecies(1.0e-9);
+
+	ResolvedPatternCalculator calculator(ResolvingPower(1.0e7), 10, 1.0e-9);
+	pattern_type pattern = calculator.getPattern(molecule);
+	CPPUNIT_ASSERT_EQUAL(expected.size(), pattern.size());
+	for (pattern_type::size_type i = 0; i < pattern.size(); ++i) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getMass(i), pattern.getMass(i), 1.0e-9);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(expected.getAbundance(i), pattern.getAbundance(i), 1.0e-12);
+	}
+}
+
+void ResolvedPatternCalculatorTest::testPartlyResolved() {
+	// at m/z 180 and R = 100000 13C and 17O are not resolved, but 2H is
+	ComposedElement molecule("C6H12O6", alphabet);
+	molecule.updateIsotopeDistribution(IsotopeDistribution::settings_type(3));
+	const IsotopeDistribution& nominal = molecule.getIsotopeDistribution();
+
+	ResolvedPatternCalculator calculator(ResolvingPower(100000.0), 3);
+	pattern_type pattern = calculator.getPattern(molecule);
+
+	const double monoisotopic_mass = pattern.getMass(0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(nominal.getMass(0), monoisotopic_mass, 1.0e-9);
+	for (unsigned int shift = 0; shift < 3; ++shift) {
+		unsigned int peaks = 0;
+		double abundance = 0.0;
+		for (pattern_type::size_type i = 0; i < pattern.size(); ++i) {
+			if (std::fabs(pattern.getMass(i) - monoisotopic_mass - shift) < 0.5) {
+				++peaks;
+				abundance += pattern.getAbundance(i);
+			}
+		}
+		// the nominal distribution is normalized to the masses kept
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(nominal.getAbundance(shift) / nominal.getAbundance(0),
+					abundance / pattern.getAbundance(0), 1.0e-6);
+		if (shift == 1) {
+			CPPUNIT_ASSERT_EQUAL(2u, peaks);
+		}
+	}
+}
+
+void ResolvedPatternCalculatorTest::testThreads() {
+	// threads sharing a calculator fold and look up the same powers
+	const char* formulas[] = { "C6H12O6", "C12H22O11", "C6H12O6", "C30H50O2" };
+	ResolvedPatternCalculator calculator(ResolvingPower(100000.0), 4);
+	std::vector<pattern_type> patterns(8);
+	std::vector<std::thread> threads;
+	for (std::size_t t = 0; t < patterns.size(); ++t) {
+		threads.push_back(std::thread([&, t]() {
+			for (int repetition = 0; repetition < 20; ++repetition) {
+				patterns[t] = calculator.getPattern(ComposedElement(formulas[t % 4], alphabet));
+			}
+		}));
+	}
+	for (std::size_t t = 0; t < threads.size(); ++t) {
+		threads[t].join();
+	}
+
+	for (std::size_t t = 0; t < patterns.size(); ++t) {
+		pattern_type expected = ResolvedPatternCalculator(ResolvingPower(100000.0), 4)
+			.getPattern(ComposedElement(formulas[t % 4], alphabet));
+		CPPUNIT_ASSERT_EQUAL(expected.size(), patterns[t].size());
+		for (pattern_type::size_type i = 0; i < expected.size(); ++i) {
+			CPPUNIT_ASSERT_EQUAL(expected.getMass(i), patterns[t].getMass(i));
+			CPPUNIT_ASSERT_EQUAL(expected.getAbundance(i), patterns[t].getAbundance(i));
+		}
+	}
+}
+
+void ResolvedPatternCalculatorTest::testInvalidResolvingPower() {
+	ResolvingPower resolving_power(0.0);
+}
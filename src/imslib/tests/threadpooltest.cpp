@@ -0,0 +1,72 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+
+#include <vector>
+#include <stdexcept>
+#include <ims/utils/threadpool.h>
+
+using namespace ims;
+
+class ThreadPoolTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE( ThreadPoolTest );
+	CPPUNIT_TEST( testParallelFor );
+	CPPUNIT_TEST( testNestedParallelFor );
+	CPPUNIT_TEST( testException );
+	CPPUNIT_TEST_SUITE_END();
+public:
+	void setUp() {};
+	void tearDown() {};
+	void testParallelFor();
+	void testNestedParallelFor();
+	void testException();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ThreadPoolTest );
+
+void ThreadPoolTest::testParallelFor() {
+	for (ThreadPool::size_type threads = 0; threads <= 4; ++threads) {
+		ThreadPool pool(threads);
+		CPPUNIT_ASSERT(pool.size() == (threads > 0 ? threads : 1));
+		// runs several loops on the same pool, with very skewed tasks
+		for (unsigned n = 0; n < 100; n += 33) {
+			std::vector<unsigned long> results(n, 0);
+			pool.parallelFor(n, [&results](ThreadPool::size_type i) {
+				unsigned long sum = 0;
+				for (unsigned long j = 0; j < (i % 7 == 0 ? 100000 : 10); ++j) {
+					sum += j % (i + 1);
+				}
+				results[i] = sum + 1;
+			});
+			for (unsigned i = 0; i < n; ++i) {
+				CPPUNIT_ASSERT(results[i] > 0);
+			}
+		}
+	}
+}
+
+void ThreadPoolTest::testNestedParallelFor() {
+	ThreadPool pool(3);
+	std::vector<unsigned> results(10, 0);
+	pool.parallelFor(results.size(), [&pool, &results](ThreadPool::size_type i) {
+		unsigned sum = 0;
+		// runs serially inside of a task
+		pool.parallelFor(5, [&sum](ThreadPool::size_type j) { sum += j; });
+		results[i] = sum;
+	});
+	for (unsigned i = 0; i < results.size(); ++i) {
+		CPPUNIT_ASSERT_EQUAL(10u, results[i]);
+	}
+}
+
+void ThreadPoolTest::testException() {
+	ThreadPool pool(2);
+	CPPUNIT_ASSERT_THROW(pool.parallelFor(10, [](ThreadPool::size_type i) {
+		if (i == 7) {
+			throw std::runtime_error("task failed");
+		}
+	}), std::runtime_error);
+	// the pool is still usable
+	unsigned long count = 0;
+	pool.parallelFor(1, [&count](ThreadPool::size_type) { ++count; });
+	CPPUNIT_ASSERT(count == 1);
+}
@@ -0,0 +1,122 @@
+/**
+ * countruntimes.cpp
+ *
+ * Measures the time to count the decompositions of CHNOPS masses from 100
+ * to 1000 Da within a relative error, once by enumerating them and once by
+ * counting them without enumeration. The first repetition includes the
+ * computation of the tables the counting caches.
+ *
+ * Usage: countruntimes [precision [ppm [repetitions]]]
+ *
+ * Invalid arguments print the usage and exit with status 2.
+ */
+
+#include <vector>
+#include <iostream>
+#include <sstream>
+
+#include <ims/weights.h>
+#include <ims/utils/stopwatch.h>
+#include <ims/decomp/integermassdecomposer.h>
+
+using namespace std;
+using namespace ims;
+
+namespace {
+
+void printUsage(const char* program) {
+	cerr << "Usage: " << program << " [precision [ppm [repetitions]]]" << endl
+		 << "  precision    positive precision of the weights, at most about 1 (default 1e-5)" << endl
+		 << "  ppm          positive relative error of the masses in ppm (default 2)" << endl
+		 << "  repetitions  positive number of repetitions (default 3)" << endl;
+}
+
+// reads the whole argument into value, fails on trailing characters
+template <typename T>
+bool parseArgument(const char* argument, T& value) {
+	istringstream argument_string(argument);
+	return (argument_string >> value) && (argument_string >> ws).eof();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	typedef IntegerMassDecomposer<> decomposer_type;
+	typedef decomposer_type::value_type value_type;
+	typedef decomposer_type::number_of_decompositions_type number_type;
+
+	// initializes precision, ppm and repetitions
+	double precision = 0.00001;
+	double ppm = 2;
+	long repetitions = 3;
+	if (argc > 4 ||
+			(argc > 1 && !(parseArgument(argv[1], precision) && precision > 0)) ||
+			(argc > 2 && !(parseArgument(argv[2], ppm) && ppm > 0)) ||
+			(argc > 3 && !(parseArgument(argv[3], repetitions) && repetitions > 0))) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	// CHNOPS monoisotopic masses
+	Weights::alphabet_masses_type masses;
+	masses.push_back(1.007825);
+	masses.push_back(12.0);
+	masses.push_back(14.003074);
+	masses.push_back(15.994915);
+	masses.push_back(30.973762);
+	masses.push_back(31.972071);
+	Weights weights(masses, precision);
+	if (weights.getWeight(0) == 0) {
+		cerr << "precision " << precision << " is too coarse for hydrogen" << endl;
+		printUsage(argv[0]);
+		return 2;
+	}
+	weights.divideByGCD();
+	cerr << "chnops mono weights: " << endl << weights;
+
+	// integer mass intervals of the measured masses
+	vector< pair<value_type, value_type> > intervals;
+	for (double mass = 100.05; mass < 1000; mass += 7.31) {
+		value_type center = static_cast<value_type>(mass / weights.getPrecision());
+		value_type error = static_cast<value_type>(mass * ppm * 1e-6 / weights.getPrecision());
+		intervals.push_back(make_pair(center - error, center + error));
+	}
+
+	decomposer_type decomposer(weights);
+	decomposer_type::bounds_type bounds;
+	Stopwatch stopwatch;
+
+	cout << "# precision\tppm\tdecompositions\tenumerate\tcount\tspeedup\tequal" << endl;
+	for (long repetition = 0; repetition < repetitions; ++repetition) {
+		number_type enumerated = 0;
+		stopwatch.start();
+		for (vector< pair<value_type, value_type> >::const_iterator it = intervals.begin();
+				it != intervals.end(); ++it) {
+			decomposer.visitDecompositions(it->first, it->second, bounds,
+				[&enumerated](const decomposer_type::decomposition_type&) { ++enumerated; });
+		}
+		double enumerate_time = stopwatch.elapsed();
+
+		number_type counted = 0;
+		stopwatch.start();
+		for (vector< pair<value_type, value_type> >::const_iterator it = intervals.begin();
+				it != intervals.end(); ++it) {
+			counted += decomposer.getNumberOfDecompositions(it->first, it->second, bounds);
+		}
+		double count_time = stopwatch.elapsed();
+
+		cout
+			<< precision << '\t'
+			<< ppm << '\t'
+			<< counted << '\t'
+			<< enumerate_time << '\t'
+			<< count_time << '\t'
+			<< enumerate_time / count_time << '\t'
+			<< (enumerated == counted ? "yes" : "no") << endl;
+		if (enumerated != counted) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
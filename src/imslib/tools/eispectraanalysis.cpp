@@ -314,9 +314,6 @@ void initializeCHNOPS(alphabet_t& chnops) {
 	typedef Alphabet::element_type element_type;
 	typedef Alphabet::container elements_type;
 
-	distribution_type::SIZE = 10;
-	distribution_type::ABUNDANCES_SUM_ERROR = 0.0001;
-
 // Hydrogen
 	nominal_mass_type massH = 1;
 	peaks_container peaksH;
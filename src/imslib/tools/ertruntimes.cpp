@@ -0,0 +1,112 @@
+/**
+ * ertruntimes.cpp
+ *
+ * Measures the time to compute the extended residue table of CHNOPS with one
+ * and with several threads.
+ *
+ * Usage: ertruntimes [precision [threads [repetitions]]]
+ *
+ * Invalid arguments print the usage and exit with status 2.
+ */
+
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <thread>
+
+#include <ims/weights.h>
+#include <ims/utils/stopwatch.h>
+#include <ims/utils/threadpool.h>
+#include <ims/decomp/extendedresiduetable.h>
+
+using namespace std;
+using namespace ims;
+
+namespace {
+
+void printUsage(const char* program) {
+	cerr << "Usage: " << program << " [precision [threads [repetitions]]]" << endl
+		 << "  precision    positive precision of the weights, at most about 1 (default 1e-6)" << endl
+		 << "  threads      positive number of threads (default: all cores)" << endl
+		 << "  repetitions  positive number of repetitions (default 3)" << endl;
+}
+
+// reads the whole argument into value, fails on trailing characters
+template <typename T>
+bool parseArgument(const char* argument, T& value) {
+	istringstream argument_string(argument);
+	return (argument_string >> value) && (argument_string >> ws).eof();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	typedef ExtendedResidueTable<unsigned long> table_type;
+	typedef table_type::column_type column_type;
+	typedef vector< pair<size_t, unsigned int> > witness_vector_type;
+
+	// initializes precision, threads and repetitions
+	double precision = 0.000001;
+	long threads = max(thread::hardware_concurrency(), 1u);
+	long repetitions = 3;
+	if (argc > 4 ||
+			(argc > 1 && !(parseArgument(argv[1], precision) && precision > 0)) ||
+			(argc > 2 && !(parseArgument(argv[2], threads) && threads > 0)) ||
+			(argc > 3 && !(parseArgument(argv[3], repetitions) && repetitions > 0))) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	// CHNOPS monoisotopic masses
+	Weights::alphabet_masses_type masses;
+	masses.push_back(1.007825);
+	masses.push_back(12.0);
+	masses.push_back(14.003074);
+	masses.push_back(15.994915);
+	masses.push_back(30.973762);
+	masses.push_back(31.972071);
+	Weights weights(masses, precision);
+	if (weights.getWeight(0) == 0) {
+		cerr << "precision " << precision << " is too coarse for hydrogen" << endl;
+		printUsage(argv[0]);
+		return 2;
+	}
+	cerr << "chnops mono weights: " << endl << weights;
+
+	ThreadPool serial_pool, parallel_pool(static_cast<ThreadPool::size_type>(threads));
+	Stopwatch stopwatch;
+
+	cout << "# precision\tthreads\tserial\tparallel\tspeedup\tequal" << endl;
+	for (long repetition = 0; repetition < repetitions; ++repetition) {
+		column_type serial_lcms(weights.size()), serial_mass_in_lcms(weights.size());
+		witness_vector_type serial_witness_vector;
+		stopwatch.start();
+		table_type serial(weights, serial_lcms, serial_mass_in_lcms, serial_witness_vector,
+						  serial_pool);
+		double serial_time = stopwatch.elapsed();
+
+		column_type lcms(weights.size()), mass_in_lcms(weights.size());
+		witness_vector_type witness_vector;
+		stopwatch.start();
+		table_type parallel(weights, lcms, mass_in_lcms, witness_vector, parallel_pool);
+		double parallel_time = stopwatch.elapsed();
+
+		bool equal = serial.size() == parallel.size() &&
+			std::equal(serial.data(), serial.data() + serial.size(), parallel.data()) &&
+			serial_witness_vector == witness_vector;
+
+		cout
+			<< precision << '\t'
+			<< parallel_pool.size() << '\t'
+			<< serial_time << '\t'
+			<< parallel_time << '\t'
+			<< serial_time / parallel_time << '\t'
+			<< (equal ? "yes" : "no") << endl;
+		if (!equal) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -221,9 +221,6 @@ void initializeCHNOPS(Alphabet& chnops) {
 	typedef Alphabet::element_type element_type;
 	typedef Alphabet::container elements_type;
 
-	distribution_type::SIZE = 10;
-	distribution_type::ABUNDANCES_SUM_ERROR = 0.0001;
-
 // Hydrogren
 	nominal_mass_type massH = 1;	
 	peaks_container peaksH;
@@ -288,7 +288,7 @@ int main(int argc,char **argv) {
 					sum += peaklist_it->second;
 				}
 				// checks if the sum of abundances is 1
-				if (fabs(sum-1) > IsotopeDistribution::ABUNDANCES_SUM_ERROR) {
+				if (fabs(sum-1) > IsotopeDistribution::DEFAULT_ABUNDANCES_SUM_ERROR) {
 					// finds the scale
 					abundance_type scale = 1/sum;
 					// substitutes the old values with new normalized ones
@@ -309,7 +309,7 @@ int main(int argc,char **argv) {
 //					 peaklist_it != it->second.end(); ++peaklist_it) {
 //					sum += peaklist_it->second;
 //				//				// checks if the sum of abundances is 1
-//				if (fabs(sum-1) > IsotopeDistribution::ABUNDANCES_SUM_ERROR) {
+//				if (fabs(sum-1) > IsotopeDistribution::DEFAULT_ABUNDANCES_SUM_ERROR) {
 //					// finds the scale
 //					abundance_type scale = 1/sum;
 //					// substitutes the old values with new normalized ones
@@ -518,7 +518,7 @@ int main(int argc,char **argv) {
 ////				if (size < molecule_with_ions_isotope_distribution.size()) {
 ////					// normalizes the isotope distribution abundances with respect to the number of elements in peaklist				
 ////					abundance_type sum = std::accumulate(theoretical_abundances.begin(), theoretical_abundances.begin() + size, 0.0);
-////					if (fabs(sum - 1) > IsotopeDistribution::ABUNDANCES_SUM_ERROR) {
+////					if (fabs(sum - 1) > IsotopeDistribution::DEFAULT_ABUNDANCES_SUM_ERROR) {
 ////						abundance_type scale = 1/sum;
 ////						std::transform(theoretical_abundances.begin(), theoretical_abundances.begin() + size,	// source range
 ////								theoretical_abundances.begin(), 											// destination
@@ -567,9 +567,6 @@ void initializeCHNOPS(alphabet_t& chnops) {
 	typedef Alphabet::element_type element_type;
 	typedef Alphabet::container elements_type;
 
-	distribution_type::SIZE = 10;
-	distribution_type::ABUNDANCES_SUM_ERROR = 0.0001;
-
 // Hydrogen
 	nominal_mass_type massH = 1;	
 	peaks_container peaksH;
@@ -447,7 +447,7 @@ int main(int argc, char** argv) {
 //				abundance_type sum = accumulate(candidate_abundances.begin(), 
 //												candidate_abundances.begin() + size, 
 //												0.0);
-//				if (fabs(sum - 1) > IsotopeDistribution::ABUNDANCES_SUM_ERROR) {
+//				if (fabs(sum - 1) > IsotopeDistribution::DEFAULT_ABUNDANCES_SUM_ERROR) {
 //					abundance_type scale = 1/sum;
 //					transform(candidate_abundances.begin(),					// begin of source range
 //							candidate_abundances.begin() + size,			// end of source range
@@ -719,9 +719,6 @@ void initializeCHNOPS(alphabet_t& chnops) {
 	typedef Alphabet::element_type element_type;
 	typedef Alphabet::container elements_type;
 
-	distribution_type::SIZE = 10;
-	distribution_type::ABUNDANCES_SUM_ERROR = 0.0001;
-
 // Hydrogen
 	nominal_mass_type massH = 1;
 	peaks_container peaksH;